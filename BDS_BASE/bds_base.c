@@ -3,11 +3,143 @@
  * 基站程序源文件
  * 功能：从ttyS1串口接收原始数据，通过互联网发送出去
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-13
+ * 最后修改时间：2026-10-18
  */
 
 #include "bds_base.h"
 
+// 运行指标编号
+static int m_serial_bytes_in = -1;
+static int m_serial_reads = -1;
+static int m_serial_read_errors = -1;
+static int m_net_bytes_out = -1;
+static int m_net_send_errors = -1;
+static int m_net_dropped_bytes = -1;
+static int m_chunk_bytes_max = -1;
+static int m_reconnects = -1;
+static int m_netlink_events = -1;
+static int m_rtcm_frames = -1;
+static int m_rtcm_crc_errors = -1;
+static int m_rtcm_skipped_bytes = -1;
+static int m_epochs[EPOCH_PASSTHROUGH + 1] = { -1, -1, -1, -1, -1 };
+static int m_epoch_latency_sum = -1;
+static int m_epoch_latency_max = -1;
+static int m_uplink_queue_max = -1;
+static int m_wakeups = -1;
+static int m_heartbeats = -1;
+static int m_heartbeat_echoes = -1;
+static int m_demux_bytes[DEMUX_CHANNELS] = { -1, -1, -1, -1 };
+static int m_demux_check_errors = -1;
+static int m_sched_deferred = -1;
+static int m_sched_decimated = -1;
+static int m_sched_lean_saved = -1;
+static int m_sched_escalations = -1;
+static int m_sched_relaxations = -1;
+static int m_sched_level_max = -1;
+static int m_obs_epochs = -1;
+static int m_obs_incomplete = -1;
+static int m_obs_missing = -1;
+static int m_obs_slips = -1;
+static int m_obs_errors = -1;
+static int m_obs_sats = -1;
+
+/**
+ * @brief 注册基站运行指标
+ */
+static void base_metrics_init(void)
+{
+    m_serial_bytes_in = metrics_register("bds_base_serial_in_bytes_total",
+                                         "Bytes read from the receiver serial port", METRIC_COUNTER);
+    m_serial_reads = metrics_register("bds_base_serial_reads_total",
+                                      "Non-empty serial read calls", METRIC_COUNTER);
+    m_serial_read_errors = metrics_register("bds_base_serial_read_errors_total",
+                                            "Failed serial read calls", METRIC_COUNTER);
+    m_net_bytes_out = metrics_register("bds_base_net_out_bytes_total",
+                                       "Bytes sent to the rover server", METRIC_COUNTER);
+    m_net_send_errors = metrics_register("bds_base_net_send_errors_total",
+                                         "Failed send calls", METRIC_COUNTER);
+    m_net_dropped_bytes = metrics_register("bds_base_net_dropped_bytes_total",
+                                           "Bytes lost by incomplete sends", METRIC_COUNTER);
+    m_chunk_bytes_max = metrics_register("bds_base_serial_chunk_bytes_max",
+                                         "Largest single serial read (backlog high-water mark)", METRIC_GAUGE_MAX);
+    m_reconnects = metrics_register("bds_base_reconnects_total",
+                                    "Upstream connections re-established", METRIC_COUNTER);
+    m_netlink_events = metrics_register("bds_base_netlink_events_total",
+                                        "Address/link/route change notifications", METRIC_COUNTER);
+    m_rtcm_frames = metrics_register("bds_base_rtcm_frames_total",
+                                     "RTCM3 frames with a valid CRC", METRIC_COUNTER);
+    m_rtcm_crc_errors = metrics_register("bds_base_rtcm_crc_errors_total",
+                                         "RTCM3 frames rejected by CRC-24Q", METRIC_COUNTER);
+    m_rtcm_skipped_bytes = metrics_register("bds_base_rtcm_skipped_bytes_total",
+                                            "Bytes discarded while resynchronising", METRIC_COUNTER);
+    m_epochs[EPOCH_COMPLETE] = metrics_register("bds_base_epochs_complete_total",
+                                                "Epochs released on the final message", METRIC_COUNTER);
+    m_epochs[EPOCH_DEADLINE] = metrics_register("bds_base_epochs_deadline_total",
+                                                "Epochs released by the deadline", METRIC_COUNTER);
+    m_epochs[EPOCH_NEXT] = metrics_register("bds_base_epochs_incomplete_total",
+                                            "Epochs released early by the next epoch", METRIC_COUNTER);
+    m_epochs[EPOCH_OVERFLOW] = metrics_register("bds_base_epochs_overflow_total",
+                                                "Partial epoch writes due to a full buffer", METRIC_COUNTER);
+    m_epochs[EPOCH_PASSTHROUGH] = metrics_register("bds_base_epoch_passthrough_total",
+                                                   "Messages sent outside any epoch", METRIC_COUNTER);
+    m_epoch_latency_sum = metrics_register("bds_base_epoch_latency_us_total",
+                                           "Sum of first-frame-to-release latency", METRIC_COUNTER);
+    m_epoch_latency_max = metrics_register("bds_base_epoch_latency_us_max",
+                                           "Worst first-frame-to-release latency", METRIC_GAUGE_MAX);
+    m_uplink_queue_max = metrics_register("bds_base_uplink_queued_bytes_max",
+                                          "Deepest upstream send queue while the socket was full", METRIC_GAUGE_MAX);
+    m_wakeups = metrics_register("bds_base_loop_wakeups_total",
+                                 "Event loop wake-ups (epoll_wait returns)", METRIC_COUNTER);
+    m_heartbeats = metrics_register("bds_base_heartbeats_total",
+                                    "Heartbeats sent to the rover server", METRIC_COUNTER);
+    m_heartbeat_echoes = metrics_register("bds_base_heartbeat_echoes_total",
+                                          "Heartbeat echoes received from the rover server", METRIC_COUNTER);
+    m_demux_bytes[DEMUX_RTCM] = metrics_register("bds_base_demux_rtcm_bytes_total",
+                                                 "Serial bytes in RTCM3 frames (correction link)", METRIC_COUNTER);
+    m_demux_bytes[DEMUX_NMEA] = metrics_register("bds_base_demux_nmea_bytes_total",
+                                                 "Serial bytes in NMEA sentences (telemetry)", METRIC_COUNTER);
+    m_demux_bytes[DEMUX_BINARY] = metrics_register("bds_base_demux_binary_bytes_total",
+                                                   "Serial bytes in vendor binary logs (archive only)", METRIC_COUNTER);
+    m_demux_bytes[DEMUX_OTHER] = metrics_register("bds_base_demux_other_bytes_total",
+                                                  "Serial bytes not recognised as any protocol", METRIC_COUNTER);
+    m_demux_check_errors = metrics_register("bds_base_demux_check_errors_total",
+                                            "Frames with a valid header but a bad checksum", METRIC_COUNTER);
+    m_sched_deferred = metrics_register("bds_base_sched_deferred_total",
+                                        "Station and ephemeris messages queued behind observations",
+                                        METRIC_COUNTER);
+    m_sched_decimated = metrics_register("bds_base_sched_decimated_total",
+                                         "Deferred messages skipped while a link was congested", METRIC_COUNTER);
+    m_sched_lean_saved = metrics_register("bds_base_sched_lean_saved_bytes_total",
+                                          "Bytes saved by sending MSM4 instead of MSM5/7", METRIC_COUNTER);
+    m_sched_escalations = metrics_register("bds_base_sched_escalations_total",
+                                           "Congestion level increases", METRIC_COUNTER);
+    m_sched_relaxations = metrics_register("bds_base_sched_relaxations_total",
+                                           "Congestion level decreases", METRIC_COUNTER);
+    m_sched_level_max = metrics_register("bds_base_sched_level_max",
+                                         "Highest congestion level reached by any destination", METRIC_GAUGE_MAX);
+}
+
+/**
+ * @brief 注册观测质量监测指标（只在启用-Q时注册，未启用的功能不占指标表）
+ */
+static void base_obs_metrics_init(void)
+{
+    m_obs_epochs = metrics_register("bds_base_obs_epochs_total",
+                                    "Observation epochs seen by the quality monitor", METRIC_COUNTER);
+    m_obs_incomplete = metrics_register("bds_base_obs_incomplete_epochs_total",
+                                        "Epochs whose last MSM message never arrived", METRIC_COUNTER);
+    m_obs_missing = metrics_register("bds_base_obs_missing_system_epochs_total",
+                                     "Epochs missing a satellite system present in the previous epoch",
+                                     METRIC_COUNTER);
+    m_obs_slips = metrics_register("bds_base_obs_slips_total",
+                                   "Lock time resets (cycle slips or loss of lock) on tracked signals",
+                                   METRIC_COUNTER);
+    m_obs_errors = metrics_register("bds_base_obs_decode_errors_total",
+                                    "MSM messages the quality monitor could not decode", METRIC_COUNTER);
+    m_obs_sats = metrics_register("bds_base_obs_satellites",
+                                  "Satellites with observations in the latest epoch", METRIC_GAUGE);
+}
+
 /**
  * @brief 初始化串口
  * @param port 串口设备路径
@@ -16,6 +148,7 @@
  */
 int init_serial(const char *port, speed_t baud)
 {
+    // 非阻塞打开：数据到达由epoll通知，read在没有数据时返回EAGAIN
     int fd = open(port, O_RDWR | O_NOCTTY | O_NDELAY);
     if (fd < 0) {
         perror("open serial port failed");
@@ -75,18 +208,20 @@ int init_serial(const char *port, speed_t baud)
 /**
  * @brief 获取本地IP地址
  * @param ifname 网卡名称，如"eth0"、"wlan0"等，如果为NULL则获取第一个可用的非回环IPv4地址
- * @return 成功返回IP地址字符串，失败返回NULL
+ * @param ip 输出的IP地址字符串
+ * @param len 输出缓冲区长度（不小于INET_ADDRSTRLEN）
+ * @return 成功返回0，失败返回-1
  */
-char *get_local_ip(const char *ifname)
+int get_local_ip(const char *ifname, char *ip, size_t len)
 {
     struct ifaddrs *ifaddr, *ifa;
     int family;
-    char *ip = NULL;
+    int found = 0;
 
     // 获取所有网络接口
     if (getifaddrs(&ifaddr) == -1) {
         perror("getifaddrs failed");
-        return NULL;
+        return -1;
     }
 
     printf("Available network interfaces:\n");
@@ -116,20 +251,15 @@ char *get_local_ip(const char *ifname)
             // 如果指定了网卡名称，则只匹配该网卡
             // 否则，返回第一个找到的非回环IPv4地址
             if ((ifname == NULL) || (strcmp(ifa->ifa_name, ifname) == 0)) {
-                ip = malloc(INET_ADDRSTRLEN);
-                if (ip == NULL) {
-                    perror("malloc failed");
-                    freeifaddrs(ifaddr);
-                    return NULL;
-                }
-                strcpy(ip, temp_ip);
+                snprintf(ip, len, "%s", temp_ip);
+                found = 1;
                 break;
             }
         }
     }
 
     // 如果没有找到非回环地址，尝试返回回环地址
-    if (ip == NULL) {
+    if (!found) {
         for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
             if (ifa->ifa_addr == NULL) {
                 continue;
@@ -143,13 +273,8 @@ char *get_local_ip(const char *ifname)
                 
                 // 返回回环地址
                 if (strcmp(temp_ip, "127.0.0.1") == 0) {
-                    ip = malloc(INET_ADDRSTRLEN);
-                    if (ip == NULL) {
-                        perror("malloc failed");
-                        freeifaddrs(ifaddr);
-                        return NULL;
-                    }
-                    strcpy(ip, temp_ip);
+                    snprintf(ip, len, "%s", temp_ip);
+                    found = 1;
                     break;
                 }
             }
@@ -159,14 +284,21 @@ char *get_local_ip(const char *ifname)
     // 释放资源
     freeifaddrs(ifaddr);
 
-    return ip;
+    return found ? 0 : -1;
 }
 
-int init_socket(const char *ip, int port)
+/**
+ * @brief 创建非阻塞socket并发起连接
+ * @param ip 服务器IP地址
+ * @param port 服务器端口号
+ * @param in_progress 输出：连接尚未完成（完成后socket变为可写）时为1
+ * @return 成功返回socket描述符，失败返回-1
+ */
+int init_socket(const char *ip, int port, int *in_progress)
 {
-    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int sock_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sock_fd < 0) {
-        perror("socket creation failed");
+        log_errno("socket creation failed");
         return -1;
     }
 
@@ -181,88 +313,1755 @@ int init_socket(const char *ip, int port)
         return -1;
     }
 
+    *in_progress = 0;
     if (connect(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("connect failed");
-        close(sock_fd);
-        return -1;
+        if (errno != EINPROGRESS) {
+            log_errno("connect to %s:%d failed", ip, port);
+            close(sock_fd);
+            return -1;
+        }
+        *in_progress = 1;
     }
 
     return sock_fd;
 }
 
 /**
- * @brief 从串口读取数据并通过网络发送
- * @param serial_fd 串口文件描述符
- * @param sock_fd socket描述符
+ * @brief 按连接状态更新上行socket关注的epoll事件，仅在变化时调用epoll_ctl
+ * @param up 上行连接状态
  */
-void serial_to_network(int serial_fd, int sock_fd)
+static void uplink_watch(struct uplink *up)
 {
-    char buffer[BUFFER_SIZE];
-    int bytes_read, bytes_sent;
+    // 服务器只下发心跳应答，不发送心跳时只关注对端关闭；连接中、有待发数据或延后电文发出一部分时关注可写
+    // （延后电文等待socket排空由定时器检查，可写事件不反映socket中未发出的字节数）
+    uint32_t events = up->watch_in ? EPOLLIN | EPOLLRDHUP : EPOLLRDHUP;
+    if (up->tls_sess != NULL) {
+        // 加密握手期间只关注握手需要的事件
+        events = up->tls_events | EPOLLRDHUP;
+    } else if (up->connecting || up->queue.count > 0 || up->bulk.head_started) {
+        events |= EPOLLOUT;
+    }
+    if (events == up->events) {
+        return;
+    }
 
-    while (1) {
-        // 从串口读取数据
-        bytes_read = read(serial_fd, buffer, BUFFER_SIZE);
-        if (bytes_read > 0) {
-            // 通过网络发送数据
-            bytes_sent = send(sock_fd, buffer, bytes_read, 0);
-            if (bytes_sent < 0) {
-                perror("send failed");
-                break;
-            } else if (bytes_sent != bytes_read) {
-                fprintf(stderr, "send incomplete data\n");
-            }
-        } else if (bytes_read < 0) {
-            perror("read failed");
-            break;
+    struct epoll_event ev = { .events = events, .data.u32 = BASE_EV_UPLINK | (uint32_t)up->index << 8 };
+    if (epoll_ctl(up->epoll_fd, up->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, up->sock_fd, &ev) != 0) {
+        log_errno("epoll_ctl uplink %s:%d failed", up->ip, up->port);
+        return;
+    }
+    up->events = events;
+}
+
+/**
+ * @brief 连接（含加密握手）完成：开始转发
+ * @param up 上行连接状态
+ */
+static void uplink_ready(struct uplink *up)
+{
+    up->connecting = 0;
+    if (up->tls != NULL) {
+        log_info("Connected to %s:%d via local address %s (%s)", up->ip, up->port, up->local_ip,
+                 tls_mode_name(tls_fd_mode(up->sock_fd)));
+    } else {
+        log_info("Connected to %s:%d via local address %s", up->ip, up->port, up->local_ip);
+    }
+
+    if (up->connects++ > 0) {
+        metrics_inc(m_reconnects);
+    }
+    uplink_watch(up);
+}
+
+/**
+ * @brief 推进加密握手，完成后换成加密后的描述符
+ * @param up 上行连接状态
+ */
+static void uplink_handshake(struct uplink *up)
+{
+    int ret = tls_session_step(up->tls_sess, &up->tls_events);
+    if (ret == 0) {
+        uplink_watch(up);
+        return;
+    }
+    if (ret < 0) {
+        uplink_close(up);
+        up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+        return;
+    }
+
+    // 用户态转发时描述符换成socketpair的一端，TCP socket归转发线程，先移出epoll
+    struct tls_session *sess = up->tls_sess;
+    up->tls_sess = NULL;
+    if (up->events) {
+        epoll_ctl(up->epoll_fd, EPOLL_CTL_DEL, up->sock_fd, NULL);
+        up->events = 0;
+    }
+    int fd = tls_session_done(sess);
+    if (fd < 0) {
+        uplink_close(up);
+        up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+        return;
+    }
+    up->sock_fd = fd;
+    uplink_ready(up);
+}
+
+/**
+ * @brief 连接建立后的处理：记录源地址、开始关注连接事件；加密传输时先握手
+ * @param up 上行连接状态
+ */
+static void uplink_connected(struct uplink *up)
+{
+    if (netmon_socket_source(up->sock_fd, up->local_ip, sizeof(up->local_ip)) != 0) {
+        up->local_ip[0] = '\0';
+    }
+
+    // 握手期间仍按连接中处理：不发送数据，超时后重连
+    if (up->tls != NULL) {
+        up->tls_sess = tls_session_new(up->tls, up->sock_fd, up->ip);
+        if (up->tls_sess == NULL) {
+            uplink_close(up);
+            up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+            return;
         }
+        up->connecting = 1;
+        up->next_retry_ns = bds_now_ns() + CONNECT_TIMEOUT * 1000000000ULL;
+        uplink_handshake(up);
+        return;
     }
+
+    uplink_ready(up);
 }
 
 /**
- * @brief 主函数
- * @return 成功返回0，失败返回-1
+ * @brief 建立上行连接（非阻塞，连接结果由可写事件通知）
+ * @param up 上行连接状态
+ * @return 成功（含连接中）返回socket描述符，失败返回-1
  */
-int main()
+int uplink_connect(struct uplink *up)
 {
-    int serial_fd, sock_fd;
-    char *local_ip = NULL;
-    char *server_ip = SERVER_IP;
-    
-    // 自动获取本地IP地址
-    // 首先尝试获取任何可用的IPv4地址
-    local_ip = get_local_ip(NULL);
-    if (local_ip != NULL) {
-        printf("Local IP address: %s\n", local_ip);
-        free(local_ip);
+    int in_progress;
+
+    up->sock_fd = init_socket(up->ip, up->port, &in_progress);
+    if (up->sock_fd < 0) {
+        up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+        return -1;
+    }
+
+    if (in_progress) {
+        // 连接中的超时时间同样用next_retry_ns记录
+        up->connecting = 1;
+        up->next_retry_ns = bds_now_ns() + CONNECT_TIMEOUT * 1000000000ULL;
+        if (netmon_socket_source(up->sock_fd, up->local_ip, sizeof(up->local_ip)) != 0) {
+            up->local_ip[0] = '\0';
+        }
+        uplink_watch(up);
     } else {
-        printf("Warning: Failed to get local IP address\n");
+        uplink_connected(up);
+    }
+
+    return up->sock_fd;
+}
+
+/**
+ * @brief 接管已建立的上行连接（热升级）
+ * @param up 上行连接状态
+ * @param sock_fd 旧进程交来的socket
+ */
+void uplink_adopt(struct uplink *up, int sock_fd)
+{
+    int flags = fcntl(sock_fd, F_GETFL);
+    if (flags < 0 || fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        log_errno("fcntl O_NONBLOCK failed");
+    }
+
+    up->sock_fd = sock_fd;
+    up->connects = 1;
+    up->connecting = 0;
+    if (netmon_socket_source(sock_fd, up->local_ip, sizeof(up->local_ip)) != 0) {
+        up->local_ip[0] = '\0';
+    }
+    log_info("Took over connection to %s:%d via local address %s", up->ip, up->port, up->local_ip);
+    uplink_watch(up);
+}
+
+/**
+ * @brief 关闭上行连接，下一轮循环立即重连
+ * @param up 上行连接状态
+ */
+void uplink_close(struct uplink *up)
+{
+    if (up->tls_sess != NULL) {
+        tls_session_free(up->tls_sess);
+        up->tls_sess = NULL;
+    }
+    if (up->sock_fd >= 0) {
+        if (up->events) {
+            epoll_ctl(up->epoll_fd, EPOLL_CTL_DEL, up->sock_fd, NULL);
+            up->events = 0;
+        }
+        close(up->sock_fd);
+        up->sock_fd = -1;
+    }
+    // 未发出的数据随连接一起丢弃（释放对共享数据块的引用），新连接从下一块数据开始
+    metrics_add(m_net_dropped_bytes, fanout_queue_clear(up->pool, &up->queue));
+    metrics_add(m_net_dropped_bytes, fanout_queue_clear(up->pool, &up->bulk));
+    up->pump_ns = 0;
+    up->connecting = 0;
+    up->local_ip[0] = '\0';
+    up->next_retry_ns = 0;
+}
+
+/**
+ * @brief 网络变化后检查出口：到服务器的源地址改变或路由消失时立即重建连接
+ * @param up 上行连接状态
+ */
+void uplink_check_route(struct uplink *up)
+{
+    char route_ip[INET_ADDRSTRLEN];
+
+    if (netmon_route_source(up->ip, up->port, route_ip, sizeof(route_ip)) != 0) {
+        if (up->sock_fd >= 0) {
+            log_info("Route to %s lost, closing upstream connection", up->ip);
+            uplink_close(up);
+        }
+        return;
+    }
+
+    if (up->sock_fd >= 0 && strcmp(route_ip, up->local_ip) == 0) {
+        return;
     }
 
-    // 初始化串口
-    serial_fd = init_serial(SERIAL_PORT, BAUD_RATE);
-    if (serial_fd < 0) {
-        fprintf(stderr, "init_serial failed\n");
+    if (up->sock_fd >= 0) {
+        log_info("Route to %s moved from %s to %s, reconnecting", up->ip, up->local_ip, route_ip);
+        uplink_close(up);
+    }
+    uplink_connect(up);
+}
+
+/**
+ * @brief socket中尚未发出的字节数（已发出待确认的部分不计，它们不会推迟新数据）
+ * @param up 上行连接状态
+ * @return 字节数
+ */
+static int uplink_unsent(const struct uplink *up)
+{
+    int unsent = 0;
+
+    // 用户态TLS转发时描述符为socketpair，不支持SIOCOUTQNSD，退回SIOCOUTQ
+    if (ioctl(up->sock_fd, SIOCOUTQNSD, &unsent) != 0 && ioctl(up->sock_fd, SIOCOUTQ, &unsent) != 0) {
+        unsent = 0;
+    }
+    return unsent;
+}
+
+/**
+ * @brief 按类别调度发送：先发完已开始的延后电文，再发实时队列；实时队列为空且socket中未发出的
+ *        字节少于门限时才把延后电文交给socket，观测值前面最多只有门限加一条延后电文。
+ *        同时用积压采样调整该目的地的降级等级
+ * @param up 上行连接状态
+ */
+static void uplink_pump(struct uplink *up)
+{
+    static const char *level_desc[SCHED_MAX_LEVEL + 1] = {
+        "sending all messages", "ephemeris and station messages decimated 1:4",
+        "MSM5/7 sent as MSM4, ephemeris and station messages 1:4",
+        "MSM5/7 sent as MSM4, ephemeris and station messages 1:16"
+    };
+    int bytes_sent = 0;
+
+    up->pump_ns = 0;
+    if (up->sock_fd < 0 || up->connecting) {
+        return;
+    }
+
+    // 积压在交出新数据之前采样：socket中未发出的字节加实时队列（延后队列不计，它只在链路空闲时发送），
+    // 刚写入的一个历元在畅通的链路上也要一个往返才能发出，不应算作拥塞
+    int backlog = uplink_unsent(up) + up->queue.bytes;
+
+    if (up->bulk.head_started) {
+        bytes_sent = fanout_flush_budget(up->pool, &up->bulk, up->sock_fd, 0);
+    }
+    if (bytes_sent >= 0 && !up->bulk.head_started && up->queue.count > 0) {
+        int n = fanout_flush(up->pool, &up->queue, up->sock_fd);
+        bytes_sent = n < 0 ? n : bytes_sent + n;
+    }
+    int unsent = uplink_unsent(up);
+    if (bytes_sent >= 0 && !up->bulk.head_started && up->queue.count == 0 && up->bulk.count > 0 &&
+        unsent < up->sched.low_water) {
+        int n = fanout_flush_budget(up->pool, &up->bulk, up->sock_fd, up->sched.low_water - unsent);
+        bytes_sent = n < 0 ? n : bytes_sent + n;
+    }
+    if (bytes_sent < 0) {
+        metrics_inc(m_net_send_errors);
+        log_errno("send to %s:%d failed", up->ip, up->port);
+        uplink_close(up);
+        return;
+    }
+    metrics_add(m_net_bytes_out, bytes_sent);
+
+    uint64_t now = bds_now_ns();
+    if (up->bulk.count > 0 && !up->bulk.head_started && up->queue.count == 0) {
+        up->pump_ns = now + SCHED_POLL_MS * 1000000ULL;
+    }
+
+    int change = sched_update(&up->sched, backlog, now);
+    if (change != 0) {
+        metrics_inc(change > 0 ? m_sched_escalations : m_sched_relaxations);
+        metrics_max(m_sched_level_max, up->sched.level);
+        log_info("Link to %s:%d %s, level %d: %s", up->ip, up->port, change > 0 ? "congested" : "recovering",
+                 up->sched.level, level_desc[up->sched.level]);
+    }
+    uplink_watch(up);
+}
+
+/**
+ * @brief 通过上行连接发送一条消息：socket发送缓冲区满时剩余部分以数据块引用排队，可写后继续发送；
+ *        队列放不下时按目的地的丢弃策略处理，不影响其他目的地
+ * @param up 上行连接状态
+ * @param m 共享的消息
+ * @return 已发送、已入队或按策略丢弃返回0，未连接或连接被关闭返回-1
+ */
+int uplink_send(struct uplink *up, const struct fanout_msg *m)
+{
+    int bytes_sent;
+
+    if (up->sock_fd < 0 || up->connecting) {
+        metrics_add(m_net_dropped_bytes, m->len);
         return -1;
     }
 
-    // 初始化网络连接
-    sock_fd = init_socket(server_ip, SERVER_PORT);
-    if (sock_fd < 0) {
-        fprintf(stderr, "init_socket failed\n");
-        close(serial_fd);
+    if (up->bulk.head_started) {
+        // 延后电文已发出一部分：字节流中不能插入其他数据，排在实时队列中等它发完
+        bytes_sent = fanout_enqueue(up->pool, &up->queue, m) == -2 ? -2 : 0;
+    } else {
+        bytes_sent = fanout_send(up->pool, &up->queue, up->sock_fd, m);
+    }
+    if (bytes_sent == -2) {
+        // 断开策略：丢弃积压，稍后重连，重连后从新数据开始
+        log_warn("uplink %s:%d queue overflowed, reconnecting", up->ip, up->port);
+        metrics_add(m_net_dropped_bytes, m->len);
+        uplink_close(up);
+        up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+        return -1;
+    }
+    if (bytes_sent < 0) {
+        metrics_inc(m_net_send_errors);
+        metrics_add(m_net_dropped_bytes, m->len);
+        log_errno("send to %s:%d failed", up->ip, up->port);
+        uplink_close(up);
         return -1;
     }
 
-    printf("BDS base station started. Listening on %s, connecting to %s:%d\n", 
-           SERIAL_PORT, server_ip, SERVER_PORT);
+    metrics_add(m_net_bytes_out, bytes_sent);
+    if (up->queue.count > 0) {
+        metrics_max(m_uplink_queue_max, up->queue.bytes);
+    }
+    if (up->scheduled) {
+        uplink_pump(up);
+    } else if (up->queue.count > 0) {
+        uplink_watch(up);
+    }
+    return 0;
+}
 
-    // 开始数据转发
-    serial_to_network(serial_fd, sock_fd);
+/**
+ * @brief 排入延后队列（基站描述和星历电文），由uplink_pump在实时数据之后发送
+ * @param up 上行连接状态
+ * @param m 共享的消息
+ */
+static void uplink_defer(struct uplink *up, const struct fanout_msg *m)
+{
+    if (up->sock_fd < 0 || up->connecting) {
+        metrics_add(m_net_dropped_bytes, m->len);
+        return;
+    }
 
-    // 关闭资源
-    close(serial_fd);
-    close(sock_fd);
+    // 延后队列固定淘汰最旧的电文（新星历取代旧星历），不因低优先级数据断开连接
+    if (fanout_enqueue(up->pool, &up->bulk, m) == 0) {
+        metrics_inc(m_sched_deferred);
+    }
+    uplink_pump(up);
+}
 
-    return 0;
-}
\ No newline at end of file
+/**
+ * @brief socket可写时发送待发队列中的数据
+ * @param up 上行连接状态
+ */
+static void uplink_flush(struct uplink *up)
+{
+    if (up->scheduled) {
+        uplink_pump(up);
+        return;
+    }
+
+    int bytes_sent = fanout_flush(up->pool, &up->queue, up->sock_fd);
+    if (bytes_sent < 0) {
+        metrics_inc(m_net_send_errors);
+        log_errno("send to %s:%d failed", up->ip, up->port);
+        uplink_close(up);
+        return;
+    }
+    metrics_add(m_net_bytes_out, bytes_sent);
+    uplink_watch(up);
+}
+
+/**
+ * @brief 处理上行socket的epoll事件：连接完成、加密握手、可写、对端关闭或出错
+ * @param up 上行连接状态
+ * @param events epoll事件
+ */
+void uplink_event(struct uplink *up, uint32_t events)
+{
+    if (up->tls_sess != NULL) {
+        if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+            log_error("TLS handshake with %s:%d failed: connection closed", up->ip, up->port);
+            uplink_close(up);
+            up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+        } else {
+            uplink_handshake(up);
+        }
+        return;
+    }
+
+    if (up->connecting) {
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (getsockopt(up->sock_fd, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0) {
+            err = errno;
+        }
+        if (err != 0) {
+            errno = err;
+            log_errno("connect to %s:%d failed", up->ip, up->port);
+            uplink_close(up);
+            up->next_retry_ns = bds_now_ns() + RECONNECT_INTERVAL * 1000000000ULL;
+        } else if (events & EPOLLOUT) {
+            uplink_connected(up);
+        }
+        return;
+    }
+
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        log_info("Upstream connection to %s:%d closed", up->ip, up->port);
+        uplink_close(up);
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        uplink_flush(up);
+    }
+}
+
+/**
+ * @brief 把一段观测数据中的MSM5/7改写为MSM4后放入共享数据块
+ * @param ctx 基站转发上下文
+ * @param m 输出的消息
+ * @param buf 按顺序拼接的完整帧
+ * @param len 长度
+ * @return 成功返回0，失败返回-1（调用方改发原数据）
+ */
+static int base_build_lean(struct base_ctx *ctx, struct fanout_msg *m, const unsigned char *buf, int len)
+{
+    int lean_len = sched_lean(buf, len, ctx->lean, sizeof(ctx->lean));
+
+    if (lean_len < 0) {
+        return -1;
+    }
+    return fanout_msg_build(&ctx->pool, m, ctx->lean, lean_len);
+}
+
+/**
+ * @brief 发布一段数据：拷贝一次到共享数据块，再按引用发往各目的地
+ * @param ctx 基站转发上下文
+ * @param only 只发往该目的地（心跳、热升级交来的待发数据），NULL表示发往全部目的地
+ * @param buf 数据
+ * @param len 数据长度（超过FANOUT_MSG_MAX时分成多条消息）
+ */
+static void base_publish(struct base_ctx *ctx, struct uplink *only, const void *buf, int len)
+{
+    const unsigned char *p = buf;
+    struct fanout_msg m;
+
+    while (len > 0) {
+        int n = len < FANOUT_MSG_MAX ? len : FANOUT_MSG_MAX;
+        if (fanout_msg_build(&ctx->pool, &m, p, n) != 0) {
+            metrics_add(m_net_dropped_bytes, n);
+        } else if (only != NULL) {
+            uplink_send(only, &m);
+            fanout_msg_release(&ctx->pool, &m);
+        } else {
+            // 各目的地只增加数据块引用，慢目的地的积压不阻塞其他目的地；
+            // 降级到MSM4的目的地共用一份改写后的数据（只在有目的地需要时改写一次）
+            struct fanout_msg lean;
+            int lean_state = 0;
+            for (int i = 0; i < ctx->up_count; i++) {
+                struct uplink *up = &ctx->ups[i];
+                if (up->sched.level >= SCHED_LEAN_LEVEL) {
+                    if (lean_state == 0) {
+                        lean_state = base_build_lean(ctx, &lean, p, n) == 0 ? 1 : -1;
+                    }
+                    if (lean_state == 1) {
+                        metrics_add(m_sched_lean_saved, m.len - lean.len);
+                        uplink_send(up, &lean);
+                        continue;
+                    }
+                }
+                uplink_send(up, &m);
+            }
+            if (lean_state == 1) {
+                fanout_msg_release(&ctx->pool, &lean);
+            }
+            fanout_msg_release(&ctx->pool, &m);
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief 观测质量监测：数据已交给各目的地之后在原缓冲区上统计，不增加转发延迟
+ * @param ctx 基站转发上下文
+ * @param buf 按顺序拼接的完整帧
+ * @param len 长度
+ */
+static void base_monitor(struct base_ctx *ctx, const unsigned char *buf, int len)
+{
+    struct obsmon *mon = ctx->obsmon;
+
+    if (mon == NULL) {
+        return;
+    }
+
+    uint64_t epochs = mon->epochs_total;
+    uint64_t incomplete = mon->incomplete_total;
+    uint64_t missing = mon->missing_total;
+    uint64_t slips = mon->slips_total;
+    uint64_t errors = mon->errors_total;
+
+    obsmon_push(mon, buf, len);
+    if (mon->epochs_total != epochs) {
+        metrics_add(m_obs_epochs, mon->epochs_total - epochs);
+        metrics_add(m_obs_incomplete, mon->incomplete_total - incomplete);
+        metrics_add(m_obs_missing, mon->missing_total - missing);
+        metrics_set(m_obs_sats, mon->sats);
+    }
+    metrics_add(m_obs_slips, mon->slips_total - slips);
+    metrics_add(m_obs_errors, mon->errors_total - errors);
+}
+
+/**
+ * @brief 观测质量摘要输出回调：每行作为一条记录写入共享内存
+ * @param line 摘要行
+ * @param len 长度
+ * @param arg 基站转发上下文
+ */
+static void base_obs_line(const char *line, int len, void *arg)
+{
+    struct base_ctx *ctx = arg;
+
+    shmring_write(ctx->obs_ring, line, len, bds_now_ns());
+}
+
+/**
+ * @brief 历元输出回调：整个历元一次发送
+ * @param buf 历元数据
+ * @param len 数据长度
+ * @param reason 输出原因
+ * @param first_ns 历元第一帧到达时间
+ * @param arg 基站转发上下文
+ */
+static void base_epoch_emit(const unsigned char *buf, int len, int reason, uint64_t first_ns, void *arg)
+{
+    struct base_ctx *ctx = arg;
+
+    metrics_inc(m_epochs[reason]);
+    if (reason != EPOCH_PASSTHROUGH) {
+        uint64_t latency_us = (bds_now_ns() - first_ns) / 1000;
+        metrics_add(m_epoch_latency_sum, latency_us);
+        metrics_max(m_epoch_latency_max, latency_us);
+    }
+
+    base_publish(ctx, NULL, buf, len);
+    base_monitor(ctx, buf, len);
+}
+
+/**
+ * @brief 发送不组装历元时已分出的完整帧
+ * @param ctx 基站转发上下文
+ */
+static void base_flush_batch(struct base_ctx *ctx)
+{
+    if (ctx->batch_len > 0) {
+        base_publish(ctx, NULL, ctx->batch, ctx->batch_len);
+        base_monitor(ctx, ctx->batch, ctx->batch_len);
+        ctx->batch_len = 0;
+    }
+}
+
+/**
+ * @brief 发布一条延后类电文：按各目的地的降级等级抽稀，保留的排入延后队列（只拷贝一次）
+ * @param ctx 基站转发上下文
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param cls 电文类别
+ */
+static void base_defer(struct base_ctx *ctx, const unsigned char *frame, int len, int cls)
+{
+    struct fanout_msg m;
+    int built = 0;
+
+    for (int i = 0; i < ctx->up_count; i++) {
+        struct uplink *up = &ctx->ups[i];
+        if (!sched_keep(&up->sched, frame, len, cls)) {
+            metrics_inc(m_sched_decimated);
+            continue;
+        }
+        if (!built) {
+            if (fanout_msg_build(&ctx->pool, &m, frame, len) != 0) {
+                metrics_add(m_net_dropped_bytes, len);
+                return;
+            }
+            built = 1;
+        }
+        uplink_defer(up, &m);
+    }
+    if (built) {
+        fanout_msg_release(&ctx->pool, &m);
+    }
+}
+
+/**
+ * @brief 分帧回调：历元组装模式下送入历元组装器，否则合并后原样发送
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param arg 基站转发上下文
+ */
+static void base_frame_cb(const unsigned char *frame, int len, void *arg)
+{
+    struct base_ctx *ctx = arg;
+
+    metrics_inc(m_rtcm_frames);
+
+    // 基站描述和星历不进入历元，排入各目的地的延后队列；uplink_defer会立即泵出队列，
+    // 不组装历元时先发出已合并的观测，延后类电文不能越过同一段串口数据中在它之前的观测
+    if (ctx->sched_mode) {
+        int cls = sched_classify(frame, len);
+        if (cls != SCHED_OBS) {
+            base_flush_batch(ctx);
+            base_defer(ctx, frame, len, cls);
+            return;
+        }
+    }
+
+    if (ctx->epoch_mode) {
+        epoch_push(&ctx->epoch, frame, len, bds_now_ns());
+        return;
+    }
+
+    if (ctx->batch_len + len > (int)sizeof(ctx->batch)) {
+        base_flush_batch(ctx);
+    }
+    memcpy(&ctx->batch[ctx->batch_len], frame, len);
+    ctx->batch_len += len;
+}
+
+/**
+ * @brief 分流回调：RTCM3帧进入转发路径，NMEA语句发布给遥测，二进制日志只在存档中保留
+ * @param channel 通道（enum demux_channel）
+ * @param data 完整帧或无法识别的字节
+ * @param len 长度
+ * @param arg 基站转发上下文
+ */
+static void base_demux_cb(int channel, const unsigned char *data, int len, void *arg)
+{
+    struct base_ctx *ctx = arg;
+
+    metrics_add(m_demux_bytes[channel], len);
+    if (channel == DEMUX_RTCM) {
+        base_frame_cb(data, len, ctx);
+    } else if (channel == DEMUX_NMEA && ctx->nmea_ring != NULL) {
+        // 写共享内存不做系统调用，MQTT客户端等读端自行取用
+        shmring_write(ctx->nmea_ring, data, len, bds_now_ns());
+    }
+}
+
+/**
+ * @brief 分帧并转发一段串口数据：发出的总是完整帧，心跳可以插在任意两次发送之间
+ * @param ctx 基站转发上下文
+ * @param data 串口数据
+ * @param len 数据长度
+ */
+static void base_push_frames(struct base_ctx *ctx, const unsigned char *data, int len)
+{
+    if (ctx->demux_mode) {
+        uint64_t check_errors = ctx->demux.check_errors;
+        demux_push(&ctx->demux, data, len, base_demux_cb, ctx);
+        metrics_add(m_demux_check_errors, ctx->demux.check_errors - check_errors);
+        base_flush_batch(ctx);
+        return;
+    }
+
+    uint64_t crc_errors = ctx->framer.crc_errors;
+    uint64_t skipped = ctx->framer.skipped_bytes;
+
+    rtcm_framer_push(&ctx->framer, data, len, base_frame_cb, ctx);
+    metrics_add(m_rtcm_crc_errors, ctx->framer.crc_errors - crc_errors);
+    metrics_add(m_rtcm_skipped_bytes, ctx->framer.skipped_bytes - skipped);
+    base_flush_batch(ctx);
+}
+
+/**
+ * @brief 向一个目的地发送心跳：序号、当前系统时钟、尚未发出的字节数，以及最近一次应答的时间戳和驻留时间
+ * @param ctx 基站转发上下文
+ * @param up 目的地的上行连接
+ */
+static void base_heartbeat(struct base_ctx *ctx, struct uplink *up)
+{
+    struct heartbeat hb;
+    unsigned char frame[HEARTBEAT_FRAME_LEN];
+    int unsent = 0;
+
+    // socket发送缓冲区中尚未被对端确认的字节
+    if (ioctl(up->sock_fd, SIOCOUTQ, &unsent) != 0) {
+        unsent = 0;
+    }
+
+    memset(&hb, 0, sizeof(hb));
+    hb.kind = HEARTBEAT_BEAT;
+    hb.seq = up->hb_seq++;
+    hb.send_ns = bds_realtime_ns();
+    hb.queued = up->queue.bytes + up->bulk.bytes + unsent;
+    if (up->echo_ns != 0) {
+        uint64_t hold_us = (bds_now_ns() - up->echo_rx_ns) / 1000;
+        hb.echo_ns = up->echo_ns;
+        hb.hold_us = hold_us > UINT32_MAX ? UINT32_MAX : (uint32_t)hold_us;
+    }
+
+    int len = heartbeat_encode(&hb, frame, sizeof(frame));
+    if (len > 0) {
+        base_publish(ctx, up, frame, len);
+        metrics_inc(m_heartbeats);
+    }
+}
+
+/**
+ * @brief 应答分帧回调：记录流动站时间戳和收到的时间，在下一个心跳中带回
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param arg 目的地的上行连接
+ */
+static void base_echo_cb(const unsigned char *frame, int len, void *arg)
+{
+    struct uplink *up = arg;
+    struct heartbeat hb;
+
+    if (heartbeat_decode(frame, len, &hb) == 1 && hb.kind == HEARTBEAT_ECHO) {
+        up->echo_ns = hb.send_ns;
+        up->echo_rx_ns = bds_now_ns();
+        metrics_inc(m_heartbeat_echoes);
+    }
+}
+
+/**
+ * @brief 读取服务器下发的心跳应答
+ * @param up 目的地的上行连接
+ * 注：对端关闭和出错由uplink_event处理
+ */
+static void base_read_uplink(struct uplink *up)
+{
+    unsigned char buffer[BUFFER_SIZE];
+
+    while (1) {
+        ssize_t n = tls_recv(up->sock_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n <= 0) {
+            return;
+        }
+        rtcm_framer_push(&up->echo_framer, buffer, n, base_echo_cb, up);
+        if (n < (ssize_t)sizeof(buffer)) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 交接数据中一个目的地的记录头（其后紧跟queued字节的待发数据）
+ */
+struct base_handoff_dest {
+    char dest[32];             // "ip:port"，新进程按此匹配自己的目的地
+    int32_t has_fd;            // 是否随交接带来了连接（按记录顺序依次取回）
+    uint32_t queued;           // 待发数据字节数
+};
+
+/**
+ * @brief 目的地标识"ip:port"
+ */
+static void base_dest_name(const struct uplink *up, char *name, size_t len)
+{
+    snprintf(name, len, "%s:%d", up->ip, up->port);
+}
+
+/**
+ * @brief 按"ip:port"查找目的地
+ * @return 目的地的上行连接，没有该目的地返回NULL
+ */
+static struct uplink *base_find_uplink(struct base_ctx *ctx, const char *dest)
+{
+    char name[32];
+
+    for (int i = 0; i < ctx->up_count; i++) {
+        base_dest_name(&ctx->ups[i], name, sizeof(name));
+        if (strcmp(name, dest) == 0) {
+            return &ctx->ups[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 把待发队列中的若干段加入交接数据
+ * @param st 交接内容
+ * @param q 待发队列
+ * @param from 起始段（相对队首）
+ * @param to 结束段（不含）
+ * @return 成功返回0，失败返回-1
+ */
+static int base_handoff_segs(struct handoff_state *st, const struct fanout_queue *q, int from, int to)
+{
+    for (int k = from; k < to; k++) {
+        const struct fanout_seg *seg = &q->segs[(q->head + k) % FANOUT_QUEUE_SEGS];
+        if (handoff_add_data(st, seg->chunk + seg->off, seg->len) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 处理新进程的热升级请求：交出描述符和尚未发出的数据
+ * @param ctx 基站转发上下文
+ * @param serial_fd 串口文件描述符
+ * @return 新进程已接管返回0（当前进程应停止转发并退出），没有请求或交接失败返回-1
+ */
+int base_handoff(struct base_ctx *ctx, int serial_fd)
+{
+    static struct handoff_state st;
+    int uplink_fds[BASE_MAX_UPLINKS];
+
+    int conn_fd = handoff_accept(ctx->handoff_fd);
+    if (conn_fd < 0) {
+        return -1;
+    }
+
+    log_info("Hot upgrade requested, handing off");
+
+    handoff_init(&st);
+    if (handoff_add_fd(&st, HANDOFF_FD_CONTROL, ctx->handoff_fd) != 0 ||
+        handoff_add_fd(&st, HANDOFF_FD_METRICS, metrics_http_fd()) != 0 ||
+        handoff_add_fd(&st, HANDOFF_FD_SERIAL, serial_fd) != 0) {
+        close(conn_fd);
+        return -1;
+    }
+
+    // 内核TLS连接与明文一样交给新进程；握手中或用户态转发的连接依赖本进程，新进程重新连接
+    for (int i = 0; i < ctx->up_count; i++) {
+        struct uplink *up = &ctx->ups[i];
+        uplink_fds[i] = up->tls_sess != NULL || up->connecting ? -1 : up->sock_fd;
+        if (uplink_fds[i] >= 0 && tls_fd_mode(uplink_fds[i]) == TLS_MODE_RELAY) {
+            log_info("Upstream TLS to %s:%d runs in a userspace relay, the new process will reconnect",
+                     up->ip, up->port);
+            uplink_fds[i] = -1;
+        }
+        if (handoff_add_fd(&st, HANDOFF_FD_UPLINK, uplink_fds[i]) != 0) {
+            close(conn_fd);
+            return -1;
+        }
+    }
+
+    // 缓存数据：标记和目的地数，每个目的地的记录头 + 待发队列（新进程直接发送），
+    // 分帧模式下再接未输出的历元和不完整的帧（新进程重新分帧继续组装）
+    uint32_t header[2] = { BASE_HANDOFF_MAGIC, (uint32_t)ctx->up_count };
+    int room = HANDOFF_MAX_DATA - (int)sizeof(header) - ctx->up_count * (int)sizeof(struct base_handoff_dest);
+    const unsigned char *partial = ctx->demux_mode ? ctx->demux.buf : ctx->framer.buf;
+    int partial_len = ctx->demux_mode ? ctx->demux.len : ctx->framer.len;
+    if (ctx->framed) {
+        room -= ctx->epoch.len + partial_len;
+    }
+    if (handoff_add_data(&st, header, sizeof(header)) != 0) {
+        close(conn_fd);
+        return -1;
+    }
+    for (int i = 0; i < ctx->up_count; i++) {
+        struct uplink *up = &ctx->ups[i];
+        struct base_handoff_dest rec;
+
+        // 交接数据放不下的队列丢弃，对应连接照常交出
+        memset(&rec, 0, sizeof(rec));
+        base_dest_name(up, rec.dest, sizeof(rec.dest));
+        rec.has_fd = uplink_fds[i] >= 0;
+        int queued = up->queue.bytes + up->bulk.bytes;
+        rec.queued = rec.has_fd && queued <= room ? (uint32_t)queued : 0;
+        if (rec.has_fd && rec.queued < (uint32_t)queued) {
+            log_warn("no room to hand off %d queued bytes for %s", queued, rec.dest);
+        }
+        room -= rec.queued;
+        if (handoff_add_data(&st, &rec, sizeof(rec)) != 0) {
+            close(conn_fd);
+            return -1;
+        }
+        if (rec.queued == 0) {
+            continue;
+        }
+
+        // 已发出一部分的延后电文必须先接上，然后是实时队列，最后是其余延后电文
+        int started = 0;
+        while (up->bulk.head_started && started < up->bulk.count &&
+               !up->bulk.segs[(up->bulk.head + started++) % FANOUT_QUEUE_SEGS].msg_end) {
+        }
+        if (base_handoff_segs(&st, &up->bulk, 0, started) != 0 ||
+            base_handoff_segs(&st, &up->queue, 0, up->queue.count) != 0 ||
+            base_handoff_segs(&st, &up->bulk, started, up->bulk.count) != 0) {
+            close(conn_fd);
+            return -1;
+        }
+    }
+    if (ctx->framed &&
+        (handoff_add_data(&st, ctx->epoch.buf, ctx->epoch.len) != 0 ||
+         handoff_add_data(&st, partial, partial_len) != 0)) {
+        close(conn_fd);
+        return -1;
+    }
+
+    if (handoff_send(conn_fd, &st) != 0) {
+        return -1;
+    }
+
+    log_info("Handed off to the new process (%d bytes of data)", st.data_len);
+    return 0;
+}
+
+/**
+ * @brief 热升级：从运行中的旧进程接管串口、各目的地的上行连接和指标端点
+ * @param ctx 基站转发上下文（历元组装器和各目的地须已初始化）
+ * @param serial_fd 输出的串口文件描述符
+ * @return 成功返回0，失败返回-1（旧进程继续运行）
+ */
+int base_takeover(struct base_ctx *ctx, int *serial_fd)
+{
+    static struct handoff_state st;
+    uint32_t header[2] = { 0, 0 };
+    const unsigned char *data;
+    int rest;
+
+    if (handoff_request(HANDOFF_NAME, &st) != 0) {
+        return -1;
+    }
+
+    *serial_fd = handoff_take_fd(&st, HANDOFF_FD_SERIAL);
+    if (*serial_fd < 0) {
+        fprintf(stderr, "handoff carried no serial port\n");
+        handoff_release(&st);
+        return -1;
+    }
+    ctx->handoff_fd = handoff_take_fd(&st, HANDOFF_FD_CONTROL);
+
+    int metrics_fd = handoff_take_fd(&st, HANDOFF_FD_METRICS);
+    if (metrics_fd >= 0 && metrics_serve_fd(metrics_fd) != 0) {
+        close(metrics_fd);
+    }
+
+    // 未被接管的目的地按定时重连处理
+    for (int i = 0; i < ctx->up_count; i++) {
+        ctx->ups[i].next_retry_ns = 0;
+    }
+
+    if (st.data_len >= (int)sizeof(header)) {
+        memcpy(header, st.data, sizeof(header));
+    }
+    // 交接格式版本已由handoff_request校验，版本一致的旧进程总是先写状态头
+    if (header[0] != BASE_HANDOFF_MAGIC) {
+        fprintf(stderr, "invalid in-flight data in handoff\n");
+        handoff_release(&st);
+        return 0;
+    }
+
+    // 沿用旧进程的TCP连接，服务器看不到断线重连；旧进程的连接按记录顺序依次取回，
+    // 按"ip:port"交给同一目的地，已不在目的地列表中的连接关闭
+    data = &st.data[sizeof(header)];
+    rest = st.data_len - (int)sizeof(header);
+    for (uint32_t i = 0; i < header[1]; i++) {
+        struct base_handoff_dest rec;
+
+        if (rest < (int)sizeof(rec)) {
+            fprintf(stderr, "invalid in-flight data in handoff\n");
+            handoff_release(&st);
+            return 0;
+        }
+        memcpy(&rec, data, sizeof(rec));
+        rec.dest[sizeof(rec.dest) - 1] = '\0';
+        data += sizeof(rec);
+        rest -= sizeof(rec);
+        if (rec.queued > (uint32_t)rest) {
+            fprintf(stderr, "invalid in-flight data in handoff\n");
+            handoff_release(&st);
+            return 0;
+        }
+
+        struct uplink *up = base_find_uplink(ctx, rec.dest);
+        int sock_fd = rec.has_fd ? handoff_take_fd(&st, HANDOFF_FD_UPLINK) : -1;
+        if (sock_fd >= 0 && (up == NULL || up->sock_fd >= 0)) {
+            printf("Closing handed-off connection to %s, no longer a destination\n", rec.dest);
+            close(sock_fd);
+        } else if (sock_fd >= 0) {
+            uplink_adopt(up, sock_fd);
+            // 旧进程未发出的数据先于串口新数据发送
+            base_publish(ctx, up, data, rec.queued);
+        }
+        data += rec.queued;
+        rest -= rec.queued;
+    }
+    handoff_release(&st);
+
+    // 未输出的历元和不完整的帧重新分帧，发往全部目的地
+    if (rest > 0) {
+        if (ctx->framed) {
+            base_push_frames(ctx, data, rest);
+        } else {
+            base_publish(ctx, NULL, data, rest);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 读取串口中已到达的全部数据并转发
+ * @param ctx 基站转发上下文
+ * @param serial_fd 串口文件描述符
+ * @return 成功返回0，串口出错或挂断返回-1
+ */
+static int base_read_serial(struct base_ctx *ctx, int serial_fd)
+{
+    unsigned char buffer[BUFFER_SIZE];
+    int bytes_read;
+
+    while (1) {
+        bytes_read = read(serial_fd, buffer, BUFFER_SIZE);
+        if (bytes_read < 0) {
+            // 数据已读完；被信号打断时重读
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            metrics_inc(m_serial_read_errors);
+            log_errno("serial read failed");
+            return -1;
+        } else if (bytes_read == 0) {
+            // 非阻塞串口无数据时返回EAGAIN，返回0表示挂断，继续等待会使epoll反复就绪
+            log_error("serial port hung up");
+            return -1;
+        }
+
+        metrics_inc(m_serial_reads);
+        metrics_add(m_serial_bytes_in, bytes_read);
+        metrics_max(m_chunk_bytes_max, bytes_read);
+
+        // 存档只拷贝到环形缓冲区，压缩和写盘在后台线程完成
+        if (ctx->archive != NULL) {
+            archive_write(ctx->archive, buffer, bytes_read);
+        }
+
+        if (ctx->framed) {
+            // 分帧后发送（历元组装模式下一个历元一次发送）
+            base_push_frames(ctx, buffer, bytes_read);
+        } else {
+            // 发往全部目的地（只拷贝一次）
+            base_publish(ctx, NULL, buffer, bytes_read);
+        }
+
+        // 没有读满说明驱动缓冲区已空，省去一次必然返回EAGAIN的read
+        if (bytes_read < BUFFER_SIZE) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief 按最近的到期时间设置定时器：各目的地的断线重连或连接超时、下次心跳、延后电文检查，历元截止时间，
+ *        观测质量摘要
+ * @param ctx 基站转发上下文
+ */
+static void base_arm_timer(struct base_ctx *ctx)
+{
+    uint64_t next = 0;
+
+    for (int i = 0; i < ctx->up_count; i++) {
+        const struct uplink *up = &ctx->ups[i];
+        uint64_t due = 0;
+
+        // 到期时间为0表示立即重连，定时器用1纳秒（已过去的时间）立即触发
+        if (up->sock_fd < 0 || up->connecting) {
+            due = up->next_retry_ns > 0 ? up->next_retry_ns : 1;
+        } else if (ctx->hb_interval_ns > 0) {
+            due = up->hb_next_ns > 0 ? up->hb_next_ns : 1;
+        }
+        if (due > 0 && (next == 0 || due < next)) {
+            next = due;
+        }
+        if (up->pump_ns > 0 && up->sock_fd >= 0 && (next == 0 || up->pump_ns < next)) {
+            next = up->pump_ns;
+        }
+    }
+    if (ctx->epoch_mode && ctx->epoch.open) {
+        uint64_t deadline = ctx->epoch.first_ns + ctx->epoch.deadline_ns;
+        if (next == 0 || deadline < next) {
+            next = deadline;
+        }
+    }
+    if (ctx->obsmon != NULL && (next == 0 || ctx->obs_next_ns < next)) {
+        next = ctx->obs_next_ns;
+    }
+
+    // 与已设置的时间相同时不再调用timerfd_settime
+    if (next == ctx->timer_ns) {
+        return;
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = next / 1000000000ULL;
+    its.it_value.tv_nsec = next % 1000000000ULL;
+    if (timerfd_settime(ctx->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) != 0) {
+        log_errno("timerfd_settime failed");
+        return;
+    }
+    ctx->timer_ns = next;
+}
+
+/**
+ * @brief 定时器到期：历元截止、观测质量摘要，以及各目的地的断线重连、连接超时、发送心跳、发送延后电文
+ * @param ctx 基站转发上下文
+ */
+static void base_timer(struct base_ctx *ctx)
+{
+    uint64_t expirations;
+
+    if (read(ctx->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        log_errno("timerfd read failed");
+    }
+    ctx->timer_ns = 0;
+
+    uint64_t now = bds_now_ns();
+
+    // 末条电文丢失时按截止时间输出历元
+    if (ctx->epoch_mode) {
+        epoch_poll(&ctx->epoch, now);
+    }
+
+    // 按周期输出观测质量摘要（写共享内存，由MQTT客户端发布）
+    if (ctx->obsmon != NULL && now >= ctx->obs_next_ns) {
+        obsmon_report(ctx->obsmon, bds_realtime_ns(), base_obs_line, ctx);
+        ctx->obs_next_ns = now + ctx->obs_interval_ns;
+    }
+
+    for (int i = 0; i < ctx->up_count; i++) {
+        struct uplink *up = &ctx->ups[i];
+
+        if (up->connecting && now >= up->next_retry_ns) {
+            log_warn("connect to %s:%d timed out", up->ip, up->port);
+            uplink_close(up);
+            up->next_retry_ns = now + RECONNECT_INTERVAL * 1000000000ULL;
+        } else if (up->sock_fd < 0 && now >= up->next_retry_ns) {
+            // 连接断开后定时重连
+            uplink_connect(up);
+        } else if (ctx->hb_interval_ns > 0 && up->sock_fd >= 0 && !up->connecting && now >= up->hb_next_ns) {
+            // 发出的总是完整帧，心跳不会插在帧中间
+            base_heartbeat(ctx, up);
+            up->hb_next_ns = now + ctx->hb_interval_ns;
+        }
+        if (up->pump_ns > 0 && now >= up->pump_ns) {
+            uplink_pump(up);
+        }
+    }
+}
+
+/**
+ * @brief 把描述符加入基站的epoll
+ * @param epoll_fd epoll描述符
+ * @param fd 描述符（小于0时忽略）
+ * @param tag 事件来源（enum base_event）
+ * @return 成功返回0，失败返回-1
+ */
+static int base_watch(int epoll_fd, int fd, uint32_t tag)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = tag };
+
+    if (fd < 0) {
+        return 0;
+    }
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 从串口读取数据并通过网络发送
+ * @param serial_fd 串口文件描述符
+ * @param ctx 基站转发上下文（上行连接断开后自动重连）
+ *
+ * 串口、上行socket、netlink、交接请求、定时器和退出信号都由epoll等待，
+ * 没有数据和到期的定时器时线程阻塞在epoll_wait中，不占用CPU
+ */
+void serial_to_network(int serial_fd, struct base_ctx *ctx)
+{
+    struct epoll_event events[BASE_MAX_EVENTS];
+
+    if (base_watch(ctx->epoll_fd, serial_fd, BASE_EV_SERIAL) != 0 ||
+        base_watch(ctx->epoll_fd, ctx->netmon_fd, BASE_EV_NETMON) != 0 ||
+        base_watch(ctx->epoll_fd, ctx->handoff_fd, BASE_EV_HANDOFF) != 0 ||
+        base_watch(ctx->epoll_fd, ctx->timer_fd, BASE_EV_TIMER) != 0 ||
+        base_watch(ctx->epoll_fd, ctx->signal_fd, BASE_EV_SIGNAL) != 0) {
+        return;
+    }
+
+    while (1) {
+        base_arm_timer(ctx);
+
+        int n = epoll_wait(ctx->epoll_fd, events, BASE_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_errno("epoll_wait failed");
+            return;
+        }
+        metrics_inc(m_wakeups);
+
+        for (int i = 0; i < n; i++) {
+            struct uplink *up = &ctx->ups[(events[i].data.u32 >> 8) % BASE_MAX_UPLINKS];
+
+            switch (events[i].data.u32 & 0xff) {
+            case BASE_EV_SERIAL:
+                if (base_read_serial(ctx, serial_fd) != 0) {
+                    return;
+                }
+                break;
+            case BASE_EV_UPLINK:
+                // 同一批事件中连接可能已被关闭
+                if (up->sock_fd >= 0 && !up->connecting && (events[i].events & EPOLLIN)) {
+                    base_read_uplink(up);
+                }
+                if (up->sock_fd >= 0) {
+                    uplink_event(up, events[i].events);
+                }
+                break;
+            case BASE_EV_NETMON:
+                // 网络接口或路由变化时立即检查出口，不等待TCP超时
+                if (netmon_read(ctx->netmon_fd) > 0) {
+                    metrics_inc(m_netlink_events);
+                    for (int k = 0; k < ctx->up_count; k++) {
+                        uplink_check_route(&ctx->ups[k]);
+                    }
+                }
+                break;
+            case BASE_EV_TIMER:
+                base_timer(ctx);
+                break;
+            case BASE_EV_HANDOFF:
+                // 新版本程序请求接管时交出描述符，对方确认后停止转发
+                if (base_handoff(ctx, serial_fd) == 0) {
+                    return;
+                }
+                break;
+            case BASE_EV_SIGNAL: {
+                struct signalfd_siginfo si;
+                if (read(ctx->signal_fd, &si, sizeof(si)) == sizeof(si)) {
+                    log_info("Received signal %u, exiting", si.ssi_signo);
+                    return;
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 解析目的地参数 host:port[,drop-new|drop-old|disconnect][,queue_kb]
+ * @param arg 参数字符串（host为IPv4地址）
+ * @param dest 输出的目的地
+ * @return 成功返回0，失败返回-1
+ */
+int parse_dest(const char *arg, struct base_dest *dest)
+{
+    char buf[64];
+    struct in_addr addr;
+    char *save = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", arg);
+    dest->policy = FANOUT_DROP_NEW;
+    dest->queue_kb = UPLINK_QUEUE_SIZE / 1024;
+
+    char *host = strtok_r(buf, ",", &save);
+    char *colon = host != NULL ? strrchr(host, ':') : NULL;
+    if (colon == NULL) {
+        fprintf(stderr, "destination must be host:port: %s\n", arg);
+        return -1;
+    }
+    *colon = '\0';
+    dest->port = atoi(colon + 1);
+    if (inet_pton(AF_INET, host, &addr) != 1 || dest->port <= 0 || dest->port > 65535) {
+        fprintf(stderr, "invalid destination address: %s\n", arg);
+        return -1;
+    }
+    snprintf(dest->ip, sizeof(dest->ip), "%s", host);
+
+    // 其余字段：丢弃策略名称或队列上限（KB）
+    for (char *tok = strtok_r(NULL, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        if (tok[0] >= '0' && tok[0] <= '9') {
+            dest->queue_kb = atoi(tok);
+            if (dest->queue_kb <= 0 || dest->queue_kb > FANOUT_QUEUE_SEGS * FANOUT_CHUNK_SIZE / 1024) {
+                fprintf(stderr, "destination queue must be 1..%d KB\n", FANOUT_QUEUE_SEGS * FANOUT_CHUNK_SIZE / 1024);
+                return -1;
+            }
+        } else if (fanout_policy_parse(tok, &dest->policy) != 0) {
+            fprintf(stderr, "unknown drop policy %s (drop-new, drop-old or disconnect)\n", tok);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @param opts 输出的运行参数
+ * @return 成功返回0，失败返回-1
+ */
+int parse_options(int argc, char *argv[], struct base_options *opts)
+{
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->serial_port = SERIAL_PORT;
+
+    while ((c = getopt(argc, argv, "m:r:c:e:a:ud:H:T:M:o:Dn:P:Q:G:h")) != -1) {
+        switch (c) {
+        case 'm':
+            opts->metrics_port = atoi(optarg);
+            break;
+        case 'r':
+            opts->rt.priority = atoi(optarg);
+            if (opts->rt.priority < 1 || opts->rt.priority > 99) {
+                fprintf(stderr, "SCHED_FIFO priority must be 1..99\n");
+                return -1;
+            }
+            break;
+        case 'c':
+            if (rt_parse_cpus(optarg, &opts->rt) != 0) {
+                return -1;
+            }
+            break;
+        case 'e':
+            opts->epoch_deadline_ms = atoi(optarg);
+            if (opts->epoch_deadline_ms <= 0) {
+                fprintf(stderr, "epoch deadline must be positive\n");
+                return -1;
+            }
+            break;
+        case 'a':
+            opts->archive_dir = optarg;
+            break;
+        case 'u':
+            opts->upgrade = 1;
+            break;
+        case 'd':
+            opts->serial_port = optarg;
+            break;
+        case 'H':
+            opts->heartbeat_ms = atoi(optarg);
+            if (opts->heartbeat_ms <= 0) {
+                fprintf(stderr, "heartbeat interval must be positive\n");
+                return -1;
+            }
+            break;
+        case 'T':
+            opts->tls_ca = optarg;
+            break;
+        case 'M':
+            opts->budget_kb = atoi(optarg);
+            if (opts->budget_kb <= 0) {
+                fprintf(stderr, "memory budget must be positive\n");
+                return -1;
+            }
+            break;
+        case 'o':
+            if (opts->dest_count == BASE_MAX_UPLINKS) {
+                fprintf(stderr, "at most %d destinations\n", BASE_MAX_UPLINKS);
+                return -1;
+            }
+            if (parse_dest(optarg, &opts->dests[opts->dest_count]) != 0) {
+                return -1;
+            }
+            for (int i = 0; i < opts->dest_count; i++) {
+                if (strcmp(opts->dests[i].ip, opts->dests[opts->dest_count].ip) == 0 &&
+                    opts->dests[i].port == opts->dests[opts->dest_count].port) {
+                    fprintf(stderr, "duplicate destination %s\n", optarg);
+                    return -1;
+                }
+            }
+            opts->dest_count++;
+            break;
+        case 'D':
+            opts->demux = 1;
+            break;
+        case 'n':
+            // 发布NMEA语句需要先分流
+            opts->demux = 1;
+            opts->nmea_ring = optarg;
+            break;
+        case 'P':
+            opts->sched_kb = atoi(optarg);
+            if (opts->sched_kb < 1 || opts->sched_kb > 64) {
+                fprintf(stderr, "deferral threshold must be 1..64 KB\n");
+                return -1;
+            }
+            break;
+        case 'Q': {
+            // 共享内存名称[:摘要周期]
+            char *colon;
+            snprintf(opts->obs_ring, sizeof(opts->obs_ring), "%s", optarg);
+            opts->obs_interval_s = OBSMON_INTERVAL_S;
+            if ((colon = strchr(opts->obs_ring, ':')) != NULL) {
+                *colon = '\0';
+                opts->obs_interval_s = atoi(colon + 1);
+            }
+            if (opts->obs_ring[0] == '\0' || opts->obs_interval_s < 1 || opts->obs_interval_s > 3600) {
+                fprintf(stderr, "quality monitor needs ring_name[:interval_s], interval 1..3600\n");
+                return -1;
+            }
+            break;
+        }
+        case 'G':
+            opts->log_file = optarg;
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [-m metrics_port] [-r rt_priority] [-c cpu_list] "
+                    "[-e epoch_deadline_ms] [-a archive_dir] [-u] [-d serial_device] "
+                    "[-H heartbeat_ms] [-T tls_ca.pem] [-M budget_kb] [-D] [-n nmea_ring_name] [-P defer_kb] "
+                    "[-Q obs_ring_name[:interval_s]] [-G log_file] "
+                    "[-o host:port[,drop-new|drop-old|disconnect][,queue_kb]]...\n", argv[0]);
+            return -1;
+        }
+    }
+
+    // 未指定目的地时连接默认服务器
+    if (opts->dest_count == 0) {
+        snprintf(opts->dests[0].ip, sizeof(opts->dests[0].ip), "%s", SERVER_IP);
+        opts->dests[0].port = SERVER_PORT;
+        opts->dests[0].policy = FANOUT_DROP_NEW;
+        opts->dests[0].queue_kb = UPLINK_QUEUE_SIZE / 1024;
+        opts->dest_count = 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回-1
+ */
+int main(int argc, char *argv[])
+{
+    int serial_fd = -1;
+    char route_ip[INET_ADDRSTRLEN];
+    struct base_options opts;
+    static struct base_ctx ctx;
+
+    if (parse_options(argc, argv, &opts) != 0) {
+        return -1;
+    }
+
+    // 注册运行指标
+    base_metrics_init();
+
+    // 退出信号：在创建任何线程之前屏蔽，由signalfd交给事件循环，结束转发后正常关闭存档文件
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    ctx.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    // 事件循环：epoll等待全部描述符，timerfd负责重连、连接超时和历元截止时间
+    ctx.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    ctx.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ctx.signal_fd < 0 || ctx.epoll_fd < 0 || ctx.timer_fd < 0) {
+        perror("event loop setup failed");
+        return -1;
+    }
+
+    // 异步日志：转发路径上的错误和状态变化只写入本线程的环形缓冲区，由后台线程格式化输出
+    if (log_start("bds_base", opts.log_file) != 0) {
+        return -1;
+    }
+
+    // 存档：后台线程在实时设置之前创建，不继承转发线程的SCHED_FIFO和CPU绑定
+    if (opts.archive_dir != NULL) {
+        ctx.archive = archive_start(opts.archive_dir, "bds_base");
+        if (ctx.archive == NULL) {
+            fprintf(stderr, "archive setup failed\n");
+            return -1;
+        }
+    }
+
+    // 历元组装：同一历元的电文合并为一次发送
+    if (opts.epoch_deadline_ms > 0) {
+        ctx.epoch_mode = 1;
+        ctx.framed = 1;
+        rtcm_framer_init(&ctx.framer);
+        epoch_init(&ctx.epoch, opts.epoch_deadline_ms, base_epoch_emit, &ctx);
+        printf("Epoch assembly enabled, deadline %d ms\n", opts.epoch_deadline_ms);
+    }
+
+    // 心跳：在帧边界插入，不组装历元时同样需要分帧
+    if (opts.heartbeat_ms > 0) {
+        ctx.framed = 1;
+        ctx.hb_interval_ns = opts.heartbeat_ms * 1000000ULL;
+        rtcm_framer_init(&ctx.framer);
+        printf("Heartbeat enabled, interval %d ms\n", opts.heartbeat_ms);
+    }
+
+    // 分流：只有RTCM3帧进入转发路径，NMEA语句和二进制日志不占用改正数链路
+    if (opts.demux) {
+        ctx.demux_mode = 1;
+        ctx.framed = 1;
+        demux_init(&ctx.demux);
+        printf("Demultiplexing serial input, only RTCM3 frames are forwarded\n");
+    }
+
+    // 按类别调度：观测值立即发送，基站描述和星历延后到链路空闲，持续拥塞时逐级降级
+    if (opts.sched_kb > 0) {
+        ctx.sched_mode = 1;
+        ctx.framed = 1;
+        rtcm_framer_init(&ctx.framer);
+        printf("Scheduling by message class, deferring station and ephemeris messages until less than "
+               "%d KB is unsent\n", opts.sched_kb);
+    }
+
+    // 观测质量监测：转发过的MSM电文逐历元统计，按周期输出摘要
+    if (opts.obs_ring[0] != '\0') {
+        ctx.framed = 1;
+        rtcm_framer_init(&ctx.framer);
+        ctx.obsmon = pool_alloc("base", "observation monitor", sizeof(*ctx.obsmon), 1, POOL_SHARED);
+        if (ctx.obsmon == NULL) {
+            archive_stop(ctx.archive);
+            return -1;
+        }
+        obsmon_init(ctx.obsmon);
+        base_obs_metrics_init();
+        ctx.obs_interval_ns = opts.obs_interval_s * 1000000000ULL;
+        ctx.obs_next_ns = bds_now_ns() + ctx.obs_interval_ns;
+    }
+
+    // 各目的地共享的数据块池：每个目的地的队列最多引用FANOUT_QUEUE_SEGS块，
+    // 再留出正在发布的一条消息，慢目的地再多的积压也不会让其他目的地取不到数据块；
+    // 调度时每个目的地还有延后队列，正在发布的消息还有改写为MSM4的一份
+    int queues = ctx.sched_mode ? 2 : 1;
+    if (fanout_pool_init(&ctx.pool, "base", opts.dest_count * queues * FANOUT_QUEUE_SEGS +
+                                            queues * FANOUT_MSG_CHUNKS) != 0) {
+        archive_stop(ctx.archive);
+        return -1;
+    }
+
+    // 加密传输：握手在用户态完成，密钥装入内核TLS后发送路径不变
+    struct tls_config *tls = NULL;
+    if (opts.tls_ca != NULL) {
+        tls = tls_client_config(opts.tls_ca);
+        if (tls == NULL) {
+            archive_stop(ctx.archive);
+            return -1;
+        }
+        printf("TLS enabled, verifying server addresses against %s\n", opts.tls_ca);
+    }
+
+    // 每个目的地独立的连接、待发队列、丢弃策略、重连和心跳状态
+    ctx.up_count = opts.dest_count;
+    for (int i = 0; i < ctx.up_count; i++) {
+        struct uplink *up = &ctx.ups[i];
+        const struct base_dest *dest = &opts.dests[i];
+
+        snprintf(up->ip, sizeof(up->ip), "%s", dest->ip);
+        up->port = dest->port;
+        up->index = i;
+        up->sock_fd = -1;
+        up->epoll_fd = ctx.epoll_fd;
+        up->tls = tls;
+        up->pool = &ctx.pool;
+        fanout_queue_init(&up->queue, dest->queue_kb * 1024, dest->policy);
+        if (ctx.sched_mode) {
+            up->scheduled = 1;
+            fanout_queue_init(&up->bulk, dest->queue_kb * 1024, FANOUT_DROP_OLD);
+            sched_link_init(&up->sched, opts.sched_kb * 1024);
+        }
+        if (opts.heartbeat_ms > 0) {
+            up->watch_in = 1;
+            rtcm_framer_init(&up->echo_framer);
+        }
+        printf("Destination %d: %s:%d, %s, queue %d KB\n", i, up->ip, up->port,
+               fanout_policy_name(dest->policy), dest->queue_kb);
+    }
+    ctx.handoff_fd = -1;
+
+    // 热升级：接管旧进程的描述符（含指标监听套接字，指标线程同样须在实时设置之前创建）；
+    // 交接后到开始转发之前到达的数据暂存在串口和socket的内核缓冲区中，不会丢失
+    if (opts.upgrade && base_takeover(&ctx, &serial_fd) != 0) {
+        fprintf(stderr, "hot upgrade failed\n");
+        archive_stop(ctx.archive);
+        return -1;
+    }
+
+    // 按需启动HTTP指标端点（热升级时已沿用旧进程的监听套接字）
+    if (opts.metrics_port > 0 && metrics_http_fd() < 0 && metrics_start_http(opts.metrics_port) != 0) {
+        fprintf(stderr, "Warning: metrics endpoint disabled\n");
+    }
+
+    // 实时模式：锁定内存、预缺页，转发线程绑核并切换到SCHED_FIFO
+    if (opts.rt.priority > 0 || opts.rt.cpu_count > 0) {
+        if (rt_setup_process() != 0 || rt_setup_thread(&opts.rt, "forward") != 0) {
+            fprintf(stderr, "real-time setup failed\n");
+            return -1;
+        }
+        rt_start_monitor(&opts.rt);
+    }
+
+    // 监听网络接口、地址和路由变化，出口改变时立即重连
+    ctx.netmon_fd = netmon_open();
+    if (ctx.netmon_fd < 0) {
+        printf("Warning: netlink monitor unavailable, relying on TCP errors\n");
+    }
+
+    if (!opts.upgrade) {
+        // 打印当前到各服务器的出口源地址
+        for (int i = 0; i < ctx.up_count; i++) {
+            if (netmon_route_source(ctx.ups[i].ip, ctx.ups[i].port, route_ip, sizeof(route_ip)) == 0) {
+                printf("Local IP address for %s: %s\n", ctx.ups[i].ip, route_ip);
+            } else {
+                printf("Warning: No route to %s\n", ctx.ups[i].ip);
+            }
+        }
+
+        // 初始化串口
+        serial_fd = init_serial(opts.serial_port, BAUD_RATE);
+        if (serial_fd < 0) {
+            fprintf(stderr, "init_serial failed\n");
+            return -1;
+        }
+
+        // 初始化网络连接（地址已在解析参数时校验，失败的目的地按定时重连处理，不影响其他目的地）
+        for (int i = 0; i < ctx.up_count; i++) {
+            if (uplink_connect(&ctx.ups[i]) < 0) {
+                fprintf(stderr, "connect to %s:%d failed, retrying\n", ctx.ups[i].ip, ctx.ups[i].port);
+            }
+        }
+
+        // 接受以后新版本程序的热升级请求
+        ctx.handoff_fd = handoff_listen(HANDOFF_NAME);
+    }
+
+    // NMEA语句发布到共享内存：同名缓冲区已存在时接着写，MQTT客户端等读端不受重启和热升级影响
+    if (opts.nmea_ring != NULL) {
+        ctx.nmea_ring = shmring_create(opts.nmea_ring, SHMRING_DEFAULT_SIZE);
+        if (ctx.nmea_ring == NULL) {
+            fprintf(stderr, "shared memory ring setup failed\n");
+            close(serial_fd);
+            archive_stop(ctx.archive);
+            return -1;
+        }
+        printf("Publishing NMEA sentences to shared memory %s\n", ctx.nmea_ring->name);
+    }
+
+    // 观测质量摘要发布到共享内存，与NMEA语句相同由MQTT客户端读取
+    if (ctx.obsmon != NULL) {
+        ctx.obs_ring = shmring_create(opts.obs_ring, SHMRING_DEFAULT_SIZE);
+        if (ctx.obs_ring == NULL) {
+            fprintf(stderr, "shared memory ring setup failed\n");
+            shmring_close(ctx.nmea_ring);
+            close(serial_fd);
+            archive_stop(ctx.archive);
+            return -1;
+        }
+        printf("Publishing observation quality summaries every %d s to shared memory %s\n",
+               opts.obs_interval_s, ctx.obs_ring->name);
+    }
+
+    // 初始化结束：输出内存预算，超出预算时退出，之后转发路径不再分配内存
+    pool_account("base", "uplink connection", ctx.ups, sizeof(ctx.ups[0]), ctx.up_count, POOL_PER_CONN);
+    pool_account("base", "epoch assembler", &ctx.epoch, sizeof(ctx.epoch), 1, POOL_SHARED);
+    if (ctx.demux_mode) {
+        pool_account("base", "serial demultiplexer", &ctx.demux, sizeof(ctx.demux), 1, POOL_SHARED);
+    }
+    if (pool_seal("bds_base", opts.budget_kb) != 0) {
+        shmring_close(ctx.nmea_ring);
+        shmring_close(ctx.obs_ring);
+        close(serial_fd);
+        for (int i = 0; i < ctx.up_count; i++) {
+            uplink_close(&ctx.ups[i]);
+        }
+        archive_stop(ctx.archive);
+        return -1;
+    }
+
+    // 实时模式：各池的大小已确定，逐页预缺页各目的地共享的数据块池
+    if (opts.rt.priority > 0 || opts.rt.cpu_count > 0) {
+        rt_prefault(ctx.pool.blocks.base, ctx.pool.blocks.size * ctx.pool.blocks.count);
+        rt_prefault(ctx.pool.refs, sizeof(int) * ctx.pool.blocks.count);
+    }
+
+    printf("BDS base station started. Listening on %s, forwarding to %d destination(s)\n",
+           opts.serial_port, ctx.up_count);
+
+    // 开始数据转发
+    serial_to_network(serial_fd, &ctx);
+
+    // 关闭资源（已交接时只关闭本进程的副本，连接和串口由新进程继续使用）
+    close(serial_fd);
+    for (int i = 0; i < ctx.up_count; i++) {
+        uplink_close(&ctx.ups[i]);
+    }
+    if (ctx.netmon_fd >= 0) {
+        close(ctx.netmon_fd);
+    }
+    if (ctx.handoff_fd >= 0) {
+        close(ctx.handoff_fd);
+    }
+    close(ctx.timer_fd);
+    close(ctx.signal_fd);
+    close(ctx.epoll_fd);
+    archive_stop(ctx.archive);
+    shmring_close(ctx.nmea_ring);
+    shmring_close(ctx.obs_ring);
+    log_stop();
+
+    // 分流统计：各通道字节数和帧数
+    if (ctx.demux_mode) {
+        for (int c = 0; c < DEMUX_CHANNELS; c++) {
+            printf("Demux %s: %llu bytes, %llu %s\n", demux_channel_name(c),
+                   (unsigned long long)ctx.demux.bytes[c], (unsigned long long)ctx.demux.frames[c],
+                   c == DEMUX_OTHER ? "runs" : "frames");
+        }
+        printf("Demux checksum errors: %llu\n", (unsigned long long)ctx.demux.check_errors);
+    }
+
+    return 0;
+}
@@ -3,7 +3,7 @@
  * 基站程序头文件
  * 功能：定义常量、结构体和函数声明
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-13
+ * 最后修改时间：2026-10-18
  */
 
 #ifndef BDS_BASE_H
@@ -12,6 +12,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
@@ -21,6 +23,32 @@
 #include <sys/ioctl.h>
 #include <net/if.h>
 #include <ifaddrs.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <linux/sockios.h>
+
+#include "bds_metrics.h"
+#include "bds_rt.h"
+#include "bds_netmon.h"
+#include "bds_rtcm.h"
+#include "bds_epoch.h"
+#include "bds_time.h"
+#include "bds_tls.h"
+#include "bds_archive.h"
+#include "bds_pool.h"
+#include "bds_handoff.h"
+#include "bds_heartbeat.h"
+#include "bds_fanout.h"
+#include "bds_demux.h"
+#include "bds_shmring.h"
+#include "bds_sched.h"
+#include "bds_log.h"
+#include "bds_obsmon.h"
 
 // 串口配置
 #define SERIAL_PORT "/dev/ttyS1"
@@ -30,11 +58,130 @@
 #define SERVER_IP "127.0.0.1"  // 服务器IP地址，实际使用时需要修改
 #define SERVER_PORT 8888       // 服务器端口号
 #define BUFFER_SIZE 1024       // 缓冲区大小
+#define RECONNECT_INTERVAL 1   // 无事件触发时的重连间隔（秒）
+#define CONNECT_TIMEOUT 5      // 非阻塞连接的超时时间（秒）
+#define UPLINK_QUEUE_SIZE (32 * 1024)  // socket发送缓冲区满时的待发队列长度（默认）
+#define BASE_MAX_UPLINKS 8     // 最多同时发往的目的地数
+
+// 事件循环配置
+#define BASE_MAX_EVENTS 8      // 每次epoll_wait最多返回的事件数
+
+// epoll事件来源（低8位；上行socket的事件在高位带目的地序号）
+enum base_event {
+    BASE_EV_SERIAL = 1,        // 串口可读
+    BASE_EV_UPLINK,            // 上行socket连接完成、可写、可读（心跳应答）或关闭
+    BASE_EV_NETMON,            // netlink网络变化
+    BASE_EV_HANDOFF,           // 热升级请求
+    BASE_EV_TIMER,             // 定时器到期
+    BASE_EV_SIGNAL             // 退出信号
+};
+
+// 热升级配置
+#define HANDOFF_NAME "bds_base.handoff"  // 交接套接字名称（抽象命名空间）
+#define BASE_HANDOFF_MAGIC 0x4E4F4642    // "BFON"：多目的地交接数据
+
+// 上行连接状态（每个目的地一个）
+struct uplink {
+    char ip[INET_ADDRSTRLEN];         // 服务器IP地址
+    int port;                         // 服务器端口号
+    int index;                        // 目的地序号（epoll事件标记）
+    int sock_fd;                      // 当前socket描述符，未连接时为-1
+    char local_ip[INET_ADDRSTRLEN];   // 当前连接使用的本地源地址
+    uint64_t next_retry_ns;           // 下次定时重连的时间，连接中为连接超时时间（单调时钟纳秒）
+    int connecting;                   // 非阻塞连接（含加密握手）是否尚未完成
+    int connects;                     // 已建立的连接数（首次之后计为重连）
+    int epoll_fd;                     // 所属的epoll描述符
+    uint32_t events;                  // 已注册的epoll事件，0表示未注册
+    int watch_in;                     // 是否读取服务器下发的数据（心跳应答）
+    struct tls_config *tls;           // 加密传输配置，NULL表示明文
+    struct tls_session *tls_sess;     // 正在进行的TLS握手
+    uint32_t tls_events;              // 握手等待的epoll事件
+    struct fanout_pool *pool;         // 共享的数据块池
+    struct fanout_queue queue;        // 待发队列（引用共享数据块，socket可写后继续发送）
+    int scheduled;                    // 是否按电文类别调度发送（-P）
+    struct fanout_queue bulk;         // 延后发送的基站描述和星历电文（实时队列为空且socket基本排空时才发送）
+    struct sched_link sched;          // 按链路积压的降级状态
+    uint64_t pump_ns;                 // 延后电文等待socket排空时的下次检查时间，0表示不需要
+    uint64_t hb_next_ns;              // 下次发送心跳的时间（单调时钟纳秒）
+    uint32_t hb_seq;                  // 下一个心跳序号
+    uint64_t echo_ns;                 // 最近一次应答中的流动站时间戳，0表示还没有应答
+    uint64_t echo_rx_ns;              // 收到该应答的时间（单调时钟纳秒）
+    struct rtcm_framer echo_framer;   // 下行应答分帧器
+};
+
+// 基站转发上下文
+struct base_ctx {
+    struct uplink ups[BASE_MAX_UPLINKS];  // 各目的地的上行连接
+    int up_count;                     // 目的地数
+    struct fanout_pool pool;          // 各目的地共享的数据块池（每段数据只拷贝一次）
+    int netmon_fd;                    // netlink监听描述符，-1表示不监听网络变化
+    int epoch_mode;                   // 是否按历元组装后再发送
+    int framed;                       // 是否分帧转发（历元组装、心跳、分流和调度都需要帧边界）
+    struct rtcm_framer framer;        // RTCM3分帧器
+    int demux_mode;                   // 是否按协议分流（只有RTCM3进入转发路径）
+    struct demux demux;               // 串口数据分流器（分流时代替RTCM3分帧器）
+    struct shmring *nmea_ring;        // NMEA语句发布到的共享内存环形缓冲区，NULL表示不发布
+    struct obsmon *obsmon;            // 观测质量监测，NULL表示不监测
+    struct shmring *obs_ring;         // 观测质量摘要发布到的共享内存环形缓冲区
+    uint64_t obs_interval_ns;         // 摘要周期
+    uint64_t obs_next_ns;             // 下次输出摘要的时间（单调时钟纳秒）
+    int batch_len;                    // 不组装历元时本次读取已分出的完整帧长度
+    unsigned char batch[BUFFER_SIZE + RTCM3_MAX_FRAME];  // 不组装历元时合并发送的完整帧
+    uint64_t hb_interval_ns;          // 心跳间隔，0表示不发送心跳
+    int sched_mode;                   // 是否按电文类别调度发送
+    unsigned char lean[FANOUT_MSG_MAX];  // MSM5/7改写为MSM4后的观测数据（降级的目的地共用）
+    struct epoch_assembler epoch;     // 历元组装器
+    struct archive *archive;          // 串口数据存档，NULL表示不存档
+    int handoff_fd;                   // 热升级交接监听描述符，-1表示不支持热升级
+    int epoll_fd;                     // 事件循环
+    int timer_fd;                     // 重连、连接超时、历元截止和心跳共用的定时器
+    uint64_t timer_ns;                // 定时器当前的到期时间，0表示未设置
+    int signal_fd;                    // 退出信号
+};
+
+// 目的地参数（-o）
+struct base_dest {
+    char ip[INET_ADDRSTRLEN];  // 服务器IP地址
+    int port;                  // 服务器端口号
+    enum fanout_policy policy; // 待发队列放不下时的处理方式
+    int queue_kb;              // 待发队列上限（KB）
+};
+
+// 运行参数（命令行可覆盖）
+struct base_options {
+    int metrics_port;          // 指标HTTP端口，0表示不启用
+    struct rt_options rt;      // 实时模式参数
+    int epoch_deadline_ms;     // 历元组装截止时间（毫秒），0表示不组装、按原始字节转发
+    const char *archive_dir;   // 存档目录，NULL表示不存档
+    int upgrade;               // 是否从运行中的旧进程接管（热升级）
+    const char *serial_port;   // 串口设备路径
+    int heartbeat_ms;          // 心跳间隔（毫秒），0表示不发送心跳
+    const char *tls_ca;        // 校验服务器证书的CA文件，非NULL时加密传输
+    int budget_kb;             // 内存预算上限（KB），0表示只输出预算不检查
+    int demux;                 // 是否按协议分流串口数据
+    int sched_kb;              // 延后门限（KB），socket中未发出的字节少于该值时才发送延后类电文，0表示不调度
+    const char *nmea_ring;     // NMEA语句发布到的共享内存名称，NULL表示不发布
+    char obs_ring[64];         // 观测质量摘要发布到的共享内存名称，空表示不监测
+    int obs_interval_s;        // 观测质量摘要周期（秒）
+    const char *log_file;      // 二进制日志文件，NULL表示只输出文本
+    struct base_dest dests[BASE_MAX_UPLINKS];  // 目的地，未指定时为SERVER_IP:SERVER_PORT
+    int dest_count;            // 目的地数
+};
 
 // 函数声明
 int init_serial(const char *port, speed_t baud);
-int init_socket(const char *ip, int port);
-void serial_to_network(int serial_fd, int sock_fd);
-char *get_local_ip(const char *ifname);
+int init_socket(const char *ip, int port, int *in_progress);
+void serial_to_network(int serial_fd, struct base_ctx *ctx);
+int uplink_connect(struct uplink *up);
+int uplink_send(struct uplink *up, const struct fanout_msg *m);
+void uplink_adopt(struct uplink *up, int sock_fd);
+void uplink_event(struct uplink *up, uint32_t events);
+void uplink_close(struct uplink *up);
+void uplink_check_route(struct uplink *up);
+int base_handoff(struct base_ctx *ctx, int serial_fd);
+int base_takeover(struct base_ctx *ctx, int *serial_fd);
+int get_local_ip(const char *ifname, char *ip, size_t len);
+int parse_dest(const char *arg, struct base_dest *dest);
+int parse_options(int argc, char *argv[], struct base_options *opts);
 
 #endif /* BDS_BASE_H */
@@ -0,0 +1,180 @@
+/*
+ * archive_bench.c
+ * 存档基准测试程序
+ * 功能：测量转发线程侧archive_write的开销（后台线程同时写入临时目录），
+ *       以及块压缩/解压在MSM观测码流上的吞吐和压缩率
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_bench.h"
+#include "bds_archive.h"
+#include "bds_msm.h"
+
+#define BENCH_STREAM_SIZE       ARCHIVE_BLOCK_SIZE
+#define ARCHIVE_BENCH_WRITES    200000
+
+// 测试上下文
+struct archive_ctx {
+    struct archive *ar;
+    unsigned char stream[BENCH_STREAM_SIZE];
+    unsigned char comp[LZ_COMPRESS_BOUND(BENCH_STREAM_SIZE)];
+    unsigned char raw[BENCH_STREAM_SIZE];
+    int comp_len;
+};
+
+/**
+ * @brief 生成MSM7观测码流：每历元BDS 12颗卫星×3个信号，观测值缓慢变化
+ * @param ctx 测试上下文
+ */
+static void make_stream(struct archive_ctx *ctx)
+{
+    static struct msm_obs obs;
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+    int len = 0;
+    uint32_t seed = 1;
+
+    memset(&obs, 0, sizeof(obs));
+    obs.hdr.msg_type = 1127;
+    obs.nsat = 12;
+    obs.nsig = 3;
+    obs.ncell = 36;
+    for (int i = 0; i < obs.nsat; i++) {
+        obs.sat_id[i] = i * 3 + 1;
+    }
+    obs.sig_id[0] = 2;
+    obs.sig_id[1] = 8;
+    obs.sig_id[2] = 14;
+    for (int i = 0; i < obs.ncell; i++) {
+        obs.cell_sat[i] = i / 3;
+        obs.cell_sig[i] = i % 3;
+    }
+
+    for (int epoch = 0; len < BENCH_STREAM_SIZE; epoch++) {
+        obs.hdr.epoch = epoch * 1000;
+        for (int i = 0; i < obs.nsat; i++) {
+            obs.rough_ms[i] = 70 + i;
+            obs.rough_mod[i] = (i * 37 + epoch) & 0x3FF;
+            obs.rough_rate[i] = -300 + i * 29;
+        }
+        for (int i = 0; i < obs.ncell; i++) {
+            seed = seed * 1103515245 + 12345;
+            obs.fine_pr[i] = (int32_t)(seed >> 13) - 262144;
+            obs.fine_phase[i] = (int32_t)(seed >> 9) - 4194304;
+            obs.lock[i] = 500;
+            obs.cnr[i] = (38 + i % 10) * 16 + (seed & 15);
+            obs.fine_rate[i] = (int16_t)((seed >> 20) & 0x1FFF) - 4096;
+        }
+        int payload_len = msm_encode(&obs, payload, sizeof(payload));
+        if (len + payload_len + RTCM3_HEADER_LEN + RTCM3_CRC_LEN > BENCH_STREAM_SIZE) {
+            break;
+        }
+        len += rtcm_frame_encode(payload, payload_len, &ctx->stream[len], BENCH_STREAM_SIZE - len);
+    }
+}
+
+/**
+ * @brief 测量转发线程侧单次archive_write的耗时分布
+ * @param ctx 测试上下文
+ * @param name 项目名称
+ * @param chunk 每次写入的字节数
+ * 注：环形缓冲区超过一半时暂停（不计时）等待后台线程写盘，只统计实际入队的写入
+ */
+static void bench_archive_write(struct archive_ctx *ctx, const char *name, int chunk)
+{
+    static uint64_t samples[ARCHIVE_BENCH_WRITES];
+    const struct timespec pause = { 0, 1000000L };
+    uint64_t total = 0;
+    int pos = 0;
+
+    for (int i = 0; i < ARCHIVE_BENCH_WRITES; i++) {
+        while (atomic_load(&ctx->ar->head) - atomic_load(&ctx->ar->tail) > ARCHIVE_RING_SIZE / 2) {
+            nanosleep(&pause, NULL);
+        }
+        if (pos + chunk > BENCH_STREAM_SIZE) {
+            pos = 0;
+        }
+
+        uint64_t t0 = bench_now_ns();
+        archive_write(ctx->ar, &ctx->stream[pos], chunk);
+        samples[i] = bench_now_ns() - t0;
+        total += samples[i];
+        pos += chunk;
+    }
+
+    // 按纳秒计数求分位数，超过1微秒的归入最后一桶
+    static uint32_t hist[1001];
+    memset(hist, 0, sizeof(hist));
+    uint64_t max = 0;
+    for (int i = 0; i < ARCHIVE_BENCH_WRITES; i++) {
+        hist[samples[i] < 1000 ? samples[i] : 1000]++;
+        max = samples[i] > max ? samples[i] : max;
+    }
+    uint64_t p99 = 0, seen = 0;
+    for (int i = 0; i <= 1000; i++) {
+        seen += hist[i];
+        if (seen >= (uint64_t)ARCHIVE_BENCH_WRITES * 99 / 100) {
+            p99 = i;
+            break;
+        }
+    }
+
+    printf("%-40s avg %6.1f ns   p99 %4llu ns   max %6llu ns\n", name, (double)total / ARCHIVE_BENCH_WRITES,
+           (unsigned long long)p99, (unsigned long long)max);
+}
+
+/**
+ * @brief 块压缩
+ */
+static uint64_t bench_compress(void *arg)
+{
+    struct archive_ctx *ctx = arg;
+    return lz_compress(ctx->stream, BENCH_STREAM_SIZE, ctx->comp, sizeof(ctx->comp));
+}
+
+/**
+ * @brief 块解压
+ */
+static uint64_t bench_decompress(void *arg)
+{
+    struct archive_ctx *ctx = arg;
+    return lz_decompress(ctx->comp, ctx->comp_len, ctx->raw, sizeof(ctx->raw));
+}
+
+/**
+ * @brief 主函数
+ * @return 成功返回0
+ */
+int main()
+{
+    static struct archive_ctx ctx;
+    static const int chunks[] = { 64, 512, 4096 };
+    char dir[] = "/tmp/archive_bench.XXXXXX";
+    char name[64];
+
+    make_stream(&ctx);
+    ctx.comp_len = lz_compress(ctx.stream, BENCH_STREAM_SIZE, ctx.comp, sizeof(ctx.comp));
+    printf("MSM7 stream: %d -> %d bytes (%.1f%%)\n", BENCH_STREAM_SIZE, ctx.comp_len,
+           ctx.comp_len * 100.0 / BENCH_STREAM_SIZE);
+
+    bench_header();
+    bench_run("lz_compress/64KB", BENCH_STREAM_SIZE, bench_compress, &ctx);
+    bench_run("lz_decompress/64KB", BENCH_STREAM_SIZE, bench_decompress, &ctx);
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp failed");
+        return 1;
+    }
+    ctx.ar = archive_start(dir, "bench");
+    if (ctx.ar == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        snprintf(name, sizeof(name), "archive_write/%d", chunks[i]);
+        bench_archive_write(&ctx, name, chunks[i]);
+    }
+    archive_stop(ctx.ar);
+    printf("Archive files left in %s\n", dir);
+
+    return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * bds_archive.c
+ * 数据存档源文件
+ * 功能：无锁单生产者/单消费者环形缓冲区、后台压缩写入线程、文件预分配与整点轮转
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_archive.h"
+
+// 运行指标编号
+static int m_in_bytes = -1;
+static int m_dropped_bytes = -1;
+static int m_out_bytes = -1;
+static int m_files = -1;
+static int m_write_errors = -1;
+static int m_write_us_max = -1;
+static int m_ring_bytes_max = -1;
+
+/**
+ * @brief 注册存档指标
+ */
+static void archive_metrics_init(void)
+{
+    m_in_bytes = metrics_register("bds_archive_in_bytes_total",
+                                  "Bytes queued for archival", METRIC_COUNTER);
+    m_dropped_bytes = metrics_register("bds_archive_dropped_bytes_total",
+                                       "Bytes dropped because the archive ring was full", METRIC_COUNTER);
+    m_out_bytes = metrics_register("bds_archive_out_bytes_total",
+                                   "Compressed bytes written to archive files", METRIC_COUNTER);
+    m_files = metrics_register("bds_archive_files_total",
+                               "Archive files completed and renamed", METRIC_COUNTER);
+    m_write_errors = metrics_register("bds_archive_write_errors_total",
+                                      "Failed archive file operations", METRIC_COUNTER);
+    m_write_us_max = metrics_register("bds_archive_write_us_max",
+                                      "Slowest archive write", METRIC_GAUGE_MAX);
+    m_ring_bytes_max = metrics_register("bds_archive_ring_bytes_max",
+                                        "Archive ring high-water mark", METRIC_GAUGE_MAX);
+}
+
+/**
+ * @brief 写入32位小端整数
+ */
+static void archive_put32(unsigned char *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+/**
+ * @brief 把out中的数据写入文件
+ * @param ar 存档状态
+ * @param partial 为1时写入全部数据（末尾不足一页的部分保留，下次连同新数据重写），
+ *                为0时只写入对齐的整页
+ */
+static void archive_flush(struct archive *ar, int partial)
+{
+    int len = partial ? ar->out_len : (ar->out_len & ~(ARCHIVE_ALIGN - 1));
+    int aligned = ar->out_len & ~(ARCHIVE_ALIGN - 1);
+
+    if (len == 0) {
+        return;
+    }
+
+    if (ar->fd >= 0) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        ssize_t n = pwrite(ar->fd, ar->out, len, ar->out_off);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        metrics_max(m_write_us_max, (uint64_t)((t1.tv_sec - t0.tv_sec) * 1000000LL +
+                                               (t1.tv_nsec - t0.tv_nsec) / 1000));
+        if (n != len) {
+            metrics_inc(m_write_errors);
+            perror("archive write failed");
+        }
+    }
+
+    memmove(ar->out, &ar->out[aligned], ar->out_len - aligned);
+    ar->out_off += aligned;
+    ar->out_len -= aligned;
+}
+
+/**
+ * @brief 压缩当前块并追加到out，攒够一个写入单位后写入文件
+ * @param ar 存档状态
+ */
+static void archive_seal_block(struct archive *ar)
+{
+    if (ar->raw_len == 0) {
+        return;
+    }
+
+    unsigned char *hdr = &ar->out[ar->out_len];
+    unsigned char *data = hdr + ARCHIVE_HEADER_LEN;
+    int comp_len = lz_compress(ar->raw, ar->raw_len, data, LZ_COMPRESS_BOUND(ARCHIVE_BLOCK_SIZE));
+
+    // 压缩无收益时原样存储
+    if (comp_len < 0 || comp_len >= ar->raw_len) {
+        memcpy(data, ar->raw, ar->raw_len);
+        comp_len = ar->raw_len;
+    }
+
+    archive_put32(hdr, ARCHIVE_MAGIC);
+    archive_put32(hdr + 4, ar->raw_len);
+    archive_put32(hdr + 8, comp_len);
+    ar->out_len += ARCHIVE_HEADER_LEN + comp_len;
+    ar->raw_len = 0;
+    metrics_add(m_out_bytes, ARCHIVE_HEADER_LEN + comp_len);
+
+    if (ar->out_len >= ARCHIVE_WRITE_SIZE) {
+        archive_flush(ar, 0);
+    }
+}
+
+/**
+ * @brief 打开新的存档文件并预分配空间
+ * @param ar 存档状态
+ * @param now 当前时间（UTC秒）
+ */
+static void archive_open(struct archive *ar, time_t now)
+{
+    struct tm tm;
+    char stamp[32];
+
+    gmtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+
+    ar->out_off = 0;
+    ar->out_len = 0;
+    ar->rotate_at = (now / ARCHIVE_ROTATE_SEC + 1) * ARCHIVE_ROTATE_SEC;
+    ar->flush_at = now + ARCHIVE_FLUSH_SEC;
+
+    // 热升级时新旧进程可能在同一秒打开文件，名称已存在时加序号，不覆盖对方的存档
+    ar->fd = -1;
+    for (int seq = 0; seq < ARCHIVE_NAME_TRIES && ar->fd < 0; seq++) {
+        if (seq == 0) {
+            snprintf(ar->final_path, sizeof(ar->final_path), "%s/%s_%s%s",
+                     ar->dir, ar->prefix, stamp, ARCHIVE_SUFFIX);
+        } else {
+            snprintf(ar->final_path, sizeof(ar->final_path), "%s/%s_%s_%d%s",
+                     ar->dir, ar->prefix, stamp, seq, ARCHIVE_SUFFIX);
+        }
+        snprintf(ar->part_path, sizeof(ar->part_path), "%s%s", ar->final_path, ARCHIVE_PART_SUFFIX);
+        if (access(ar->final_path, F_OK) == 0) {
+            continue;
+        }
+        ar->fd = open(ar->part_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (ar->fd < 0 && errno != EEXIST) {
+            break;
+        }
+    }
+    if (ar->fd < 0) {
+        metrics_inc(m_write_errors);
+        perror("archive open failed");
+        return;
+    }
+
+    // 预分配整小时的空间，减少写入时的块分配和碎片；文件长度在关闭时按实际数据截断
+    if (fallocate(ar->fd, FALLOC_FL_KEEP_SIZE, 0, ARCHIVE_PREALLOC) != 0 && errno != EOPNOTSUPP) {
+        perror("archive fallocate failed");
+    }
+
+    printf("Archiving to %s\n", ar->part_path);
+}
+
+/**
+ * @brief 写完当前文件：截断预分配空间、落盘、去掉.part后缀
+ * @param ar 存档状态
+ */
+static void archive_close(struct archive *ar)
+{
+    archive_seal_block(ar);
+    archive_flush(ar, 1);
+
+    if (ar->fd < 0) {
+        return;
+    }
+
+    if (ftruncate(ar->fd, ar->out_off + ar->out_len) != 0 || fdatasync(ar->fd) != 0) {
+        metrics_inc(m_write_errors);
+        perror("archive sync failed");
+    }
+    close(ar->fd);
+    ar->fd = -1;
+
+    if (rename(ar->part_path, ar->final_path) != 0) {
+        metrics_inc(m_write_errors);
+        perror("archive rename failed");
+        return;
+    }
+
+    // 改名也要落盘，掉电后不会出现只有.part的文件
+    int dir_fd = open(ar->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    metrics_inc(m_files);
+}
+
+/**
+ * @brief 后台写入线程：从环形缓冲区取数据、分块压缩、写入和轮转
+ * @param arg 存档状态
+ * @return NULL
+ */
+static void *archive_thread(void *arg)
+{
+    struct archive *ar = arg;
+    const struct timespec idle = { 0, ARCHIVE_POLL_MS * 1000000L };
+
+    pthread_setname_np(pthread_self(), "archive");
+    archive_open(ar, time(NULL));
+
+    while (1) {
+        size_t head = atomic_load_explicit(&ar->head, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&ar->tail, memory_order_relaxed);
+        size_t avail = head - tail;
+        time_t now = time(NULL);
+
+        if (avail > 0) {
+            metrics_max(m_ring_bytes_max, avail);
+
+            // 取出不超过当前块剩余空间的数据（环形缓冲区回绕时分两段拷贝）
+            size_t n = ARCHIVE_BLOCK_SIZE - ar->raw_len;
+            if (n > avail) {
+                n = avail;
+            }
+            size_t off = tail & (ARCHIVE_RING_SIZE - 1);
+            size_t first = ARCHIVE_RING_SIZE - off < n ? ARCHIVE_RING_SIZE - off : n;
+            memcpy(&ar->raw[ar->raw_len], &ar->ring[off], first);
+            memcpy(&ar->raw[ar->raw_len + first], ar->ring, n - first);
+            atomic_store_explicit(&ar->tail, tail + n, memory_order_release);
+            ar->raw_len += n;
+
+            if (ar->raw_len == ARCHIVE_BLOCK_SIZE) {
+                archive_seal_block(ar);
+            }
+        }
+
+        // 整点轮转；未满的块最多缓存ARCHIVE_FLUSH_SEC秒
+        if (now >= ar->rotate_at) {
+            archive_close(ar);
+            archive_open(ar, now);
+        } else if (now >= ar->flush_at) {
+            archive_seal_block(ar);
+            archive_flush(ar, 1);
+            if (ar->fd < 0) {
+                archive_open(ar, now);
+            }
+            ar->flush_at = now + ARCHIVE_FLUSH_SEC;
+        }
+
+        if (avail == 0) {
+            if (!atomic_load(&ar->running)) {
+                break;
+            }
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    archive_close(ar);
+    return NULL;
+}
+
+/**
+ * @brief 释放存档的缓冲区和状态
+ * @param ar 存档状态
+ */
+static void archive_free(struct archive *ar)
+{
+    pool_free(ar->ring);
+    pool_free(ar->raw);
+    pool_free(ar->out);
+    pool_free(ar);
+}
+
+/**
+ * @brief 创建存档并启动后台写入线程
+ * @param dir 存档目录（不存在时创建）
+ * @param prefix 文件名前缀
+ * @return 存档状态，失败返回NULL
+ * 注：须在实时模式设置之前调用，后台线程不继承转发线程的SCHED_FIFO和CPU绑定
+ */
+struct archive *archive_start(const char *dir, const char *prefix)
+{
+    struct archive *ar = NULL;
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror("archive mkdir failed");
+        return NULL;
+    }
+
+    ar = pool_alloc("archive", "archive state", sizeof(*ar), 1, POOL_SHARED);
+    if (ar == NULL) {
+        return NULL;
+    }
+    snprintf(ar->dir, sizeof(ar->dir), "%s", dir);
+    snprintf(ar->prefix, sizeof(ar->prefix), "%s", prefix);
+    ar->fd = -1;
+    atomic_store(&ar->running, 1);
+
+    // out须容纳一个写入单位、保留的末页和一个最坏情况的压缩块（不小于一页的池按页对齐）
+    ar->ring = pool_alloc("archive", "ring buffer", ARCHIVE_RING_SIZE, 1, POOL_SHARED);
+    ar->raw = pool_alloc("archive", "compression block", ARCHIVE_BLOCK_SIZE, 1, POOL_SHARED);
+    ar->out = pool_alloc("archive", "write buffer", ARCHIVE_WRITE_SIZE + ARCHIVE_ALIGN + ARCHIVE_HEADER_LEN +
+                         LZ_COMPRESS_BOUND(ARCHIVE_BLOCK_SIZE), 1, POOL_SHARED);
+    if (ar->ring == NULL || ar->raw == NULL || ar->out == NULL) {
+        archive_free(ar);
+        return NULL;
+    }
+
+    // 预先触碰全部页面，转发线程写入时不发生缺页
+    memset(ar->ring, 0, ARCHIVE_RING_SIZE);
+
+    archive_metrics_init();
+
+    if (bds_thread_create(&ar->tid, BDS_THREAD_STACK, 0, archive_thread, ar) != 0) {
+        fprintf(stderr, "archive thread creation failed\n");
+        archive_free(ar);
+        return NULL;
+    }
+
+    return ar;
+}
+
+/**
+ * @brief 把数据放入存档环形缓冲区（只由一个线程调用，不阻塞、不做系统调用）
+ * @param ar 存档状态
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 成功返回0，缓冲区已满时丢弃数据并返回-1
+ */
+int archive_write(struct archive *ar, const void *buf, size_t len)
+{
+    size_t head = atomic_load_explicit(&ar->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ar->tail, memory_order_acquire);
+
+    if (len > ARCHIVE_RING_SIZE - (head - tail)) {
+        metrics_add(m_dropped_bytes, len);
+        return -1;
+    }
+
+    size_t off = head & (ARCHIVE_RING_SIZE - 1);
+    size_t first = ARCHIVE_RING_SIZE - off < len ? ARCHIVE_RING_SIZE - off : len;
+    memcpy(&ar->ring[off], buf, first);
+    memcpy(ar->ring, (const unsigned char *)buf + first, len - first);
+    atomic_store_explicit(&ar->head, head + len, memory_order_release);
+    metrics_add(m_in_bytes, len);
+
+    return 0;
+}
+
+/**
+ * @brief 停止存档：写完剩余数据、关闭并改名当前文件，释放资源
+ * @param ar 存档状态
+ */
+void archive_stop(struct archive *ar)
+{
+    if (ar == NULL) {
+        return;
+    }
+
+    atomic_store(&ar->running, 0);
+    pthread_join(ar->tid, NULL);
+    archive_free(ar);
+}
@@ -0,0 +1,78 @@
+/*
+ * bds_archive.h
+ * 数据存档头文件
+ * 功能：转发线程把数据写入无锁环形缓冲区，后台线程分块压缩后按大块对齐写入预分配文件，
+ *       按整点轮转，写完的文件原子改名
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_ARCHIVE_H
+#define BDS_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "bds_metrics.h"
+#include "bds_thread.h"
+#include "bds_lz.h"
+#include "bds_pool.h"
+
+// 存档配置
+#define ARCHIVE_RING_SIZE     (4 * 1024 * 1024)   // 环形缓冲区大小（2的幂），SD卡停顿数秒也不丢数据
+#define ARCHIVE_BLOCK_SIZE    (64 * 1024)         // 每个压缩块的原始数据长度
+#define ARCHIVE_WRITE_SIZE    (256 * 1024)        // 每次写入的字节数
+#define ARCHIVE_ALIGN         4096                // 写入偏移对齐
+#define ARCHIVE_PREALLOC      (32 * 1024 * 1024)  // 每个文件预分配的空间
+#define ARCHIVE_ROTATE_SEC    3600                // 轮转周期（秒），按UTC整点对齐
+#define ARCHIVE_FLUSH_SEC     10                  // 未满块的最长缓存时间（秒）
+#define ARCHIVE_POLL_MS       20                  // 后台线程空闲时的轮询间隔（毫秒）
+#define ARCHIVE_PATH_LEN      512                 // 文件路径最大长度
+#define ARCHIVE_NAME_TRIES    10                  // 同一秒内文件名冲突时的最大序号
+
+// 存档文件格式：连续的块记录，每块 = 块头 + 数据
+// 块头：魔数(4) + 原始长度(4) + 数据长度(4)，小端；数据长度等于原始长度时数据未压缩
+#define ARCHIVE_MAGIC         0x315A4442          // "BDZ1"
+#define ARCHIVE_HEADER_LEN    12
+#define ARCHIVE_SUFFIX        ".bdz"
+#define ARCHIVE_PART_SUFFIX   ".part"             // 正在写入的文件后缀
+
+// 存档状态
+struct archive {
+    // 转发线程（生产者）与后台线程（消费者）各自写的位置分开放在不同缓存行
+    _Atomic size_t head __attribute__((aligned(64)));   // 已写入环形缓冲区的总字节数
+    _Atomic size_t tail __attribute__((aligned(64)));   // 后台线程已取走的总字节数
+    unsigned char *ring __attribute__((aligned(64)));   // 环形缓冲区
+
+    // 以下只由后台线程访问
+    char dir[ARCHIVE_PATH_LEN / 2];       // 存档目录
+    char prefix[32];                      // 文件名前缀
+    char part_path[ARCHIVE_PATH_LEN + 8]; // 正在写入的文件路径
+    char final_path[ARCHIVE_PATH_LEN];    // 写完后的文件路径
+    int fd;                               // 当前文件描述符，-1表示未打开
+    unsigned char *raw;                   // 当前块的原始数据
+    int raw_len;
+    unsigned char *out;                   // 待写入的文件数据（从文件偏移out_off开始）
+    int out_len;
+    off_t out_off;                        // out对应的文件偏移（按ARCHIVE_ALIGN对齐）
+    time_t rotate_at;                     // 下次轮转时间
+    time_t flush_at;                      // 下次强制写入时间
+    atomic_int running;                   // 清零后后台线程写完剩余数据并退出
+    pthread_t tid;
+};
+
+// 函数声明
+struct archive *archive_start(const char *dir, const char *prefix);
+int archive_write(struct archive *ar, const void *buf, size_t len);
+void archive_stop(struct archive *ar);
+
+#endif /* BDS_ARCHIVE_H */
@@ -0,0 +1,88 @@
+/*
+ * bds_bench.h
+ * 微基准测试辅助头文件
+ * 功能：自动校准迭代次数，输出每次操作耗时(ns/op)和吞吐量(MB/s)，仅供基准测试程序使用
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_BENCH_H
+#define BDS_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+// 基准配置
+#define BENCH_MIN_NS      200000000ULL   // 每项至少运行0.2秒
+#define BENCH_START_ITERS 16             // 初始迭代次数
+
+// 被测函数：ctx为测试上下文，返回值累加到sink防止被优化掉
+typedef uint64_t (*bench_fn)(void *ctx);
+
+// 防优化汇总值
+static volatile uint64_t bench_sink;
+
+/**
+ * @brief 获取单调时钟（纳秒）
+ * @return 当前时间
+ */
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief 打印表头（未开启编译优化时给出提示）
+ */
+static inline void bench_header(void)
+{
+#ifndef __OPTIMIZE__
+    printf("Warning: built without optimization, numbers are not representative\n");
+#endif
+    printf("%-40s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "MB/s");
+}
+
+/**
+ * @brief 运行单项基准并打印结果
+ * @param name 项目名称
+ * @param bytes_per_op 每次操作处理的字节数（0表示不计算吞吐量）
+ * @param fn 被测函数
+ * @param ctx 测试上下文
+ * @return 每次操作耗时（纳秒）
+ */
+static inline double bench_run(const char *name, size_t bytes_per_op, bench_fn fn, void *ctx)
+{
+    uint64_t iters = BENCH_START_ITERS;
+    uint64_t elapsed = 0;
+    uint64_t acc = 0;
+
+    // 迭代次数翻倍直到运行时间足够长
+    while (1) {
+        uint64_t start = bench_now_ns();
+        for (uint64_t i = 0; i < iters; i++) {
+            acc += fn(ctx);
+        }
+        elapsed = bench_now_ns() - start;
+        if (elapsed >= BENCH_MIN_NS) {
+            break;
+        }
+        iters *= 2;
+    }
+    bench_sink += acc;
+
+    double ns_per_op = (double)elapsed / iters;
+    if (bytes_per_op > 0) {
+        printf("%-40s %12llu %12.1f %12.1f\n", name, (unsigned long long)iters, ns_per_op,
+               bytes_per_op * 1000.0 / ns_per_op);
+    } else {
+        printf("%-40s %12llu %12.1f %12s\n", name, (unsigned long long)iters, ns_per_op, "-");
+    }
+
+    return ns_per_op;
+}
+
+#endif /* BDS_BENCH_H */
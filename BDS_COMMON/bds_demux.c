@@ -0,0 +1,331 @@
+/*
+ * bds_demux.c
+ * 串口数据分流源文件
+ * 功能：单遍扫描串口字节流，识别RTCM3、NMEA和厂商二进制帧，按通道回调
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_demux.h"
+
+// 帧识别结果
+enum demux_check {
+    DEMUX_NONE = 0,            // 当前字节不是有效帧的开头
+    DEMUX_MORE,                // 可能是帧开头，数据不够，需要更多字节
+    DEMUX_FRAME                // 完整且校验通过的帧
+};
+
+static const char *demux_names[DEMUX_CHANNELS] = { "rtcm", "nmea", "binary", "other" };
+
+// NovAtel/Unicore CRC32查表（反射多项式0xEDB88320，初值0，不取反）
+static uint32_t demux_crc_table[256];
+static int demux_crc_ready = 0;
+
+/**
+ * @brief 生成CRC32表
+ */
+static void demux_crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+        demux_crc_table[i] = crc;
+    }
+    demux_crc_ready = 1;
+}
+
+/**
+ * @brief 计算NovAtel/Unicore二进制帧的CRC32
+ */
+static uint32_t demux_crc32(const unsigned char *buf, int len)
+{
+    uint32_t crc = 0;
+
+    for (int i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ demux_crc_table[(crc ^ buf[i]) & 0xFF];
+    }
+    return crc;
+}
+
+/**
+ * @brief 是否可能是一帧的第一个字节
+ */
+static inline int demux_is_sync(unsigned char c)
+{
+    return c == RTCM3_PREAMBLE || c == '$' || c == DEMUX_UBX_SYNC1 || c == DEMUX_OEM_SYNC1;
+}
+
+/**
+ * @brief 识别RTCM3帧
+ */
+static int demux_check_rtcm(const unsigned char *p, int avail, int *frame_len)
+{
+    if (avail < RTCM3_HEADER_LEN) {
+        return DEMUX_MORE;
+    }
+    if ((p[1] & 0xFC) != 0) {
+        return DEMUX_NONE;
+    }
+
+    int len = RTCM3_HEADER_LEN + (((p[1] & 0x03) << 8) | p[2]) + RTCM3_CRC_LEN;
+    if (avail < len) {
+        return DEMUX_MORE;
+    }
+
+    uint32_t crc = rtcm_crc24q(p, len - RTCM3_CRC_LEN);
+    if (p[len - 3] != ((crc >> 16) & 0xFF) || p[len - 2] != ((crc >> 8) & 0xFF) || p[len - 1] != (crc & 0xFF)) {
+        return -1;
+    }
+    *frame_len = len;
+    return DEMUX_FRAME;
+}
+
+/**
+ * @brief 识别NMEA语句（从'$'到'\n'，只含可打印字符）
+ * 注：遇到不可打印字节立即判定不是语句，二进制数据中偶然出现的'$'不会让后面的帧等待下一次读取
+ */
+static int demux_check_nmea(const unsigned char *p, int avail, int *frame_len)
+{
+    int limit = avail < NMEA_MAX_LINE + 2 ? avail : NMEA_MAX_LINE + 2;
+
+    for (int i = 1; i < limit; i++) {
+        if (p[i] == '\n') {
+            int line_len = (i > 1 && p[i - 1] == '\r') ? i - 1 : i;
+            if (!nmea_checksum_ok((const char *)p, line_len)) {
+                return -1;
+            }
+            *frame_len = i + 1;
+            return DEMUX_FRAME;
+        }
+        if ((p[i] < 0x20 || p[i] > 0x7E) && p[i] != '\r') {
+            return DEMUX_NONE;
+        }
+    }
+    return avail < NMEA_MAX_LINE + 2 ? DEMUX_MORE : DEMUX_NONE;
+}
+
+/**
+ * @brief 识别UBX帧
+ */
+static int demux_check_ubx(const unsigned char *p, int avail, int *frame_len)
+{
+    if (avail < 2) {
+        return DEMUX_MORE;
+    }
+    if (p[1] != DEMUX_UBX_SYNC2) {
+        return DEMUX_NONE;
+    }
+    if (avail < DEMUX_UBX_HEADER_LEN) {
+        return DEMUX_MORE;
+    }
+
+    int len = DEMUX_UBX_HEADER_LEN + (p[4] | (p[5] << 8)) + 2;
+    if (len > DEMUX_MAX_FRAME) {
+        return DEMUX_NONE;
+    }
+    if (avail < len) {
+        return DEMUX_MORE;
+    }
+
+    // 8位Fletcher校验，范围为类别到数据末尾
+    unsigned char ck_a = 0, ck_b = 0;
+    for (int i = 2; i < len - 2; i++) {
+        ck_a += p[i];
+        ck_b += ck_a;
+    }
+    if (p[len - 2] != ck_a || p[len - 1] != ck_b) {
+        return -1;
+    }
+    *frame_len = len;
+    return DEMUX_FRAME;
+}
+
+/**
+ * @brief 识别NovAtel（0xAA 0x44 0x12）和Unicore（0xAA 0x44 0xB5）二进制帧
+ */
+static int demux_check_oem(const unsigned char *p, int avail, int *frame_len)
+{
+    if (avail < 3) {
+        return DEMUX_MORE;
+    }
+    if (p[1] != DEMUX_OEM_SYNC2 || (p[2] != 0x12 && p[2] != 0xB5)) {
+        return DEMUX_NONE;
+    }
+    if (avail < DEMUX_OEM_MIN_HEADER) {
+        return DEMUX_MORE;
+    }
+
+    int header_len = p[3];
+    int len = header_len + (p[8] | (p[9] << 8)) + 4;
+    if (header_len < DEMUX_OEM_MIN_HEADER || len > DEMUX_MAX_FRAME) {
+        return DEMUX_NONE;
+    }
+    if (avail < len) {
+        return DEMUX_MORE;
+    }
+
+    uint32_t crc = demux_crc32(p, len - 4);
+    if ((uint32_t)(p[len - 4] | (p[len - 3] << 8) | (p[len - 2] << 16) | ((uint32_t)p[len - 1] << 24)) != crc) {
+        return -1;
+    }
+    *frame_len = len;
+    return DEMUX_FRAME;
+}
+
+/**
+ * @brief 识别从p开始的一帧
+ * @param d 分流器
+ * @param p 数据
+ * @param avail 可用字节数
+ * @param frame_len 输出的帧长度（DEMUX_FRAME时有效）
+ * @param channel 输出的通道（DEMUX_FRAME时有效）
+ * @return enum demux_check
+ */
+static int demux_check(struct demux *d, const unsigned char *p, int avail, int *frame_len, int *channel)
+{
+    int ret;
+
+    switch (p[0]) {
+    case RTCM3_PREAMBLE:
+        *channel = DEMUX_RTCM;
+        ret = demux_check_rtcm(p, avail, frame_len);
+        break;
+    case '$':
+        *channel = DEMUX_NMEA;
+        ret = demux_check_nmea(p, avail, frame_len);
+        break;
+    case DEMUX_UBX_SYNC1:
+        *channel = DEMUX_BINARY;
+        ret = demux_check_ubx(p, avail, frame_len);
+        break;
+    case DEMUX_OEM_SYNC1:
+        *channel = DEMUX_BINARY;
+        ret = demux_check_oem(p, avail, frame_len);
+        break;
+    default:
+        return DEMUX_NONE;
+    }
+
+    // 帧头有效但校验失败：按未识别字节处理并重新同步
+    if (ret < 0) {
+        d->check_errors++;
+        return DEMUX_NONE;
+    }
+    return ret;
+}
+
+/**
+ * @brief 输出一帧或一段无法识别的字节
+ */
+static inline void demux_emit(struct demux *d, int channel, const unsigned char *data, int len, demux_fn cb,
+                              void *arg)
+{
+    if (len <= 0) {
+        return;
+    }
+    d->bytes[channel] += len;
+    d->frames[channel]++;
+    cb(channel, data, len, arg);
+}
+
+/**
+ * @brief 初始化分流器
+ * @param d 分流器
+ */
+void demux_init(struct demux *d)
+{
+    if (!demux_crc_ready) {
+        demux_crc_init();
+    }
+    memset(d, 0, sizeof(*d));
+}
+
+/**
+ * @brief 输入一段字节流，每个完整帧按通道回调，无法识别的连续字节合并为一段回调
+ * @param d 分流器
+ * @param data 输入数据
+ * @param len 输入长度
+ * @param cb 通道回调
+ * @param arg 回调参数
+ * 注：完整落在输入中的帧直接在输入缓冲区上回调，不做拷贝；只有跨读取边界的半帧进入缓存
+ */
+void demux_push(struct demux *d, const unsigned char *data, size_t len, demux_fn cb, void *arg)
+{
+    size_t pos = 0;
+    int frame_len = 0, channel = DEMUX_OTHER;
+
+    // 先处理缓存中的半帧：补足后输出，确定不是帧时跳到下一个可能的帧头
+    while (d->len > 0) {
+        int ret = demux_check(d, d->buf, d->len, &frame_len, &channel);
+        if (ret == DEMUX_MORE) {
+            if (pos >= len) {
+                return;
+            }
+            size_t n = sizeof(d->buf) - d->len;
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            memcpy(&d->buf[d->len], &data[pos], n);
+            d->len += n;
+            pos += n;
+            continue;
+        }
+
+        int used = 1;
+        if (ret == DEMUX_FRAME) {
+            demux_emit(d, channel, d->buf, frame_len, cb, arg);
+            used = frame_len;
+        } else {
+            while (used < d->len && !demux_is_sync(d->buf[used])) {
+                used++;
+            }
+            demux_emit(d, DEMUX_OTHER, d->buf, used, cb, arg);
+        }
+        d->len -= used;
+        memmove(d->buf, &d->buf[used], d->len);
+
+        // 缓存中只剩已从输入复制来的字节时，退回到输入上处理，避免复制后面的整段数据
+        if (d->len > 0 && (size_t)d->len <= pos) {
+            pos -= d->len;
+            d->len = 0;
+        }
+    }
+
+    // 快速路径：直接在输入上识别，无法识别的字节合并后一次回调
+    size_t other = pos;
+    while (pos < len) {
+        if (!demux_is_sync(data[pos])) {
+            pos++;
+            continue;
+        }
+
+        int ret = demux_check(d, &data[pos], (int)(len - pos), &frame_len, &channel);
+        if (ret == DEMUX_NONE) {
+            pos++;
+            continue;
+        }
+
+        demux_emit(d, DEMUX_OTHER, &data[other], (int)(pos - other), cb, arg);
+        if (ret == DEMUX_MORE) {
+            memcpy(d->buf, &data[pos], len - pos);
+            d->len = (int)(len - pos);
+            return;
+        }
+        demux_emit(d, channel, &data[pos], frame_len, cb, arg);
+        pos += frame_len;
+        other = pos;
+    }
+    demux_emit(d, DEMUX_OTHER, &data[other], (int)(pos - other), cb, arg);
+}
+
+/**
+ * @brief 通道名称
+ * @param channel enum demux_channel
+ * @return 名称字符串
+ */
+const char *demux_channel_name(int channel)
+{
+    return channel >= 0 && channel < DEMUX_CHANNELS ? demux_names[channel] : "unknown";
+}
@@ -0,0 +1,61 @@
+/*
+ * bds_demux.h
+ * 串口数据分流头文件
+ * 功能：接收机同一串口上交错输出RTCM3、NMEA语句和厂商二进制日志，单遍扫描字节流，
+ *       按帧头和校验（CRC-24Q、NMEA异或校验、UBX Fletcher、NovAtel/Unicore CRC32）识别每一帧，
+ *       按协议分到不同通道，无法识别的字节单独计数
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_DEMUX_H
+#define BDS_DEMUX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bds_rtcm.h"
+#include "bds_nmea.h"
+
+// 分流配置
+#define DEMUX_MAX_FRAME      4096      // 可识别的最大帧长度（RTCM3最大1029字节，二进制日志超过该长度按未识别处理）
+
+// UBX帧格式：同步字(0xB5 0x62) + 类别 + 编号 + 长度(小端16位) + 数据 + 校验(2字节)
+#define DEMUX_UBX_SYNC1      0xB5
+#define DEMUX_UBX_SYNC2      0x62
+#define DEMUX_UBX_HEADER_LEN 6
+
+// NovAtel/Unicore二进制帧格式：同步字(0xAA 0x44 0x12/0xB5) + 头长度 + ... + 数据长度(偏移8，小端16位) + 数据 + CRC32
+#define DEMUX_OEM_SYNC1      0xAA
+#define DEMUX_OEM_SYNC2      0x44
+#define DEMUX_OEM_MIN_HEADER 12
+
+// 分流通道
+enum demux_channel {
+    DEMUX_RTCM = 0,            // RTCM3差分电文（改正数链路）
+    DEMUX_NMEA,                // NMEA语句（遥测）
+    DEMUX_BINARY,              // 厂商二进制日志（存档）
+    DEMUX_OTHER,               // 无法识别的字节
+    DEMUX_CHANNELS
+};
+
+// 通道回调：data为一个完整帧（无法识别的字节为一段连续字节）
+typedef void (*demux_fn)(int channel, const unsigned char *data, int len, void *arg);
+
+// 分流器状态（只缓存跨读取边界的半帧）
+struct demux {
+    unsigned char buf[DEMUX_MAX_FRAME];
+    int len;                               // 已缓存的字节数
+    uint64_t bytes[DEMUX_CHANNELS];        // 各通道字节数
+    uint64_t frames[DEMUX_CHANNELS];       // 各通道帧数（无法识别的字节为段数）
+    uint64_t check_errors;                 // 帧头有效但校验失败的次数
+};
+
+// 函数声明
+void demux_init(struct demux *d);
+void demux_push(struct demux *d, const unsigned char *data, size_t len, demux_fn cb, void *arg);
+const char *demux_channel_name(int channel);
+
+#endif /* BDS_DEMUX_H */
@@ -0,0 +1,137 @@
+/*
+ * bds_epoch.c
+ * 历元组装源文件
+ * 功能：实现历元边界判断、缓存、截止时间检查和整历元输出
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_epoch.h"
+
+/**
+ * @brief 初始化历元组装器
+ * @param ea 历元组装器
+ * @param deadline_ms 截止时间（毫秒）
+ * @param emit 输出回调
+ * @param arg 回调参数
+ */
+void epoch_init(struct epoch_assembler *ea, int deadline_ms, epoch_emit_fn emit, void *arg)
+{
+    memset(ea, 0, sizeof(*ea));
+    ea->deadline_ns = (uint64_t)deadline_ms * 1000000ULL;
+    ea->emit = emit;
+    ea->arg = arg;
+}
+
+/**
+ * @brief 输出当前缓存的历元并清空
+ * @param ea 历元组装器
+ * @param reason 输出原因
+ */
+void epoch_flush(struct epoch_assembler *ea, int reason)
+{
+    if (ea->len > 0) {
+        ea->count[reason]++;
+        ea->emit(ea->buf, ea->len, reason, ea->first_ns, ea->arg);
+    }
+
+    ea->len = 0;
+    ea->frames = 0;
+    ea->open = 0;
+    ea->sys_mask = 0;
+}
+
+/**
+ * @brief 追加一帧到历元缓存，放不下时先输出已缓存的部分
+ * @param ea 历元组装器
+ * @param frame 帧数据
+ * @param len 帧长度
+ */
+static void epoch_append(struct epoch_assembler *ea, const unsigned char *frame, int len)
+{
+    if (ea->len + len > EPOCH_BUFFER_SIZE) {
+        uint64_t first_ns = ea->first_ns;
+        unsigned int sys_mask = ea->sys_mask;
+        epoch_flush(ea, EPOCH_OVERFLOW);
+        // 溢出后仍属同一历元，保持打开状态
+        ea->open = 1;
+        ea->first_ns = first_ns;
+        ea->sys_mask = sys_mask;
+    }
+
+    memcpy(&ea->buf[ea->len], frame, len);
+    ea->len += len;
+    ea->frames++;
+}
+
+/**
+ * @brief 输入一帧
+ * @param ea 历元组装器
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param now_ns 当前时间（单调时钟纳秒）
+ */
+void epoch_push(struct epoch_assembler *ea, const unsigned char *frame, int len, uint64_t now_ns)
+{
+    struct rtcm_obs_header hdr;
+
+    if (rtcm_parse_obs_header(frame, len, &hdr) != 1) {
+        // 非观测电文：历元打开时随历元一起输出，否则立即输出
+        if (ea->open) {
+            epoch_append(ea, frame, len);
+        } else {
+            ea->count[EPOCH_PASSTHROUGH]++;
+            ea->emit(frame, len, EPOCH_PASSTHROUGH, now_ns, ea->arg);
+        }
+        return;
+    }
+
+    // 同一系统出现了不同的历元时间：前一历元的末条电文丢失
+    unsigned int bit = 1u << hdr.sys;
+    if (ea->open && (ea->sys_mask & bit) && ea->epoch[hdr.sys] != hdr.epoch) {
+        epoch_flush(ea, EPOCH_NEXT);
+    }
+
+    if (!ea->open) {
+        ea->open = 1;
+        ea->first_ns = now_ns;
+    }
+    ea->sys_mask |= bit;
+    ea->epoch[hdr.sys] = hdr.epoch;
+    epoch_append(ea, frame, len);
+
+    if (!hdr.multiple) {
+        epoch_flush(ea, EPOCH_COMPLETE);
+    }
+}
+
+/**
+ * @brief 检查截止时间，超时则强制输出
+ * @param ea 历元组装器
+ * @param now_ns 当前时间
+ */
+void epoch_poll(struct epoch_assembler *ea, uint64_t now_ns)
+{
+    if (ea->open && now_ns - ea->first_ns >= ea->deadline_ns) {
+        epoch_flush(ea, EPOCH_DEADLINE);
+    }
+}
+
+/**
+ * @brief 计算距离截止时间的毫秒数（用于poll超时）
+ * @param ea 历元组装器
+ * @param now_ns 当前时间
+ * @return 剩余毫秒数，无打开历元返回-1
+ */
+int epoch_timeout_ms(const struct epoch_assembler *ea, uint64_t now_ns)
+{
+    if (!ea->open) {
+        return -1;
+    }
+
+    uint64_t due = ea->first_ns + ea->deadline_ns;
+    if (now_ns >= due) {
+        return 0;
+    }
+    return (int)((due - now_ns + 999999ULL) / 1000000ULL);
+}
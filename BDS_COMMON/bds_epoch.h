@@ -0,0 +1,58 @@
+/*
+ * bds_epoch.h
+ * 历元组装头文件
+ * 功能：按观测电文的历元时间和多电文标志把同一历元的RTCM3帧合并为一次输出，
+ *       末条电文丢失时按截止时间强制输出
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_EPOCH_H
+#define BDS_EPOCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bds_rtcm.h"
+
+// 历元组装配置
+#define EPOCH_BUFFER_SIZE   16384   // 单个历元的最大字节数（超出时提前输出）
+
+// 历元输出原因
+enum epoch_reason {
+    EPOCH_COMPLETE = 0,    // 收到多电文标志为0的末条电文
+    EPOCH_DEADLINE,        // 截止时间到，末条电文未到
+    EPOCH_NEXT,            // 新历元的电文先到，前一历元不完整
+    EPOCH_OVERFLOW,        // 历元缓冲区已满
+    EPOCH_PASSTHROUGH      // 不属于任何历元的电文，直接输出
+};
+
+// 历元输出回调：buf为整个历元的帧拼接，first_ns为历元第一帧到达时间
+typedef void (*epoch_emit_fn)(const unsigned char *buf, int len, int reason,
+                              uint64_t first_ns, void *arg);
+
+// 历元组装器
+struct epoch_assembler {
+    unsigned char buf[EPOCH_BUFFER_SIZE];
+    int len;                            // 已缓存字节数
+    int frames;                         // 已缓存帧数
+    int open;                           // 是否有未输出的历元
+    uint64_t first_ns;                  // 历元第一帧到达时间
+    uint32_t epoch[RTCM_SYS_COUNT];     // 各系统在当前历元中的历元时间
+    unsigned int sys_mask;              // 当前历元已出现的卫星系统
+    uint64_t deadline_ns;               // 截止时间（从第一帧起算）
+    epoch_emit_fn emit;                 // 输出回调
+    void *arg;                          // 回调参数
+    uint64_t count[EPOCH_PASSTHROUGH + 1];  // 按输出原因统计
+};
+
+// 函数声明
+void epoch_init(struct epoch_assembler *ea, int deadline_ms, epoch_emit_fn emit, void *arg);
+void epoch_push(struct epoch_assembler *ea, const unsigned char *frame, int len, uint64_t now_ns);
+void epoch_poll(struct epoch_assembler *ea, uint64_t now_ns);
+int epoch_timeout_ms(const struct epoch_assembler *ea, uint64_t now_ns);
+void epoch_flush(struct epoch_assembler *ea, int reason);
+
+#endif /* BDS_EPOCH_H */
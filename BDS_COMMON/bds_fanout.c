@@ -0,0 +1,493 @@
+/*
+ * bds_fanout.c
+ * 多目的地发送源文件
+ * 功能：引用计数数据块池、每个目的地的有界待发队列和丢弃策略，sendmsg按数据段直接发送
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_fanout.h"
+
+// 运行指标编号
+static int m_dropped = -1;
+static int m_dropped_bytes = -1;
+static int m_evicted = -1;
+static int m_evicted_bytes = -1;
+static int m_overflows = -1;
+static int m_exhausted = -1;
+static int m_chunks_max = -1;
+
+static const char *fanout_policy_names[] = { "drop-new", "drop-old", "disconnect" };
+
+/**
+ * @brief 注册多目的地发送运行指标
+ */
+static void fanout_metrics_init(void)
+{
+    m_dropped = metrics_register("bds_fanout_dropped_total",
+                                 "Messages not queued for a destination because its queue was full",
+                                 METRIC_COUNTER);
+    m_dropped_bytes = metrics_register("bds_fanout_dropped_bytes_total",
+                                       "Bytes not queued for a destination because its queue was full",
+                                       METRIC_COUNTER);
+    m_evicted = metrics_register("bds_fanout_evicted_total",
+                                 "Queued messages evicted to make room for newer data", METRIC_COUNTER);
+    m_evicted_bytes = metrics_register("bds_fanout_evicted_bytes_total",
+                                       "Queued bytes evicted to make room for newer data", METRIC_COUNTER);
+    m_overflows = metrics_register("bds_fanout_overflow_disconnects_total",
+                                   "Destinations disconnected because their queue overflowed", METRIC_COUNTER);
+    m_exhausted = metrics_register("bds_fanout_exhausted_total",
+                                   "Messages dropped because every shared chunk was in use", METRIC_COUNTER);
+    m_chunks_max = metrics_register("bds_fanout_chunks_max",
+                                    "Most shared chunks in use at once", METRIC_GAUGE_MAX);
+}
+
+/**
+ * @brief 分配数据块池（数据块和引用计数各占一个池）
+ * @param fp 数据块池
+ * @param owner 所属模块（内存预算表）
+ * @param chunks 数据块数，应不少于 目的地数 × FANOUT_QUEUE_SEGS + FANOUT_MSG_CHUNKS，保证不会用完
+ * @return 成功返回0，失败返回-1
+ */
+int fanout_pool_init(struct fanout_pool *fp, const char *owner, int chunks)
+{
+    static int metrics_ready = 0;
+
+    if (!metrics_ready) {
+        fanout_metrics_init();
+        metrics_ready = 1;
+    }
+
+    memset(fp, 0, sizeof(*fp));
+    if (pool_blocks_init(&fp->blocks, owner, "fanout chunk", FANOUT_CHUNK_SIZE, chunks) != 0) {
+        return -1;
+    }
+    fp->refs = pool_alloc(owner, "fanout chunk refcount", sizeof(int), chunks, POOL_SHARED);
+    if (fp->refs == NULL) {
+        pool_blocks_free(&fp->blocks);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 释放数据块池
+ * @param fp 数据块池
+ */
+void fanout_pool_free(struct fanout_pool *fp)
+{
+    pool_free(fp->refs);
+    pool_blocks_free(&fp->blocks);
+    fp->refs = NULL;
+}
+
+/**
+ * @brief 数据块的引用计数
+ */
+static inline int *fanout_ref(struct fanout_pool *fp, const unsigned char *chunk)
+{
+    return &fp->refs[(size_t)(chunk - fp->blocks.base) / FANOUT_CHUNK_SIZE];
+}
+
+/**
+ * @brief 释放一个数据块引用，最后一个引用释放时归还数据块
+ */
+static void fanout_put(struct fanout_pool *fp, unsigned char *chunk)
+{
+    if (--*fanout_ref(fp, chunk) == 0) {
+        pool_block_put(&fp->blocks, chunk);
+    }
+}
+
+/**
+ * @brief 把一段数据拷贝到数据块中（整个发送路径上唯一的一次拷贝），发布者持有每块一个引用
+ * @param fp 数据块池
+ * @param m 输出的消息
+ * @param buf 数据
+ * @param len 数据长度，不大于FANOUT_MSG_MAX
+ * @return 成功返回0，数据过长或数据块用完返回-1
+ */
+int fanout_msg_build(struct fanout_pool *fp, struct fanout_msg *m, const void *buf, int len)
+{
+    const unsigned char *p = buf;
+
+    m->count = 0;
+    m->len = 0;
+    if (len > FANOUT_MSG_MAX) {
+        log_warn("fanout message of %d bytes exceeds %d", len, FANOUT_MSG_MAX);
+        return -1;
+    }
+
+    while (m->len < len) {
+        unsigned char *chunk = pool_block_get(&fp->blocks);
+        if (chunk == NULL) {
+            metrics_inc(m_exhausted);
+            fanout_msg_release(fp, m);
+            return -1;
+        }
+        int n = len - m->len < FANOUT_CHUNK_SIZE ? len - m->len : FANOUT_CHUNK_SIZE;
+        memcpy(chunk, p + m->len, n);
+        *fanout_ref(fp, chunk) = 1;
+        m->chunks[m->count] = chunk;
+        m->lens[m->count] = n;
+        m->count++;
+        m->len += n;
+    }
+    metrics_max(m_chunks_max, fp->blocks.count - fp->blocks.free_count);
+    return 0;
+}
+
+/**
+ * @brief 发布者释放自己的引用（已排入队列的数据块由各队列继续持有）
+ * @param fp 数据块池
+ * @param m 消息
+ */
+void fanout_msg_release(struct fanout_pool *fp, struct fanout_msg *m)
+{
+    for (int i = 0; i < m->count; i++) {
+        fanout_put(fp, m->chunks[i]);
+    }
+    m->count = 0;
+    m->len = 0;
+}
+
+/**
+ * @brief 初始化目的地待发队列
+ * @param q 待发队列
+ * @param limit 排队字节数上限，不足一条最大消息时按一条最大消息计
+ * @param policy 放不下时的处理方式
+ */
+void fanout_queue_init(struct fanout_queue *q, int limit, enum fanout_policy policy)
+{
+    memset(q, 0, sizeof(*q));
+    q->limit = limit < FANOUT_MSG_MAX ? FANOUT_MSG_MAX : limit;
+    q->policy = policy;
+}
+
+/**
+ * @brief 队列中第i段（从队首算起）
+ */
+static inline struct fanout_seg *fanout_seg_at(struct fanout_queue *q, int i)
+{
+    return &q->segs[(q->head + i) % FANOUT_QUEUE_SEGS];
+}
+
+/**
+ * @brief 在队尾追加一段并增加数据块引用
+ */
+static void fanout_push(struct fanout_pool *fp, struct fanout_queue *q, unsigned char *chunk, int off, int len,
+                        int msg_end)
+{
+    struct fanout_seg *seg = fanout_seg_at(q, q->count);
+
+    seg->chunk = chunk;
+    seg->off = (uint16_t)off;
+    seg->len = (uint16_t)len;
+    seg->msg_end = (uint8_t)msg_end;
+    ++*fanout_ref(fp, chunk);
+    q->count++;
+    q->bytes += len;
+}
+
+/**
+ * @brief 淘汰最旧的一条尚未开始发送的消息（队首消息已发出一部分时淘汰它后面的一条）
+ * @return 淘汰了消息返回1，没有可淘汰的消息返回0
+ */
+static int fanout_evict(struct fanout_pool *fp, struct fanout_queue *q)
+{
+    int first = 0;
+
+    if (q->head_started) {
+        while (first < q->count && !fanout_seg_at(q, first)->msg_end) {
+            first++;
+        }
+        first++;
+    }
+    if (first >= q->count) {
+        return 0;
+    }
+
+    int end = first;
+    int bytes = 0;
+    while (end < q->count) {
+        struct fanout_seg *seg = fanout_seg_at(q, end++);
+        bytes += seg->len;
+        fanout_put(fp, seg->chunk);
+        if (seg->msg_end) {
+            break;
+        }
+    }
+
+    // 后面的数据段前移补上空位
+    int removed = end - first;
+    for (int i = end; i < q->count; i++) {
+        *fanout_seg_at(q, i - removed) = *fanout_seg_at(q, i);
+    }
+    q->count -= removed;
+    q->bytes -= bytes;
+    metrics_inc(m_evicted);
+    metrics_add(m_evicted_bytes, bytes);
+    return 1;
+}
+
+/**
+ * @brief 检查队列能否再放下一条消息，放不下时按丢弃策略腾出空间
+ * @return 放得下返回0，按策略丢弃新消息返回1，按FANOUT_DISCONNECT策略需要断开返回-2
+ */
+static int fanout_admit(struct fanout_pool *fp, struct fanout_queue *q, const struct fanout_msg *m)
+{
+    while (q->bytes + m->len > q->limit || q->count + m->count > FANOUT_QUEUE_SEGS) {
+        if (q->policy == FANOUT_DISCONNECT) {
+            metrics_inc(m_overflows);
+            return -2;
+        }
+        if (q->policy == FANOUT_DROP_NEW || !fanout_evict(fp, q)) {
+            metrics_inc(m_dropped);
+            metrics_add(m_dropped_bytes, m->len);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 把消息从skip字节处起按数据段排入队尾
+ */
+static void fanout_push_msg(struct fanout_pool *fp, struct fanout_queue *q, const struct fanout_msg *m, int skip)
+{
+    for (int i = 0; i < m->count; i++) {
+        if (skip >= m->lens[i]) {
+            skip -= m->lens[i];
+            continue;
+        }
+        fanout_push(fp, q, m->chunks[i], skip, m->lens[i] - skip, i == m->count - 1);
+        skip = 0;
+    }
+}
+
+/**
+ * @brief 发往一个目的地：队列为空时直接发送，socket发不完的部分和队列非空时的整条消息以引用方式排队
+ * @param fp 数据块池
+ * @param q 目的地的待发队列
+ * @param fd 目的地socket（非阻塞）
+ * @param m 消息
+ * @return 直接发出的字节数（含0），socket出错返回-1，按FANOUT_DISCONNECT策略需要断开返回-2
+ */
+int fanout_send(struct fanout_pool *fp, struct fanout_queue *q, int fd, const struct fanout_msg *m)
+{
+    int sent = 0;
+
+    if (m->len == 0) {
+        return 0;
+    }
+
+    if (q->count == 0) {
+        struct iovec iov[FANOUT_MSG_CHUNKS];
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        for (int i = 0; i < m->count; i++) {
+            iov[i].iov_base = m->chunks[i];
+            iov[i].iov_len = m->lens[i];
+        }
+        msg.msg_iov = iov;
+        msg.msg_iovlen = m->count;
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return -1;
+            }
+            sent = 0;
+        }
+        if (sent == m->len) {
+            return sent;
+        }
+        // 空队列总能放下一条消息（上限不小于FANOUT_MSG_MAX），发出一部分的消息不能丢弃
+        q->head_started = sent > 0;
+    } else {
+        int ret = fanout_admit(fp, q, m);
+        if (ret != 0) {
+            return ret < 0 ? ret : 0;
+        }
+    }
+
+    // 跳过已直接发出的部分，其余部分按数据段排队
+    fanout_push_msg(fp, q, m, sent);
+    return sent;
+}
+
+/**
+ * @brief 只排队不发送（由调用方决定何时交给socket，如延后发送的低优先级电文）
+ * @param fp 数据块池
+ * @param q 待发队列
+ * @param m 消息
+ * @return 已排队返回0，按策略丢弃返回1，按FANOUT_DISCONNECT策略需要断开返回-2
+ */
+int fanout_enqueue(struct fanout_pool *fp, struct fanout_queue *q, const struct fanout_msg *m)
+{
+    if (m->len == 0) {
+        return 0;
+    }
+    int ret = fanout_admit(fp, q, m);
+    if (ret == 0) {
+        fanout_push_msg(fp, q, m, 0);
+    }
+    return ret;
+}
+
+/**
+ * @brief 发送队首的segs个数据段（每次sendmsg最多携带FANOUT_MAX_IOV段）
+ * @return 发出的字节数，socket出错返回-1
+ */
+static int fanout_flush_segs(struct fanout_pool *fp, struct fanout_queue *q, int fd, int segs)
+{
+    int total = 0;
+
+    while (segs > 0 && q->count > 0) {
+        struct iovec iov[FANOUT_MAX_IOV];
+        struct msghdr msg;
+        int n = segs < FANOUT_MAX_IOV ? segs : FANOUT_MAX_IOV;
+        if (n > q->count) {
+            n = q->count;
+        }
+        int want = 0;
+
+        memset(&msg, 0, sizeof(msg));
+        for (int i = 0; i < n; i++) {
+            struct fanout_seg *seg = fanout_seg_at(q, i);
+            iov[i].iov_base = seg->chunk + seg->off;
+            iov[i].iov_len = seg->len;
+            want += seg->len;
+        }
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+
+        int sent = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return total;
+            }
+            return -1;
+        }
+        int partial = sent < want;
+        total += sent;
+        q->bytes -= sent;
+
+        // 发完的数据段出队并释放引用，发出一部分的数据段前移起点
+        while (sent > 0) {
+            struct fanout_seg *seg = fanout_seg_at(q, 0);
+            if (sent < seg->len) {
+                seg->off += sent;
+                seg->len -= sent;
+                q->head_started = 1;
+                break;
+            }
+            sent -= seg->len;
+            q->head_started = !seg->msg_end;
+            fanout_put(fp, seg->chunk);
+            q->head = (q->head + 1) % FANOUT_QUEUE_SEGS;
+            q->count--;
+            segs--;
+        }
+
+        // 没有全部发出说明socket发送缓冲区已满
+        if (partial) {
+            return total;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief socket可写时发送待发队列
+ * @param fp 数据块池
+ * @param q 目的地的待发队列
+ * @param fd 目的地socket（非阻塞）
+ * @return 发出的字节数，socket出错返回-1
+ */
+int fanout_flush(struct fanout_pool *fp, struct fanout_queue *q, int fd)
+{
+    return fanout_flush_segs(fp, q, fd, q->count);
+}
+
+/**
+ * @brief 按字节预算发送待发队列：先发完已发出一部分的队首消息，之后只在已交出的字节数
+ *        小于预算时开始下一条整消息（最多超出一条消息），不会在消息中间停下来等预算
+ * @param fp 数据块池
+ * @param q 待发队列
+ * @param fd 目的地socket（非阻塞）
+ * @param budget 字节预算，不大于0时只发完已开始的消息
+ * @return 发出的字节数，socket出错返回-1
+ */
+int fanout_flush_budget(struct fanout_pool *fp, struct fanout_queue *q, int fd, int budget)
+{
+    int segs = 0, bytes = 0;
+
+    // 已开始的消息必须发完，字节流中不能插入其他数据
+    if (q->head_started) {
+        while (segs < q->count) {
+            struct fanout_seg *seg = fanout_seg_at(q, segs++);
+            bytes += seg->len;
+            if (seg->msg_end) {
+                break;
+            }
+        }
+    }
+    while (segs < q->count && bytes < budget) {
+        struct fanout_seg *seg = fanout_seg_at(q, segs++);
+        bytes += seg->len;
+        while (!seg->msg_end && segs < q->count) {
+            seg = fanout_seg_at(q, segs++);
+            bytes += seg->len;
+        }
+    }
+    return fanout_flush_segs(fp, q, fd, segs);
+}
+
+/**
+ * @brief 清空待发队列（连接关闭时）
+ * @param fp 数据块池
+ * @param q 目的地的待发队列
+ * @return 丢弃的字节数
+ */
+int fanout_queue_clear(struct fanout_pool *fp, struct fanout_queue *q)
+{
+    int bytes = q->bytes;
+
+    while (q->count > 0) {
+        fanout_put(fp, fanout_seg_at(q, 0)->chunk);
+        q->head = (q->head + 1) % FANOUT_QUEUE_SEGS;
+        q->count--;
+    }
+    q->head = 0;
+    q->bytes = 0;
+    q->head_started = 0;
+    return bytes;
+}
+
+/**
+ * @brief 解析丢弃策略名称
+ * @param name drop-new、drop-old或disconnect
+ * @param policy 输出的丢弃策略
+ * @return 成功返回0，名称无效返回-1
+ */
+int fanout_policy_parse(const char *name, enum fanout_policy *policy)
+{
+    for (int i = 0; i < (int)(sizeof(fanout_policy_names) / sizeof(fanout_policy_names[0])); i++) {
+        if (strcmp(name, fanout_policy_names[i]) == 0) {
+            *policy = (enum fanout_policy)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 丢弃策略名称
+ * @param policy 丢弃策略
+ * @return 名称字符串
+ */
+const char *fanout_policy_name(enum fanout_policy policy)
+{
+    return fanout_policy_names[policy];
+}
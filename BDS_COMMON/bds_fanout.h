@@ -0,0 +1,88 @@
+/*
+ * bds_fanout.h
+ * 多目的地发送头文件
+ * 功能：同一份数据只拷贝一次到引用计数的数据块中，发往多个目的地；每个目的地有独立的
+ *       有界待发队列（只保存数据块引用）和丢弃策略，socket发不完的部分排队，
+ *       一个目的地积压或断开不影响其他目的地
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_FANOUT_H
+#define BDS_FANOUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "bds_metrics.h"
+#include "bds_pool.h"
+#include "bds_log.h"
+
+// 多目的地发送配置
+#define FANOUT_CHUNK_SIZE    1024        // 数据块大小（一次串口读取）
+#define FANOUT_MSG_MAX       16384       // 一次发布的最大字节数（一个完整历元）
+#define FANOUT_MSG_CHUNKS    (FANOUT_MSG_MAX / FANOUT_CHUNK_SIZE)
+#define FANOUT_QUEUE_SEGS    128         // 每个目的地待发队列最多引用的数据段数
+#define FANOUT_MAX_IOV       16          // 每次sendmsg最多携带的数据段数
+
+// 目的地待发队列放不下新数据时的处理方式
+enum fanout_policy {
+    FANOUT_DROP_NEW = 0,       // 丢弃新数据（整条消息），已排队的数据照常发出
+    FANOUT_DROP_OLD,           // 从队首淘汰尚未开始发送的整条旧消息，优先保证新数据
+    FANOUT_DISCONNECT          // 断开连接，重连后从新数据开始
+};
+
+// 引用计数的数据块池（单线程使用）
+struct fanout_pool {
+    struct pool_blocks blocks; // 数据块
+    int *refs;                 // 每个数据块的引用数
+};
+
+// 一次发布的数据（发布者持有每个数据块的一个引用）
+struct fanout_msg {
+    int count;                                 // 数据块数
+    int len;                                   // 总字节数
+    unsigned char *chunks[FANOUT_MSG_CHUNKS];  // 数据块
+    int lens[FANOUT_MSG_CHUNKS];               // 每个数据块中的有效字节数
+};
+
+// 待发队列中的一段（引用一个数据块的一部分）
+struct fanout_seg {
+    unsigned char *chunk;      // 数据块
+    uint16_t off;              // 未发出部分的起点
+    uint16_t len;              // 未发出部分的长度
+    uint8_t msg_end;           // 是否为一条消息的最后一段
+};
+
+// 一个目的地的待发队列
+struct fanout_queue {
+    struct fanout_seg segs[FANOUT_QUEUE_SEGS];  // 环形数组
+    int head;                  // 队首位置
+    int count;                 // 段数
+    int bytes;                 // 排队的字节数
+    int limit;                 // 排队字节数上限
+    int head_started;          // 队首消息已发出一部分（不能再淘汰，否则对端收到半帧）
+    enum fanout_policy policy; // 放不下时的处理方式
+};
+
+// 函数声明
+int fanout_pool_init(struct fanout_pool *fp, const char *owner, int chunks);
+void fanout_pool_free(struct fanout_pool *fp);
+int fanout_msg_build(struct fanout_pool *fp, struct fanout_msg *m, const void *buf, int len);
+void fanout_msg_release(struct fanout_pool *fp, struct fanout_msg *m);
+void fanout_queue_init(struct fanout_queue *q, int limit, enum fanout_policy policy);
+int fanout_send(struct fanout_pool *fp, struct fanout_queue *q, int fd, const struct fanout_msg *m);
+int fanout_enqueue(struct fanout_pool *fp, struct fanout_queue *q, const struct fanout_msg *m);
+int fanout_flush(struct fanout_pool *fp, struct fanout_queue *q, int fd);
+int fanout_flush_budget(struct fanout_pool *fp, struct fanout_queue *q, int fd, int budget);
+int fanout_queue_clear(struct fanout_pool *fp, struct fanout_queue *q);
+int fanout_policy_parse(const char *name, enum fanout_policy *policy);
+const char *fanout_policy_name(enum fanout_policy policy);
+
+#endif /* BDS_FANOUT_H */
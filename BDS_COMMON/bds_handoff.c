@@ -0,0 +1,345 @@
+/*
+ * bds_handoff.c
+ * 热升级交接源文件
+ * 功能：抽象命名空间的SOCK_SEQPACKET监听、SCM_RIGHTS收发描述符和缓存数据、应答确认
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_handoff.h"
+
+// 交接报文头（同一台机器上的新旧进程之间传递，使用本机字节序）
+struct handoff_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fd_count;
+    uint32_t data_len;
+    int32_t roles[HANDOFF_MAX_FDS];
+};
+
+/**
+ * @brief 填写抽象命名空间的Unix域地址（不在文件系统中留下文件）
+ * @param addr 输出地址
+ * @param name 名称
+ * @return 地址长度
+ */
+static socklen_t handoff_addr(struct sockaddr_un *addr, const char *name)
+{
+    size_t len = strlen(name);
+
+    if (len > sizeof(addr->sun_path) - 1) {
+        len = sizeof(addr->sun_path) - 1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(&addr->sun_path[1], name, len);
+
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + len);
+}
+
+/**
+ * @brief 等待描述符可读
+ * @param fd 描述符
+ * @return 可读返回0，超时或出错返回-1
+ */
+static int handoff_wait(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    while (1) {
+        int n = poll(&pfd, 1, HANDOFF_TIMEOUT_MS);
+        if (n > 0) {
+            return 0;
+        }
+        if (n == 0) {
+            log_warn("handoff timed out");
+            return -1;
+        }
+        if (errno != EINTR) {
+            log_errno("handoff poll failed");
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief 创建交接监听套接字（非阻塞）
+ * @param name 名称（每个程序一个，如"bds_base.handoff"）
+ * @return 成功返回套接字描述符，名称已被占用（已有实例在运行）或失败返回-1
+ */
+int handoff_listen(const char *name)
+{
+    struct sockaddr_un addr;
+    socklen_t addr_len = handoff_addr(&addr, name);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("handoff socket creation failed");
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        if (errno == EADDRINUSE) {
+            fprintf(stderr, "Warning: another instance owns %s, hot upgrade disabled\n", name);
+        } else {
+            perror("handoff bind failed");
+        }
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, 1) < 0) {
+        perror("handoff listen failed");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief 检查是否有新进程请求交接（不阻塞）
+ * @param listen_fd 交接监听套接字
+ * @return 有请求返回连接描述符，没有请求返回-1
+ */
+int handoff_accept(int listen_fd)
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        log_errno("handoff accept failed");
+    }
+    return fd;
+}
+
+/**
+ * @brief 向新进程发送交接内容并等待确认（旧进程调用，完成后关闭连接）
+ * @param conn_fd handoff_accept返回的连接
+ * @param st 交接内容
+ * @return 新进程确认返回0（旧进程应立即停止并退出），失败返回-1（旧进程继续运行）
+ */
+int handoff_send(int conn_fd, const struct handoff_state *st)
+{
+    struct handoff_header hdr;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    } ctrl;
+    struct iovec iov[2];
+    struct msghdr msg;
+    uint32_t ack = 0;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = HANDOFF_MAGIC;
+    hdr.version = HANDOFF_VERSION;
+    hdr.fd_count = st->fd_count;
+    hdr.data_len = st->data_len;
+    for (int i = 0; i < st->fd_count; i++) {
+        hdr.roles[i] = st->roles[i];
+    }
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (void *)st->data;
+    iov[1].iov_len = st->data_len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    if (st->fd_count > 0) {
+        memset(&ctrl, 0, sizeof(ctrl));
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * st->fd_count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * st->fd_count);
+        memcpy(CMSG_DATA(cmsg), st->fds, sizeof(int) * st->fd_count);
+    }
+
+    if (sendmsg(conn_fd, &msg, MSG_NOSIGNAL) != (ssize_t)(sizeof(hdr) + st->data_len)) {
+        log_errno("handoff sendmsg failed");
+        close(conn_fd);
+        return -1;
+    }
+
+    // 新进程确认收到后旧进程才能退出；新进程中途失败时旧进程继续工作
+    if (handoff_wait(conn_fd) != 0 ||
+        recv(conn_fd, &ack, sizeof(ack), 0) != sizeof(ack) || ack != HANDOFF_MAGIC) {
+        log_warn("handoff not acknowledged, continuing");
+        close(conn_fd);
+        return -1;
+    }
+
+    close(conn_fd);
+    return 0;
+}
+
+/**
+ * @brief 向运行中的旧进程请求交接（新进程调用）
+ * @param name 名称
+ * @param st 输出的交接内容
+ * @return 成功返回0（已确认，旧进程随即退出），没有运行中的实例或失败返回-1
+ */
+int handoff_request(const char *name, struct handoff_state *st)
+{
+    struct sockaddr_un addr;
+    socklen_t addr_len = handoff_addr(&addr, name);
+    struct handoff_header hdr;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    } ctrl;
+    struct iovec iov[2];
+    struct msghdr msg;
+    uint32_t ack = HANDOFF_MAGIC;
+
+    handoff_init(st);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("handoff socket creation failed");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        perror("handoff connect failed");
+        close(fd);
+        return -1;
+    }
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = st->data;
+    iov[1].iov_len = sizeof(st->data);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    if (handoff_wait(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+
+    // 先收下描述符，校验失败时也要关闭，避免泄漏
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n > 0 && cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        st->fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(st->fds, CMSG_DATA(cmsg), sizeof(int) * st->fd_count);
+    }
+
+    if (n < (ssize_t)sizeof(hdr) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+        hdr.magic != HANDOFF_MAGIC || hdr.version != HANDOFF_VERSION ||
+        hdr.fd_count != (uint32_t)st->fd_count || n != (ssize_t)(sizeof(hdr) + hdr.data_len)) {
+        fprintf(stderr, "invalid handoff message\n");
+        for (int i = 0; i < st->fd_count; i++) {
+            close(st->fds[i]);
+        }
+        handoff_init(st);
+        close(fd);
+        return -1;
+    }
+
+    for (int i = 0; i < st->fd_count; i++) {
+        st->roles[i] = hdr.roles[i];
+    }
+    st->data_len = hdr.data_len;
+
+    if (send(fd, &ack, sizeof(ack), MSG_NOSIGNAL) != sizeof(ack)) {
+        perror("handoff ack failed");
+        for (int i = 0; i < st->fd_count; i++) {
+            close(st->fds[i]);
+        }
+        handoff_init(st);
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+/**
+ * @brief 清空交接内容
+ * @param st 交接内容
+ */
+void handoff_init(struct handoff_state *st)
+{
+    st->fd_count = 0;
+    st->data_len = 0;
+}
+
+/**
+ * @brief 添加一个要交接的描述符
+ * @param st 交接内容
+ * @param role 用途（enum handoff_role）
+ * @param fd 描述符（小于0时忽略）
+ * @return 成功返回0，超出上限返回-1
+ */
+int handoff_add_fd(struct handoff_state *st, int role, int fd)
+{
+    if (fd < 0) {
+        return 0;
+    }
+    if (st->fd_count >= HANDOFF_MAX_FDS) {
+        log_warn("too many fds to hand off");
+        return -1;
+    }
+
+    st->fds[st->fd_count] = fd;
+    st->roles[st->fd_count] = role;
+    st->fd_count++;
+    return 0;
+}
+
+/**
+ * @brief 追加尚未发出的缓存数据
+ * @param st 交接内容
+ * @param data 数据
+ * @param len 数据长度
+ * @return 成功返回0，超出上限返回-1
+ */
+int handoff_add_data(struct handoff_state *st, const void *data, int len)
+{
+    if (len < 0 || len > HANDOFF_MAX_DATA - st->data_len) {
+        log_warn("too much in-flight data to hand off");
+        return -1;
+    }
+
+    memcpy(&st->data[st->data_len], data, len);
+    st->data_len += len;
+    return 0;
+}
+
+/**
+ * @brief 取回一个指定用途的描述符（同一用途有多个时依次取回）
+ * @param st 交接内容
+ * @param role 用途
+ * @return 描述符，没有该用途的描述符返回-1
+ */
+int handoff_take_fd(struct handoff_state *st, int role)
+{
+    for (int i = 0; i < st->fd_count; i++) {
+        if (st->roles[i] == role && st->fds[i] >= 0) {
+            int fd = st->fds[i];
+            st->fds[i] = -1;
+            return fd;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 关闭未被取回的描述符（新版本不再使用的用途）
+ * @param st 交接内容
+ */
+void handoff_release(struct handoff_state *st)
+{
+    for (int i = 0; i < st->fd_count; i++) {
+        if (st->fds[i] >= 0) {
+            close(st->fds[i]);
+            st->fds[i] = -1;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * bds_handoff.h
+ * 热升级交接头文件
+ * 功能：新进程通过Unix域套接字向运行中的旧进程请求交接，旧进程用SCM_RIGHTS传递
+ *       串口、套接字等文件描述符以及尚未发出的缓存数据，新进程确认后旧进程退出
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_HANDOFF_H
+#define BDS_HANDOFF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "bds_log.h"
+
+// 交接配置
+#define HANDOFF_MAX_FDS     32              // 单次交接的最大描述符数
+#define HANDOFF_MAX_DATA    (64 * 1024)     // 缓存数据的最大长度
+#define HANDOFF_TIMEOUT_MS  2000            // 等待对方应答的超时时间（毫秒）
+#define HANDOFF_MAGIC       0x46464F48      // "HOFF"
+#define HANDOFF_VERSION     4               // 交接数据格式不兼容时递增
+
+// 描述符用途（接收方按用途取回）
+enum handoff_role {
+    HANDOFF_FD_CONTROL = 1,    // 交接监听套接字本身，新进程继续用于下一次升级
+    HANDOFF_FD_METRICS,        // 指标HTTP监听套接字
+    HANDOFF_FD_SERIAL,         // 串口
+    HANDOFF_FD_UPLINK,         // 基站到服务器的连接
+    HANDOFF_FD_LISTEN,         // 流动站监听套接字
+    HANDOFF_FD_CLIENT,         // 流动站已接受的连接
+    HANDOFF_FD_RELAY           // 流动站下游转发监听套接字
+};
+
+// 交接内容
+struct handoff_state {
+    int fd_count;
+    int fds[HANDOFF_MAX_FDS];
+    int roles[HANDOFF_MAX_FDS];
+    int data_len;                          // 缓存数据长度（按原顺序继续发送）
+    unsigned char data[HANDOFF_MAX_DATA];
+};
+
+// 函数声明
+int handoff_listen(const char *name);
+int handoff_accept(int listen_fd);
+int handoff_send(int conn_fd, const struct handoff_state *st);
+int handoff_request(const char *name, struct handoff_state *st);
+void handoff_init(struct handoff_state *st);
+int handoff_add_fd(struct handoff_state *st, int role, int fd);
+int handoff_add_data(struct handoff_state *st, const void *data, int len);
+int handoff_take_fd(struct handoff_state *st, int role);
+void handoff_release(struct handoff_state *st);
+
+#endif /* BDS_HANDOFF_H */
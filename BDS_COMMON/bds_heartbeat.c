@@ -0,0 +1,92 @@
+/*
+ * bds_heartbeat.c
+ * 链路心跳源文件
+ * 功能：心跳电文（专有电文4094）的编码和解码
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_heartbeat.h"
+
+/**
+ * @brief 写入64位字段（分高低32位）
+ * @param buf 电文
+ * @param pos 起始位
+ * @param v 数值
+ */
+static void heartbeat_set_u64(unsigned char *buf, int pos, uint64_t v)
+{
+    rtcm_set_bits(buf, pos, 32, (uint32_t)(v >> 32));
+    rtcm_set_bits(buf, pos + 32, 32, (uint32_t)v);
+}
+
+/**
+ * @brief 读取64位字段
+ * @param buf 电文
+ * @param pos 起始位
+ * @return 数值
+ */
+static uint64_t heartbeat_get_u64(const unsigned char *buf, int pos)
+{
+    return ((uint64_t)rtcm_get_bits(buf, pos, 32) << 32) | rtcm_get_bits(buf, pos + 32, 32);
+}
+
+/**
+ * @brief 编码心跳帧
+ * @param hb 心跳内容
+ * @param out 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 帧长度，缓冲区不足返回-1
+ *
+ * 电文格式：电文号(12) 类型(4) 标识(32) 版本(8) 序号(32) 时间戳(64) 应答时间戳(64) 驻留时间(32) 队列深度(32)
+ */
+int heartbeat_encode(const struct heartbeat *hb, unsigned char *out, size_t size)
+{
+    unsigned char payload[HEARTBEAT_PAYLOAD_LEN];
+
+    memset(payload, 0, sizeof(payload));
+    rtcm_set_bits(payload, 0, 12, HEARTBEAT_MSG_TYPE);
+    rtcm_set_bits(payload, 12, 4, hb->kind);
+    rtcm_set_bits(payload, 16, 32, HEARTBEAT_MAGIC);
+    rtcm_set_bits(payload, 48, 8, HEARTBEAT_VERSION);
+    rtcm_set_bits(payload, 56, 32, hb->seq);
+    heartbeat_set_u64(payload, 88, hb->send_ns);
+    heartbeat_set_u64(payload, 152, hb->echo_ns);
+    rtcm_set_bits(payload, 216, 32, hb->hold_us);
+    rtcm_set_bits(payload, 248, 32, hb->queued);
+
+    return rtcm_frame_encode(payload, sizeof(payload), out, size);
+}
+
+/**
+ * @brief 解码心跳帧：长度、标识、版本和类型都匹配才是心跳，其他4094电文（厂商专有数据）原样转发
+ * @param frame 校验通过的完整帧
+ * @param len 帧长度
+ * @param hb 输出的心跳内容
+ * @return 是心跳帧返回1，不是返回0，帧头不完整返回-1
+ */
+int heartbeat_decode(const unsigned char *frame, int len, struct heartbeat *hb)
+{
+    const unsigned char *payload = frame + RTCM3_HEADER_LEN;
+    int type = rtcm_msg_type(frame, len);
+
+    if (type != HEARTBEAT_MSG_TYPE) {
+        return type < 0 ? -1 : 0;
+    }
+    if (len != HEARTBEAT_FRAME_LEN || rtcm_get_bits(payload, 16, 32) != HEARTBEAT_MAGIC ||
+        rtcm_get_bits(payload, 48, 8) != HEARTBEAT_VERSION) {
+        return 0;
+    }
+    int kind = rtcm_get_bits(payload, 12, 4);
+    if (kind != HEARTBEAT_BEAT && kind != HEARTBEAT_ECHO) {
+        return 0;
+    }
+
+    hb->kind = kind;
+    hb->seq = rtcm_get_bits(payload, 56, 32);
+    hb->send_ns = heartbeat_get_u64(payload, 88);
+    hb->echo_ns = heartbeat_get_u64(payload, 152);
+    hb->hold_us = rtcm_get_bits(payload, 216, 32);
+    hb->queued = rtcm_get_bits(payload, 248, 32);
+    return 1;
+}
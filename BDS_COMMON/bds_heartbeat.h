@@ -0,0 +1,49 @@
+/*
+ * bds_heartbeat.h
+ * 链路心跳头文件
+ * 功能：基站→流动站链路上的带内心跳。基站在帧边界插入专有RTCM3电文，携带序号、发送时的系统时钟
+ *       和待发队列深度；流动站在写串口前剥离心跳，计算数据龄期，并立即回送应答，
+ *       基站在下一个心跳中带回应答时间戳和驻留时间，流动站据此计算往返时延（不依赖两端时钟同步）；
+ *       4094是厂商专有电文号，接收机同样会输出，只有标识和版本都匹配的电文才是心跳
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_HEARTBEAT_H
+#define BDS_HEARTBEAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bds_rtcm.h"
+
+// 心跳配置
+#define HEARTBEAT_MSG_TYPE      4094            // 专有电文号（4095用于并发测试电文）
+#define HEARTBEAT_MAGIC         0x42444842      // 心跳标识"BDHB"，区别于其他厂商的4094电文
+#define HEARTBEAT_VERSION       1               // 心跳格式版本，格式变化时递增
+#define HEARTBEAT_PAYLOAD_LEN   35              // 电文长度（字节）
+#define HEARTBEAT_FRAME_LEN     (RTCM3_HEADER_LEN + HEARTBEAT_PAYLOAD_LEN + RTCM3_CRC_LEN)
+
+// 心跳方向
+enum heartbeat_kind {
+    HEARTBEAT_BEAT = 1,        // 基站→流动站：心跳
+    HEARTBEAT_ECHO = 2         // 流动站→基站：应答
+};
+
+// 心跳内容
+struct heartbeat {
+    int kind;                  // enum heartbeat_kind
+    uint32_t seq;              // 心跳序号（应答中为所应答的心跳序号）
+    uint64_t send_ns;          // 心跳：基站发送时的系统时钟（UTC纳秒）；应答：流动站收到心跳时的单调时钟
+    uint64_t echo_ns;          // 心跳：最近一次应答中的流动站时间戳，0表示还没有应答
+    uint32_t hold_us;          // 心跳：基站收到该应答到发出本心跳的间隔（微秒）
+    uint32_t queued;           // 心跳：基站发送时尚未发出的字节数（用户态队列加socket发送缓冲区）
+};
+
+// 函数声明
+int heartbeat_encode(const struct heartbeat *hb, unsigned char *out, size_t size);
+int heartbeat_decode(const unsigned char *frame, int len, struct heartbeat *hb);
+
+#endif /* BDS_HEARTBEAT_H */
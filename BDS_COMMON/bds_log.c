@@ -0,0 +1,945 @@
+/*
+ * bds_log.c
+ * 异步日志源文件
+ * 功能：每线程无锁环形缓冲区、调用点限速与抑制计数、后台格式化输出、二进制日志文件
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_log.h"
+
+// 格式说明符中的长度修饰
+enum log_length {
+    LOG_LEN_NONE = 0,
+    LOG_LEN_HH,
+    LOG_LEN_H,
+    LOG_LEN_L,
+    LOG_LEN_LL,
+    LOG_LEN_Z,
+    LOG_LEN_J,
+    LOG_LEN_T,
+    LOG_LEN_BIG_L
+};
+
+// 解析出的格式说明符
+struct log_spec {
+    char flags[8];             // 标志字符
+    int width;                 // 宽度，-1表示未指定
+    int width_star;            // 宽度由参数给出
+    int prec;                  // 精度，-1表示未指定
+    int prec_star;             // 精度由参数给出
+    int length;                // enum log_length
+    char conv;                 // 转换字符，0表示格式串不完整
+};
+
+// 日志状态（后台线程启动后环形缓冲区才可用，之前的调用直接同步输出）
+static struct {
+    struct log_ring *rings;               // LOG_MAX_THREADS个环形缓冲区
+    atomic_int ring_count;                // 已分配给线程的环形缓冲区数
+    struct log_site *_Atomic sites[LOG_MAX_SITES];   // 登记的调用点
+    atomic_int site_count;
+    atomic_int running;                   // 后台线程运行中，清零后等写入中的记录完成、取完剩余记录并退出
+    atomic_int sleeping;                  // 后台线程即将在futex上等待，写入记录后需要唤醒
+    int fd;                               // 二进制日志文件，-1表示不写文件
+    pthread_t tid;
+    char text_err[LOG_RING_RECORDS * LOG_TEXT_SIZE / 8];  // 一批标准错误输出
+    int text_err_len;
+    char text_out[LOG_RING_RECORDS * LOG_TEXT_SIZE / 8];  // 一批标准输出
+    int text_out_len;
+    unsigned char file_buf[64 * 1024];    // 一批二进制日志
+    int file_len;
+} log_state = { .fd = -1 };
+
+// 本线程的环形缓冲区，NULL表示尚未分配；分配完后的线程为log_no_ring
+static __thread struct log_ring *log_my_ring;
+static struct log_ring log_no_ring_mark;
+#define log_no_ring (&log_no_ring_mark)
+
+// 运行指标编号
+static int m_records = -1;
+static int m_dropped = -1;
+static int m_suppressed = -1;
+static int m_ring_max = -1;
+static int m_wakeups = -1;
+
+/**
+ * @brief 注册日志运行指标
+ */
+static void log_metrics_init(void)
+{
+    m_records = metrics_register("bds_log_records_total",
+                                 "Log records written by the background thread", METRIC_COUNTER);
+    m_dropped = metrics_register("bds_log_dropped_total",
+                                 "Log records dropped because the thread's ring was full", METRIC_COUNTER);
+    m_suppressed = metrics_register("bds_log_suppressed_total",
+                                    "Log records suppressed by the per-site rate limit", METRIC_COUNTER);
+    m_ring_max = metrics_register("bds_log_ring_records_max",
+                                  "Most records waiting in one thread's ring", METRIC_GAUGE_MAX);
+    m_wakeups = metrics_register("bds_log_wakeups_total",
+                                 "Futex wakeups of the idle log thread", METRIC_COUNTER);
+}
+
+/**
+ * @brief futex系统调用（进程内，使用FUTEX_PRIVATE_FLAG）
+ */
+static inline long log_futex(atomic_int *addr, int op, int val, const struct timespec *ts)
+{
+    return syscall(SYS_futex, (int *)addr, op | FUTEX_PRIVATE_FLAG, val, ts, NULL, 0);
+}
+
+/**
+ * @brief 唤醒空闲的后台线程：只有后台线程已置等待标志时才做系统调用，
+ *        与后台线程的“先置等待标志、再检查各环形缓冲区”配对，不会漏掉唤醒
+ */
+static void log_wake(void)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&log_state.sleeping, memory_order_relaxed) &&
+        atomic_exchange_explicit(&log_state.sleeping, 0, memory_order_relaxed)) {
+        log_futex(&log_state.sleeping, FUTEX_WAKE, 1, NULL);
+        metrics_inc(m_wakeups);
+    }
+}
+
+/**
+ * @brief 解析一个格式说明符
+ * @param p 指向'%'之后的字符
+ * @param spec 输出的说明符
+ * @return 指向转换字符（格式串不完整时指向结尾的'\0'）
+ */
+static const char *log_parse_spec(const char *p, struct log_spec *spec)
+{
+    int n = 0;
+
+    memset(spec, 0, sizeof(*spec));
+    spec->width = -1;
+    spec->prec = -1;
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+        if (n < (int)sizeof(spec->flags) - 1) {
+            spec->flags[n++] = *p;
+        }
+        p++;
+    }
+    if (*p == '*') {
+        spec->width_star = 1;
+        p++;
+    } else if (*p >= '0' && *p <= '9') {
+        spec->width = (int)strtol(p, (char **)&p, 10);
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->prec_star = 1;
+            p++;
+        } else {
+            spec->prec = (int)strtol(p, (char **)&p, 10);
+        }
+    }
+
+    switch (*p) {
+    case 'h':
+        spec->length = p[1] == 'h' ? LOG_LEN_HH : LOG_LEN_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = p[1] == 'l' ? LOG_LEN_LL : LOG_LEN_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+    case 'z':
+        spec->length = LOG_LEN_Z;
+        p++;
+        break;
+    case 'j':
+        spec->length = LOG_LEN_J;
+        p++;
+        break;
+    case 't':
+        spec->length = LOG_LEN_T;
+        p++;
+        break;
+    case 'L':
+        spec->length = LOG_LEN_BIG_L;
+        p++;
+        break;
+    default:
+        break;
+    }
+
+    spec->conv = *p;
+    return p;
+}
+
+/**
+ * @brief 参数区追加一个8字节值
+ * @return 成功返回0，放不下返回-1
+ */
+static int log_put_u64(unsigned char *out, int *len, uint64_t v)
+{
+    if (*len + 8 > LOG_ARGS_SIZE) {
+        return -1;
+    }
+    memcpy(&out[*len], &v, 8);
+    *len += 8;
+    return 0;
+}
+
+/**
+ * @brief 读取一个有符号整数参数（按长度修饰取出并截断）
+ */
+static int64_t log_arg_signed(va_list *ap, int length)
+{
+    switch (length) {
+    case LOG_LEN_HH:
+        return (signed char)va_arg(*ap, int);
+    case LOG_LEN_H:
+        return (short)va_arg(*ap, int);
+    case LOG_LEN_L:
+        return va_arg(*ap, long);
+    case LOG_LEN_LL:
+        return va_arg(*ap, long long);
+    case LOG_LEN_Z:
+        return (int64_t)va_arg(*ap, size_t);
+    case LOG_LEN_J:
+        return va_arg(*ap, intmax_t);
+    case LOG_LEN_T:
+        return va_arg(*ap, ptrdiff_t);
+    default:
+        return va_arg(*ap, int);
+    }
+}
+
+/**
+ * @brief 读取一个无符号整数参数（按长度修饰取出并截断）
+ */
+static uint64_t log_arg_unsigned(va_list *ap, int length)
+{
+    switch (length) {
+    case LOG_LEN_HH:
+        return (unsigned char)va_arg(*ap, unsigned int);
+    case LOG_LEN_H:
+        return (unsigned short)va_arg(*ap, unsigned int);
+    case LOG_LEN_L:
+        return va_arg(*ap, unsigned long);
+    case LOG_LEN_LL:
+        return va_arg(*ap, unsigned long long);
+    case LOG_LEN_Z:
+        return va_arg(*ap, size_t);
+    case LOG_LEN_J:
+        return va_arg(*ap, uintmax_t);
+    case LOG_LEN_T:
+        return (uint64_t)va_arg(*ap, ptrdiff_t);
+    default:
+        return va_arg(*ap, unsigned int);
+    }
+}
+
+/**
+ * @brief 按格式串把参数编码到参数区：整数和指针8字节，浮点数按double 8字节，
+ *        字符串为1字节长度加内容（调用返回后指针可能失效，必须拷贝）
+ * @param fmt 格式串
+ * @param ap 参数
+ * @param out 参数区
+ * @return 编码长度（放不下的参数及其后的参数不编码，格式化时显示为"..."）
+ */
+static int log_encode(const char *fmt, va_list *ap, unsigned char *out)
+{
+    struct log_spec spec;
+    int len = 0;
+
+    for (const char *p = fmt; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        p = log_parse_spec(p + 1, &spec);
+        if (spec.conv == '\0') {
+            break;
+        }
+        if ((spec.width_star && log_put_u64(out, &len, (uint64_t)(int64_t)va_arg(*ap, int)) != 0) ||
+            (spec.prec_star && log_put_u64(out, &len, (uint64_t)(int64_t)va_arg(*ap, int)) != 0)) {
+            break;
+        }
+
+        int full = 0;
+        switch (spec.conv) {
+        case 'd':
+        case 'i':
+            full = log_put_u64(out, &len, (uint64_t)log_arg_signed(ap, spec.length));
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            full = log_put_u64(out, &len, log_arg_unsigned(ap, spec.length));
+            break;
+        case 'c':
+            full = log_put_u64(out, &len, (uint64_t)va_arg(*ap, int));
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            double d = spec.length == LOG_LEN_BIG_L ? (double)va_arg(*ap, long double) : va_arg(*ap, double);
+            uint64_t v;
+            memcpy(&v, &d, 8);
+            full = log_put_u64(out, &len, v);
+            break;
+        }
+        case 'p':
+            full = log_put_u64(out, &len, (uint64_t)(uintptr_t)va_arg(*ap, void *));
+            break;
+        case 's': {
+            const char *s = va_arg(*ap, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            int n = (int)strnlen(s, LOG_STR_MAX);
+            if (len + 1 + n > LOG_ARGS_SIZE) {
+                full = -1;
+                break;
+            }
+            out[len] = (unsigned char)n;
+            memcpy(&out[len + 1], s, n);
+            len += 1 + n;
+            break;
+        }
+        default:
+            // 不支持的转换（如%n）：不读取参数，之后的参数无法对齐，停止编码
+            full = -1;
+            break;
+        }
+        if (full != 0) {
+            break;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief 从参数区取一个8字节值
+ * @return 成功返回0，参数已用完返回-1
+ */
+static int log_get_u64(const unsigned char *args, int args_len, int *pos, uint64_t *v)
+{
+    if (*pos + 8 > args_len) {
+        return -1;
+    }
+    memcpy(v, &args[*pos], 8);
+    *pos += 8;
+    return 0;
+}
+
+/**
+ * @brief 按格式串和编码后的参数生成文本（后台线程和解码工具共用）
+ * @param fmt 格式串
+ * @param args 参数区
+ * @param args_len 参数长度
+ * @param out 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 输出长度（不含结尾的'\0'）
+ */
+static int log_render(const char *fmt, const unsigned char *args, int args_len, char *out, int size)
+{
+    struct log_spec spec;
+    int len = 0, pos = 0;
+
+    for (const char *p = fmt; *p != '\0' && len < size - 1; p++) {
+        if (*p != '%') {
+            out[len++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p++;
+            continue;
+        }
+        p = log_parse_spec(p + 1, &spec);
+        if (spec.conv == '\0') {
+            break;
+        }
+
+        // 重建说明符：宽度和精度代入数值，整数统一按long long输出
+        uint64_t v = 0, star = 0;
+        char sf[48];
+        int n = snprintf(sf, sizeof(sf), "%%%s", spec.flags);
+        if (spec.width_star) {
+            if (log_get_u64(args, args_len, &pos, &star) != 0) {
+                goto truncated;
+            }
+            n += snprintf(sf + n, sizeof(sf) - n, "%d", (int)(int64_t)star);
+        } else if (spec.width >= 0) {
+            n += snprintf(sf + n, sizeof(sf) - n, "%d", spec.width);
+        }
+        if (spec.prec_star) {
+            if (log_get_u64(args, args_len, &pos, &star) != 0) {
+                goto truncated;
+            }
+            if ((int)(int64_t)star >= 0) {
+                n += snprintf(sf + n, sizeof(sf) - n, ".%d", (int)(int64_t)star);
+            }
+        } else if (spec.prec >= 0) {
+            n += snprintf(sf + n, sizeof(sf) - n, ".%d", spec.prec);
+        }
+
+        int room = size - len;
+        int w = 0;
+        switch (spec.conv) {
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (log_get_u64(args, args_len, &pos, &v) != 0) {
+                goto truncated;
+            }
+            snprintf(sf + n, sizeof(sf) - n, "ll%c", spec.conv);
+            if (spec.conv == 'd' || spec.conv == 'i') {
+                w = snprintf(&out[len], room, sf, (long long)(int64_t)v);
+            } else {
+                w = snprintf(&out[len], room, sf, (unsigned long long)v);
+            }
+            break;
+        case 'c':
+            if (log_get_u64(args, args_len, &pos, &v) != 0) {
+                goto truncated;
+            }
+            snprintf(sf + n, sizeof(sf) - n, "c");
+            w = snprintf(&out[len], room, sf, (int)v);
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            double d;
+            if (log_get_u64(args, args_len, &pos, &v) != 0) {
+                goto truncated;
+            }
+            memcpy(&d, &v, 8);
+            snprintf(sf + n, sizeof(sf) - n, "%c", spec.conv);
+            w = snprintf(&out[len], room, sf, d);
+            break;
+        }
+        case 'p':
+            if (log_get_u64(args, args_len, &pos, &v) != 0) {
+                goto truncated;
+            }
+            snprintf(sf + n, sizeof(sf) - n, "p");
+            w = snprintf(&out[len], room, sf, (void *)(uintptr_t)v);
+            break;
+        case 's': {
+            char s[LOG_STR_MAX + 1];
+            if (pos >= args_len || pos + 1 + args[pos] > args_len) {
+                goto truncated;
+            }
+            memcpy(s, &args[pos + 1], args[pos]);
+            s[args[pos]] = '\0';
+            pos += 1 + args[pos];
+            snprintf(sf + n, sizeof(sf) - n, "s");
+            w = snprintf(&out[len], room, sf, s);
+            break;
+        }
+        default:
+            goto truncated;
+        }
+        len += w < room ? w : room - 1;
+    }
+    out[len] = '\0';
+    return len;
+
+truncated:
+    len += snprintf(&out[len], size - len, "...");
+    return len < size ? len : size - 1;
+}
+
+/**
+ * @brief 生成一条日志的文本行：时间（UTC）、消息、errno说明和抑制条数
+ * @param site 调用点
+ * @param rec 记录
+ * @param out 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 输出长度（含结尾的换行）
+ */
+int log_format(const struct log_site *site, const struct log_record *rec, char *out, int size)
+{
+    static const char level_mark[] = "EWI";
+    time_t sec = (time_t)(rec->ts_ns / 1000000000ULL);
+    struct tm tm;
+    char errbuf[128];
+    int len;
+
+    gmtime_r(&sec, &tm);
+    len = snprintf(out, size, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ %c ", tm.tm_year + 1900, tm.tm_mon + 1,
+                   tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(rec->ts_ns / 1000000 % 1000),
+                   site->level >= 0 && site->level <= LOG_LEVEL_INFO ? level_mark[site->level] : '?');
+
+    // 汇总记录：调用点停止触发后报告窗口内被抑制的条数
+    if (rec->args_len == LOG_ARGS_SUMMARY) {
+        len += snprintf(&out[len], size - len, "%u similar messages suppressed: %s (%s:%d)\n",
+                        rec->suppressed, site->fmt, site->file, site->line);
+        return len < size ? len : size - 1;
+    }
+
+    len += log_render(site->fmt, rec->args, rec->args_len, &out[len], size - len - 1);
+    if (site->with_errno && len < size - 1) {
+        len += snprintf(&out[len], size - len, ": %s", strerror_r(rec->err, errbuf, sizeof(errbuf)));
+    }
+    if (rec->suppressed > 0 && len < size - 1) {
+        len += snprintf(&out[len], size - len, " (%u similar messages suppressed)", rec->suppressed);
+    }
+    if (len > size - 2) {
+        len = size - 2;
+    }
+    out[len++] = '\n';
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief 登记调用点（多个线程同时首次调用时只有一个编号生效）
+ * @param site 调用点
+ */
+static void log_register(struct log_site *site)
+{
+    int id = atomic_fetch_add(&log_state.site_count, 1) + 1;
+    int expected = 0;
+
+    if (!atomic_compare_exchange_strong(&site->id, &expected, id)) {
+        return;
+    }
+    if (id <= LOG_MAX_SITES) {
+        atomic_store_explicit(&log_state.sites[id - 1], site, memory_order_release);
+    }
+}
+
+/**
+ * @brief 取本线程的环形缓冲区（首次调用时分配）
+ * @return 环形缓冲区，已分配完时返回log_no_ring
+ */
+static struct log_ring *log_ring_get(void)
+{
+    if (log_my_ring == NULL) {
+        int i = atomic_fetch_add(&log_state.ring_count, 1);
+        log_my_ring = i < LOG_MAX_THREADS ? &log_state.rings[i] : log_no_ring;
+    }
+    return log_my_ring;
+}
+
+/**
+ * @brief 同步输出（后台线程启动之前、停止之后和没有环形缓冲区的线程）
+ */
+static void log_write_now(struct log_site *site, const struct log_record *rec)
+{
+    char text[LOG_TEXT_SIZE];
+    int len = log_format(site, rec, text, sizeof(text));
+
+    if (write(site->level == LOG_LEVEL_INFO ? STDOUT_FILENO : STDERR_FILENO, text, len) < 0) {
+        return;
+    }
+}
+
+/**
+ * @brief 写一条日志（通过log_error等宏调用）：限速、编码参数、放入本线程的环形缓冲区，
+ *        只在后台线程空闲等待时做一次唤醒的系统调用，不受标准错误输出速度影响，不改变errno
+ * @param site 调用点
+ * @param fmt 格式串（与site->fmt相同，用于编译期参数检查）
+ */
+void log_write(struct log_site *site, const char *fmt, ...)
+{
+    int err = errno;
+    uint64_t now = bds_now_ns();
+    struct log_record local;
+    va_list ap;
+
+    if (atomic_load_explicit(&site->id, memory_order_relaxed) == 0) {
+        log_register(site);
+    }
+
+    // 每秒窗口内超过上限的只计数；新窗口的第一条带上此前被抑制的条数
+    uint64_t window = atomic_load_explicit(&site->window_ns, memory_order_relaxed);
+    if (now - window >= 1000000000ULL) {
+        atomic_store_explicit(&site->window_ns, now, memory_order_relaxed);
+        atomic_store_explicit(&site->window_count, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&site->window_count, 1, memory_order_relaxed) >= LOG_RATE_PER_SEC) {
+        // 开始抑制时唤醒后台线程，由它在调用点不再触发时按时报告被抑制的条数
+        if (atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed) == 0) {
+            log_wake();
+        }
+        metrics_inc(m_suppressed);
+        errno = err;
+        return;
+    }
+
+    struct log_ring *ring = atomic_load_explicit(&log_state.running, memory_order_acquire) ? log_ring_get() : NULL;
+    struct log_record *rec = &local;
+    uint32_t head = 0;
+    if (ring != NULL && ring != log_no_ring) {
+        // 先标记写入中再复查运行标志，与log_stop的“先清运行标志、再等写入完成”配对：
+        // 复查通过的记录一定在最后一批中取走，否则改为同步输出
+        atomic_store_explicit(&ring->writing, 1, memory_order_seq_cst);
+        if (!atomic_load_explicit(&log_state.running, memory_order_seq_cst)) {
+            atomic_store_explicit(&ring->writing, 0, memory_order_release);
+            ring = NULL;
+        }
+    }
+    if (ring != NULL && ring != log_no_ring) {
+        head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail >= LOG_RING_RECORDS) {
+            // 写满时丢弃本条，被抑制的条数留给下一条报告
+            atomic_store_explicit(&ring->writing, 0, memory_order_release);
+            metrics_inc(m_dropped);
+            errno = err;
+            return;
+        }
+        metrics_max(m_ring_max, head - tail + 1);
+        rec = &ring->records[head & (LOG_RING_RECORDS - 1)];
+    }
+
+    rec->ts_ns = bds_realtime_ns();
+    rec->site = site;
+    rec->err = err;
+    rec->suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    va_start(ap, fmt);
+    rec->args_len = (uint16_t)log_encode(fmt, &ap, rec->args);
+    va_end(ap);
+
+    if (rec == &local) {
+        log_write_now(site, rec);
+    } else {
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        atomic_store_explicit(&ring->writing, 0, memory_order_release);
+        log_wake();
+    }
+    errno = err;
+}
+
+/**
+ * @brief 写出全部数据（EINTR重试）
+ */
+static void log_write_all(int fd, const void *buf, int len)
+{
+    const char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief 输出缓存的文本和二进制日志
+ */
+static void log_flush(void)
+{
+    if (log_state.text_err_len > 0) {
+        log_write_all(STDERR_FILENO, log_state.text_err, log_state.text_err_len);
+        log_state.text_err_len = 0;
+    }
+    if (log_state.text_out_len > 0) {
+        log_write_all(STDOUT_FILENO, log_state.text_out, log_state.text_out_len);
+        log_state.text_out_len = 0;
+    }
+    if (log_state.file_len > 0) {
+        log_write_all(log_state.fd, log_state.file_buf, log_state.file_len);
+        log_state.file_len = 0;
+    }
+}
+
+/**
+ * @brief 二进制日志追加一段数据（缓存满时先写出）
+ */
+static void log_file_put(const void *data, int len)
+{
+    if (log_state.file_len + len > (int)sizeof(log_state.file_buf)) {
+        log_flush();
+    }
+    memcpy(&log_state.file_buf[log_state.file_len], data, len);
+    log_state.file_len += len;
+}
+
+/**
+ * @brief 把一条记录写入二进制日志（调用点第一次出现时先写定义）
+ */
+static void log_file_record(struct log_site *site, const struct log_record *rec)
+{
+    uint32_t id = (uint32_t)atomic_load(&site->id);
+
+    if (!site->file_defined) {
+        unsigned char def[16];
+        uint32_t line = (uint32_t)site->line;
+        uint16_t fmt_len = (uint16_t)strlen(site->fmt);
+        uint16_t file_len = (uint16_t)strlen(site->file);
+        def[0] = LOG_ENTRY_SITE;
+        def[1] = (unsigned char)site->level;
+        def[2] = (unsigned char)site->with_errno;
+        def[3] = 0;
+        memcpy(&def[4], &id, 4);
+        memcpy(&def[8], &line, 4);
+        memcpy(&def[12], &fmt_len, 2);
+        memcpy(&def[14], &file_len, 2);
+        log_file_put(def, sizeof(def));
+        log_file_put(site->fmt, fmt_len);
+        log_file_put(site->file, file_len);
+        site->file_defined = 1;
+    }
+
+    unsigned char hdr[24];
+    uint16_t args_len = rec->args_len;
+    hdr[0] = LOG_ENTRY_RECORD;
+    hdr[1] = 0;
+    memcpy(&hdr[2], &args_len, 2);
+    memcpy(&hdr[4], &id, 4);
+    memcpy(&hdr[8], &rec->ts_ns, 8);
+    memcpy(&hdr[16], &rec->err, 4);
+    memcpy(&hdr[20], &rec->suppressed, 4);
+    log_file_put(hdr, sizeof(hdr));
+    if (args_len != LOG_ARGS_SUMMARY) {
+        log_file_put(rec->args, args_len);
+    }
+}
+
+/**
+ * @brief 输出一条记录：文本按级别进入标准输出或标准错误的批次，同时写二进制日志
+ */
+static void log_emit(struct log_site *site, const struct log_record *rec)
+{
+    int is_out = site->level == LOG_LEVEL_INFO;
+    char *text = is_out ? log_state.text_out : log_state.text_err;
+    int *text_len = is_out ? &log_state.text_out_len : &log_state.text_err_len;
+
+    if (*text_len + LOG_TEXT_SIZE > (int)sizeof(log_state.text_err)) {
+        log_flush();
+    }
+    *text_len += log_format(site, rec, &text[*text_len], LOG_TEXT_SIZE);
+    if (log_state.fd >= 0) {
+        log_file_record(site, rec);
+    }
+    metrics_inc(m_records);
+}
+
+/**
+ * @brief 报告已停止触发的调用点在上一个窗口中被抑制的条数
+ * @param now 当前时间（单调时钟纳秒）
+ * @return 窗口尚未结束、留待之后报告的调用点数
+ */
+static int log_report_suppressed(uint64_t now)
+{
+    int count = atomic_load(&log_state.site_count);
+    int pending = 0;
+
+    if (count > LOG_MAX_SITES) {
+        count = LOG_MAX_SITES;
+    }
+    for (int i = 0; i < count; i++) {
+        struct log_site *site = atomic_load_explicit(&log_state.sites[i], memory_order_acquire);
+        if (site == NULL || atomic_load_explicit(&site->suppressed, memory_order_relaxed) == 0) {
+            continue;
+        }
+        if (now - atomic_load_explicit(&site->window_ns, memory_order_relaxed) < 1000000000ULL) {
+            pending++;
+            continue;
+        }
+        struct log_record rec;
+        rec.ts_ns = bds_realtime_ns();
+        rec.site = site;
+        rec.err = 0;
+        rec.suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+        rec.args_len = LOG_ARGS_SUMMARY;
+        if (rec.suppressed > 0) {
+            log_emit(site, &rec);
+        }
+    }
+    return pending;
+}
+
+/**
+ * @brief 检查是否有记录待取
+ * @param count 已分配的环形缓冲区数
+ * @return 有返回1，否则返回0
+ */
+static int log_has_records(int count)
+{
+    for (int i = 0; i < count; i++) {
+        struct log_ring *ring = &log_state.rings[i];
+        if (atomic_load_explicit(&ring->head, memory_order_seq_cst) !=
+            atomic_load_explicit(&ring->tail, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 等待各线程正在写入的记录完成（运行标志清零之后调用，之后的写入都改为同步输出）
+ */
+static void log_wait_writers(void)
+{
+    int count = atomic_load(&log_state.ring_count);
+
+    if (count > LOG_MAX_THREADS) {
+        count = LOG_MAX_THREADS;
+    }
+    for (int i = 0; i < count; i++) {
+        while (atomic_load_explicit(&log_state.rings[i].writing, memory_order_acquire)) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief 后台线程：依次取出各线程的记录，格式化后成批输出；没有记录时在futex上等待，
+ *        由写入记录的线程唤醒，只有尚有被抑制的条数待报告时才定时醒来
+ * @param arg 未使用
+ * @return NULL
+ */
+static void *log_thread(void *arg)
+{
+    uint64_t next_report = 0;
+
+    (void)arg;
+    pthread_setname_np(pthread_self(), "log");
+
+    while (1) {
+        int running = atomic_load(&log_state.running);
+        if (!running) {
+            log_wait_writers();
+        }
+        int count = atomic_load(&log_state.ring_count);
+        int taken = 0;
+
+        if (count > LOG_MAX_THREADS) {
+            count = LOG_MAX_THREADS;
+        }
+        for (int i = 0; i < count; i++) {
+            struct log_ring *ring = &log_state.rings[i];
+            uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            for (; tail != head; tail++, taken++) {
+                const struct log_record *rec = &ring->records[tail & (LOG_RING_RECORDS - 1)];
+                log_emit(rec->site, rec);
+            }
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        }
+
+        uint64_t now = bds_now_ns();
+        int pending = 0;
+        if (now >= next_report || !running) {
+            pending = log_report_suppressed(running ? now : UINT64_MAX);
+            next_report = now + 1000000000ULL;
+        } else {
+            pending = 1;
+        }
+        log_flush();
+
+        if (!running) {
+            break;
+        }
+        if (taken > 0) {
+            continue;
+        }
+
+        // 先置等待标志再检查各环形缓冲区和运行标志，与log_wake的“先写入再检查标志”配对
+        atomic_store_explicit(&log_state.sleeping, 1, memory_order_seq_cst);
+        if (log_has_records(count < LOG_MAX_THREADS ? count : LOG_MAX_THREADS) ||
+            atomic_load_explicit(&log_state.ring_count, memory_order_seq_cst) != count ||
+            !atomic_load_explicit(&log_state.running, memory_order_seq_cst)) {
+            atomic_store_explicit(&log_state.sleeping, 0, memory_order_relaxed);
+            continue;
+        }
+        struct timespec ts = { 0, 0 };
+        if (pending) {
+            uint64_t wait_ns = next_report > now ? next_report - now : 0;
+            ts.tv_sec = wait_ns / 1000000000ULL;
+            ts.tv_nsec = wait_ns % 1000000000ULL;
+        }
+        log_futex(&log_state.sleeping, FUTEX_WAIT, 1, pending ? &ts : NULL);
+        atomic_store_explicit(&log_state.sleeping, 0, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 启动异步日志：分配各线程的环形缓冲区，打开二进制日志文件，创建后台线程；
+ *        须在实时设置之前调用（后台线程不继承SCHED_FIFO和CPU绑定），之前的日志调用同步输出
+ * @param program 程序名（写入二进制日志文件头）
+ * @param path 二进制日志文件路径（追加写入），NULL表示只输出文本
+ * @return 成功返回0，失败返回-1（日志调用继续同步输出）
+ */
+int log_start(const char *program, const char *path)
+{
+    log_metrics_init();
+
+    log_state.rings = pool_alloc("log", "thread ring", sizeof(struct log_ring), LOG_MAX_THREADS, POOL_SHARED);
+    if (log_state.rings == NULL) {
+        return -1;
+    }
+
+    if (path != NULL) {
+        log_state.fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (log_state.fd < 0) {
+            perror("open log file failed");
+            return -1;
+        }
+        unsigned char hdr[44];
+        uint32_t magic = LOG_FILE_MAGIC, version = LOG_FILE_VERSION, pid = (uint32_t)getpid();
+        memset(hdr, 0, sizeof(hdr));
+        memcpy(&hdr[0], &magic, 4);
+        memcpy(&hdr[4], &version, 4);
+        memcpy(&hdr[8], &pid, 4);
+        snprintf((char *)&hdr[12], 32, "%s", program);
+        log_file_put(hdr, sizeof(hdr));
+    }
+
+    // 后台线程屏蔽全部信号，退出信号总是交给主线程（signalfd或信号处理函数）
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    atomic_store(&log_state.running, 1);
+    int ret = bds_thread_create(&log_state.tid, BDS_THREAD_STACK, 0, log_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0) {
+        fprintf(stderr, "log thread creation failed\n");
+        atomic_store(&log_state.running, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 停止异步日志：先清运行标志（写入时复查，之后的日志调用同步输出），
+ *        后台线程等正在写入的记录完成、输出剩余记录后退出
+ */
+void log_stop(void)
+{
+    if (!atomic_load(&log_state.running)) {
+        return;
+    }
+    atomic_store(&log_state.running, 0);
+    log_wake();
+    pthread_join(log_state.tid, NULL);
+    if (log_state.fd >= 0) {
+        close(log_state.fd);
+        log_state.fd = -1;
+    }
+}
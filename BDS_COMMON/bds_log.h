@@ -0,0 +1,116 @@
+/*
+ * bds_log.h
+ * 异步日志头文件
+ * 功能：转发路径上的日志调用只把格式串指针和参数编码成定长记录写入本线程的无锁环形缓冲区，
+ *       后台线程格式化后输出到标准输出/标准错误，并可同时写入紧凑的二进制日志文件供事后分析；
+ *       每个调用点按秒限速，超出的只计数，之后报告被抑制的条数
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_LOG_H
+#define BDS_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "bds_metrics.h"
+#include "bds_thread.h"
+#include "bds_pool.h"
+#include "bds_time.h"
+
+// 日志配置
+#define LOG_MAX_THREADS     24             // 使用环形缓冲区的线程数，之后的线程直接同步输出
+#define LOG_RING_RECORDS    128            // 每个线程的记录数（2的幂），写满时丢弃并计数
+#define LOG_RECORD_SIZE     256            // 记录大小
+#define LOG_ARGS_SIZE       (LOG_RECORD_SIZE - 32)  // 记录中的参数区
+#define LOG_STR_MAX         95             // 字符串参数最多保存的字节数（超出截断）
+#define LOG_MAX_SITES       256            // 登记的调用点数（用于报告被抑制的条数）
+#define LOG_RATE_PER_SEC    10             // 每个调用点每秒最多输出的条数
+#define LOG_TEXT_SIZE       512            // 一条格式化文本的上限
+#define LOG_ARGS_SUMMARY    0xFFFF         // 参数长度取该值表示抑制计数汇总（没有参数）
+
+// 二进制日志文件：每个进程先写文件头，再写连续的条目（小端）；调用点第一次出现时先写定义条目
+// 文件头：魔数(4) + 版本(4) + 进程号(4) + 程序名(32)
+// 调用点定义：类型1(1) + 级别(1) + 带errno(1) + 保留(1) + 编号(4) + 行号(4) + 格式串长度(2) + 文件名长度(2) + 格式串 + 文件名
+// 记录：类型2(1) + 保留(1) + 参数长度(2) + 编号(4) + 时间(8) + errno(4) + 抑制条数(4) + 参数
+#define LOG_FILE_MAGIC      0x474C4442     // "BDLG"
+#define LOG_FILE_VERSION    1
+#define LOG_ENTRY_SITE      1
+#define LOG_ENTRY_RECORD    2
+
+// 日志级别（错误和警告输出到标准错误，信息输出到标准输出）
+enum log_level {
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO
+};
+
+// 调用点（每个日志调用处一个静态实例）
+struct log_site {
+    const char *fmt;           // printf格式串（字符串常量）
+    const char *file;          // 源文件
+    int line;                  // 行号
+    int level;                 // enum log_level
+    int with_errno;            // 是否在末尾附加errno说明（与perror相同）
+    _Atomic int id;            // 登记后的编号（从1开始），0表示尚未登记
+    _Atomic uint64_t window_ns;        // 当前限速窗口的起点
+    _Atomic uint32_t window_count;     // 窗口内已输出的条数
+    _Atomic uint32_t suppressed;       // 被限速丢弃、尚未报告的条数
+    int file_defined;          // 已写入二进制日志文件（只由后台线程访问）
+};
+
+// 一条日志记录
+struct log_record {
+    uint64_t ts_ns;            // 系统时钟（UTC）纳秒
+    struct log_site *site;     // 调用点
+    int32_t err;               // 调用时的errno
+    uint32_t suppressed;       // 此前被抑制的条数
+    uint16_t args_len;         // 参数长度，LOG_ARGS_SUMMARY表示抑制计数汇总
+    uint8_t reserved[6];
+    unsigned char args[LOG_ARGS_SIZE];  // 按格式串顺序编码的参数
+};
+
+// 每个线程的环形缓冲区（单生产者单消费者）
+struct log_ring {
+    _Atomic uint32_t head __attribute__((aligned(64)));   // 已写入的记录数
+    _Atomic int writing;                                  // 本线程正在写入记录（log_stop等其完成后再取最后一批）
+    _Atomic uint32_t tail __attribute__((aligned(64)));   // 后台线程已取走的记录数
+    struct log_record records[LOG_RING_RECORDS] __attribute__((aligned(64)));
+};
+
+// 日志调用：格式串须为字符串常量，参数按printf检查
+#define LOG_AT(lvl, err, format, ...)                                               \
+    do {                                                                            \
+        static struct log_site log_site_ = {                                        \
+            .fmt = format, .file = __FILE__, .line = __LINE__,                      \
+            .level = lvl, .with_errno = err                                         \
+        };                                                                          \
+        log_write(&log_site_, format, ##__VA_ARGS__);                               \
+    } while (0)
+
+#define log_error(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, 0, fmt, ##__VA_ARGS__)
+#define log_errno(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, 1, fmt, ##__VA_ARGS__)
+#define log_warn(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, 0, fmt, ##__VA_ARGS__)
+#define log_info(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, 0, fmt, ##__VA_ARGS__)
+
+// 函数声明
+int log_start(const char *program, const char *path);
+void log_write(struct log_site *site, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int log_format(const struct log_site *site, const struct log_record *rec, char *out, int size);
+void log_stop(void);
+
+#endif /* BDS_LOG_H */
@@ -0,0 +1,199 @@
+/*
+ * bds_logcat.c
+ * 二进制日志解码工具
+ * 功能：把-G选项写出的二进制日志文件还原为与控制台相同的文本行，每个进程的记录前输出程序名和进程号
+ * 使用：bds_logcat 文件... > 文本文件
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_log.h"
+
+#define LOGCAT_MAX_IDS  4096       // 调用点编号上限（编号按登记次数增长，可能大于调用点数）
+#define LOGCAT_STR_MAX  1024       // 格式串和文件名的长度上限
+
+// 一个进程的调用点表
+static struct log_site *logcat_sites[LOGCAT_MAX_IDS + 1];
+
+/**
+ * @brief 读取32位小端整数
+ */
+static uint32_t get32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief 读取16位小端整数
+ */
+static uint16_t get16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief 清空调用点表（新进程的文件头之后编号重新开始）
+ */
+static void logcat_reset(void)
+{
+    for (int i = 0; i <= LOGCAT_MAX_IDS; i++) {
+        if (logcat_sites[i] != NULL) {
+            free((char *)logcat_sites[i]->fmt);
+            free((char *)logcat_sites[i]->file);
+            free(logcat_sites[i]);
+            logcat_sites[i] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief 读取一个调用点定义（类型字节之后的部分）
+ * @return 成功返回0，文件损坏返回-1
+ */
+static int logcat_site(FILE *in)
+{
+    unsigned char hdr[15];
+
+    if (fread(hdr, 1, sizeof(hdr), in) != sizeof(hdr)) {
+        return -1;
+    }
+    uint32_t id = get32(hdr + 3);
+    uint16_t fmt_len = get16(hdr + 11);
+    uint16_t file_len = get16(hdr + 13);
+    if (id == 0 || fmt_len > LOGCAT_STR_MAX || file_len > LOGCAT_STR_MAX) {
+        return -1;
+    }
+
+    char *fmt = calloc(1, fmt_len + 1);
+    char *file = calloc(1, file_len + 1);
+    struct log_site *site = calloc(1, sizeof(*site));
+    if (fmt == NULL || file == NULL || site == NULL || fread(fmt, 1, fmt_len, in) != fmt_len ||
+        fread(file, 1, file_len, in) != file_len) {
+        free(fmt);
+        free(file);
+        free(site);
+        return -1;
+    }
+    site->fmt = fmt;
+    site->file = file;
+    site->line = (int)get32(hdr + 7);
+    site->level = hdr[0];
+    site->with_errno = hdr[1];
+
+    if (id > LOGCAT_MAX_IDS) {
+        free(fmt);
+        free(file);
+        free(site);
+        return 0;
+    }
+    if (logcat_sites[id] != NULL) {
+        free((char *)logcat_sites[id]->fmt);
+        free((char *)logcat_sites[id]->file);
+        free(logcat_sites[id]);
+    }
+    logcat_sites[id] = site;
+    return 0;
+}
+
+/**
+ * @brief 解码一个日志文件
+ * @param path 文件路径
+ * @param out 输出流
+ * @return 成功返回0，文件损坏返回-1
+ */
+static int logcat_file(const char *path, FILE *out)
+{
+    static struct log_record rec;
+    char text[LOG_TEXT_SIZE];
+    unsigned char hdr[44];
+    long records = 0;
+    int ret = 0;
+
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    logcat_reset();
+    int type;
+    while ((type = fgetc(in)) != EOF) {
+        if (type == (LOG_FILE_MAGIC & 0xFF)) {
+            // 文件头：新进程开始追加
+            hdr[0] = (unsigned char)type;
+            if (fread(hdr + 1, 1, sizeof(hdr) - 1, in) != sizeof(hdr) - 1 || get32(hdr) != LOG_FILE_MAGIC) {
+                ret = -1;
+                break;
+            }
+            if (get32(hdr + 4) != LOG_FILE_VERSION) {
+                fprintf(stderr, "%s: unsupported version %u\n", path, get32(hdr + 4));
+                ret = -1;
+                break;
+            }
+            hdr[sizeof(hdr) - 1] = '\0';
+            fprintf(out, "== %s pid %u ==\n", (const char *)hdr + 12, get32(hdr + 8));
+            logcat_reset();
+        } else if (type == LOG_ENTRY_SITE) {
+            if (logcat_site(in) != 0) {
+                ret = -1;
+                break;
+            }
+        } else if (type == LOG_ENTRY_RECORD) {
+            if (fread(hdr, 1, 23, in) != 23) {
+                ret = -1;
+                break;
+            }
+            uint32_t id = get32(hdr + 3);
+            rec.args_len = get16(hdr + 1);
+            memcpy(&rec.ts_ns, hdr + 7, 8);
+            rec.err = (int32_t)get32(hdr + 15);
+            rec.suppressed = get32(hdr + 19);
+            if (rec.args_len != LOG_ARGS_SUMMARY &&
+                (rec.args_len > LOG_ARGS_SIZE || fread(rec.args, 1, rec.args_len, in) != rec.args_len)) {
+                ret = -1;
+                break;
+            }
+            if (id > LOGCAT_MAX_IDS || logcat_sites[id] == NULL) {
+                fprintf(out, "(record for unknown site %u)\n", id);
+                continue;
+            }
+            rec.site = logcat_sites[id];
+            log_format(rec.site, &rec, text, sizeof(text));
+            fputs(text, out);
+            records++;
+        } else {
+            ret = -1;
+            break;
+        }
+    }
+    if (ret != 0) {
+        fprintf(stderr, "%s: bad or truncated entry after %ld records\n", path, records);
+    }
+
+    fclose(in);
+    logcat_reset();
+    return ret;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回1
+ */
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s file...\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (logcat_file(argv[i], stdout) != 0) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,234 @@
+/*
+ * bds_lz.c
+ * 块压缩源文件
+ * 功能：哈希表查找4字节匹配的单遍压缩，以及带边界检查的解压
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_lz.h"
+
+/**
+ * @brief 读取4字节（非对齐）
+ */
+static inline uint32_t lz_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief 4字节哈希
+ */
+static inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * @brief 写入长度扩展字节（每字节255，最后一字节为余数）
+ * @param dst 输出缓冲区
+ * @param op 当前输出位置
+ * @param end 输出缓冲区末尾
+ * @param rem 剩余长度
+ * @return 新的输出位置，缓冲区不足返回-1
+ */
+static int lz_put_length(unsigned char *dst, int op, int end, int rem)
+{
+    while (rem >= 255) {
+        if (op >= end) {
+            return -1;
+        }
+        dst[op++] = 255;
+        rem -= 255;
+    }
+    if (op >= end) {
+        return -1;
+    }
+    dst[op++] = (unsigned char)rem;
+    return op;
+}
+
+/**
+ * @brief 输出一个序列：字面量 + 匹配（match_len为0时只输出字面量，用于块末尾）
+ * @return 新的输出位置，缓冲区不足返回-1
+ */
+static int lz_emit(unsigned char *dst, int op, int end, const unsigned char *lit, int lit_len,
+                   int offset, int match_len)
+{
+    int ml = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+
+    if (op >= end) {
+        return -1;
+    }
+    int token = op++;
+    dst[token] = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+
+    if (lit_len >= 15 && (op = lz_put_length(dst, op, end, lit_len - 15)) < 0) {
+        return -1;
+    }
+    if (op + lit_len > end) {
+        return -1;
+    }
+    memcpy(&dst[op], lit, lit_len);
+    op += lit_len;
+
+    if (match_len == 0) {
+        return op;
+    }
+    if (op + 2 > end) {
+        return -1;
+    }
+    dst[op++] = offset & 0xFF;
+    dst[op++] = (offset >> 8) & 0xFF;
+    if (ml >= 15 && (op = lz_put_length(dst, op, end, ml - 15)) < 0) {
+        return -1;
+    }
+    return op;
+}
+
+/**
+ * @brief 压缩一块数据
+ * @param src 原始数据
+ * @param src_len 原始长度（0~LZ_MAX_BLOCK）
+ * @param dst 输出缓冲区
+ * @param dst_size 输出缓冲区大小（不小于LZ_COMPRESS_BOUND(src_len)时保证成功）
+ * @return 压缩后长度，参数错误或缓冲区不足返回-1
+ */
+int lz_compress(const unsigned char *src, int src_len, unsigned char *dst, int dst_size)
+{
+    int table[1 << LZ_HASH_BITS];
+    int ip = 0, anchor = 0, op = 0;
+
+    if (src_len < 0 || src_len > LZ_MAX_BLOCK) {
+        return -1;
+    }
+
+    if (src_len > LZ_MF_LIMIT) {
+        int limit = src_len - LZ_MF_LIMIT;
+        memset(table, 0xFF, sizeof(table));
+
+        while (ip < limit) {
+            uint32_t seq = lz_read32(&src[ip]);
+            uint32_t h = lz_hash(seq);
+            int ref = table[h];
+            table[h] = ip;
+
+            if (ref < 0 || ip - ref > LZ_MAX_OFFSET || lz_read32(&src[ref]) != seq) {
+                // 连续未命中时加大步长，不可压缩数据也能快速通过
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // 向前延伸匹配，末尾保留LZ_LAST_LITERALS字节为字面量
+            int match_len = LZ_MIN_MATCH;
+            int max_len = src_len - LZ_LAST_LITERALS - ip;
+            while (match_len < max_len && src[ref + match_len] == src[ip + match_len]) {
+                match_len++;
+            }
+
+            op = lz_emit(dst, op, dst_size, &src[anchor], ip - anchor, ip - ref, match_len);
+            if (op < 0) {
+                return -1;
+            }
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    return lz_emit(dst, op, dst_size, &src[anchor], src_len - anchor, 0, 0);
+}
+
+/**
+ * @brief 读取长度扩展字节
+ * @return 扩展长度，数据不完整或超出上限返回-1
+ */
+static int lz_get_length(const unsigned char *src, int src_len, int *ip)
+{
+    int len = 0;
+    unsigned char b;
+
+    do {
+        if (*ip >= src_len || len > LZ_MAX_BLOCK) {
+            return -1;
+        }
+        b = src[(*ip)++];
+        len += b;
+    } while (b == 255);
+
+    return len;
+}
+
+/**
+ * @brief 解压一块数据
+ * @param src 压缩数据
+ * @param src_len 压缩长度
+ * @param dst 输出缓冲区
+ * @param dst_size 输出缓冲区大小
+ * @return 解压后长度，数据损坏或缓冲区不足返回-1
+ */
+int lz_decompress(const unsigned char *src, int src_len, unsigned char *dst, int dst_size)
+{
+    int ip = 0, op = 0;
+
+    while (ip < src_len) {
+        int token = src[ip++];
+
+        // 字面量
+        int lit_len = token >> 4;
+        if (lit_len == 15) {
+            int ext = lz_get_length(src, src_len, &ip);
+            if (ext < 0) {
+                return -1;
+            }
+            lit_len += ext;
+        }
+        if (lit_len > src_len - ip || lit_len > dst_size - op) {
+            return -1;
+        }
+        memcpy(&dst[op], &src[ip], lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // 最后一个序列只有字面量
+        if (ip == src_len) {
+            break;
+        }
+
+        // 匹配
+        if (src_len - ip < 2) {
+            return -1;
+        }
+        int offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return -1;
+        }
+        int match_len = token & 0x0F;
+        if (match_len == 15) {
+            int ext = lz_get_length(src, src_len, &ip);
+            if (ext < 0) {
+                return -1;
+            }
+            match_len += ext;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > dst_size - op) {
+            return -1;
+        }
+
+        // 回溯距离小于匹配长度时源和目标重叠，逐字节复制
+        const unsigned char *ref = &dst[op - offset];
+        if (offset >= match_len) {
+            memcpy(&dst[op], ref, match_len);
+        } else {
+            for (int i = 0; i < match_len; i++) {
+                dst[op + i] = ref[i];
+            }
+        }
+        op += match_len;
+    }
+
+    return op;
+}
@@ -0,0 +1,32 @@
+/*
+ * bds_lz.h
+ * 块压缩头文件
+ * 功能：LZ77类快速块压缩/解压（与LZ4块格式兼容），用于存档文件
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_LZ_H
+#define BDS_LZ_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// 压缩参数
+#define LZ_HASH_BITS        12      // 哈希表大小（2^12项）
+#define LZ_MIN_MATCH        4       // 最短匹配长度
+#define LZ_LAST_LITERALS    5       // 块末尾必须为字面量的字节数
+#define LZ_MF_LIMIT         12      // 距块末尾不足该字节数时不再查找匹配
+#define LZ_MAX_OFFSET       65535   // 最大回溯距离
+#define LZ_MAX_BLOCK        (1 << 20)   // 单块最大长度
+
+// 最坏情况下的压缩输出长度
+#define LZ_COMPRESS_BOUND(n) ((n) + (n) / 255 + 16)
+
+// 函数声明
+int lz_compress(const unsigned char *src, int src_len, unsigned char *dst, int dst_size);
+int lz_decompress(const unsigned char *src, int src_len, unsigned char *dst, int dst_size);
+
+#endif /* BDS_LZ_H */
@@ -0,0 +1,293 @@
+/*
+ * bds_metrics.c
+ * 运行指标源文件
+ * 功能：指标注册、每线程槽分配、读取时聚合以及Prometheus文本HTTP端点
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_metrics.h"
+
+// 指标描述表（注册只在启动阶段进行）
+struct metrics_desc {
+    char name[METRICS_NAME_LEN];
+    char help[METRICS_HELP_LEN];
+    metric_type_t type;
+};
+
+static struct metrics_desc metrics_table[METRICS_MAX_METRICS];
+static atomic_int metrics_count = 0;
+
+// 每线程槽；线程退出时归还，同时存在的线程超过上限时（如每个连接一个的TLS转发线程）共用溢出槽
+static struct metrics_slot metrics_slots[METRICS_MAX_THREADS];
+static atomic_int metrics_slot_used[METRICS_MAX_THREADS];   // 槽位是否有线程持有
+static atomic_int metrics_slot_next = 0;                    // 用过的槽位数（聚合时只遍历这些）
+static atomic_int metrics_shared_used = 0;                  // 溢出槽是否用过
+static pthread_key_t metrics_slot_key;                      // 线程退出时归还指标槽
+static pthread_once_t metrics_key_once = PTHREAD_ONCE_INIT;
+struct metrics_slot metrics_shared_slot;
+
+__thread struct metrics_slot *metrics_tls_slot = NULL;
+
+// HTTP端点的监听套接字（热升级时交给新进程）
+static int metrics_listen_fd = -1;
+
+/**
+ * @brief 注册指标
+ * @param name 指标名称（Prometheus命名规则）
+ * @param help 指标说明
+ * @param type 指标类型
+ * @return 指标编号
+ * 注：注册只在启动阶段进行，表满说明METRICS_MAX_METRICS小于程序注册的指标数，
+ *     直接退出，不带着缺失的指标继续运行
+ */
+int metrics_register(const char *name, const char *help, metric_type_t type)
+{
+    int id = atomic_fetch_add(&metrics_count, 1);
+    if (id >= METRICS_MAX_METRICS) {
+        fprintf(stderr, "metrics table full (%d), cannot register %s\n", METRICS_MAX_METRICS, name);
+        exit(EXIT_FAILURE);
+    }
+
+    struct metrics_desc *d = &metrics_table[id];
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    snprintf(d->help, sizeof(d->help), "%s", help != NULL ? help : "");
+    d->type = type;
+
+    return id;
+}
+
+/**
+ * @brief 线程退出时归还指标槽：计数器和高水位值留在槽中继续计入总数，
+ *        仪表值是该线程自己的分量，清零后不再计入
+ * @param arg 指标槽
+ */
+static void metrics_slot_release(void *arg)
+{
+    struct metrics_slot *slot = arg;
+    int count = atomic_load(&metrics_count);
+
+    for (int id = 0; id < count && id < METRICS_MAX_METRICS; id++) {
+        if (metrics_table[id].type == METRIC_GAUGE) {
+            atomic_store_explicit(&slot->value[id], 0, memory_order_relaxed);
+        }
+    }
+    metrics_tls_slot = NULL;
+    atomic_store_explicit(&metrics_slot_used[slot - metrics_slots], 0, memory_order_release);
+}
+
+/**
+ * @brief 创建归还指标槽的线程键
+ */
+static void metrics_key_init(void)
+{
+    if (pthread_key_create(&metrics_slot_key, metrics_slot_release) != 0) {
+        fprintf(stderr, "metrics thread key creation failed\n");
+    }
+}
+
+/**
+ * @brief 为当前线程分配指标槽（优先使用已退出线程归还的槽位）
+ * @return 指标槽指针
+ */
+struct metrics_slot *metrics_thread_slot(void)
+{
+    pthread_once(&metrics_key_once, metrics_key_init);
+
+    for (int i = 0; i < METRICS_MAX_THREADS; i++) {
+        int expected = 0;
+        if (!atomic_compare_exchange_strong(&metrics_slot_used[i], &expected, 1)) {
+            continue;
+        }
+
+        // 聚合范围扩大到这个槽位
+        int next = atomic_load(&metrics_slot_next);
+        while (next < i + 1 && !atomic_compare_exchange_weak(&metrics_slot_next, &next, i + 1)) {
+        }
+        metrics_tls_slot = &metrics_slots[i];
+        pthread_setspecific(metrics_slot_key, metrics_tls_slot);
+        return metrics_tls_slot;
+    }
+
+    atomic_store(&metrics_shared_used, 1);
+    metrics_tls_slot = &metrics_shared_slot;
+    return metrics_tls_slot;
+}
+
+/**
+ * @brief 聚合单个指标
+ * @param id 指标编号
+ * @return 聚合值
+ */
+static uint64_t metrics_aggregate(int id)
+{
+    int used = atomic_load(&metrics_slot_next);
+    uint64_t total = 0;
+
+    if (atomic_load(&metrics_shared_used)) {
+        used = METRICS_MAX_THREADS + 1;
+    }
+
+    for (int i = 0; i < used; i++) {
+        const struct metrics_slot *slot = i < METRICS_MAX_THREADS ? &metrics_slots[i] : &metrics_shared_slot;
+        uint64_t v = atomic_load_explicit(&slot->value[id], memory_order_relaxed);
+        if (metrics_table[id].type == METRIC_GAUGE_MAX) {
+            if (v > total) {
+                total = v;
+            }
+        } else {
+            total += v;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * @brief 以Prometheus文本格式输出全部指标
+ * @param buf 输出缓冲区
+ * @param len 缓冲区长度
+ * @return 写入的字节数（不含结束符）
+ */
+size_t metrics_format(char *buf, size_t len)
+{
+    int count = atomic_load(&metrics_count);
+    size_t pos = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+
+    for (int id = 0; id < count && id < METRICS_MAX_METRICS; id++) {
+        const struct metrics_desc *d = &metrics_table[id];
+        int n = snprintf(buf + pos, len - pos, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n",
+                         d->name, d->help, d->name,
+                         d->type == METRIC_COUNTER ? "counter" : "gauge",
+                         d->name, (unsigned long long)metrics_aggregate(id));
+        if (n < 0 || (size_t)n >= len - pos) {
+            break;
+        }
+        pos += n;
+    }
+
+    return pos;
+}
+
+/**
+ * @brief HTTP端点线程：每个请求返回一次完整的指标文本
+ * @param arg 监听socket描述符
+ * @return NULL
+ */
+static void *metrics_http_thread(void *arg)
+{
+    int listen_fd = (int)(intptr_t)arg;
+    static char body[METRICS_BODY_SIZE];
+    char header[128];
+    char request[512];
+
+    while (1) {
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            perror("metrics accept failed");
+            continue;
+        }
+
+        // 只发起连接不发请求或不读响应的客户端不能卡住端点
+        struct timeval tv = { .tv_sec = METRICS_IO_TIMEOUT_S, .tv_usec = 0 };
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        // 请求内容不做区分，读出后统一返回指标
+        if (recv(client_fd, request, sizeof(request), 0) < 0) {
+            close(client_fd);
+            continue;
+        }
+
+        size_t body_len = metrics_format(body, sizeof(body));
+        int header_len = snprintf(header, sizeof(header),
+                                  "HTTP/1.0 200 OK\r\n"
+                                  "Content-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %zu\r\n\r\n", body_len);
+
+        if (send(client_fd, header, header_len, MSG_NOSIGNAL) == header_len) {
+            send(client_fd, body, body_len, MSG_NOSIGNAL);
+        }
+        close(client_fd);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 启动本地HTTP指标端点（只监听127.0.0.1）
+ * @param port 监听端口号
+ * @return 成功返回0，失败返回-1
+ */
+int metrics_start_http(int port)
+{
+    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        perror("metrics socket creation failed");
+        return -1;
+    }
+
+    int opt = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("metrics setsockopt failed");
+        close(sock_fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (bind(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("metrics bind failed");
+        close(sock_fd);
+        return -1;
+    }
+
+    if (listen(sock_fd, 5) < 0) {
+        perror("metrics listen failed");
+        close(sock_fd);
+        return -1;
+    }
+
+    if (metrics_serve_fd(sock_fd) != 0) {
+        close(sock_fd);
+        return -1;
+    }
+
+    printf("Metrics endpoint listening on http://127.0.0.1:%d/metrics\n", port);
+    return 0;
+}
+
+/**
+ * @brief 在已监听的套接字上提供指标端点（热升级时沿用旧进程的监听套接字）
+ * @param sock_fd 监听套接字
+ * @return 成功返回0，失败返回-1
+ */
+int metrics_serve_fd(int sock_fd)
+{
+    pthread_t tid;
+    if (bds_thread_create(&tid, BDS_THREAD_STACK, 1, metrics_http_thread, (void *)(intptr_t)sock_fd) != 0) {
+        fprintf(stderr, "metrics thread creation failed\n");
+        return -1;
+    }
+
+    metrics_listen_fd = sock_fd;
+    return 0;
+}
+
+/**
+ * @brief 获取指标端点的监听套接字
+ * @return 监听套接字，未启动返回-1
+ */
+int metrics_http_fd(void)
+{
+    return metrics_listen_fd;
+}
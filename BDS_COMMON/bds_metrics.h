@@ -0,0 +1,142 @@
+/*
+ * bds_metrics.h
+ * 运行指标头文件
+ * 功能：每线程缓存行对齐的计数器/仪表，读取时聚合，通过本地HTTP以Prometheus文本格式输出
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_METRICS_H
+#define BDS_METRICS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "bds_thread.h"
+
+// 指标配置
+#define METRICS_MAX_THREADS   32     // 同时独占指标槽的线程数（线程退出时归还），更多的线程共用溢出槽
+#define METRICS_MAX_METRICS   128    // 最多注册的指标数（基站全部选项同时启用时约70个）
+#define METRICS_NAME_LEN      64     // 指标名称最大长度
+#define METRICS_HELP_LEN      96     // 指标说明最大长度
+#define METRICS_CACHE_LINE    64     // 缓存行大小
+#define METRICS_BODY_SIZE     65536  // 输出文本缓冲区大小（每个指标连同说明约200字节）
+#define METRICS_IO_TIMEOUT_S  2      // 指标端点读请求、写响应的超时（秒）
+
+// 指标类型
+typedef enum {
+    METRIC_COUNTER = 0,   // 单调递增计数器，读取时各线程求和
+    METRIC_GAUGE,         // 仪表值，读取时各线程求和（已退出的线程不计）
+    METRIC_GAUGE_MAX      // 高水位仪表，读取时各线程取最大值
+} metric_type_t;
+
+// 每线程指标槽：每个线程独占一块缓存行对齐的区域，只有该线程写入
+struct metrics_slot {
+    _Atomic uint64_t value[METRICS_MAX_METRICS];
+} __attribute__((aligned(METRICS_CACHE_LINE)));
+
+// 当前线程的指标槽（首次使用时分配，线程退出时归还）
+extern __thread struct metrics_slot *metrics_tls_slot;
+
+// 溢出槽：独占槽都被持有时的线程共用，写入使用原子读-改-写
+extern struct metrics_slot metrics_shared_slot;
+
+// 函数声明
+int metrics_register(const char *name, const char *help, metric_type_t type);
+struct metrics_slot *metrics_thread_slot(void);
+size_t metrics_format(char *buf, size_t len);
+int metrics_start_http(int port);
+int metrics_serve_fd(int sock_fd);
+int metrics_http_fd(void);
+
+/**
+ * @brief 获取当前线程的指标槽
+ * @return 指标槽指针，线程数超过上限时返回共享的溢出槽
+ */
+static inline struct metrics_slot *metrics_slot_get(void)
+{
+    struct metrics_slot *slot = metrics_tls_slot;
+    if (slot == NULL) {
+        slot = metrics_thread_slot();
+    }
+    return slot;
+}
+
+/**
+ * @brief 计数器增加
+ * @param id 指标编号（metrics_register返回值）
+ * @param n 增量
+ * 注：独占槽只有所属线程写入，读-改-写使用relaxed原子读写即可，不需要总线锁；
+ *     共用的溢出槽有多个写入者，改用原子加
+ */
+static inline void metrics_add(int id, uint64_t n)
+{
+    if (id < 0) {
+        return;
+    }
+    struct metrics_slot *slot = metrics_slot_get();
+    _Atomic uint64_t *p = &slot->value[id];
+    if (slot == &metrics_shared_slot) {
+        atomic_fetch_add_explicit(p, n, memory_order_relaxed);
+        return;
+    }
+    atomic_store_explicit(p, atomic_load_explicit(p, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief 计数器加一
+ * @param id 指标编号
+ */
+static inline void metrics_inc(int id)
+{
+    metrics_add(id, 1);
+}
+
+/**
+ * @brief 设置仪表值（本线程分量）
+ * @param id 指标编号
+ * @param v 数值
+ */
+static inline void metrics_set(int id, uint64_t v)
+{
+    if (id < 0) {
+        return;
+    }
+    atomic_store_explicit(&metrics_slot_get()->value[id], v, memory_order_relaxed);
+}
+
+/**
+ * @brief 更新高水位值
+ * @param id 指标编号
+ * @param v 当前观测值，大于已记录值时更新
+ */
+static inline void metrics_max(int id, uint64_t v)
+{
+    if (id < 0) {
+        return;
+    }
+    struct metrics_slot *slot = metrics_slot_get();
+    _Atomic uint64_t *p = &slot->value[id];
+    uint64_t cur = atomic_load_explicit(p, memory_order_relaxed);
+    if (slot == &metrics_shared_slot) {
+        while (v > cur && !atomic_compare_exchange_weak_explicit(p, &cur, v, memory_order_relaxed,
+                                                                 memory_order_relaxed)) {
+        }
+        return;
+    }
+    if (v > cur) {
+        atomic_store_explicit(p, v, memory_order_relaxed);
+    }
+}
+
+#endif /* BDS_METRICS_H */
@@ -0,0 +1,614 @@
+/*
+ * bds_msm.c
+ * MSM观测电文解码源文件
+ * 功能：MSM4/5/7电文的快速解码（每个字段一次64位非对齐读取）、逐位参考解码和编码
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <endian.h>
+
+#include "bds_msm.h"
+
+// 快速解码缓冲区末尾的填充字节数（读取掩码时最多越过电文末尾11字节）
+#define MSM_PAD_BYTES 16
+
+// 电文头各字段的起始位（相对电文内容）
+#define MSM_POS_STATION     12
+#define MSM_POS_EPOCH       24
+#define MSM_POS_MULTIPLE    54
+#define MSM_POS_IODS        55
+#define MSM_POS_CLK_STEER   65
+#define MSM_POS_EXT_CLOCK   67
+#define MSM_POS_SMOOTHING   69
+#define MSM_POS_SMOOTH_INT  70
+#define MSM_POS_SAT_MASK    73
+#define MSM_POS_SIG_MASK    137
+#define MSM_POS_CELL_MASK   169
+
+// 各MSM等级的字段位宽
+struct msm_layout {
+    int sat_ext;        // 卫星数据是否含扩展信息和粗略变化率（MSM5/7）
+    int sat_bits;       // 每颗卫星的数据位数
+    int pr_bits;        // 精细伪距位数
+    int phase_bits;     // 精细相位位数
+    int lock_bits;      // 锁定时间指示位数
+    int cnr_bits;       // 载噪比位数
+    int has_rate;       // 单元数据是否含精细变化率
+    int cell_bits;      // 每个单元的数据位数
+    int pr_scale;       // 精细伪距换算到MSM7分辨率的倍数
+    int phase_scale;    // 精细相位换算到MSM7分辨率的倍数
+    int cnr_scale;      // 载噪比换算到1/16 dB-Hz的倍数
+};
+
+static const struct msm_layout msm4_layout = { 0, 18, 15, 22, 4, 6, 0, 48, 32, 4, 16 };
+static const struct msm_layout msm5_layout = { 1, 36, 15, 22, 4, 6, 1, 63, 32, 4, 16 };
+static const struct msm_layout msm7_layout = { 1, 36, 20, 24, 10, 10, 1, 80, 1, 1, 1 };
+
+/**
+ * @brief 按MSM等级选择字段布局
+ * @param msm MSM等级
+ * @return 布局，不支持的等级返回NULL
+ */
+static const struct msm_layout *msm_get_layout(int msm)
+{
+    switch (msm) {
+    case 4:
+        return &msm4_layout;
+    case 5:
+        return &msm5_layout;
+    case 7:
+        return &msm7_layout;
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief 计算MSM电文所需的总位数
+ * @param nsat 卫星数
+ * @param nsig 信号数
+ * @param ncell 单元数
+ * @param layout 字段布局
+ * @return 总位数
+ */
+static int msm_total_bits(int nsat, int nsig, int ncell, const struct msm_layout *layout)
+{
+    return MSM_POS_CELL_MASK + nsat * nsig + nsat * layout->sat_bits + ncell * layout->cell_bits;
+}
+
+/**
+ * @brief 读取从pos开始的64位（左对齐）
+ * @param buf 数据（末尾有填充）
+ * @param pos 起始位
+ * @return 左对齐的位串
+ */
+static inline uint64_t msm_peek(const unsigned char *buf, int pos)
+{
+    uint64_t word;
+    memcpy(&word, &buf[pos >> 3], sizeof(word));
+    return be64toh(word) << (pos & 7);
+}
+
+/**
+ * @brief 读取无符号位域（1~56位）
+ */
+static inline uint32_t msm_u(const unsigned char *buf, int pos, int len)
+{
+    return (uint32_t)(msm_peek(buf, pos) >> (64 - len));
+}
+
+/**
+ * @brief 读取有符号位域（1~56位，二进制补码）
+ */
+static inline int32_t msm_s(const unsigned char *buf, int pos, int len)
+{
+    return (int32_t)((int64_t)msm_peek(buf, pos) >> (64 - len));
+}
+
+/**
+ * @brief 读取64位掩码
+ */
+static inline uint64_t msm_mask64(const unsigned char *buf, int pos)
+{
+    return ((uint64_t)msm_u(buf, pos, 32) << 32) | msm_u(buf, pos + 32, 32);
+}
+
+/**
+ * @brief 快速解码MSM4/5/7电文
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param obs 输出的观测数据（只填写nsat/nsig/ncell范围内的数组元素）
+ * @return 成功返回0，不是MSM4/5/7或电文不完整返回-1
+ */
+int msm_decode(const unsigned char *frame, int len, struct msm_obs *obs)
+{
+    unsigned char buf[RTCM3_MAX_PAYLOAD + MSM_PAD_BYTES];
+    int payload_len = len - RTCM3_HEADER_LEN - RTCM3_CRC_LEN;
+    int type = rtcm_msg_type(frame, len);
+    int sys = rtcm_msm_sys(type);
+
+    if (sys < 0 || payload_len * 8 < MSM_POS_CELL_MASK || payload_len > RTCM3_MAX_PAYLOAD) {
+        return -1;
+    }
+    const struct msm_layout *layout = msm_get_layout(type % 10);
+    if (layout == NULL) {
+        return -1;
+    }
+
+    // 拷贝到带填充的缓冲区，字段读取时可以无条件读8字节
+    memcpy(buf, &frame[RTCM3_HEADER_LEN], payload_len);
+    memset(&buf[payload_len], 0, MSM_PAD_BYTES);
+
+    obs->hdr.msg_type = type;
+    obs->hdr.sys = sys;
+    obs->hdr.msm = type % 10;
+    obs->hdr.station_id = msm_u(buf, MSM_POS_STATION, 12);
+    obs->hdr.epoch = msm_u(buf, MSM_POS_EPOCH, 30);
+    obs->hdr.multiple = msm_u(buf, MSM_POS_MULTIPLE, 1);
+    obs->iods = msm_u(buf, MSM_POS_IODS, 3);
+    obs->clk_steering = msm_u(buf, MSM_POS_CLK_STEER, 2);
+    obs->ext_clock = msm_u(buf, MSM_POS_EXT_CLOCK, 2);
+    obs->smoothing = msm_u(buf, MSM_POS_SMOOTHING, 1);
+    obs->smoothing_interval = msm_u(buf, MSM_POS_SMOOTH_INT, 3);
+
+    // 卫星掩码和信号掩码：逐个取最高的置位
+    uint64_t sat_mask = msm_mask64(buf, MSM_POS_SAT_MASK);
+    uint32_t sig_mask = msm_u(buf, MSM_POS_SIG_MASK, 32);
+    int nsat = 0, nsig = 0;
+    while (sat_mask) {
+        int bit = __builtin_clzll(sat_mask);
+        obs->sat_id[nsat++] = bit + 1;
+        sat_mask &= ~(1ULL << (63 - bit));
+    }
+    while (sig_mask) {
+        int bit = __builtin_clz(sig_mask);
+        obs->sig_id[nsig++] = bit + 1;
+        sig_mask &= ~(1u << (31 - bit));
+    }
+
+    int cell_mask_bits = nsat * nsig;
+    if (cell_mask_bits > MSM_MAX_CELLS) {
+        return -1;
+    }
+
+    // 单元掩码：按卫星优先顺序，每个置位对应一个单元
+    int ncell = 0;
+    if (cell_mask_bits > 0) {
+        uint64_t cell_mask = msm_mask64(buf, MSM_POS_CELL_MASK);
+        cell_mask &= ~0ULL << (64 - cell_mask_bits);
+        while (cell_mask) {
+            int bit = __builtin_clzll(cell_mask);
+            obs->cell_sat[ncell] = bit / nsig;
+            obs->cell_sig[ncell] = bit % nsig;
+            ncell++;
+            cell_mask &= ~(1ULL << (63 - bit));
+        }
+    }
+
+    obs->nsat = nsat;
+    obs->nsig = nsig;
+    obs->ncell = ncell;
+    if (msm_total_bits(nsat, nsig, ncell, layout) > payload_len * 8) {
+        return -1;
+    }
+
+    // 卫星数据：每个字段的所有卫星连续存放
+    int pos = MSM_POS_CELL_MASK + cell_mask_bits;
+    for (int i = 0; i < nsat; i++, pos += 8) {
+        obs->rough_ms[i] = msm_u(buf, pos, 8);
+    }
+    if (layout->sat_ext) {
+        for (int i = 0; i < nsat; i++, pos += 4) {
+            obs->ext_info[i] = msm_u(buf, pos, 4);
+        }
+    }
+    for (int i = 0; i < nsat; i++, pos += 10) {
+        obs->rough_mod[i] = msm_u(buf, pos, 10);
+    }
+    if (layout->sat_ext) {
+        for (int i = 0; i < nsat; i++, pos += 14) {
+            obs->rough_rate[i] = msm_s(buf, pos, 14);
+        }
+    }
+
+    // 单元数据：每个字段的所有单元连续存放
+    for (int i = 0; i < ncell; i++, pos += layout->pr_bits) {
+        obs->fine_pr[i] = msm_s(buf, pos, layout->pr_bits) * layout->pr_scale;
+    }
+    for (int i = 0; i < ncell; i++, pos += layout->phase_bits) {
+        obs->fine_phase[i] = msm_s(buf, pos, layout->phase_bits) * layout->phase_scale;
+    }
+    for (int i = 0; i < ncell; i++, pos += layout->lock_bits) {
+        obs->lock[i] = msm_u(buf, pos, layout->lock_bits);
+    }
+    for (int i = 0; i < ncell; i++, pos += 1) {
+        obs->half_cycle[i] = msm_u(buf, pos, 1);
+    }
+    for (int i = 0; i < ncell; i++, pos += layout->cnr_bits) {
+        obs->cnr[i] = msm_u(buf, pos, layout->cnr_bits) * layout->cnr_scale;
+    }
+    if (layout->has_rate) {
+        for (int i = 0; i < ncell; i++, pos += 15) {
+            obs->fine_rate[i] = msm_s(buf, pos, 15);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 逐位读取有符号位域
+ */
+static int32_t msm_ref_s(const unsigned char *buf, int pos, int len)
+{
+    uint32_t value = rtcm_get_bits(buf, pos, len);
+    if (value & (1u << (len - 1))) {
+        return (int32_t)value - (int32_t)(1u << (len - 1)) * 2;
+    }
+    return (int32_t)value;
+}
+
+/**
+ * @brief 参考解码：逐位读取每个字段，用于校验快速解码和性能对比
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param obs 输出的观测数据
+ * @return 成功返回0，不是MSM4/5/7或电文不完整返回-1
+ */
+int msm_decode_reference(const unsigned char *frame, int len, struct msm_obs *obs)
+{
+    const unsigned char *buf = frame + RTCM3_HEADER_LEN;
+    int payload_len = len - RTCM3_HEADER_LEN - RTCM3_CRC_LEN;
+    int type = rtcm_msg_type(frame, len);
+    int sys = rtcm_msm_sys(type);
+
+    if (sys < 0 || payload_len * 8 < MSM_POS_CELL_MASK || payload_len > RTCM3_MAX_PAYLOAD) {
+        return -1;
+    }
+    const struct msm_layout *layout = msm_get_layout(type % 10);
+    if (layout == NULL) {
+        return -1;
+    }
+
+    obs->hdr.msg_type = type;
+    obs->hdr.sys = sys;
+    obs->hdr.msm = type % 10;
+    obs->hdr.station_id = rtcm_get_bits(buf, MSM_POS_STATION, 12);
+    obs->hdr.epoch = rtcm_get_bits(buf, MSM_POS_EPOCH, 30);
+    obs->hdr.multiple = rtcm_get_bits(buf, MSM_POS_MULTIPLE, 1);
+    obs->iods = rtcm_get_bits(buf, MSM_POS_IODS, 3);
+    obs->clk_steering = rtcm_get_bits(buf, MSM_POS_CLK_STEER, 2);
+    obs->ext_clock = rtcm_get_bits(buf, MSM_POS_EXT_CLOCK, 2);
+    obs->smoothing = rtcm_get_bits(buf, MSM_POS_SMOOTHING, 1);
+    obs->smoothing_interval = rtcm_get_bits(buf, MSM_POS_SMOOTH_INT, 3);
+
+    int nsat = 0, nsig = 0, ncell = 0;
+    for (int i = 0; i < MSM_MAX_SATS; i++) {
+        if (rtcm_get_bits(buf, MSM_POS_SAT_MASK + i, 1)) {
+            obs->sat_id[nsat++] = i + 1;
+        }
+    }
+    for (int i = 0; i < MSM_MAX_SIGS; i++) {
+        if (rtcm_get_bits(buf, MSM_POS_SIG_MASK + i, 1)) {
+            obs->sig_id[nsig++] = i + 1;
+        }
+    }
+    if (nsat * nsig > MSM_MAX_CELLS) {
+        return -1;
+    }
+
+    int pos = MSM_POS_CELL_MASK;
+    for (int i = 0; i < nsat; i++) {
+        for (int j = 0; j < nsig; j++, pos++) {
+            if (pos < payload_len * 8 && rtcm_get_bits(buf, pos, 1)) {
+                obs->cell_sat[ncell] = i;
+                obs->cell_sig[ncell] = j;
+                ncell++;
+            }
+        }
+    }
+
+    obs->nsat = nsat;
+    obs->nsig = nsig;
+    obs->ncell = ncell;
+    if (msm_total_bits(nsat, nsig, ncell, layout) > payload_len * 8) {
+        return -1;
+    }
+
+    for (int i = 0; i < nsat; i++) {
+        obs->rough_ms[i] = rtcm_get_bits(buf, pos, 8);
+        pos += 8;
+    }
+    if (layout->sat_ext) {
+        for (int i = 0; i < nsat; i++) {
+            obs->ext_info[i] = rtcm_get_bits(buf, pos, 4);
+            pos += 4;
+        }
+    }
+    for (int i = 0; i < nsat; i++) {
+        obs->rough_mod[i] = rtcm_get_bits(buf, pos, 10);
+        pos += 10;
+    }
+    if (layout->sat_ext) {
+        for (int i = 0; i < nsat; i++) {
+            obs->rough_rate[i] = msm_ref_s(buf, pos, 14);
+            pos += 14;
+        }
+    }
+
+    for (int i = 0; i < ncell; i++) {
+        obs->fine_pr[i] = msm_ref_s(buf, pos, layout->pr_bits) * layout->pr_scale;
+        pos += layout->pr_bits;
+    }
+    for (int i = 0; i < ncell; i++) {
+        obs->fine_phase[i] = msm_ref_s(buf, pos, layout->phase_bits) * layout->phase_scale;
+        pos += layout->phase_bits;
+    }
+    for (int i = 0; i < ncell; i++) {
+        obs->lock[i] = rtcm_get_bits(buf, pos, layout->lock_bits);
+        pos += layout->lock_bits;
+    }
+    for (int i = 0; i < ncell; i++) {
+        obs->half_cycle[i] = rtcm_get_bits(buf, pos, 1);
+        pos += 1;
+    }
+    for (int i = 0; i < ncell; i++) {
+        obs->cnr[i] = rtcm_get_bits(buf, pos, layout->cnr_bits) * layout->cnr_scale;
+        pos += layout->cnr_bits;
+    }
+    if (layout->has_rate) {
+        for (int i = 0; i < ncell; i++) {
+            obs->fine_rate[i] = msm_ref_s(buf, pos, 15);
+            pos += 15;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 编码MSM4/5/7电文内容（不含帧头和CRC，用rtcm_frame_encode封装）
+ * @param obs 观测数据（hdr.msg_type决定系统和MSM等级，单元须按卫星优先顺序排列）
+ * @param payload 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 电文长度，参数错误或缓冲区不足返回-1
+ * 注：MSM4/5的精细伪距、精细相位和载噪比按各自分辨率截断
+ */
+int msm_encode(const struct msm_obs *obs, unsigned char *payload, int size)
+{
+    const struct msm_layout *layout = msm_get_layout(obs->hdr.msg_type % 10);
+    int nsat = obs->nsat, nsig = obs->nsig, ncell = obs->ncell;
+
+    if (rtcm_msm_sys(obs->hdr.msg_type) < 0 || layout == NULL ||
+        nsat < 0 || nsig < 0 || ncell < 0 || nsat > MSM_MAX_SATS || nsig > MSM_MAX_SIGS ||
+        nsat * nsig > MSM_MAX_CELLS || ncell > nsat * nsig) {
+        return -1;
+    }
+
+    int bits = msm_total_bits(nsat, nsig, ncell, layout);
+    int payload_len = (bits + 7) / 8;
+    if (payload_len > RTCM3_MAX_PAYLOAD || payload_len > size) {
+        return -1;
+    }
+    memset(payload, 0, payload_len);
+
+    rtcm_set_bits(payload, 0, 12, obs->hdr.msg_type);
+    rtcm_set_bits(payload, MSM_POS_STATION, 12, obs->hdr.station_id);
+    rtcm_set_bits(payload, MSM_POS_EPOCH, 30, obs->hdr.epoch);
+    rtcm_set_bits(payload, MSM_POS_MULTIPLE, 1, obs->hdr.multiple);
+    rtcm_set_bits(payload, MSM_POS_IODS, 3, obs->iods);
+    rtcm_set_bits(payload, MSM_POS_CLK_STEER, 2, obs->clk_steering);
+    rtcm_set_bits(payload, MSM_POS_EXT_CLOCK, 2, obs->ext_clock);
+    rtcm_set_bits(payload, MSM_POS_SMOOTHING, 1, obs->smoothing);
+    rtcm_set_bits(payload, MSM_POS_SMOOTH_INT, 3, obs->smoothing_interval);
+
+    // 掩码：卫星号/信号号须严格递增
+    for (int i = 0; i < nsat; i++) {
+        int id = obs->sat_id[i];
+        if (id < 1 || id > MSM_MAX_SATS || (i > 0 && id <= obs->sat_id[i - 1])) {
+            return -1;
+        }
+        rtcm_set_bits(payload, MSM_POS_SAT_MASK + id - 1, 1, 1);
+    }
+    for (int i = 0; i < nsig; i++) {
+        int id = obs->sig_id[i];
+        if (id < 1 || id > MSM_MAX_SIGS || (i > 0 && id <= obs->sig_id[i - 1])) {
+            return -1;
+        }
+        rtcm_set_bits(payload, MSM_POS_SIG_MASK + id - 1, 1, 1);
+    }
+    int prev = -1;
+    for (int i = 0; i < ncell; i++) {
+        int bit = obs->cell_sat[i] * nsig + obs->cell_sig[i];
+        if (obs->cell_sat[i] >= nsat || obs->cell_sig[i] >= nsig || bit <= prev) {
+            return -1;
+        }
+        rtcm_set_bits(payload, MSM_POS_CELL_MASK + bit, 1, 1);
+        prev = bit;
+    }
+
+    int pos = MSM_POS_CELL_MASK + nsat * nsig;
+    for (int i = 0; i < nsat; i++, pos += 8) {
+        rtcm_set_bits(payload, pos, 8, obs->rough_ms[i]);
+    }
+    if (layout->sat_ext) {
+        for (int i = 0; i < nsat; i++, pos += 4) {
+            rtcm_set_bits(payload, pos, 4, obs->ext_info[i]);
+        }
+    }
+    for (int i = 0; i < nsat; i++, pos += 10) {
+        rtcm_set_bits(payload, pos, 10, obs->rough_mod[i]);
+    }
+    if (layout->sat_ext) {
+        for (int i = 0; i < nsat; i++, pos += 14) {
+            rtcm_set_bits(payload, pos, 14, (uint32_t)obs->rough_rate[i]);
+        }
+    }
+
+    for (int i = 0; i < ncell; i++, pos += layout->pr_bits) {
+        rtcm_set_bits(payload, pos, layout->pr_bits, (uint32_t)(obs->fine_pr[i] / layout->pr_scale));
+    }
+    for (int i = 0; i < ncell; i++, pos += layout->phase_bits) {
+        rtcm_set_bits(payload, pos, layout->phase_bits,
+                      (uint32_t)(obs->fine_phase[i] / layout->phase_scale));
+    }
+    for (int i = 0; i < ncell; i++, pos += layout->lock_bits) {
+        rtcm_set_bits(payload, pos, layout->lock_bits, obs->lock[i]);
+    }
+    for (int i = 0; i < ncell; i++, pos += 1) {
+        rtcm_set_bits(payload, pos, 1, obs->half_cycle[i]);
+    }
+    for (int i = 0; i < ncell; i++, pos += layout->cnr_bits) {
+        rtcm_set_bits(payload, pos, layout->cnr_bits, obs->cnr[i] / layout->cnr_scale);
+    }
+    if (layout->has_rate) {
+        for (int i = 0; i < ncell; i++, pos += 15) {
+            rtcm_set_bits(payload, pos, 15, (uint32_t)obs->fine_rate[i]);
+        }
+    }
+
+    return payload_len;
+}
+
+/**
+ * @brief 锁定时间指示换算为最短锁定时间
+ * @param lock 锁定时间指示（MSM4/5为DF402，MSM7为DF407）
+ * @param msm MSM等级
+ * @return 该指示值对应的最短连续跟踪时间（毫秒）
+ */
+uint32_t msm_lock_ms(int lock, int msm)
+{
+    if (msm != 7) {
+        // DF402：0表示不足32毫秒，之后锁定时间每翻一倍加1
+        return lock > 0 ? 16U << lock : 0;
+    }
+
+    // DF407：64以下为毫秒数，之后每32个指示值分辨率减半，704以上为保留值
+    if (lock < 64) {
+        return lock;
+    }
+    if (lock > 704) {
+        lock = 704;
+    }
+    int n = lock / 32 - 1;
+    return (uint32_t)(lock - 32 * n) << n;
+}
+
+/**
+ * @brief 连续跟踪时间换算为锁定时间指示（msm_lock_ms的逆运算，取最短锁定时间不超过lock_ms的最大指示值）
+ * @param lock_ms 连续跟踪时间（毫秒）
+ * @param msm MSM等级
+ * @return MSM4/5的锁定时间指示（DF402）或MSM7的扩展锁定时间指示（DF407）
+ */
+int msm_lock_indicator(uint64_t lock_ms, int msm)
+{
+    int n = 0;
+
+    if (msm != 7) {
+        if (lock_ms < 32) {
+            return 0;
+        }
+        while ((lock_ms >> (n + 1)) >= 32 && n < 15) {
+            n++;
+        }
+        return n + 1 > 15 ? 15 : n + 1;
+    }
+
+    // DF407：64毫秒以下为原值，之后每翻一倍分辨率减半、指示值增加32（t = (i - 32n) << n）
+    if (lock_ms < 64) {
+        return (int)lock_ms;
+    }
+    if (lock_ms >= (1ULL << 26)) {
+        return 704;
+    }
+    n = 1;
+    while ((lock_ms >> n) >= 64) {
+        n++;
+    }
+    return (int)(lock_ms >> n) + 32 * n;
+}
+
+/**
+ * @brief 扩展锁定时间指示（DF407）换算为锁定时间指示（DF402）
+ * @param lock DF407
+ * @return DF402（按最短锁定时间取值，不会高估连续跟踪时间）
+ */
+static int msm_lock_reduce(int lock)
+{
+    uint32_t ms = msm_lock_ms(lock, 7);
+
+    // DF402：32毫秒以下为0，之后锁定时间每翻一倍加1
+    if (ms < 32) {
+        return 0;
+    }
+    int k = 31 - __builtin_clz(ms) - 4;
+    return k > 15 ? 15 : k;
+}
+
+/**
+ * @brief 按较低的分辨率四舍五入（无效值保持不变，结果仍以MSM7分辨率表示）
+ * @param v 数值（MSM7分辨率）
+ * @param scale 目标分辨率与MSM7分辨率之比
+ * @param bits 目标字段位数（有符号）
+ * @param invalid 无效值
+ * @return 舍入后的数值
+ */
+static int32_t msm_round(int32_t v, int scale, int bits, int32_t invalid)
+{
+    int32_t max = (1 << (bits - 1)) - 1;
+
+    if (v == invalid) {
+        return invalid;
+    }
+    int32_t r = (v >= 0 ? v + scale / 2 : v - scale / 2) / scale;
+    if (r > max) {
+        r = max;
+    } else if (r < -max) {
+        r = -max;
+    }
+    return r * scale;
+}
+
+/**
+ * @brief 把MSM5/7电文改写为同一卫星系统的MSM4（去掉多普勒和扩展信息，伪距、相位和载噪比降到MSM4分辨率）
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param out 输出缓冲区（MSM4帧总是不长于原帧）
+ * @param size 输出缓冲区大小
+ * @return MSM4帧长度，不是MSM5/7返回0，电文无效或缓冲区不足返回-1
+ */
+int msm_reduce(const unsigned char *frame, int len, unsigned char *out, int size)
+{
+    struct msm_obs obs;
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+    int type = rtcm_msg_type(frame, len);
+
+    if (rtcm_msm_sys(type) < 0 || (type % 10 != 5 && type % 10 != 7)) {
+        return 0;
+    }
+    if (msm_decode(frame, len, &obs) != 0) {
+        return -1;
+    }
+
+    // MSM5的单元字段与MSM4分辨率相同，只有MSM7需要换算
+    if (obs.hdr.msm == 7) {
+        for (int i = 0; i < obs.ncell; i++) {
+            obs.fine_pr[i] = msm_round(obs.fine_pr[i], msm4_layout.pr_scale, msm4_layout.pr_bits,
+                                       MSM_INVALID_FINE_PR);
+            obs.fine_phase[i] = msm_round(obs.fine_phase[i], msm4_layout.phase_scale, msm4_layout.phase_bits,
+                                          MSM_INVALID_FINE_PHASE);
+            obs.lock[i] = msm_lock_reduce(obs.lock[i]);
+            int cnr = (obs.cnr[i] + msm4_layout.cnr_scale / 2) / msm4_layout.cnr_scale;
+            obs.cnr[i] = (cnr > 63 ? 63 : cnr) * msm4_layout.cnr_scale;
+        }
+    }
+
+    obs.hdr.msg_type = type - type % 10 + 4;
+    obs.hdr.msm = 4;
+    int payload_len = msm_encode(&obs, payload, sizeof(payload));
+    if (payload_len < 0) {
+        return -1;
+    }
+    return rtcm_frame_encode(payload, payload_len, out, size);
+}
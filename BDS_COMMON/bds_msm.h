@@ -0,0 +1,77 @@
+/*
+ * bds_msm.h
+ * MSM观测电文解码头文件
+ * 功能：把MSM4/5/7电文（BDS 1124~1127及其他卫星系统）解码为结构数组（SoA）布局，
+ *       提供按64位字读取的快速解码、逐位读取的参考解码和编码，以及MSM5/7到MSM4的改写
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_MSM_H
+#define BDS_MSM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bds_rtcm.h"
+
+// MSM容量限制
+#define MSM_MAX_SATS    64      // 卫星掩码位数
+#define MSM_MAX_SIGS    32      // 信号掩码位数
+#define MSM_MAX_CELLS   64      // 单元掩码最多64位（卫星数×信号数）
+
+// 无效值（已统一到MSM7的分辨率）
+#define MSM_INVALID_FINE_PR     (-524288)   // -2^19
+#define MSM_INVALID_FINE_PHASE  (-8388608)  // -2^23
+#define MSM_INVALID_ROUGH_RATE  (-8192)     // -2^13
+#define MSM_INVALID_FINE_RATE   (-16384)    // -2^14
+#define MSM_INVALID_ROUGH_MS    255
+
+// MSM观测数据（结构数组布局，同一字段连续存放）
+// 为便于统一处理，MSM4/5的精细伪距、精细相位和载噪比换算到MSM7的分辨率：
+//   fine_pr单位2^-29毫秒，fine_phase单位2^-31毫秒，cnr单位1/16 dB-Hz
+// 锁定时间指示：MSM4/5为4位指示，MSM7为10位扩展指示，保持原值
+struct msm_obs {
+    struct rtcm_obs_header hdr;     // 电文号、系统、MSM等级、站号、历元、多电文标志
+    int iods;                       // 数据站发布序号
+    int clk_steering;               // 钟驾驭指示
+    int ext_clock;                  // 外部钟指示
+    int smoothing;                  // 无弥散平滑标志
+    int smoothing_interval;         // 平滑间隔
+
+    int nsat;                       // 卫星数
+    int nsig;                       // 信号数
+    int ncell;                      // 有观测的单元数
+
+    // 卫星数据（按nsat）
+    uint8_t sat_id[MSM_MAX_SATS];        // 卫星号（1~64）
+    uint8_t rough_ms[MSM_MAX_SATS];      // 粗略距离整毫秒
+    uint8_t ext_info[MSM_MAX_SATS];      // 扩展卫星信息（MSM5/7）
+    uint16_t rough_mod[MSM_MAX_SATS];    // 粗略距离毫秒内部分（2^-10毫秒）
+    int16_t rough_rate[MSM_MAX_SATS];    // 粗略相位距离变化率（米/秒，MSM5/7）
+
+    // 信号数据（按nsig）
+    uint8_t sig_id[MSM_MAX_SIGS];        // 信号号（1~32）
+
+    // 单元数据（按ncell）
+    uint8_t cell_sat[MSM_MAX_CELLS];     // 所属卫星在sat_*数组中的下标
+    uint8_t cell_sig[MSM_MAX_CELLS];     // 所属信号在sig_id数组中的下标
+    int32_t fine_pr[MSM_MAX_CELLS];      // 精细伪距（2^-29毫秒）
+    int32_t fine_phase[MSM_MAX_CELLS];   // 精细相位距离（2^-31毫秒）
+    uint16_t lock[MSM_MAX_CELLS];        // 锁定时间指示
+    uint8_t half_cycle[MSM_MAX_CELLS];   // 半周模糊度指示
+    uint16_t cnr[MSM_MAX_CELLS];         // 载噪比（1/16 dB-Hz，0表示无效）
+    int16_t fine_rate[MSM_MAX_CELLS];    // 精细相位距离变化率（0.0001米/秒，MSM5/7）
+};
+
+// 函数声明
+int msm_decode(const unsigned char *frame, int len, struct msm_obs *obs);
+int msm_decode_reference(const unsigned char *frame, int len, struct msm_obs *obs);
+int msm_encode(const struct msm_obs *obs, unsigned char *payload, int size);
+int msm_reduce(const unsigned char *frame, int len, unsigned char *out, int size);
+uint32_t msm_lock_ms(int lock, int msm);
+int msm_lock_indicator(uint64_t lock_ms, int msm);
+
+#endif /* BDS_MSM_H */
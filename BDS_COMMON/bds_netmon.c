@@ -0,0 +1,175 @@
+/*
+ * bds_netmon.c
+ * 网络接口监测源文件
+ * 功能：rtnetlink事件读取与解析，查询当前到服务器的出口源地址
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_netmon.h"
+
+/**
+ * @brief 打开rtnetlink监听socket（非阻塞）
+ * @return 成功返回socket描述符，失败返回-1
+ */
+int netmon_open(void)
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        perror("netlink socket creation failed");
+        return -1;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("netlink bind failed");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief 打印单条地址事件
+ * @param nh netlink消息头
+ */
+static void netmon_print_addr(struct nlmsghdr *nh)
+{
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+    struct rtattr *rta = IFA_RTA(ifa);
+    int rta_len = IFA_PAYLOAD(nh);
+    char ifname[IF_NAMESIZE] = "?";
+    char ip[INET_ADDRSTRLEN] = "?";
+
+    if_indextoname(ifa->ifa_index, ifname);
+    for (; RTA_OK(rta, rta_len); rta = RTA_NEXT(rta, rta_len)) {
+        if (rta->rta_type == IFA_LOCAL && ifa->ifa_family == AF_INET) {
+            inet_ntop(AF_INET, RTA_DATA(rta), ip, sizeof(ip));
+        }
+    }
+
+    log_info("Netlink: address %s %s on %s",
+             nh->nlmsg_type == RTM_NEWADDR ? "added" : "removed", ip, ifname);
+}
+
+/**
+ * @brief 读取并解析全部待处理的netlink消息
+ * @param fd netlink socket描述符
+ * @return 返回事件位掩码（无事件为0），出错返回-1
+ */
+int netmon_read(int fd)
+{
+    char buffer[NETMON_BUFFER_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int events = 0;
+
+    while (1) {
+        ssize_t len = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == ENOBUFS) {
+                // 内核丢弃了部分事件，按全部变化处理
+                events |= NETMON_EV_LINK | NETMON_EV_ADDR | NETMON_EV_ROUTE;
+                continue;
+            }
+            log_errno("netlink recv failed");
+            return -1;
+        }
+        if (len == 0) {
+            break;
+        }
+
+        int remain = (int)len;
+        struct nlmsghdr *nh = (struct nlmsghdr *)buffer;
+        for (; NLMSG_OK(nh, remain); nh = NLMSG_NEXT(nh, remain)) {
+            switch (nh->nlmsg_type) {
+            case RTM_NEWLINK:
+            case RTM_DELLINK: {
+                struct ifinfomsg *ifi = NLMSG_DATA(nh);
+                char ifname[IF_NAMESIZE] = "?";
+                if_indextoname(ifi->ifi_index, ifname);
+                log_info("Netlink: link %s %s", ifname,
+                         (ifi->ifi_flags & IFF_RUNNING) ? "running" : "down");
+                events |= NETMON_EV_LINK;
+                break;
+            }
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                netmon_print_addr(nh);
+                events |= NETMON_EV_ADDR;
+                break;
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE: {
+                struct rtmsg *rtm = NLMSG_DATA(nh);
+                // 只关心主路由表，本地/广播路由的变化不影响出口选择
+                if (rtm->rtm_table == RT_TABLE_MAIN) {
+                    events |= NETMON_EV_ROUTE;
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    return events;
+}
+
+/**
+ * @brief 查询内核当前到服务器会选用的源地址（UDP connect不发送数据，只做路由查找）
+ * @param ip 服务器IP地址
+ * @param port 服务器端口号
+ * @param src 输出的源地址字符串
+ * @param len 输出缓冲区长度
+ * @return 成功返回0，无可用路由返回-1
+ */
+int netmon_route_source(const char *ip, int port, char *src, size_t len)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int rc = netmon_socket_source(fd, src, len);
+    close(fd);
+    return rc;
+}
+
+/**
+ * @brief 获取已连接socket的本地源地址
+ * @param sock_fd socket描述符
+ * @param src 输出的源地址字符串
+ * @param len 输出缓冲区长度
+ * @return 成功返回0，失败返回-1
+ */
+int netmon_socket_source(int sock_fd, char *src, size_t len)
+{
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+
+    if (getsockname(sock_fd, (struct sockaddr *)&local, &local_len) < 0) {
+        return -1;
+    }
+    if (inet_ntop(AF_INET, &local.sin_addr, src, len) == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * bds_netmon.h
+ * 网络接口监测头文件
+ * 功能：通过rtnetlink监听地址、链路和路由变化，判断上行连接的出口是否改变
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_NETMON_H
+#define BDS_NETMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "bds_log.h"
+
+// 事件类型（位掩码）
+#define NETMON_EV_LINK   0x01   // 链路状态变化
+#define NETMON_EV_ADDR   0x02   // 地址增删
+#define NETMON_EV_ROUTE  0x04   // 路由增删
+
+#define NETMON_BUFFER_SIZE 8192 // netlink接收缓冲区大小
+
+// 函数声明
+int netmon_open(void);
+int netmon_read(int fd);
+int netmon_route_source(const char *ip, int port, char *src, size_t len);
+int netmon_socket_source(int sock_fd, char *src, size_t len);
+
+#endif /* BDS_NETMON_H */
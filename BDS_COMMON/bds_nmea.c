@@ -0,0 +1,222 @@
+/*
+ * bds_nmea.c
+ * NMEA语句处理源文件
+ * 功能：按行分割和校验NMEA语句、GGA字段解析、WGS84经纬度到ECEF的转换
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_nmea.h"
+
+// WGS84椭球参数
+#define NMEA_WGS84_A    6378137.0
+#define NMEA_WGS84_F    (1.0 / 298.257223563)
+#define NMEA_DEG2RAD    (M_PI / 180.0)
+
+#define NMEA_GGA_FIELDS 15     // GGA语句的字段数（含语句名）
+
+/**
+ * @brief 初始化语句提取状态
+ * @param r 语句提取状态
+ */
+void nmea_reader_init(struct nmea_reader *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+/**
+ * @brief 十六进制字符转数值
+ * @param c 字符
+ * @return 数值，不是十六进制字符返回-1
+ */
+static int nmea_hex(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief 检查语句格式和校验和（$与*之间各字节异或）
+ * @param line 语句（不含行尾）
+ * @param len 语句长度
+ * @return 校验通过返回1，否则返回0
+ */
+int nmea_checksum_ok(const char *line, int len)
+{
+    unsigned char sum = 0;
+    int i;
+
+    if (len < 9 || line[0] != '$' || line[len - 3] != '*') {
+        return 0;
+    }
+    for (i = 1; i < len - 3; i++) {
+        sum ^= (unsigned char)line[i];
+    }
+
+    int hi = nmea_hex(line[len - 2]);
+    int lo = nmea_hex(line[len - 1]);
+    return hi >= 0 && lo >= 0 && ((hi << 4) | lo) == sum;
+}
+
+/**
+ * @brief 输入一段字节流，对其中每条校验通过的语句调用回调
+ * @param r 语句提取状态
+ * @param data 输入数据
+ * @param len 输入长度
+ * @param cb 语句回调
+ * @param arg 回调参数
+ * 注：$之前的字节（如接收机同时输出的二进制数据）和超长的行直接丢弃
+ */
+void nmea_reader_push(struct nmea_reader *r, const unsigned char *data, size_t len,
+                      nmea_line_fn cb, void *arg)
+{
+    for (size_t i = 0; i < len; i++) {
+        char c = (char)data[i];
+
+        if (c == '$') {
+            // 新语句开始，丢弃未结束的半行
+            r->buf[0] = c;
+            r->len = 1;
+        } else if (c == '\r' || c == '\n') {
+            if (r->len > 0) {
+                r->buf[r->len] = '\0';
+                if (nmea_checksum_ok(r->buf, r->len)) {
+                    r->sentences++;
+                    cb(r->buf, r->len, arg);
+                } else {
+                    r->checksum_errors++;
+                }
+            }
+            r->len = 0;
+        } else if (r->len > 0) {
+            if (r->len >= NMEA_MAX_LINE) {
+                r->len = -1;
+            } else {
+                r->buf[r->len++] = c;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 把ddmm.mmmm格式的经纬度转换为度
+ * @param field 字段内容
+ * @param hemi 半球字段（N/S/E/W）
+ * @param max 度数上限（纬度90，经度180）
+ * @param out 输出的度数
+ * @return 成功返回0，字段为空、格式错误或超出范围返回-1
+ */
+static int nmea_parse_angle(const char *field, const char *hemi, double max, double *out)
+{
+    char *end;
+    double v = strtod(field, &end);
+
+    // 符号由半球字段表示，负数、NaN和无穷大都不是有效的ddmm.mmmm
+    if (end == field || (*end != ',' && *end != '*') || !(v >= 0.0 && v <= max * 100.0)) {
+        return -1;
+    }
+
+    double deg = floor(v / 100.0);
+    double min = v - deg * 100.0;
+    if (min >= 60.0) {
+        return -1;
+    }
+    *out = deg + min / 60.0;
+    if (*out > max) {
+        return -1;
+    }
+    if (*hemi == 'S' || *hemi == 'W') {
+        *out = -*out;
+    } else if (*hemi != 'N' && *hemi != 'E') {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析GGA语句（任意系统前缀：GP/GN/BD/GB等）
+ * @param line 校验通过的语句
+ * @param gga 输出的定位结果
+ * @return 有效定位返回0，不是GGA、字段缺失、未定位或坐标超出范围返回-1
+ */
+int nmea_parse_gga(const char *line, struct nmea_gga *gga)
+{
+    const char *field[NMEA_GGA_FIELDS];
+    int n = 0;
+
+    if (strlen(line) < 6 || strncmp(&line[3], "GGA,", 4) != 0) {
+        return -1;
+    }
+
+    // 按逗号切分字段（空字段保留位置）
+    field[n++] = line;
+    for (const char *p = line; *p != '\0' && *p != '*' && n < NMEA_GGA_FIELDS; p++) {
+        if (*p == ',') {
+            field[n++] = p + 1;
+        }
+    }
+    if (n < 12) {
+        return -1;
+    }
+
+    memset(gga, 0, sizeof(*gga));
+    gga->quality = atoi(field[6]);
+    if (gga->quality <= 0) {
+        return -1;
+    }
+    if (nmea_parse_angle(field[2], field[3], 90.0, &gga->lat) != 0 ||
+        nmea_parse_angle(field[4], field[5], 180.0, &gga->lon) != 0) {
+        return -1;
+    }
+    gga->sats = atoi(field[7]);
+    gga->hdop = atof(field[8]);
+    gga->height = atof(field[9]) + atof(field[11]);
+
+    // 高度超出范围（含NaN）的定位不用于选择基站，避免算出无意义的基线
+    if (!(gga->height >= NMEA_HEIGHT_MIN && gga->height <= NMEA_HEIGHT_MAX)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief WGS84经纬度转换为ECEF坐标
+ * @param lat 纬度（度）
+ * @param lon 经度（度）
+ * @param height 椭球高（米）
+ * @param ecef 输出的ECEF坐标（米）
+ */
+void nmea_llh_to_ecef(double lat, double lon, double height, double ecef[3])
+{
+    double e2 = NMEA_WGS84_F * (2.0 - NMEA_WGS84_F);
+    double sin_lat = sin(lat * NMEA_DEG2RAD);
+    double cos_lat = cos(lat * NMEA_DEG2RAD);
+    double n = NMEA_WGS84_A / sqrt(1.0 - e2 * sin_lat * sin_lat);
+
+    ecef[0] = (n + height) * cos_lat * cos(lon * NMEA_DEG2RAD);
+    ecef[1] = (n + height) * cos_lat * sin(lon * NMEA_DEG2RAD);
+    ecef[2] = (n * (1.0 - e2) + height) * sin_lat;
+}
+
+/**
+ * @brief 计算两点的直线距离（基线长度）
+ * @param a 第一点ECEF坐标
+ * @param b 第二点ECEF坐标
+ * @return 距离（米）
+ */
+double nmea_distance(const double a[3], const double b[3])
+{
+    double dx = a[0] - b[0];
+    double dy = a[1] - b[1];
+    double dz = a[2] - b[2];
+
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
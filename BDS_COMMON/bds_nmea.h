@@ -0,0 +1,54 @@
+/*
+ * bds_nmea.h
+ * NMEA语句处理头文件
+ * 功能：从串口字节流中按行提取校验通过的NMEA语句，解析GGA定位结果，
+ *       经纬度与ECEF坐标转换和基线长度计算
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_NMEA_H
+#define BDS_NMEA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+// NMEA配置
+#define NMEA_MAX_LINE   128    // 单条语句的最大长度（标准为82字节，留出厂商扩展余量）
+#define NMEA_HEIGHT_MIN (-1000.0)  // 可接受的最低椭球高（米，陆地最低处加高程异常仍在此之上）
+#define NMEA_HEIGHT_MAX 20000.0    // 可接受的最高椭球高（米，民用接收机在18km以上不输出定位）
+
+// GGA定位结果
+struct nmea_gga {
+    double lat;            // 纬度（度，北纬为正）
+    double lon;            // 经度（度，东经为正）
+    double height;         // 椭球高（米，海拔高加高程异常）
+    int quality;           // 定位质量：0无效，1单点，2差分，4固定解，5浮点解
+    int sats;              // 使用的卫星数
+    double hdop;           // 水平精度因子
+};
+
+// 语句回调：line为去掉行尾的完整语句（以'\0'结尾）
+typedef void (*nmea_line_fn)(const char *line, int len, void *arg);
+
+// 按行提取语句的状态（只缓存跨读取边界的半行）
+struct nmea_reader {
+    char buf[NMEA_MAX_LINE + 1];
+    int len;                   // 已缓存的字节数，-1表示正在丢弃超长行
+    uint64_t sentences;        // 校验通过的语句数
+    uint64_t checksum_errors;  // 校验错误次数
+};
+
+// 函数声明
+void nmea_reader_init(struct nmea_reader *r);
+void nmea_reader_push(struct nmea_reader *r, const unsigned char *data, size_t len,
+                      nmea_line_fn cb, void *arg);
+int nmea_checksum_ok(const char *line, int len);
+int nmea_parse_gga(const char *line, struct nmea_gga *gga);
+void nmea_llh_to_ecef(double lat, double lon, double height, double ecef[3]);
+double nmea_distance(const double a[3], const double b[3]);
+
+#endif /* BDS_NMEA_H */
@@ -0,0 +1,314 @@
+/*
+ * bds_obsmon.c
+ * 观测质量监测源文件
+ * 功能：逐帧解码MSM电文并更新各卫星信号的累计量，历元结束时更新卫星数和完整性，按周期输出JSON摘要
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_obsmon.h"
+
+// 卫星系统名称和卫星号前缀（按enum rtcm_sys）
+static const char *const obsmon_sys_names[RTCM_SYS_COUNT] = { "GPS", "GLO", "GAL", "SBS", "QZS", "BDS", "IRN" };
+static const char obsmon_sys_prefix[RTCM_SYS_COUNT] = { 'G', 'R', 'E', 'S', 'J', 'C', 'I' };
+
+/**
+ * @brief 初始化观测质量监测
+ * @param mon 监测状态
+ */
+void obsmon_init(struct obsmon *mon)
+{
+    memset(mon, 0, sizeof(*mon));
+}
+
+/**
+ * @brief 结束当前历元：更新各系统的卫星数和历元完整性
+ * @param mon 监测状态
+ * @param incomplete 末条电文未到（被下一历元的电文结束）
+ */
+static void obsmon_close_epoch(struct obsmon *mon, int incomplete)
+{
+    int total = 0;
+
+    for (int i = 0; i < RTCM_SYS_COUNT; i++) {
+        struct obsmon_sys *s = &mon->sys[i];
+        if (!(mon->open_mask & (1u << i))) {
+            s->sats = 0;
+            continue;
+        }
+        s->sats = __builtin_popcountll(s->sat_mask);
+        if (s->epochs == 0 || s->sats < s->sats_min) {
+            s->sats_min = s->sats;
+        }
+        if (s->sats > s->sats_max) {
+            s->sats_max = s->sats;
+        }
+        s->epochs++;
+        total += s->sats;
+    }
+    mon->sats = total;
+
+    mon->epochs++;
+    mon->epochs_total++;
+    if (incomplete) {
+        mon->incomplete++;
+        mon->incomplete_total++;
+    }
+    if (mon->last_mask & ~mon->open_mask) {
+        mon->missing++;
+        mon->missing_total++;
+    }
+    mon->last_mask = mon->open_mask;
+    mon->open_mask = 0;
+}
+
+/**
+ * @brief 按MSM信号号查找统计槽位，没有时分配空闲槽位
+ * @param s 卫星系统
+ * @param sig_id MSM信号号（1~32）
+ * @return 槽位，槽位用完返回-1
+ */
+static int obsmon_sig_slot(struct obsmon_sys *s, int sig_id)
+{
+    for (int k = 0; k < OBSMON_SIGS; k++) {
+        if (s->sig_id[k] == sig_id) {
+            return k;
+        }
+        if (s->sig_id[k] == 0) {
+            s->sig_id[k] = sig_id;
+            return k;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 处理一个完整帧（不是MSM4/5/7的电文忽略）
+ * @param mon 监测状态
+ * @param frame 完整帧
+ * @param len 帧长度
+ */
+static void obsmon_frame(struct obsmon *mon, const unsigned char *frame, int len)
+{
+    struct msm_obs *obs = &mon->obs;
+    int type = rtcm_msg_type(frame, len);
+    int sys = rtcm_msm_sys(type);
+
+    if (sys < 0 || (type % 10 != 4 && type % 10 != 5 && type % 10 != 7)) {
+        return;
+    }
+    if (msm_decode(frame, len, obs) != 0) {
+        mon->errors_total++;
+        return;
+    }
+
+    // 该系统已在当前历元出现但历元时间变了：上一历元的末条电文丢失
+    struct obsmon_sys *s = &mon->sys[sys];
+    unsigned int bit = 1u << sys;
+    if ((mon->open_mask & bit) && s->epoch != obs->hdr.epoch) {
+        obsmon_close_epoch(mon, 1);
+    }
+    if (mon->open_mask == 0) {
+        mon->epoch_seq++;
+    }
+    if (!(mon->open_mask & bit)) {
+        mon->open_mask |= bit;
+        s->epoch = obs->hdr.epoch;
+        s->sat_mask = 0;
+    }
+
+    int slot[MSM_MAX_SIGS];
+    for (int j = 0; j < obs->nsig; j++) {
+        slot[j] = obsmon_sig_slot(s, obs->sig_id[j]);
+    }
+
+    for (int i = 0; i < obs->ncell; i++) {
+        int sat = obs->sat_id[obs->cell_sat[i]] - 1;
+        s->sat_mask |= 1ULL << sat;
+
+        int k = slot[obs->cell_sig[i]];
+        if (k < 0) {
+            s->extra_cells++;
+            continue;
+        }
+
+        // 连续跟踪时锁定时间只增不减，回退说明发生了周跳或失锁
+        struct obsmon_cell *c = &s->cells[sat][k];
+        uint32_t lock_ms = msm_lock_ms(obs->lock[i], obs->hdr.msm);
+        if (c->last_epoch != 0 && c->last_epoch != mon->epoch_seq &&
+            mon->epoch_seq - c->last_epoch <= OBSMON_GAP_EPOCHS && lock_ms < c->lock_ms) {
+            c->slips++;
+            mon->slips_total++;
+        }
+        c->lock_ms = lock_ms;
+        c->last_epoch = mon->epoch_seq;
+
+        if (obs->cnr[i] > 0 && c->cnr_count < UINT16_MAX) {
+            c->cnr_sum += obs->cnr[i];
+            c->cnr_count++;
+        }
+    }
+
+    if (!obs->hdr.multiple) {
+        obsmon_close_epoch(mon, 0);
+    }
+}
+
+/**
+ * @brief 处理一段转发过的数据（在原缓冲区上逐帧读取，不拷贝）
+ * @param mon 监测状态
+ * @param buf 按顺序拼接的完整帧
+ * @param len 长度
+ */
+void obsmon_push(struct obsmon *mon, const unsigned char *buf, int len)
+{
+    int pos = 0;
+
+    while (pos + RTCM3_HEADER_LEN <= len && buf[pos] == RTCM3_PREAMBLE) {
+        int n = RTCM3_HEADER_LEN + (((buf[pos + 1] & 0x03) << 8) | buf[pos + 2]) + RTCM3_CRC_LEN;
+        if (pos + n > len) {
+            break;
+        }
+        obsmon_frame(mon, &buf[pos], n);
+        pos += n;
+    }
+}
+
+/**
+ * @brief 向摘要行追加格式化文本（放不下时截断，由调用方检查）
+ */
+static int obsmon_append(char *line, int pos, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static int obsmon_append(char *line, int pos, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (pos >= OBSMON_LINE_MAX) {
+        return pos;
+    }
+    va_start(ap, fmt);
+    int n = vsnprintf(&line[pos], OBSMON_LINE_MAX - pos, fmt, ap);
+    va_end(ap);
+    return n < 0 ? pos : pos + n;
+}
+
+/**
+ * @brief 输出一个卫星系统的摘要：卫星数和每个信号的平均/最低载噪比、最弱卫星和周跳数
+ * @param mon 监测状态
+ * @param sys 卫星系统
+ * @param t 摘要时间（UTC秒）
+ * @param line 输出缓冲区（OBSMON_LINE_MAX）
+ * @return 长度，放不下时返回-1
+ */
+static int obsmon_sys_line(const struct obsmon *mon, int sys, uint64_t t, char *line)
+{
+    const struct obsmon_sys *s = &mon->sys[sys];
+    int pos = 0;
+
+    pos = obsmon_append(line, pos, "{\"t\":%llu,\"sys\":\"%s\",\"epochs\":%u,\"sats\":%d,\"sats_min\":%d,"
+                        "\"sats_max\":%d,\"sig\":[", (unsigned long long)t, obsmon_sys_names[sys], s->epochs,
+                        s->sats, s->sats_min, s->sats_max);
+
+    int first = 1;
+    for (int k = 0; k < OBSMON_SIGS && s->sig_id[k] != 0; k++) {
+        uint64_t sum = 0, count = 0;
+        unsigned int slips = 0;
+        int sats = 0, weak = -1;
+        double weak_cnr = 0;
+
+        for (int sat = 0; sat < MSM_MAX_SATS; sat++) {
+            const struct obsmon_cell *c = &s->cells[sat][k];
+            slips += c->slips;
+            if (c->cnr_count == 0) {
+                continue;
+            }
+            double mean = (double)c->cnr_sum / c->cnr_count;
+            if (weak < 0 || mean < weak_cnr) {
+                weak = sat;
+                weak_cnr = mean;
+            }
+            sum += c->cnr_sum;
+            count += c->cnr_count;
+            sats++;
+        }
+        if (sats == 0 && slips == 0) {
+            continue;
+        }
+
+        pos = obsmon_append(line, pos, "%s{\"id\":%d,\"sats\":%d,\"slips\":%u", first ? "" : ",",
+                            s->sig_id[k], sats, slips);
+        if (sats > 0) {
+            pos = obsmon_append(line, pos, ",\"cnr\":%.1f,\"min\":%.1f,\"weak\":\"%c%02d\"",
+                                (double)sum / count / 16, weak_cnr / 16, obsmon_sys_prefix[sys], weak + 1);
+        }
+        pos = obsmon_append(line, pos, "}");
+        first = 0;
+    }
+
+    pos = obsmon_append(line, pos, "]");
+    if (s->extra_cells > 0) {
+        pos = obsmon_append(line, pos, ",\"extra_cells\":%u", s->extra_cells);
+    }
+    pos = obsmon_append(line, pos, "}\n");
+    return pos < OBSMON_LINE_MAX ? pos : -1;
+}
+
+/**
+ * @brief 输出本周期的摘要并清零周期统计：先输出一行历元完整性，再每个出现过的卫星系统一行
+ * @param mon 监测状态
+ * @param wall_ns 摘要时间（系统时钟纳秒）
+ * @param emit 输出回调
+ * @param arg 回调参数
+ * @return 输出的行数
+ */
+int obsmon_report(struct obsmon *mon, uint64_t wall_ns, obsmon_line_fn emit, void *arg)
+{
+    char line[OBSMON_LINE_MAX];
+    char systems[RTCM_SYS_COUNT + 1];
+    uint64_t t = wall_ns / 1000000000ULL;
+    int lines = 0, n = 0;
+
+    for (int i = 0; i < RTCM_SYS_COUNT; i++) {
+        if (mon->sys[i].epochs > 0) {
+            systems[n++] = obsmon_sys_prefix[i];
+        }
+    }
+    systems[n] = '\0';
+
+    int len = snprintf(line, sizeof(line), "{\"t\":%llu,\"epochs\":%u,\"incomplete\":%u,\"missing_sys\":%u,"
+                       "\"sats\":%d,\"systems\":\"%s\"}\n", (unsigned long long)t, mon->epochs,
+                       mon->incomplete, mon->missing, mon->sats, systems);
+    if (len > 0 && len < (int)sizeof(line)) {
+        emit(line, len, arg);
+        lines++;
+    }
+
+    for (int i = 0; i < RTCM_SYS_COUNT; i++) {
+        struct obsmon_sys *s = &mon->sys[i];
+        if (s->epochs == 0) {
+            continue;
+        }
+        len = obsmon_sys_line(mon, i, t, line);
+        if (len > 0) {
+            emit(line, len, arg);
+            lines++;
+        }
+
+        // 清零周期统计，锁定时间和上次观测的历元保留，周跳检测跨周期连续
+        for (int sat = 0; sat < MSM_MAX_SATS; sat++) {
+            for (int k = 0; k < OBSMON_SIGS; k++) {
+                s->cells[sat][k].cnr_sum = 0;
+                s->cells[sat][k].cnr_count = 0;
+                s->cells[sat][k].slips = 0;
+            }
+        }
+        s->epochs = 0;
+        s->sats_min = 0;
+        s->sats_max = 0;
+        s->extra_cells = 0;
+    }
+    mon->epochs = 0;
+    mon->incomplete = 0;
+    mon->missing = 0;
+    return lines;
+}
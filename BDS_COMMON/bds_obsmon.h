@@ -0,0 +1,76 @@
+/*
+ * bds_obsmon.h
+ * 观测质量监测头文件
+ * 功能：从转发过的MSM观测电文中逐历元累计各卫星系统、卫星和信号的载噪比、锁定时间回退（周跳或失锁）、
+ *       卫星数和历元完整性，按周期输出紧凑的摘要；每颗卫星每个信号的状态大小固定，不随运行时间增长
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_OBSMON_H
+#define BDS_OBSMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include "bds_rtcm.h"
+#include "bds_msm.h"
+
+// 监测配置
+#define OBSMON_SIGS         4       // 每个卫星系统统计的信号数（按首次出现分配，之后的信号只计数）
+#define OBSMON_GAP_EPOCHS   10      // 中断不超过该历元数时，锁定时间回退计为周跳；更久的视为重新捕获
+#define OBSMON_INTERVAL_S   10      // 默认摘要周期（秒）
+#define OBSMON_LINE_MAX     512     // 一条摘要的长度上限
+
+// 一颗卫星的一个信号（16字节）
+struct obsmon_cell {
+    uint32_t lock_ms;          // 上次观测的最短锁定时间（毫秒）
+    uint32_t last_epoch;       // 上次观测的历元序号，0表示没有观测
+    uint32_t cnr_sum;          // 本周期载噪比之和（1/16 dB-Hz）
+    uint16_t cnr_count;        // 本周期有效载噪比的个数
+    uint16_t slips;            // 本周期锁定时间回退次数
+};
+
+// 一个卫星系统
+struct obsmon_sys {
+    uint8_t sig_id[OBSMON_SIGS];    // 各信号槽位的MSM信号号，0表示未分配
+    uint32_t epoch;                 // 当前历元的历元时间（同一历元可能分成多条电文）
+    uint64_t sat_mask;              // 当前历元已出现的卫星
+    int sats;                       // 最近一个历元的卫星数
+    int sats_min;                   // 本周期最少卫星数
+    int sats_max;                   // 本周期最多卫星数
+    uint32_t epochs;                // 本周期出现该系统的历元数
+    uint32_t extra_cells;           // 本周期因信号槽位用完未统计的单元数
+    struct obsmon_cell cells[MSM_MAX_SATS][OBSMON_SIGS];
+};
+
+// 观测质量监测状态
+struct obsmon {
+    struct obsmon_sys sys[RTCM_SYS_COUNT];
+    uint32_t epoch_seq;        // 历元序号（从1开始）
+    unsigned int open_mask;    // 当前历元已出现的卫星系统，0表示没有未结束的历元
+    unsigned int last_mask;    // 上一个历元的卫星系统
+    uint32_t epochs;           // 本周期历元数
+    uint32_t incomplete;       // 本周期末条电文未到、被下一历元结束的历元数
+    uint32_t missing;          // 本周期比上一历元少了卫星系统的历元数
+    uint64_t epochs_total;     // 累计历元数
+    uint64_t incomplete_total; // 累计不完整历元数
+    uint64_t missing_total;    // 累计缺少卫星系统的历元数
+    uint64_t slips_total;      // 累计锁定时间回退次数
+    uint64_t errors_total;     // 累计无法解码的MSM电文数
+    int sats;                  // 最近一个历元各系统的卫星数之和
+    struct msm_obs obs;        // 解码缓冲区
+};
+
+// 摘要输出回调：每次一行（以换行结尾）
+typedef void (*obsmon_line_fn)(const char *line, int len, void *arg);
+
+// 函数声明
+void obsmon_init(struct obsmon *mon);
+void obsmon_push(struct obsmon *mon, const unsigned char *buf, int len);
+int obsmon_report(struct obsmon *mon, uint64_t wall_ns, obsmon_line_fn emit, void *arg);
+
+#endif /* BDS_OBSMON_H */
@@ -0,0 +1,299 @@
+/*
+ * bds_pool.c
+ * 固定内存池源文件
+ * 功能：启动时分配并登记全部内存池，封存后输出内存预算、检查预算上限，之后拒绝再分配
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_pool.h"
+
+// 进程静态数据区（.data和.bss）的起止位置，由链接器提供
+extern char __data_start[];
+extern char _end[];
+
+// 预算表中的一项
+struct pool_item {
+    const char *owner;         // 所属模块
+    const char *name;          // 用途
+    size_t unit;               // 单个大小
+    size_t count;              // 个数
+    size_t bytes;              // 实际占用（含对齐或按页取整）
+    enum pool_kind kind;       // 计费方式
+    void *ptr;                 // pool_alloc分配的池，NULL表示只登记
+    int in_static;             // 位于静态数据区，从“其他静态数据”中扣除
+};
+
+// 预算表只在主线程初始化期间修改
+static struct pool_item pool_items[POOL_MAX_ITEMS];
+static int pool_count = 0;
+static int pool_sealed = 0;
+
+static const char *pool_kind_names[] = { "shared", "per connection", "queue" };
+
+/**
+ * @brief 登记一项
+ * @return 成功返回条目，预算表已满返回NULL
+ */
+static struct pool_item *pool_add(const char *owner, const char *name, size_t unit, size_t count,
+                                  size_t bytes, enum pool_kind kind)
+{
+    if (pool_count == POOL_MAX_ITEMS) {
+        fprintf(stderr, "pool table full, %s %s not recorded\n", owner, name);
+        return NULL;
+    }
+
+    struct pool_item *it = &pool_items[pool_count++];
+    it->owner = owner;
+    it->name = name;
+    it->unit = unit;
+    it->count = count;
+    it->bytes = bytes;
+    it->kind = kind;
+    it->ptr = NULL;
+    it->in_static = 0;
+    return it;
+}
+
+/**
+ * @brief 分配一个内存池（清零）并登记到预算表，只能在pool_seal之前调用
+ * @param owner 所属模块
+ * @param name 用途
+ * @param unit 单个大小
+ * @param count 个数
+ * @param kind 计费方式
+ * @return 成功返回池地址（不小于一页时按页对齐，否则按缓存行对齐），失败返回NULL
+ */
+void *pool_alloc(const char *owner, const char *name, size_t unit, size_t count, enum pool_kind kind)
+{
+    void *p = NULL;
+
+    if (pool_sealed) {
+        fprintf(stderr, "pool allocation after startup refused: %s %s\n", owner, name);
+        errno = EPERM;
+        return NULL;
+    }
+    if (unit == 0 || count == 0 || count > SIZE_MAX / unit) {
+        fprintf(stderr, "invalid pool size: %s %s\n", owner, name);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t len = unit * count;
+#ifdef BDS_STATIC_MEMORY
+    // 静态内存构建：每个池独占匿名映射，进程不引用malloc
+    len = (len + POOL_PAGE_SIZE - 1) & ~(size_t)(POOL_PAGE_SIZE - 1);
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("pool mmap failed");
+        return NULL;
+    }
+#else
+    int err = posix_memalign(&p, len >= POOL_PAGE_SIZE ? POOL_PAGE_SIZE : POOL_ALIGN, len);
+    if (err != 0) {
+        errno = err;
+        perror("pool alloc failed");
+        return NULL;
+    }
+    memset(p, 0, len);
+#endif
+
+    struct pool_item *it = pool_add(owner, name, unit, count, len, kind);
+    if (it == NULL) {
+#ifdef BDS_STATIC_MEMORY
+        munmap(p, len);
+#else
+        free(p);
+#endif
+        errno = ENOMEM;
+        return NULL;
+    }
+    it->ptr = p;
+    return p;
+}
+
+/**
+ * @brief 登记不经过pool_alloc的内存（静态数据区中的上下文和槽位、共享内存和文件映射）
+ * @param owner 所属模块
+ * @param name 用途
+ * @param addr 内存地址（位于静态数据区时从“其他静态数据”中扣除，避免重复计入）
+ * @param unit 单个大小
+ * @param count 个数
+ * @param kind 计费方式
+ */
+void pool_account(const char *owner, const char *name, const void *addr, size_t unit, size_t count,
+                  enum pool_kind kind)
+{
+    struct pool_item *it = pool_add(owner, name, unit, count, unit * count, kind);
+    if (it != NULL) {
+        it->in_static = (const char *)addr >= __data_start && (const char *)addr < _end;
+    }
+}
+
+/**
+ * @brief 释放pool_alloc分配的池并从预算表中移除（只在启动失败和退出时调用）
+ * @param p 池地址，NULL时忽略
+ */
+void pool_free(void *p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < pool_count; i++) {
+        if (pool_items[i].ptr != p) {
+            continue;
+        }
+#ifdef BDS_STATIC_MEMORY
+        munmap(p, pool_items[i].bytes);
+#else
+        free(p);
+#endif
+        pool_items[i] = pool_items[--pool_count];
+        return;
+    }
+    fprintf(stderr, "pool_free: %p is not a pool\n", p);
+}
+
+/**
+ * @brief 分配固定大小块池（块和空闲编号栈各占一个池）
+ * @param bp 块池
+ * @param owner 所属模块
+ * @param name 用途
+ * @param size 每块大小
+ * @param count 块数
+ * @return 成功返回0，失败返回-1
+ */
+int pool_blocks_init(struct pool_blocks *bp, const char *owner, const char *name, size_t size, int count)
+{
+    memset(bp, 0, sizeof(*bp));
+    if (count <= 0) {
+        return 0;
+    }
+
+    bp->base = pool_alloc(owner, name, size, count, POOL_QUEUE);
+    bp->free_ids = pool_alloc(owner, "queue block free list", sizeof(int), count, POOL_SHARED);
+    if (bp->base == NULL || bp->free_ids == NULL) {
+        pool_blocks_free(bp);
+        return -1;
+    }
+
+    // 编号从小到大出栈
+    for (int i = 0; i < count; i++) {
+        bp->free_ids[i] = count - 1 - i;
+    }
+    bp->free_count = count;
+    bp->low = count;
+    bp->count = count;
+    bp->size = size;
+    return 0;
+}
+
+/**
+ * @brief 释放块池
+ * @param bp 块池
+ */
+void pool_blocks_free(struct pool_blocks *bp)
+{
+    pool_free(bp->base);
+    pool_free(bp->free_ids);
+    memset(bp, 0, sizeof(*bp));
+}
+
+/**
+ * @brief 当前预算合计（已登记的池加上进程静态数据区）
+ * @return 字节数
+ */
+size_t pool_total(void)
+{
+    size_t total = (size_t)(_end - __data_start);
+
+    for (int i = 0; i < pool_count; i++) {
+        if (!pool_items[i].in_static) {
+            total += pool_items[i].bytes;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief 读取进程实际锁定的内存（/proc/self/smaps_rollup中的Locked，VmLck还包括未映射页的保留区）
+ * @return KB，未锁定或读取失败返回0
+ */
+static size_t pool_locked_kb(void)
+{
+    char line[128];
+    size_t kb = 0;
+
+    FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "Locked: %zu kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+/**
+ * @brief 初始化结束：输出内存预算（每项、合计和每个连接的开销），检查预算上限，之后拒绝再分配
+ * @param pipeline 流水线名称
+ * @param budget_kb 预算上限（KB），0表示不检查
+ * @return 未超出预算返回0，超出返回-1（调用方应退出）
+ */
+int pool_seal(const char *pipeline, size_t budget_kb)
+{
+    size_t static_bytes = (size_t)(_end - __data_start);
+
+#ifdef BDS_STATIC_MEMORY
+    printf("Memory budget for %s (static memory build):\n", pipeline);
+#else
+    printf("Memory budget for %s:\n", pipeline);
+#endif
+    printf("  %-8s %-30s %10s %8s %12s  %s\n", "owner", "item", "unit", "count", "bytes", "kind");
+    for (int i = 0; i < pool_count; i++) {
+        const struct pool_item *it = &pool_items[i];
+        printf("  %-8s %-30s %10zu %8zu %12zu  %s\n", it->owner, it->name, it->unit, it->count, it->bytes,
+               pool_kind_names[it->kind]);
+        if (it->in_static) {
+            static_bytes -= it->bytes < static_bytes ? it->bytes : static_bytes;
+        }
+    }
+    printf("  %-8s %-30s %10s %8s %12zu  %s\n", "process", "other static data", "", "", static_bytes,
+           pool_kind_names[POOL_SHARED]);
+
+    size_t total = pool_total();
+    printf("  total %zu bytes (%.1f KB)\n", total, total / 1024.0);
+
+    // 实时模式下mlockall锁定的全部内存：预算之外还有代码段、共享库和各线程的栈
+    size_t locked_kb = pool_locked_kb();
+    if (locked_kb > 0) {
+        printf("  locked by mlockall %zu KB (including code, libraries and thread stacks)\n", locked_kb);
+    }
+
+    // 每个连接：槽位固定占用，积压时再从共享队列块中取用
+    for (int i = 0; i < pool_count; i++) {
+        const struct pool_item *it = &pool_items[i];
+        if (it->kind == POOL_PER_CONN) {
+            printf("  per connection: %s %s %zu bytes (%zu slots)\n", it->owner, it->name, it->unit, it->count);
+        } else if (it->kind == POOL_QUEUE) {
+            printf("  per backlogged connection: +%zu bytes %s %s (%zu shared)\n", it->unit, it->owner, it->name,
+                   it->count);
+        }
+    }
+
+    pool_sealed = 1;
+    if (budget_kb == 0) {
+        return 0;
+    }
+    if (total > budget_kb * 1024) {
+        fprintf(stderr, "memory budget exceeded: %s needs %zu KB, budget is %zu KB\n", pipeline,
+                (total + 1023) / 1024, budget_kb);
+        return -1;
+    }
+    printf("  within budget of %zu KB\n", budget_kb);
+    return 0;
+}
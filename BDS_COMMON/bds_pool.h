@@ -0,0 +1,83 @@
+/*
+ * bds_pool.h
+ * 固定内存池头文件
+ * 功能：启动时按配置一次性分配全部缓冲区、队列和连接槽位，逐项登记到内存预算表；
+ *       初始化结束后封存（pool_seal），输出每条流水线和每个连接的内存预算，超出预算时启动失败，
+ *       之后不再分配内存。静态内存构建（BDS_STATIC_MEMORY）下池直接用mmap映射，不经过malloc
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_POOL_H
+#define BDS_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+// 内存池配置
+#define POOL_MAX_ITEMS   64        // 预算表最多登记的条目数
+#define POOL_ALIGN       64        // 小于一页的池按缓存行对齐
+#define POOL_PAGE_SIZE   4096      // 不小于一页的池按页对齐（静态内存构建下所有池按页取整）
+
+// 预算条目的计费方式
+enum pool_kind {
+    POOL_SHARED = 0,           // 整条流水线一份
+    POOL_PER_CONN,             // 每个连接槽位一份（count为槽位数）
+    POOL_QUEUE                 // 连接之间共享、积压时按需取用的队列块
+};
+
+// 固定大小块池（空闲块编号栈，取用和归还都是O(1)，不分配内存）
+struct pool_blocks {
+    unsigned char *base;       // 全部块的连续内存
+    int *free_ids;             // 空闲块编号栈
+    int free_count;            // 空闲块数
+    int low;                   // 空闲块数的最低值（峰值占用 = count - low）
+    int count;                 // 块数
+    size_t size;               // 每块大小
+};
+
+// 函数声明
+void *pool_alloc(const char *owner, const char *name, size_t unit, size_t count, enum pool_kind kind);
+void pool_account(const char *owner, const char *name, const void *addr, size_t unit, size_t count,
+                  enum pool_kind kind);
+void pool_free(void *p);
+int pool_blocks_init(struct pool_blocks *bp, const char *owner, const char *name, size_t size, int count);
+void pool_blocks_free(struct pool_blocks *bp);
+int pool_seal(const char *pipeline, size_t budget_kb);
+size_t pool_total(void);
+
+/**
+ * @brief 取一个空闲块
+ * @param bp 块池
+ * @return 块地址，池已用完返回NULL
+ */
+static inline unsigned char *pool_block_get(struct pool_blocks *bp)
+{
+    if (bp->free_count == 0) {
+        return NULL;
+    }
+    int id = bp->free_ids[--bp->free_count];
+    if (bp->free_count < bp->low) {
+        bp->low = bp->free_count;
+    }
+    return bp->base + (size_t)id * bp->size;
+}
+
+/**
+ * @brief 归还一个块
+ * @param bp 块池
+ * @param block pool_block_get返回的块，NULL时忽略
+ */
+static inline void pool_block_put(struct pool_blocks *bp, unsigned char *block)
+{
+    if (block != NULL) {
+        bp->free_ids[bp->free_count++] = (int)((size_t)(block - bp->base) / bp->size);
+    }
+}
+
+#endif /* BDS_POOL_H */
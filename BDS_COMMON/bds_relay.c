@@ -0,0 +1,498 @@
+/*
+ * bds_relay.c
+ * 下游转发源文件
+ * 功能：接受流动站客户端连接，非阻塞广播差分数据，慢客户端排队超限后断开
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_relay.h"
+
+// 运行指标编号（客户端数量可达上万，连接和断开只计数，不逐个打印）
+static int m_clients = -1;
+static int m_accepts = -1;
+static int m_rejects = -1;
+static int m_disconnects = -1;
+static int m_slow_disconnects = -1;
+static int m_queue_exhausted = -1;
+static int m_queue_blocks = -1;
+static int m_out_bytes = -1;
+static int m_queue_max = -1;
+
+/**
+ * @brief 注册下游转发运行指标
+ */
+static void relay_metrics_init(void)
+{
+    m_clients = metrics_register("bds_relay_clients",
+                                 "Connected downstream clients", METRIC_GAUGE);
+    m_accepts = metrics_register("bds_relay_accepts_total",
+                                 "Accepted downstream connections", METRIC_COUNTER);
+    m_rejects = metrics_register("bds_relay_rejects_total",
+                                 "Downstream connections refused at the client limit", METRIC_COUNTER);
+    m_disconnects = metrics_register("bds_relay_disconnects_total",
+                                     "Closed downstream connections", METRIC_COUNTER);
+    m_slow_disconnects = metrics_register("bds_relay_slow_disconnects_total",
+                                          "Downstream clients dropped because their queue overflowed",
+                                          METRIC_COUNTER);
+    m_queue_exhausted = metrics_register("bds_relay_queue_exhausted_total",
+                                         "Downstream clients dropped because every send queue block was in use",
+                                         METRIC_COUNTER);
+    m_queue_blocks = metrics_register("bds_relay_queue_blocks_max",
+                                      "Most send queue blocks in use at once", METRIC_GAUGE_MAX);
+    m_out_bytes = metrics_register("bds_relay_out_bytes_total",
+                                   "Bytes sent to downstream clients", METRIC_COUNTER);
+    m_queue_max = metrics_register("bds_relay_queued_bytes_max",
+                                   "Largest per-client send queue", METRIC_GAUGE_MAX);
+}
+
+/**
+ * @brief 创建下游监听socket（非阻塞）
+ * @param port 监听端口号
+ * @param shared 非0时设置SO_REUSEPORT，多个分片各自监听同一端口，由内核分配新连接
+ * @return 成功返回socket描述符，失败返回-1
+ */
+int relay_listen(int port, int shared)
+{
+    int sock_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock_fd < 0) {
+        perror("relay socket creation failed");
+        return -1;
+    }
+
+    int opt = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("relay setsockopt failed");
+        close(sock_fd);
+        return -1;
+    }
+    if (shared && setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("relay SO_REUSEPORT failed");
+        close(sock_fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("relay bind failed");
+        close(sock_fd);
+        return -1;
+    }
+
+    if (listen(sock_fd, RELAY_BACKLOG) < 0) {
+        perror("relay listen failed");
+        close(sock_fd);
+        return -1;
+    }
+
+    return sock_fd;
+}
+
+/**
+ * @brief 修改客户端关注的epoll事件（有积压时才关注可写）
+ * @param r 转发状态
+ * @param id 客户端编号
+ */
+static void relay_watch(struct relay *r, int id)
+{
+    struct relay_client *c = &r->clients[id];
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)id };
+
+    if (c->out_len > 0) {
+        ev.events |= EPOLLOUT;
+    }
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) < 0) {
+        log_errno("relay epoll_ctl failed");
+    }
+}
+
+/**
+ * @brief 关闭客户端连接并回收编号
+ * @param r 转发状态
+ * @param id 客户端编号
+ */
+static void relay_drop(struct relay *r, int id)
+{
+    struct relay_client *c = &r->clients[id];
+
+    // 关闭描述符时内核自动把它移出epoll
+    close(c->fd);
+    c->fd = -1;
+    c->out_len = 0;
+    c->out_off = 0;
+    pool_block_put(&r->queues, c->out_buf);
+    c->out_buf = NULL;
+
+    // 活动列表末尾的客户端填到空位，保持紧凑
+    int last = r->active[r->count - 1];
+    r->active[c->pos] = last;
+    r->clients[last].pos = c->pos;
+    r->count--;
+    r->free_ids[r->free_count++] = id;
+
+    metrics_inc(m_disconnects);
+    metrics_set(m_clients, r->count);
+}
+
+/**
+ * @brief 接受所有排队的新连接
+ * @param r 转发状态
+ */
+static void relay_accept(struct relay *r)
+{
+    while (1) {
+        int fd = accept4(r->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_errno("relay accept failed");
+            }
+            return;
+        }
+
+        if (r->free_count == 0) {
+            metrics_inc(m_rejects);
+            close(fd);
+            continue;
+        }
+
+        // 差分电文小而频繁，关闭Nagle算法避免攒包延迟
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        int id = r->free_ids[--r->free_count];
+        struct relay_client *c = &r->clients[id];
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)id };
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            log_errno("relay epoll_ctl failed");
+            r->free_ids[r->free_count++] = id;
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->out_len = 0;
+        c->out_off = 0;
+        c->pos = r->count;
+        r->active[r->count++] = id;
+
+        metrics_inc(m_accepts);
+        metrics_set(m_clients, r->count);
+
+        // 加入时先发的数据排在所有广播之前（回调中发送失败时客户端已被关闭）
+        if (r->on_join != NULL) {
+            r->on_join(r, id, r->join_arg);
+        }
+    }
+}
+
+/**
+ * @brief 创建下游转发（接管监听socket），客户端槽位和待发队列块一次分配
+ * @param listen_fd 非阻塞监听socket（relay_listen创建或热升级时接管）
+ * @param max_clients 最大客户端数，受进程描述符上限约束
+ * @param queue_blocks 待发队列块数，即同时积压的客户端数上限
+ * @return 成功返回转发状态，失败返回NULL（监听socket已关闭）
+ */
+struct relay *relay_start(int listen_fd, int max_clients, int queue_blocks)
+{
+    static int metrics_ready = 0;
+    struct rlimit rl;
+
+    if (!metrics_ready) {
+        relay_metrics_init();
+        metrics_ready = 1;
+    }
+
+    // 每个客户端占用一个描述符：软上限提到硬上限，客户端数留出余量
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+        if (rl.rlim_cur != RLIM_INFINITY && (rlim_t)max_clients + 64 > rl.rlim_cur) {
+            max_clients = rl.rlim_cur > 128 ? (int)rl.rlim_cur - 64 : 64;
+            fprintf(stderr, "Warning: relay limited to %d clients by RLIMIT_NOFILE\n", max_clients);
+        }
+    }
+    if (queue_blocks > max_clients) {
+        queue_blocks = max_clients;
+    }
+
+    struct relay *r = pool_alloc("relay", "relay state", sizeof(*r), 1, POOL_SHARED);
+    if (r == NULL) {
+        close(listen_fd);
+        return NULL;
+    }
+    r->listen_fd = listen_fd;
+    r->max_clients = max_clients;
+    r->clients = pool_alloc("relay", "client slot", sizeof(*r->clients) + 2 * sizeof(int), max_clients,
+                            POOL_PER_CONN);
+    if (r->clients != NULL) {
+        // 先把槽位全部标为空闲，后续初始化失败时relay_stop不会去关闭描述符0
+        for (int i = 0; i < max_clients; i++) {
+            r->clients[i].fd = -1;
+        }
+    }
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->clients == NULL || pool_blocks_init(&r->queues, "relay", "send queue block", RELAY_QUEUE_SIZE,
+                                               queue_blocks) != 0 || r->epoll_fd < 0) {
+        perror("relay setup failed");
+        relay_stop(r);
+        return NULL;
+    }
+
+    // 活动列表和空闲编号栈与客户端槽位放在同一个池中
+    r->active = (int *)&r->clients[max_clients];
+    r->free_ids = r->active + max_clients;
+
+    // 编号从小到大出栈
+    for (int i = 0; i < max_clients; i++) {
+        r->free_ids[i] = max_clients - 1 - i;
+    }
+    r->free_count = max_clients;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = RELAY_LISTEN_TAG };
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        log_errno("relay epoll_ctl failed");
+        relay_stop(r);
+        return NULL;
+    }
+
+    metrics_set(m_clients, 0);
+    return r;
+}
+
+/**
+ * @brief 客户端可写时发送待发队列中的数据
+ * @param r 转发状态
+ * @param id 客户端编号
+ */
+static void relay_flush(struct relay *r, int id)
+{
+    struct relay_client *c = &r->clients[id];
+
+    while (c->out_len > 0) {
+        int n = send(c->fd, &c->out_buf[c->out_off], c->out_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            relay_drop(r, id);
+            return;
+        }
+        metrics_add(m_out_bytes, n);
+        c->out_off += n;
+        c->out_len -= n;
+    }
+
+    // 队列发完即归还，块池只需容纳同时积压的客户端
+    c->out_off = 0;
+    pool_block_put(&r->queues, c->out_buf);
+    c->out_buf = NULL;
+    relay_watch(r, id);
+}
+
+/**
+ * @brief 读取并丢弃客户端发来的数据（如GGA），发现对端关闭
+ * @param r 转发状态
+ * @param id 客户端编号
+ */
+static void relay_read(struct relay *r, int id)
+{
+    unsigned char buf[512];
+
+    while (1) {
+        ssize_t n = recv(r->clients[id].fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        relay_drop(r, id);
+        return;
+    }
+}
+
+/**
+ * @brief 处理所有待处理的epoll事件（不阻塞），在epoll_fd可读时调用
+ * @param r 转发状态
+ */
+void relay_poll(struct relay *r)
+{
+    struct epoll_event events[RELAY_MAX_EVENTS];
+
+    int n = epoll_wait(r->epoll_fd, events, RELAY_MAX_EVENTS, 0);
+    for (int i = 0; i < n; i++) {
+        uint32_t id = events[i].data.u32;
+        if (id == RELAY_LISTEN_TAG) {
+            relay_accept(r);
+            continue;
+        }
+
+        // 同一批事件中该客户端可能已被关闭
+        if (r->clients[id].fd < 0) {
+            continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+            relay_flush(r, id);
+        }
+        if (r->clients[id].fd >= 0 && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+            relay_read(r, id);
+        }
+    }
+}
+
+/**
+ * @brief 向一个客户端发送数据，发不完的部分排队
+ * @param r 转发状态
+ * @param id 客户端编号
+ * @param buf 数据
+ * @param len 数据长度
+ */
+static void relay_send(struct relay *r, int id, const unsigned char *buf, int len)
+{
+    struct relay_client *c = &r->clients[id];
+    int sent = 0;
+
+    // 队列非空时直接排在队尾，保持顺序
+    if (c->out_len == 0) {
+        sent = send(c->fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                relay_drop(r, id);
+                return;
+            }
+            sent = 0;
+        }
+        metrics_add(m_out_bytes, sent);
+        if (sent == len) {
+            return;
+        }
+    }
+
+    // 排队放不下时断开：丢弃中间的数据会让流动站收到拼接错误的电文
+    int remain = len - sent;
+    if (c->out_len + remain > RELAY_QUEUE_SIZE) {
+        metrics_inc(m_slow_disconnects);
+        relay_drop(r, id);
+        return;
+    }
+
+    // 块池用完时同样断开：运行中不再分配内存
+    if (c->out_buf == NULL) {
+        c->out_buf = pool_block_get(&r->queues);
+        if (c->out_buf == NULL) {
+            metrics_inc(m_queue_exhausted);
+            relay_drop(r, id);
+            return;
+        }
+        metrics_max(m_queue_blocks, r->queues.count - r->queues.free_count);
+    }
+    if (c->out_off + c->out_len + remain > RELAY_QUEUE_SIZE) {
+        memmove(c->out_buf, &c->out_buf[c->out_off], c->out_len);
+        c->out_off = 0;
+    }
+
+    int was_empty = (c->out_len == 0);
+    memcpy(&c->out_buf[c->out_off + c->out_len], buf + sent, remain);
+    c->out_len += remain;
+    metrics_max(m_queue_max, c->out_len);
+    if (was_empty) {
+        relay_watch(r, id);
+    }
+}
+
+/**
+ * @brief 把数据广播给所有客户端
+ * @param r 转发状态，NULL时忽略
+ * @param buf 数据
+ * @param len 数据长度
+ */
+void relay_broadcast(struct relay *r, const void *buf, int len)
+{
+    if (r == NULL || len <= 0) {
+        return;
+    }
+
+    // 从后往前遍历：关闭客户端时由末尾的客户端补位，不会漏掉
+    for (int i = r->count - 1; i >= 0; i--) {
+        relay_send(r, r->active[i], buf, len);
+    }
+}
+
+/**
+ * @brief 只向一个客户端发送数据（在加入回调中调用）
+ * @param r 转发状态
+ * @param id 客户端编号
+ * @param buf 数据
+ * @param len 数据长度
+ */
+void relay_send_to(struct relay *r, int id, const void *buf, int len)
+{
+    if (len <= 0 || r->clients[id].fd < 0) {
+        return;
+    }
+    relay_send(r, id, buf, len);
+}
+
+/**
+ * @brief 设置新客户端加入回调
+ * @param r 转发状态
+ * @param cb 回调，NULL表示取消
+ * @param arg 回调参数
+ */
+void relay_set_join(struct relay *r, relay_join_cb cb, void *arg)
+{
+    r->on_join = cb;
+    r->join_arg = arg;
+}
+
+/**
+ * @brief 断开全部客户端（保留监听socket），用于客户端已经少收数据、只能重连的场合
+ * @param r 转发状态
+ */
+void relay_drop_all(struct relay *r)
+{
+    while (r->count > 0) {
+        relay_drop(r, r->active[r->count - 1]);
+    }
+}
+
+/**
+ * @brief 关闭所有客户端连接和监听socket，释放转发状态
+ * @param r 转发状态，NULL时忽略
+ */
+void relay_stop(struct relay *r)
+{
+    if (r == NULL) {
+        return;
+    }
+
+    if (r->clients != NULL) {
+        for (int i = 0; i < r->max_clients; i++) {
+            if (r->clients[i].fd >= 0) {
+                close(r->clients[i].fd);
+            }
+        }
+    }
+    if (r->epoll_fd >= 0) {
+        close(r->epoll_fd);
+    }
+    if (r->listen_fd >= 0) {
+        close(r->listen_fd);
+    }
+    pool_blocks_free(&r->queues);
+    pool_free(r->clients);
+    pool_free(r);
+}
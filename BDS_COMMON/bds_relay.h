@@ -0,0 +1,77 @@
+/*
+ * bds_relay.h
+ * 下游转发头文件
+ * 功能：接受大量流动站客户端连接，把收到的差分数据原样广播给所有客户端；
+ *       内部使用一个epoll描述符，可嵌入调用方的poll/epoll循环，慢客户端排队超限后断开
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_RELAY_H
+#define BDS_RELAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "bds_metrics.h"
+#include "bds_pool.h"
+#include "bds_log.h"
+
+// 转发配置
+#define RELAY_MAX_CLIENTS   16384               // 最大客户端数
+#define RELAY_QUEUE_SIZE    (32 * 1024)         // 每个客户端的待发队列，放不下时断开该客户端
+#define RELAY_QUEUE_BLOCKS  1024                // 待发队列块数（客户端积压时取用，清空后归还）
+#define RELAY_BACKLOG       4096                // 监听队列长度（大量客户端同时重连）
+#define RELAY_MAX_EVENTS    256                 // 每次处理的epoll事件数
+#define RELAY_LISTEN_TAG    UINT32_MAX          // 监听socket在epoll中的标记
+
+// 客户端状态
+struct relay_client {
+    int fd;                    // 连接描述符，-1表示空闲
+    int pos;                   // 在活动列表中的位置
+    int out_len;               // 待发数据长度
+    int out_off;               // 待发数据起点
+    unsigned char *out_buf;    // 待发队列（积压时从队列块池取用，发完归还），NULL表示没有积压
+};
+
+struct relay;
+
+// 新客户端加入回调（可用relay_send_to先发给它一些数据，如静态电文快照）
+typedef void (*relay_join_cb)(struct relay *r, int id, void *arg);
+
+// 转发状态
+struct relay {
+    int listen_fd;             // 监听socket
+    int epoll_fd;              // 内部epoll描述符（可读表示有事件待处理）
+    int max_clients;
+    int count;                 // 当前客户端数
+    int *active;               // 活动客户端编号（紧凑排列，广播时顺序遍历）
+    int *free_ids;             // 空闲编号栈
+    int free_count;
+    struct relay_client *clients;
+    struct pool_blocks queues; // 待发队列块池（所有客户端共享）
+    relay_join_cb on_join;     // 新客户端加入回调，NULL表示没有
+    void *join_arg;            // 回调参数
+};
+
+// 函数声明
+int relay_listen(int port, int shared);
+struct relay *relay_start(int listen_fd, int max_clients, int queue_blocks);
+void relay_poll(struct relay *r);
+void relay_broadcast(struct relay *r, const void *buf, int len);
+void relay_send_to(struct relay *r, int id, const void *buf, int len);
+void relay_set_join(struct relay *r, relay_join_cb cb, void *arg);
+void relay_drop_all(struct relay *r);
+void relay_stop(struct relay *r);
+
+#endif /* BDS_RELAY_H */
@@ -0,0 +1,151 @@
+/*
+ * bds_ring_cat.c
+ * 共享内存环形缓冲区读取工具
+ * 功能：作为读端示例和调试工具，把流动站程序发布到共享内存的RTCM3帧输出到标准输出，
+ *       定期在标准错误输出记录数、丢失数和从写端收到数据到读出的延迟
+ * 使用：bds_ring_cat [-q] [-n 记录数] [名称] > stream.rtcm3（名称默认bds_sove.ring）
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <signal.h>
+#include <getopt.h>
+
+#include "bds_shmring.h"
+#include "bds_rtcm.h"
+#include "bds_time.h"
+
+#define RING_CAT_DEFAULT_NAME  "bds_sove.ring"
+#define RING_CAT_REPORT_SEC    5                   // 统计输出间隔（秒）
+
+static volatile sig_atomic_t ring_cat_stop = 0;
+
+/**
+ * @brief 退出信号处理
+ * @param sig 信号编号
+ */
+static void ring_cat_signal_handler(int sig)
+{
+    (void)sig;
+    ring_cat_stop = 1;
+}
+
+/**
+ * @brief 写出全部数据
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 成功返回0，失败返回-1
+ */
+static int ring_cat_write(const unsigned char *buf, int len)
+{
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("write failed");
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回1
+ */
+int main(int argc, char *argv[])
+{
+    static unsigned char buf[RTCM3_MAX_FRAME];
+    struct shmring_reader rd;
+    struct shmring_info info;
+    long long limit = 0;
+    int quiet = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "qn:h")) != -1) {
+        switch (c) {
+        case 'q':
+            quiet = 1;
+            break;
+        case 'n':
+            limit = atoll(optarg);
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [-q] [-n records] [name]\n"
+                    "  -q  only print statistics, do not copy frames to stdout\n", argv[0]);
+            return 1;
+        }
+    }
+    const char *name = optind < argc ? argv[optind] : RING_CAT_DEFAULT_NAME;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = ring_cat_signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (shmring_reader_open(&rd, name) != 0) {
+        return 1;
+    }
+
+    unsigned long long records = 0, bytes = 0, lat_sum = 0, lat_max = 0, period = 0;
+    unsigned long long total_lat_sum = 0, total_lat_max = 0;
+    uint64_t next_report = bds_now_ns() + RING_CAT_REPORT_SEC * 1000000000ULL;
+    int ret = 0;
+
+    while (!ring_cat_stop && (limit == 0 || (long long)records < limit)) {
+        int len = shmring_read(&rd, buf, sizeof(buf), &info, 500);
+        uint64_t now = bds_now_ns();
+
+        if (len < 0) {
+            // 写端以不同大小重建了缓冲区：重新打开
+            shmring_reader_close(&rd);
+            if (shmring_reader_open(&rd, name) != 0) {
+                ret = 1;
+                break;
+            }
+            continue;
+        }
+        if (len > 0) {
+            uint64_t lat = now - info.time_ns;
+            records++;
+            period++;
+            bytes += len;
+            lat_sum += lat;
+            total_lat_sum += lat;
+            if (lat > lat_max) {
+                lat_max = lat;
+            }
+            if (lat > total_lat_max) {
+                total_lat_max = lat;
+            }
+            if (!quiet && ring_cat_write(buf, len < (int)sizeof(buf) ? len : (int)sizeof(buf)) != 0) {
+                ret = 1;
+                break;
+            }
+        }
+
+        if (now >= next_report) {
+            fprintf(stderr, "%llu records, %llu bytes, %llu lost, %llu overruns, latency avg %llu max %llu us\n",
+                    records, bytes, (unsigned long long)rd.lost, (unsigned long long)rd.overruns,
+                    period > 0 ? lat_sum / period / 1000 : 0, lat_max / 1000);
+            lat_sum = 0;
+            lat_max = 0;
+            period = 0;
+            next_report = now + RING_CAT_REPORT_SEC * 1000000000ULL;
+        }
+    }
+
+    fprintf(stderr, "Read %llu records, %llu bytes, %llu lost, %llu overruns, latency avg %llu max %llu us\n",
+            records, bytes, (unsigned long long)rd.lost, (unsigned long long)rd.overruns,
+            records > 0 ? total_lat_sum / records / 1000 : 0, total_lat_max / 1000);
+    shmring_reader_close(&rd);
+    return ret;
+}
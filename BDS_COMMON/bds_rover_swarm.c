@@ -0,0 +1,922 @@
+/*
+ * bds_rover_swarm.c
+ * 流动站并发负载测试工具
+ * 功能：本进程扮演基站向流动站程序发送带序号和发送时间的测试电文，同时用epoll打开
+ *       成千上万个下游客户端连接，逐字节核对每个客户端收到的数据，统计每个客户端的
+ *       投递延迟分位数、停顿和断线，用于评估转发主机容量、发现扇出性能退化
+ * 使用：bds_sove -d /dev/null -l 2101 & bds_rover_swarm -n 5000 -t 30（-h查看全部参数）
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "bds_rtcm.h"
+#include "bds_time.h"
+
+// 测试电文：电文号(12) + 保留(4) + 序号(32) + 发送时间(64，单调时钟纳秒) + 按序号生成的填充
+#define SWARM_MSG_TYPE      4095                // 专有电文号，只在测试中使用
+#define SWARM_MSG_HEADER    14                  // 电文头字节数
+#define SWARM_MSG_PAYLOAD   1000                // 单帧最大电文长度
+
+// 测试配置
+#define SWARM_HISTORY       (8 * 1024 * 1024)   // 已发送数据的保留长度（2的幂），用于逐字节核对
+#define SWARM_FRAMES        65536               // 已发送帧的保留个数（2的幂）
+#define SWARM_BASE_QUEUE    (1024 * 1024)       // 基站连接的待发队列
+#define SWARM_TICK_MS       10                  // 定时器周期
+#define SWARM_RETRY_MS      1000                // 断线重连间隔
+#define SWARM_DRAIN_MS      2000                // 停止发送后等待在途数据的时间
+#define SWARM_MAX_EVENTS    512
+#define SWARM_BASE_TAG      UINT32_MAX          // epoll中基站连接的标记
+#define SWARM_TIMER_TAG     (UINT32_MAX - 1)    // epoll中定时器的标记
+#define SWARM_REPORT_WORST  5                   // 结果中列出的最差客户端数
+
+// 延迟直方图：微秒，小于32精确计数，之后每个2的幂分16档（相对误差不超过6%）
+#define SWARM_HIST_SUB      16
+#define SWARM_HIST_BUCKETS  400
+
+// 客户端状态
+enum swarm_state {
+    SWARM_IDLE = 0,        // 等待（重新）连接
+    SWARM_CONNECTING,      // 非阻塞连接中
+    SWARM_SYNCING,         // 已连接，寻找第一个完整测试帧
+    SWARM_SYNCED           // 已对齐到发送数据，逐字节核对
+};
+
+// 客户端
+struct swarm_client {
+    int fd;
+    int state;
+    uint64_t retry_ns;                          // 下次连接时间
+    uint64_t off;                               // 下一个字节在发送数据中的位置
+    uint32_t next_seq;                          // 下一个要收齐的帧序号
+    uint64_t last_rx_ns;                        // 最近一次收到数据的时间
+    int in_stall;                               // 当前是否处于停顿中
+    int sync_len;
+    unsigned char sync_buf[2 * RTCM3_MAX_FRAME];
+    uint64_t frames;                            // 收齐的帧数
+    uint64_t bytes;                             // 收到的字节数
+    uint32_t stalls;                            // 停顿次数
+    uint64_t stall_max_ns;                      // 最长停顿
+    uint32_t disconnects;                       // 被动断线次数
+    uint32_t mismatches;                        // 数据不一致次数
+    uint32_t hist[SWARM_HIST_BUCKETS];
+};
+
+// 已发送帧
+struct swarm_frame {
+    uint32_t seq;
+    uint32_t len;
+    uint64_t off;                               // 在发送数据中的起点
+    uint64_t sent_ns;                           // 发送时间
+};
+
+// 运行参数
+struct swarm_options {
+    const char *host;       // 流动站程序地址
+    int base_port;          // 基站数据端口
+    int relay_port;         // 下游客户端端口
+    int clients;            // 客户端数
+    int connect_rate;       // 每秒新建连接数
+    int rate;               // 每秒历元数
+    int epoch_bytes;        // 每个历元的字节数
+    int duration;           // 全部连接后的测试时长（秒）
+    int stall_ms;           // 停顿判定阈值（毫秒）
+};
+
+// 测试状态
+struct swarm {
+    struct swarm_options opts;
+    struct sockaddr_storage relay_addr;
+    socklen_t relay_addr_len;
+    int epoll_fd;
+    int base_fd;
+    struct swarm_client *clients;
+    int connected;                              // 已建立的连接数
+    int started;                                // 已发起的首次连接数
+
+    // 发送端
+    unsigned char *history;                     // 已发送数据（环形）
+    uint64_t sent_off;                          // 已产生的总字节数
+    struct swarm_frame *frames;                 // 已发送帧（环形）
+    uint32_t next_seq;
+    unsigned char *base_buf;                    // 基站连接待发队列
+    int base_len;
+    uint64_t skipped_epochs;                    // 基站连接积压时跳过的历元数
+
+    // 全局统计
+    uint64_t lagged;                            // 落后超过保留长度的次数
+    uint64_t connect_errors;
+    uint32_t hist[SWARM_HIST_BUCKETS];
+};
+
+static volatile sig_atomic_t swarm_stop = 0;
+
+/**
+ * @brief 退出信号处理
+ * @param sig 信号编号
+ */
+static void swarm_signal_handler(int sig)
+{
+    (void)sig;
+    swarm_stop = 1;
+}
+
+/**
+ * @brief 延迟值对应的直方图档位
+ * @param us 延迟（微秒）
+ * @return 档位
+ */
+static int swarm_hist_index(uint64_t us)
+{
+    if (us < 2 * SWARM_HIST_SUB) {
+        return (int)us;
+    }
+
+    int e = 63 - __builtin_clzll(us) - 4;
+    int idx = e * SWARM_HIST_SUB + (int)(us >> e);
+    return idx < SWARM_HIST_BUCKETS ? idx : SWARM_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief 直方图档位的下界
+ * @param idx 档位
+ * @return 延迟（微秒）
+ */
+static uint64_t swarm_hist_value(int idx)
+{
+    if (idx < 2 * SWARM_HIST_SUB) {
+        return idx;
+    }
+
+    int e = idx / SWARM_HIST_SUB - 1;
+    return (uint64_t)(idx % SWARM_HIST_SUB + SWARM_HIST_SUB) << e;
+}
+
+/**
+ * @brief 直方图分位数
+ * @param hist 直方图
+ * @param q 分位（0~1）
+ * @return 延迟（微秒），没有样本返回0
+ */
+static uint64_t swarm_hist_quantile(const uint32_t *hist, double q)
+{
+    uint64_t total = 0, seen = 0;
+
+    for (int i = 0; i < SWARM_HIST_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(q * (double)(total - 1)) + 1;
+    for (int i = 0; i < SWARM_HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= rank) {
+            return swarm_hist_value(i);
+        }
+    }
+    return swarm_hist_value(SWARM_HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief 伪随机数（xorshift32），由序号决定测试帧的填充内容
+ * @param state 状态
+ * @return 随机数
+ */
+static uint32_t swarm_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @param opts 输出的运行参数
+ * @return 成功返回0，失败返回-1
+ */
+static int swarm_parse_options(int argc, char *argv[], struct swarm_options *opts)
+{
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->host = "127.0.0.1";
+    opts->base_port = 8888;
+    opts->relay_port = 2101;
+    opts->clients = 1000;
+    opts->connect_rate = 500;
+    opts->rate = 10;
+    opts->epoch_bytes = 2000;
+    opts->duration = 30;
+    opts->stall_ms = 1000;
+
+    while ((c = getopt(argc, argv, "H:b:l:n:c:r:s:t:S:h")) != -1) {
+        switch (c) {
+        case 'H':
+            opts->host = optarg;
+            break;
+        case 'b':
+            opts->base_port = atoi(optarg);
+            break;
+        case 'l':
+            opts->relay_port = atoi(optarg);
+            break;
+        case 'n':
+            opts->clients = atoi(optarg);
+            break;
+        case 'c':
+            opts->connect_rate = atoi(optarg);
+            break;
+        case 'r':
+            opts->rate = atoi(optarg);
+            break;
+        case 's':
+            opts->epoch_bytes = atoi(optarg);
+            break;
+        case 't':
+            opts->duration = atoi(optarg);
+            break;
+        case 'S':
+            opts->stall_ms = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-H host] [-b base_port] [-l relay_port] [-n clients] [-c connects_per_s]\n"
+                    "       [-r epochs_per_s] [-s bytes_per_epoch] [-t seconds] [-S stall_ms]\n"
+                    "  feeds the rover program as its base station and checks every relayed byte\n",
+                    argv[0]);
+            return -1;
+        }
+    }
+
+    if (opts->clients < 1 || opts->connect_rate < 1 || opts->rate < 1 || opts->rate > 1000 ||
+        opts->epoch_bytes < RTCM3_HEADER_LEN + SWARM_MSG_HEADER + RTCM3_CRC_LEN ||
+        opts->epoch_bytes > SWARM_BASE_QUEUE / 4 || opts->duration < 1 || opts->stall_ms < 1) {
+        fprintf(stderr, "invalid options\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析主机地址
+ * @param host 主机
+ * @param port 端口
+ * @param addr 输出地址
+ * @param addr_len 输出地址长度
+ * @return 成功返回0，失败返回-1
+ */
+static int swarm_resolve(const char *host, int port, struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    struct addrinfo hints, *res;
+    char service[16];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+    int err = getaddrinfo(host, service, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "getaddrinfo %s: %s\n", host, gai_strerror(err));
+        return -1;
+    }
+
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    *addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/**
+ * @brief 以基站身份连接流动站程序
+ * @param sw 测试状态
+ * @return 成功返回0，失败返回-1
+ */
+static int swarm_connect_base(struct swarm *sw)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+
+    if (swarm_resolve(sw->opts.host, sw->opts.base_port, &addr, &addr_len) != 0) {
+        return -1;
+    }
+
+    sw->base_fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sw->base_fd < 0 || connect(sw->base_fd, (struct sockaddr *)&addr, addr_len) != 0) {
+        perror("base connect failed");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(sw->base_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    fcntl(sw->base_fd, F_SETFL, fcntl(sw->base_fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = SWARM_BASE_TAG };
+    if (epoll_ctl(sw->epoll_fd, EPOLL_CTL_ADD, sw->base_fd, &ev) < 0) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 发送基站连接待发队列中的数据
+ * @param sw 测试状态
+ * @return 成功返回0，连接断开返回-1
+ */
+static int swarm_base_flush(struct swarm *sw)
+{
+    int off = 0;
+
+    while (off < sw->base_len) {
+        ssize_t n = send(sw->base_fd, &sw->base_buf[off], sw->base_len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            perror("base send failed");
+            return -1;
+        }
+        off += n;
+    }
+
+    sw->base_len -= off;
+    memmove(sw->base_buf, &sw->base_buf[off], sw->base_len);
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = SWARM_BASE_TAG };
+    if (sw->base_len > 0) {
+        ev.events |= EPOLLOUT;
+    }
+    epoll_ctl(sw->epoll_fd, EPOLL_CTL_MOD, sw->base_fd, &ev);
+    return 0;
+}
+
+/**
+ * @brief 产生一个历元的测试帧，记入发送数据并放入基站连接待发队列
+ * @param sw 测试状态
+ */
+static void swarm_emit_epoch(struct swarm *sw)
+{
+    unsigned char payload[SWARM_MSG_PAYLOAD];
+    unsigned char frame[RTCM3_MAX_FRAME];
+    int remain = sw->opts.epoch_bytes;
+
+    // 基站连接积压（流动站程序读取跟不上）时整历元跳过，发送数据保持连续
+    if (sw->base_len + remain + RTCM3_MAX_FRAME > SWARM_BASE_QUEUE) {
+        sw->skipped_epochs++;
+        return;
+    }
+
+    uint64_t now = bds_now_ns();
+    while (remain >= RTCM3_HEADER_LEN + SWARM_MSG_HEADER + RTCM3_CRC_LEN) {
+        int len = remain - RTCM3_HEADER_LEN - RTCM3_CRC_LEN;
+        if (len > SWARM_MSG_PAYLOAD) {
+            len = SWARM_MSG_PAYLOAD;
+        }
+        // 剩余部分放不下一个最小帧时并入本帧
+        if (remain - (len + RTCM3_HEADER_LEN + RTCM3_CRC_LEN) < RTCM3_HEADER_LEN + SWARM_MSG_HEADER + RTCM3_CRC_LEN &&
+            remain - RTCM3_HEADER_LEN - RTCM3_CRC_LEN <= SWARM_MSG_PAYLOAD) {
+            len = remain - RTCM3_HEADER_LEN - RTCM3_CRC_LEN;
+        }
+
+        uint32_t seq = sw->next_seq++;
+        uint32_t state = seq * 2654435761U + 1;
+        rtcm_set_bits(payload, 0, 12, SWARM_MSG_TYPE);
+        rtcm_set_bits(payload, 12, 4, 0);
+        rtcm_set_bits(payload, 16, 32, seq);
+        rtcm_set_bits(payload, 48, 32, (uint32_t)(now >> 32));
+        rtcm_set_bits(payload, 80, 32, (uint32_t)now);
+        for (int i = SWARM_MSG_HEADER; i < len; i++) {
+            payload[i] = (unsigned char)swarm_rand(&state);
+        }
+        int flen = rtcm_frame_encode(payload, len, frame, sizeof(frame));
+
+        struct swarm_frame *f = &sw->frames[seq & (SWARM_FRAMES - 1)];
+        f->seq = seq;
+        f->len = flen;
+        f->off = sw->sent_off;
+        f->sent_ns = now;
+
+        for (int i = 0; i < flen; i++) {
+            sw->history[(sw->sent_off + i) & (SWARM_HISTORY - 1)] = frame[i];
+        }
+        sw->sent_off += flen;
+        memcpy(&sw->base_buf[sw->base_len], frame, flen);
+        sw->base_len += flen;
+        remain -= flen;
+    }
+}
+
+/**
+ * @brief 发起一个客户端的非阻塞连接
+ * @param sw 测试状态
+ * @param id 客户端编号
+ */
+static void swarm_connect(struct swarm *sw, int id)
+{
+    struct swarm_client *c = &sw->clients[id];
+
+    c->fd = socket(sw->relay_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) {
+        perror("socket creation failed");
+        sw->connect_errors++;
+        c->retry_ns = bds_now_ns() + SWARM_RETRY_MS * 1000000ULL;
+        return;
+    }
+
+    if (connect(c->fd, (struct sockaddr *)&sw->relay_addr, sw->relay_addr_len) < 0 && errno != EINPROGRESS) {
+        sw->connect_errors++;
+        close(c->fd);
+        c->fd = -1;
+        c->retry_ns = bds_now_ns() + SWARM_RETRY_MS * 1000000ULL;
+        return;
+    }
+
+    struct epoll_event ev = { .events = EPOLLOUT | EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)id };
+    epoll_ctl(sw->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+    c->state = SWARM_CONNECTING;
+}
+
+/**
+ * @brief 关闭客户端连接，稍后重连
+ * @param sw 测试状态
+ * @param id 客户端编号
+ * @param counted 是否计为断线（连接失败不计）
+ */
+static void swarm_close(struct swarm *sw, int id, int counted)
+{
+    struct swarm_client *c = &sw->clients[id];
+
+    if (c->state >= SWARM_SYNCING) {
+        sw->connected--;
+        if (counted) {
+            c->disconnects++;
+        }
+    } else {
+        sw->connect_errors++;
+    }
+    close(c->fd);
+    c->fd = -1;
+    c->state = SWARM_IDLE;
+    c->in_stall = 0;
+    c->sync_len = 0;
+    c->retry_ns = bds_now_ns() + SWARM_RETRY_MS * 1000000ULL;
+}
+
+/**
+ * @brief 核对已对齐客户端收到的数据，更新收齐帧的延迟
+ * @param sw 测试状态
+ * @param c 客户端
+ * @param buf 收到的数据
+ * @param len 数据长度
+ */
+static void swarm_check(struct swarm *sw, struct swarm_client *c, const unsigned char *buf, int len)
+{
+    // 落后超过保留长度时无法核对，重新对齐
+    if (c->off + SWARM_HISTORY < sw->sent_off) {
+        sw->lagged++;
+        c->state = SWARM_SYNCING;
+        c->sync_len = 0;
+        return;
+    }
+
+    // 环形缓冲区回绕处分两段比较
+    size_t start = c->off & (SWARM_HISTORY - 1);
+    size_t first = SWARM_HISTORY - start < (size_t)len ? SWARM_HISTORY - start : (size_t)len;
+    if (c->off + len > sw->sent_off ||
+        memcmp(&sw->history[start], buf, first) != 0 ||
+        memcmp(sw->history, buf + first, len - first) != 0) {
+        c->mismatches++;
+        c->state = SWARM_SYNCING;
+        c->sync_len = 0;
+        return;
+    }
+    c->off += len;
+
+    uint64_t now = bds_now_ns();
+    while (c->next_seq != sw->next_seq) {
+        const struct swarm_frame *f = &sw->frames[c->next_seq & (SWARM_FRAMES - 1)];
+        if (f->seq != c->next_seq || f->off + f->len > c->off) {
+            break;
+        }
+        int idx = swarm_hist_index((now - f->sent_ns) / 1000);
+        c->hist[idx]++;
+        sw->hist[idx]++;
+        c->frames++;
+        c->next_seq++;
+    }
+}
+
+/**
+ * @brief 在连接开头的数据中寻找第一个完整测试帧，对齐后转为逐字节核对
+ * @param sw 测试状态
+ * @param c 客户端
+ * @param buf 收到的数据
+ * @param len 数据长度
+ */
+static void swarm_sync(struct swarm *sw, struct swarm_client *c, const unsigned char *buf, int len)
+{
+    while (len > 0) {
+        int n = len;
+        if (n > (int)sizeof(c->sync_buf) - c->sync_len) {
+            n = (int)sizeof(c->sync_buf) - c->sync_len;
+        }
+        memcpy(&c->sync_buf[c->sync_len], buf, n);
+        c->sync_len += n;
+        buf += n;
+        len -= n;
+
+        int i = 0;
+        while (i + RTCM3_HEADER_LEN <= c->sync_len) {
+            const unsigned char *p = &c->sync_buf[i];
+            int plen = ((p[1] & 0x03) << 8) | p[2];
+            int flen = plen + RTCM3_HEADER_LEN + RTCM3_CRC_LEN;
+            if (p[0] != RTCM3_PREAMBLE || plen < SWARM_MSG_HEADER) {
+                i++;
+                continue;
+            }
+            if (i + flen > c->sync_len) {
+                break;
+            }
+            uint32_t crc = rtcm_crc24q(p, plen + RTCM3_HEADER_LEN);
+            const unsigned char *q = &p[plen + RTCM3_HEADER_LEN];
+            if (crc != ((uint32_t)q[0] << 16 | (uint32_t)q[1] << 8 | q[2]) ||
+                rtcm_get_bits(p + RTCM3_HEADER_LEN, 0, 12) != SWARM_MSG_TYPE) {
+                i++;
+                continue;
+            }
+
+            uint32_t seq = rtcm_get_bits(p + RTCM3_HEADER_LEN, 16, 32);
+            const struct swarm_frame *f = &sw->frames[seq & (SWARM_FRAMES - 1)];
+            if (f->seq != seq || (int)f->len != flen || seq >= sw->next_seq) {
+                i++;
+                continue;
+            }
+
+            // 找到帧起点：从这里开始与发送数据逐字节核对
+            c->state = SWARM_SYNCED;
+            c->off = f->off;
+            c->next_seq = seq;
+            int rest = c->sync_len - i;
+            c->sync_len = 0;
+            swarm_check(sw, c, p, rest);
+            if (len > 0) {
+                // 核对失败时剩余数据重新寻找帧起点
+                if (c->state == SWARM_SYNCED) {
+                    swarm_check(sw, c, buf, len);
+                } else {
+                    swarm_sync(sw, c, buf, len);
+                }
+            }
+            return;
+        }
+
+        // 丢掉已确认不是帧起点的字节
+        memmove(c->sync_buf, &c->sync_buf[i], c->sync_len - i);
+        c->sync_len -= i;
+        if (c->sync_len == (int)sizeof(c->sync_buf)) {
+            c->sync_len = 0;
+        }
+    }
+}
+
+/**
+ * @brief 处理客户端的epoll事件
+ * @param sw 测试状态
+ * @param id 客户端编号
+ * @param events epoll事件
+ */
+static void swarm_client_event(struct swarm *sw, int id, uint32_t events)
+{
+    static unsigned char buf[64 * 1024];
+    struct swarm_client *c = &sw->clients[id];
+
+    if (c->state == SWARM_CONNECTING) {
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        if (err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+            swarm_close(sw, id, 0);
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = (uint32_t)id };
+        epoll_ctl(sw->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->state = SWARM_SYNCING;
+        c->last_rx_ns = bds_now_ns();
+        sw->connected++;
+    }
+
+    while (1) {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) {
+            uint64_t now = bds_now_ns();
+            c->in_stall = 0;
+            if (now - c->last_rx_ns > c->stall_max_ns) {
+                c->stall_max_ns = now - c->last_rx_ns;
+            }
+            c->last_rx_ns = now;
+            c->bytes += n;
+            if (c->state == SWARM_SYNCED) {
+                swarm_check(sw, c, buf, (int)n);
+            } else {
+                swarm_sync(sw, c, buf, (int)n);
+            }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        swarm_close(sw, id, 1);
+        return;
+    }
+}
+
+/**
+ * @brief 定时处理：按节奏发起连接、重连断开的客户端、检查停顿
+ * @param sw 测试状态
+ * @param now 当前时间
+ * @param ramp_start 开始发起连接的时间
+ * @param producing 是否仍在发送数据（停止发送后不再判定停顿）
+ */
+static void swarm_tick(struct swarm *sw, uint64_t now, uint64_t ramp_start, int producing)
+{
+    uint64_t stall_ns = (uint64_t)sw->opts.stall_ms * 1000000ULL;
+
+    // 首次连接按每秒connect_rate个的速度发起，避免瞬间打满监听队列
+    uint64_t due = (now - ramp_start) / 1000000ULL * sw->opts.connect_rate / 1000 + 1;
+    while (sw->started < sw->opts.clients && (uint64_t)sw->started < due) {
+        swarm_connect(sw, sw->started++);
+    }
+
+    for (int i = 0; i < sw->started; i++) {
+        struct swarm_client *c = &sw->clients[i];
+        if (c->state == SWARM_IDLE && now >= c->retry_ns && producing) {
+            swarm_connect(sw, i);
+        } else if (c->state >= SWARM_SYNCING && producing && !c->in_stall && now > c->last_rx_ns + stall_ns) {
+            c->in_stall = 1;
+            c->stalls++;
+        }
+    }
+}
+
+/**
+ * @brief 输出测试结果
+ * @param sw 测试状态
+ * @param elapsed_ns 测试时长
+ * @return 全部客户端数据一致、无断线返回0，否则返回1
+ */
+static int swarm_report(struct swarm *sw, uint64_t elapsed_ns)
+{
+    uint64_t frames = 0, bytes = 0, stall_max = 0;
+    uint64_t stalls = 0, disconnects = 0, mismatches = 0;
+    int never_synced = 0, stalled_clients = 0;
+    int n = sw->started;
+
+    static uint32_t p99_hist[SWARM_HIST_BUCKETS];
+    memset(p99_hist, 0, sizeof(p99_hist));
+
+    for (int i = 0; i < n; i++) {
+        struct swarm_client *c = &sw->clients[i];
+        frames += c->frames;
+        bytes += c->bytes;
+        stalls += c->stalls;
+        disconnects += c->disconnects;
+        mismatches += c->mismatches;
+        stalled_clients += c->stalls > 0;
+        if (c->stall_max_ns > stall_max) {
+            stall_max = c->stall_max_ns;
+        }
+        if (c->frames == 0) {
+            never_synced++;
+        } else {
+            p99_hist[swarm_hist_index(swarm_hist_quantile(c->hist, 0.99))]++;
+        }
+    }
+
+    double secs = elapsed_ns / 1e9;
+    printf("Sent %u frames (%llu bytes) in %.1f s, %llu epochs skipped on base backpressure\n",
+           sw->next_seq, (unsigned long long)sw->sent_off, secs, (unsigned long long)sw->skipped_epochs);
+    printf("Clients: %d started, %d connected at end, %d never received a full frame, %llu connect errors\n",
+           n, sw->connected, never_synced, (unsigned long long)sw->connect_errors);
+    printf("Delivered %llu frames, %llu bytes (%.1f MB/s aggregate)\n",
+           (unsigned long long)frames, (unsigned long long)bytes, secs > 0 ? bytes / secs / 1e6 : 0.0);
+    printf("Latency us (all frames): p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+           (unsigned long long)swarm_hist_quantile(sw->hist, 0.5),
+           (unsigned long long)swarm_hist_quantile(sw->hist, 0.9),
+           (unsigned long long)swarm_hist_quantile(sw->hist, 0.99),
+           (unsigned long long)swarm_hist_quantile(sw->hist, 0.999),
+           (unsigned long long)swarm_hist_quantile(sw->hist, 1.0));
+    printf("Per-client p99 us: best %llu  median %llu  p90 %llu  worst %llu\n",
+           (unsigned long long)swarm_hist_quantile(p99_hist, 0.0),
+           (unsigned long long)swarm_hist_quantile(p99_hist, 0.5),
+           (unsigned long long)swarm_hist_quantile(p99_hist, 0.9),
+           (unsigned long long)swarm_hist_quantile(p99_hist, 1.0));
+    printf("Stalls > %d ms: %llu on %d clients, longest gap %llu ms\n",
+           sw->opts.stall_ms, (unsigned long long)stalls, stalled_clients,
+           (unsigned long long)(stall_max / 1000000ULL));
+    printf("Disconnects: %llu, mismatches: %llu, lagged beyond history: %llu\n",
+           (unsigned long long)disconnects, (unsigned long long)mismatches, (unsigned long long)sw->lagged);
+
+    // 列出p99最差的几个客户端，便于对照服务端日志
+    int worst[SWARM_REPORT_WORST];
+    uint64_t worst_p99[SWARM_REPORT_WORST];
+    int worst_count = 0;
+    for (int i = 0; i < n; i++) {
+        if (sw->clients[i].frames == 0) {
+            continue;
+        }
+        uint64_t p99 = swarm_hist_quantile(sw->clients[i].hist, 0.99);
+        int k = worst_count < SWARM_REPORT_WORST ? worst_count++ : SWARM_REPORT_WORST;
+        while (k > 0 && worst_p99[k - 1] < p99) {
+            if (k < SWARM_REPORT_WORST) {
+                worst[k] = worst[k - 1];
+                worst_p99[k] = worst_p99[k - 1];
+            }
+            k--;
+        }
+        if (k < SWARM_REPORT_WORST) {
+            worst[k] = i;
+            worst_p99[k] = p99;
+        }
+    }
+    for (int k = 0; k < worst_count; k++) {
+        struct swarm_client *c = &sw->clients[worst[k]];
+        printf("  worst #%d: client %d p50 %llu p99 %llu max %llu us, %llu frames, %u stalls, %u disconnects\n",
+               k + 1, worst[k],
+               (unsigned long long)swarm_hist_quantile(c->hist, 0.5), (unsigned long long)worst_p99[k],
+               (unsigned long long)swarm_hist_quantile(c->hist, 1.0),
+               (unsigned long long)c->frames, c->stalls, c->disconnects);
+    }
+
+    return (mismatches == 0 && sw->lagged == 0 && disconnects == 0 && never_synced == 0) ? 0 : 1;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 测试通过返回0，发现数据错误、断线或无法启动返回1
+ */
+int main(int argc, char *argv[])
+{
+    static struct swarm sw;
+    struct epoll_event events[SWARM_MAX_EVENTS];
+    struct rlimit rl;
+
+    if (swarm_parse_options(argc, argv, &sw.opts) != 0) {
+        return 1;
+    }
+    if (swarm_resolve(sw.opts.host, sw.opts.relay_port, &sw.relay_addr, &sw.relay_addr_len) != 0) {
+        return 1;
+    }
+
+    // 每个客户端一个描述符
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur != RLIM_INFINITY && (rlim_t)sw.opts.clients + 16 > rl.rlim_cur) {
+        fprintf(stderr, "RLIMIT_NOFILE %llu is too low for %d clients\n",
+                (unsigned long long)rl.rlim_cur, sw.opts.clients);
+        return 1;
+    }
+
+    sw.clients = calloc(sw.opts.clients, sizeof(*sw.clients));
+    sw.history = malloc(SWARM_HISTORY);
+    sw.frames = calloc(SWARM_FRAMES, sizeof(*sw.frames));
+    sw.base_buf = malloc(SWARM_BASE_QUEUE);
+    if (sw.clients == NULL || sw.history == NULL || sw.frames == NULL || sw.base_buf == NULL) {
+        perror("allocation failed");
+        return 1;
+    }
+    // 帧表初始序号设为不可能出现的值，避免误认
+    for (int i = 0; i < SWARM_FRAMES; i++) {
+        sw.frames[i].seq = UINT32_MAX;
+    }
+    for (int i = 0; i < sw.opts.clients; i++) {
+        sw.clients[i].fd = -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = swarm_signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    sw.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sw.epoll_fd < 0 || timer_fd < 0) {
+        perror("epoll/timerfd creation failed");
+        return 1;
+    }
+    struct itimerspec its = {
+        .it_interval = { 0, SWARM_TICK_MS * 1000000L },
+        .it_value = { 0, SWARM_TICK_MS * 1000000L },
+    };
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = SWARM_TIMER_TAG };
+    epoll_ctl(sw.epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+
+    if (swarm_connect_base(&sw) != 0) {
+        return 1;
+    }
+    printf("Feeding %s:%d as the base, %d clients on port %d at %d/s, %d epochs/s x %d bytes\n",
+           sw.opts.host, sw.opts.base_port, sw.opts.clients, sw.opts.relay_port,
+           sw.opts.connect_rate, sw.opts.rate, sw.opts.epoch_bytes);
+
+    uint64_t start = bds_now_ns();
+    uint64_t period_ns = 1000000000ULL / sw.opts.rate;
+    uint64_t next_epoch = start;
+    uint64_t next_progress = start + 1000000000ULL;
+    uint64_t ramp_ns = (uint64_t)sw.opts.clients * 1000000000ULL / sw.opts.connect_rate;
+    uint64_t end = start + ramp_ns + (uint64_t)sw.opts.duration * 1000000000ULL;
+    uint64_t drain_end = 0;
+    int base_ok = 1;
+
+    while (1) {
+        int n = epoll_wait(sw.epoll_fd, events, SWARM_MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait failed");
+            break;
+        }
+
+        uint64_t now = bds_now_ns();
+        int producing = (drain_end == 0);
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+            if (tag == SWARM_TIMER_TAG) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                    perror("timerfd read failed");
+                }
+                // 落后多个周期时只补发一个历元，不突发
+                if (producing && now >= next_epoch) {
+                    swarm_emit_epoch(&sw);
+                    next_epoch += period_ns;
+                    if (next_epoch < now) {
+                        next_epoch = now + period_ns;
+                    }
+                    if (swarm_base_flush(&sw) != 0) {
+                        base_ok = 0;
+                    }
+                }
+                swarm_tick(&sw, now, start, producing);
+            } else if (tag == SWARM_BASE_TAG) {
+                if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                    fprintf(stderr, "rover program closed the base connection\n");
+                    base_ok = 0;
+                } else if ((events[i].events & EPOLLOUT) && swarm_base_flush(&sw) != 0) {
+                    base_ok = 0;
+                }
+            } else {
+                swarm_client_event(&sw, (int)tag, events[i].events);
+            }
+        }
+
+        if (producing && now >= next_progress) {
+            next_progress += 1000000000ULL;
+            printf("[%3llus] %d/%d connected, %u frames sent, p99 %llu us\n",
+                   (unsigned long long)((now - start) / 1000000000ULL), sw.connected, sw.opts.clients,
+                   sw.next_seq, (unsigned long long)swarm_hist_quantile(sw.hist, 0.99));
+            fflush(stdout);
+        }
+
+        // 停止发送后留出时间让在途数据到达
+        if (producing && (swarm_stop || !base_ok || now >= end)) {
+            drain_end = now + SWARM_DRAIN_MS * 1000000ULL;
+        }
+        if (drain_end != 0 && now >= drain_end) {
+            break;
+        }
+    }
+
+    int ret = swarm_report(&sw, bds_now_ns() - start);
+    return base_ok ? ret : 1;
+}
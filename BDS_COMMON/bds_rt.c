@@ -0,0 +1,232 @@
+/*
+ * bds_rt.c
+ * 实时运行模式源文件
+ * 功能：实现线程绑核、实时调度、内存锁定、预缺页和调度延迟监测
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_rt.h"
+
+// 调度延迟指标编号
+static int m_lat_max = -1;
+static int m_lat_p99 = -1;
+static int m_lat_p999 = -1;
+static int m_lat_overruns = -1;
+
+/**
+ * @brief 解析CPU列表，如"2"或"2,3"
+ * @param list CPU编号列表（逗号分隔）
+ * @param opts 输出的实时模式参数
+ * @return 成功返回0，失败返回-1
+ */
+int rt_parse_cpus(const char *list, struct rt_options *opts)
+{
+    const char *p = list;
+
+    CPU_ZERO(&opts->cpus);
+    opts->cpu_count = 0;
+
+    while (*p != '\0') {
+        char *end;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || cpu < 0 || cpu >= CPU_SETSIZE) {
+            fprintf(stderr, "invalid cpu list: %s\n", list);
+            return -1;
+        }
+        if (*end != ',' && *end != '\0') {
+            fprintf(stderr, "invalid cpu list: %s\n", list);
+            return -1;
+        }
+        CPU_SET((int)cpu, &opts->cpus);
+        opts->cpu_count++;
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 进程级实时准备：锁定全部内存、关闭堆收缩并预缺页栈空间
+ * @return 成功返回0，失败返回-1
+ */
+int rt_setup_process(void)
+{
+    // 锁定当前和以后映射的全部内存，避免运行中发生缺页
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall failed");
+        return -1;
+    }
+
+    // 禁止堆收缩和mmap分配，已缺页的堆内存不会归还给内核
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    // 预缺页栈空间
+    volatile unsigned char stack[RT_PREFAULT_STACK];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 线程级实时准备：绑定CPU并切换到SCHED_FIFO（优先级为0时为普通调度）
+ * @param opts 实时模式参数
+ * @param name 线程名称（用于打印）
+ * @return 成功返回0，失败返回-1
+ */
+int rt_setup_thread(const struct rt_options *opts, const char *name)
+{
+    if (opts->cpu_count > 0) {
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &opts->cpus);
+        if (rc != 0) {
+            fprintf(stderr, "pthread_setaffinity_np failed for %s: %s\n", name, strerror(rc));
+            return -1;
+        }
+    }
+
+    // 优先级为0时显式切回普通调度：新线程默认继承创建者（已是SCHED_FIFO的转发线程）的调度策略
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = opts->priority;
+    int rc = pthread_setschedparam(pthread_self(), opts->priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_setschedparam failed for %s: %s\n", name, strerror(rc));
+        return -1;
+    }
+
+    printf("Real-time thread %s: %s priority %d, %d cpu(s) pinned\n",
+           name, opts->priority > 0 ? "SCHED_FIFO" : "SCHED_OTHER", opts->priority, opts->cpu_count);
+    return 0;
+}
+
+/**
+ * @brief 预缺页缓冲区（逐页原子或0，只建立可写映射、不改变内容，其他线程已在使用的队列也可调用）
+ * @param buf 缓冲区，NULL时忽略
+ * @param len 缓冲区长度
+ */
+void rt_prefault(void *buf, size_t len)
+{
+    unsigned char *p = buf;
+
+    if (p == NULL || len == 0) {
+        return;
+    }
+    for (size_t i = 0; i < len; i += 4096) {
+        __atomic_fetch_or(&p[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_or(&p[len - 1], 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 根据直方图计算分位数
+ * @param hist 直方图
+ * @param total 样本总数
+ * @param q 分位（0~1）
+ * @return 分位数对应的延迟（微秒，桶上界）
+ */
+static uint64_t rt_hist_quantile(const uint64_t *hist, uint64_t total, double q)
+{
+    uint64_t target = (uint64_t)(total * q);
+    uint64_t acc = 0;
+
+    for (int i = 0; i < RT_HIST_BUCKETS; i++) {
+        acc += hist[i];
+        if (acc > target) {
+            return (uint64_t)(i + 1) * RT_HIST_BUCKET_US;
+        }
+    }
+
+    return (uint64_t)RT_HIST_BUCKETS * RT_HIST_BUCKET_US;
+}
+
+/**
+ * @brief 调度延迟监测线程：按固定周期绝对定时睡眠，统计唤醒偏差
+ * @param arg 实时模式参数
+ * @return NULL
+ */
+static void *rt_monitor_thread(void *arg)
+{
+    struct rt_options opts = *(const struct rt_options *)arg;
+    static uint64_t hist[RT_HIST_BUCKETS];
+    uint64_t samples = 0, max_us = 0;
+    struct timespec next, now;
+    time_t last_report;
+
+    // 监测线程与转发线程同核、低一级优先级：不抢占转发线程，测到的延迟含转发线程占用CPU的时间；
+    // 转发线程为最低的实时优先级1时监测线程按普通调度运行
+    if (opts.priority > 0) {
+        opts.priority--;
+    }
+    rt_setup_thread(&opts, "latency-monitor");
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    last_report = next.tv_sec;
+
+    while (1) {
+        next.tv_nsec += RT_MONITOR_PERIOD_US * 1000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        int64_t late_ns = (int64_t)(now.tv_sec - next.tv_sec) * 1000000000LL +
+                          (now.tv_nsec - next.tv_nsec);
+        uint64_t late_us = late_ns > 0 ? (uint64_t)late_ns / 1000 : 0;
+        int bucket = (int)(late_us / RT_HIST_BUCKET_US);
+        if (bucket >= RT_HIST_BUCKETS) {
+            bucket = RT_HIST_BUCKETS - 1;
+            metrics_inc(m_lat_overruns);
+        }
+        hist[bucket]++;
+        samples++;
+        if (late_us > max_us) {
+            max_us = late_us;
+            metrics_max(m_lat_max, max_us);
+        }
+
+        // 周期性更新分位数并打印
+        if (now.tv_sec - last_report >= RT_REPORT_INTERVAL) {
+            uint64_t p99 = rt_hist_quantile(hist, samples, 0.99);
+            uint64_t p999 = rt_hist_quantile(hist, samples, 0.999);
+            metrics_set(m_lat_p99, p99);
+            metrics_set(m_lat_p999, p999);
+            printf("Scheduling latency: samples %llu, p99 <%llu us, p999 <%llu us, max %llu us\n",
+                   (unsigned long long)samples, (unsigned long long)p99,
+                   (unsigned long long)p999, (unsigned long long)max_us);
+            last_report = now.tv_sec;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 启动调度延迟监测线程
+ * @param opts 实时模式参数（须在进程生命周期内有效）
+ * @return 成功返回0，失败返回-1
+ */
+int rt_start_monitor(const struct rt_options *opts)
+{
+    m_lat_max = metrics_register("bds_rt_sched_latency_max_us",
+                                 "Worst observed scheduling latency", METRIC_GAUGE_MAX);
+    m_lat_p99 = metrics_register("bds_rt_sched_latency_p99_us",
+                                 "99th percentile scheduling latency", METRIC_GAUGE);
+    m_lat_p999 = metrics_register("bds_rt_sched_latency_p999_us",
+                                  "99.9th percentile scheduling latency", METRIC_GAUGE);
+    m_lat_overruns = metrics_register("bds_rt_sched_latency_overruns_total",
+                                      "Wakeups later than the histogram range", METRIC_COUNTER);
+
+    pthread_t tid;
+    if (bds_thread_create(&tid, BDS_THREAD_STACK, 1, rt_monitor_thread, (void *)opts) != 0) {
+        fprintf(stderr, "latency monitor thread creation failed\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * bds_rt.h
+ * 实时运行模式头文件
+ * 功能：CPU亲和性、SCHED_FIFO调度、内存锁定与预缺页，以及运行期调度延迟统计
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_RT_H
+#define BDS_RT_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+#include "bds_metrics.h"
+#include "bds_thread.h"
+
+// 实时模式配置
+#define RT_PREFAULT_STACK   (256 * 1024)  // 预缺页的栈大小
+#define RT_MONITOR_PERIOD_US 1000         // 延迟监测线程周期（微秒）
+#define RT_HIST_BUCKETS     1024          // 延迟直方图桶数（每桶10微秒）
+#define RT_HIST_BUCKET_US   10            // 直方图桶宽（微秒）
+#define RT_REPORT_INTERVAL  10            // 延迟报告间隔（秒）
+
+// 实时模式参数
+struct rt_options {
+    int priority;              // SCHED_FIFO优先级，0表示不启用实时模式
+    cpu_set_t cpus;            // 绑定的CPU集合
+    int cpu_count;             // 绑定的CPU个数，0表示不绑定
+};
+
+// 函数声明
+int rt_parse_cpus(const char *list, struct rt_options *opts);
+int rt_setup_process(void);
+int rt_setup_thread(const struct rt_options *opts, const char *name);
+void rt_prefault(void *buf, size_t len);
+int rt_start_monitor(const struct rt_options *opts);
+
+#endif /* BDS_RT_H */
@@ -0,0 +1,405 @@
+/*
+ * bds_rtcm.c
+ * RTCM3帧处理源文件
+ * 功能：CRC-24Q查表计算、位域读写、流式分帧、观测电文头和基准站坐标电文解析
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_rtcm.h"
+
+#define RTCM_CRC24Q_POLY 0x1864CFB
+
+// CRC-24Q查找表（程序启动时生成）
+static uint32_t rtcm_crc_table[256];
+
+/**
+ * @brief 生成CRC-24Q查找表
+ */
+__attribute__((constructor)) static void rtcm_crc_table_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 16;
+        for (int j = 0; j < 8; j++) {
+            crc <<= 1;
+            if (crc & 0x1000000) {
+                crc ^= RTCM_CRC24Q_POLY;
+            }
+        }
+        rtcm_crc_table[i] = crc & 0xFFFFFF;
+    }
+}
+
+/**
+ * @brief 计算CRC-24Q
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 24位校验值
+ */
+uint32_t rtcm_crc24q(const unsigned char *buf, size_t len)
+{
+    uint32_t crc = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        crc = ((crc << 8) & 0xFFFFFF) ^ rtcm_crc_table[(crc >> 16) ^ buf[i]];
+    }
+
+    return crc;
+}
+
+/**
+ * @brief 读取无符号位域（高位在前）
+ * @param buf 数据
+ * @param pos 起始位
+ * @param len 位数（1~32）
+ * @return 位域值
+ */
+uint32_t rtcm_get_bits(const unsigned char *buf, int pos, int len)
+{
+    uint32_t value = 0;
+
+    for (int i = pos; i < pos + len; i++) {
+        value = (value << 1) | ((buf[i / 8] >> (7 - i % 8)) & 1u);
+    }
+
+    return value;
+}
+
+/**
+ * @brief 写入无符号位域（高位在前）
+ * @param buf 数据
+ * @param pos 起始位
+ * @param len 位数（1~32）
+ * @param value 位域值
+ */
+void rtcm_set_bits(unsigned char *buf, int pos, int len, uint32_t value)
+{
+    for (int i = pos + len - 1; i >= pos; i--, value >>= 1) {
+        unsigned char mask = 1u << (7 - i % 8);
+        if (value & 1u) {
+            buf[i / 8] |= mask;
+        } else {
+            buf[i / 8] &= ~mask;
+        }
+    }
+}
+
+/**
+ * @brief 把电文封装为RTCM3帧
+ * @param payload 电文内容
+ * @param payload_len 电文长度（0~1023）
+ * @param out 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 帧长度，参数错误或缓冲区不足返回-1
+ */
+int rtcm_frame_encode(const unsigned char *payload, int payload_len, unsigned char *out, size_t size)
+{
+    int frame_len = RTCM3_HEADER_LEN + payload_len + RTCM3_CRC_LEN;
+
+    if (payload_len < 0 || payload_len > RTCM3_MAX_PAYLOAD || (size_t)frame_len > size) {
+        return -1;
+    }
+
+    out[0] = RTCM3_PREAMBLE;
+    out[1] = (payload_len >> 8) & 0x03;
+    out[2] = payload_len & 0xFF;
+    memcpy(&out[RTCM3_HEADER_LEN], payload, payload_len);
+
+    uint32_t crc = rtcm_crc24q(out, RTCM3_HEADER_LEN + payload_len);
+    out[frame_len - 3] = (crc >> 16) & 0xFF;
+    out[frame_len - 2] = (crc >> 8) & 0xFF;
+    out[frame_len - 1] = crc & 0xFF;
+
+    return frame_len;
+}
+
+/**
+ * @brief 校验完整帧的CRC
+ * @param frame 帧数据
+ * @param frame_len 帧长度
+ * @return 校验通过返回1，否则返回0
+ */
+static int rtcm_frame_crc_ok(const unsigned char *frame, int frame_len)
+{
+    uint32_t crc = rtcm_crc24q(frame, frame_len - RTCM3_CRC_LEN);
+    return ((crc >> 16) & 0xFF) == frame[frame_len - 3] &&
+           ((crc >> 8) & 0xFF) == frame[frame_len - 2] &&
+           (crc & 0xFF) == frame[frame_len - 1];
+}
+
+/**
+ * @brief 初始化分帧器
+ * @param f 分帧器
+ */
+void rtcm_framer_init(struct rtcm_framer *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+/**
+ * @brief 丢弃缓存中start之前的数据，并重新同步到下一个前导字节
+ * @param f 分帧器
+ * @param start 开始查找前导字节的位置
+ * @param consumed 开头已作为有效帧处理的字节数（不计入丢弃统计）
+ */
+static void rtcm_framer_resync(struct rtcm_framer *f, int start, int consumed)
+{
+    const unsigned char *p = NULL;
+
+    if (start < f->len) {
+        p = memchr(&f->buf[start], RTCM3_PREAMBLE, f->len - start);
+    }
+
+    int skip = (p != NULL) ? (int)(p - f->buf) : f->len;
+    f->skipped_bytes += skip - consumed;
+    f->len -= skip;
+    memmove(f->buf, &f->buf[skip], f->len);
+}
+
+/**
+ * @brief 输入一段字节流，对其中每个校验通过的完整帧调用回调
+ * @param f 分帧器
+ * @param data 输入数据
+ * @param len 输入长度
+ * @param cb 帧回调
+ * @param arg 回调参数
+ * 注：完整落在输入中的帧直接在输入缓冲区上回调，不做拷贝
+ */
+void rtcm_framer_push(struct rtcm_framer *f, const unsigned char *data, size_t len,
+                      rtcm_frame_fn cb, void *arg)
+{
+    size_t pos = 0;
+
+    while (1) {
+        // 先处理缓存中的半帧
+        if (f->len > 0) {
+            size_t n;
+
+            if (f->len < RTCM3_HEADER_LEN) {
+                n = RTCM3_HEADER_LEN - f->len;
+                if (n > len - pos) {
+                    n = len - pos;
+                }
+                memcpy(&f->buf[f->len], &data[pos], n);
+                f->len += n;
+                pos += n;
+                if (f->len < RTCM3_HEADER_LEN) {
+                    return;
+                }
+            }
+
+            if ((f->buf[1] & 0xFC) != 0) {
+                rtcm_framer_resync(f, 1, 0);
+                continue;
+            }
+
+            int frame_len = RTCM3_HEADER_LEN + (((f->buf[1] & 0x03) << 8) | f->buf[2]) + RTCM3_CRC_LEN;
+            if (f->len < frame_len) {
+                n = frame_len - f->len;
+                if (n > len - pos) {
+                    n = len - pos;
+                }
+                memcpy(&f->buf[f->len], &data[pos], n);
+                f->len += n;
+                pos += n;
+                if (f->len < frame_len) {
+                    return;
+                }
+            }
+
+            if (rtcm_frame_crc_ok(f->buf, frame_len)) {
+                f->frames++;
+                cb(f->buf, frame_len, arg);
+                rtcm_framer_resync(f, frame_len, frame_len);
+            } else {
+                f->crc_errors++;
+                rtcm_framer_resync(f, 1, 0);
+            }
+            continue;
+        }
+
+        if (pos >= len) {
+            return;
+        }
+
+        // 快速路径：直接在输入上查找前导字节
+        const unsigned char *p = memchr(&data[pos], RTCM3_PREAMBLE, len - pos);
+        if (p == NULL) {
+            f->skipped_bytes += len - pos;
+            return;
+        }
+        f->skipped_bytes += (size_t)(p - &data[pos]);
+        pos = p - data;
+
+        size_t avail = len - pos;
+        if (avail < RTCM3_HEADER_LEN) {
+            memcpy(f->buf, p, avail);
+            f->len = avail;
+            return;
+        }
+        if ((p[1] & 0xFC) != 0) {
+            f->skipped_bytes++;
+            pos++;
+            continue;
+        }
+
+        int frame_len = RTCM3_HEADER_LEN + (((p[1] & 0x03) << 8) | p[2]) + RTCM3_CRC_LEN;
+        if (avail < (size_t)frame_len) {
+            memcpy(f->buf, p, avail);
+            f->len = avail;
+            return;
+        }
+
+        if (rtcm_frame_crc_ok(p, frame_len)) {
+            f->frames++;
+            cb(p, frame_len, arg);
+            pos += frame_len;
+        } else {
+            f->crc_errors++;
+            f->skipped_bytes++;
+            pos++;
+        }
+    }
+}
+
+/**
+ * @brief 读取帧的电文号
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @return 电文号，电文过短返回-1
+ */
+int rtcm_msg_type(const unsigned char *frame, int len)
+{
+    if (len < RTCM3_HEADER_LEN + 2 + RTCM3_CRC_LEN) {
+        return -1;
+    }
+    return (frame[3] << 4) | (frame[4] >> 4);
+}
+
+/**
+ * @brief 判断电文是否为MSM并返回卫星系统
+ * @param type 电文号
+ * @return MSM1~7返回卫星系统（enum rtcm_sys），其他电文返回-1
+ */
+int rtcm_msm_sys(int type)
+{
+    static const int sys_map[7] = {
+        RTCM_SYS_GPS, RTCM_SYS_GLO, RTCM_SYS_GAL, RTCM_SYS_SBS,
+        RTCM_SYS_QZS, RTCM_SYS_BDS, RTCM_SYS_IRN
+    };
+
+    if (type < 1071 || type > 1137 || type % 10 < 1 || type % 10 > 7) {
+        return -1;
+    }
+    return sys_map[(type - 1070) / 10];
+}
+
+/**
+ * @brief 解析观测电文头（MSM1~7以及传统观测电文1001~1004、1009~1012）
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param hdr 输出的电文头
+ * @return 是观测电文返回1，不是观测电文返回0，电文过短返回-1
+ */
+int rtcm_parse_obs_header(const unsigned char *frame, int len, struct rtcm_obs_header *hdr)
+{
+    const unsigned char *payload = frame + RTCM3_HEADER_LEN;
+    int payload_len = len - RTCM3_HEADER_LEN - RTCM3_CRC_LEN;
+    int type = rtcm_msg_type(frame, len);
+
+    if (type < 0) {
+        return -1;
+    }
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->msg_type = type;
+
+    int sys = rtcm_msm_sys(type);
+    if (sys >= 0) {
+        // MSM：电文号(12) 站号(12) 历元(30) 多电文标志(1)
+        if (payload_len * 8 < 55) {
+            return -1;
+        }
+        hdr->sys = sys;
+        hdr->msm = type % 10;
+        hdr->station_id = rtcm_get_bits(payload, 12, 12);
+        hdr->epoch = rtcm_get_bits(payload, 24, 30);
+        hdr->multiple = rtcm_get_bits(payload, 54, 1);
+        return 1;
+    }
+
+    if (type >= 1001 && type <= 1004) {
+        // GPS传统观测：电文号(12) 站号(12) 周内秒毫秒(30) 同步标志(1)
+        if (payload_len * 8 < 55) {
+            return -1;
+        }
+        hdr->sys = RTCM_SYS_GPS;
+        hdr->station_id = rtcm_get_bits(payload, 12, 12);
+        hdr->epoch = rtcm_get_bits(payload, 24, 30);
+        hdr->multiple = rtcm_get_bits(payload, 54, 1);
+        return 1;
+    }
+
+    if (type >= 1009 && type <= 1012) {
+        // GLONASS传统观测：电文号(12) 站号(12) 日内毫秒(27) 同步标志(1)
+        if (payload_len * 8 < 52) {
+            return -1;
+        }
+        hdr->sys = RTCM_SYS_GLO;
+        hdr->station_id = rtcm_get_bits(payload, 12, 12);
+        hdr->epoch = rtcm_get_bits(payload, 24, 27);
+        hdr->multiple = rtcm_get_bits(payload, 51, 1);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 读取38位有符号坐标（0.1毫米）
+ * @param payload 电文
+ * @param pos 起始位
+ * @return 坐标（米）
+ */
+static double rtcm_get_coord(const unsigned char *payload, int pos)
+{
+    int64_t v = ((int64_t)rtcm_get_bits(payload, pos, 6) << 32) | rtcm_get_bits(payload, pos + 6, 32);
+
+    if (v & (1LL << 37)) {
+        v -= 1LL << 38;
+    }
+    return v * 0.0001;
+}
+
+/**
+ * @brief 解析基准站坐标电文（1005/1006）
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param st 输出的基准站坐标
+ * @return 是基准站坐标电文返回1，不是返回0，电文过短返回-1
+ */
+int rtcm_parse_station(const unsigned char *frame, int len, struct rtcm_station *st)
+{
+    const unsigned char *payload = frame + RTCM3_HEADER_LEN;
+    int payload_len = len - RTCM3_HEADER_LEN - RTCM3_CRC_LEN;
+    int type = rtcm_msg_type(frame, len);
+
+    if (type != 1005 && type != 1006) {
+        return type < 0 ? -1 : 0;
+    }
+
+    // 电文号(12) 站号(12) ITRF(6) 系统标志(4) X(38) 振荡器/保留(2) Y(38) 1/4周(2) Z(38) [天线高(16)]
+    if (payload_len * 8 < (type == 1005 ? 152 : 168)) {
+        return -1;
+    }
+    memset(st, 0, sizeof(*st));
+    st->msg_type = type;
+    st->station_id = rtcm_get_bits(payload, 12, 12);
+    st->ecef[0] = rtcm_get_coord(payload, 34);
+    st->ecef[1] = rtcm_get_coord(payload, 74);
+    st->ecef[2] = rtcm_get_coord(payload, 114);
+    if (type == 1006) {
+        st->height = rtcm_get_bits(payload, 152, 16) * 0.0001;
+    }
+    return 1;
+}
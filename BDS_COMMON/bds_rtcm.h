@@ -0,0 +1,80 @@
+/*
+ * bds_rtcm.h
+ * RTCM3帧处理头文件
+ * 功能：RTCM3分帧与CRC-24Q校验、帧封装、观测电文头（历元时间/多电文标志）解析、
+ *       基准站坐标电文（1005/1006）解析
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_RTCM_H
+#define BDS_RTCM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// RTCM3帧格式：前导字节(8) + 保留(6) + 长度(10) + 电文 + CRC-24Q(24)
+#define RTCM3_PREAMBLE      0xD3
+#define RTCM3_HEADER_LEN    3
+#define RTCM3_CRC_LEN       3
+#define RTCM3_MAX_PAYLOAD   1023
+#define RTCM3_MAX_FRAME     (RTCM3_HEADER_LEN + RTCM3_MAX_PAYLOAD + RTCM3_CRC_LEN)
+
+// 卫星系统编号
+enum rtcm_sys {
+    RTCM_SYS_GPS = 0,
+    RTCM_SYS_GLO,
+    RTCM_SYS_GAL,
+    RTCM_SYS_SBS,
+    RTCM_SYS_QZS,
+    RTCM_SYS_BDS,
+    RTCM_SYS_IRN,
+    RTCM_SYS_COUNT
+};
+
+// 观测电文头
+struct rtcm_obs_header {
+    int msg_type;          // 电文号
+    int sys;               // 卫星系统（enum rtcm_sys）
+    int msm;               // MSM等级（4~7），传统观测电文为0
+    int station_id;        // 参考站ID
+    uint32_t epoch;        // 历元时间（GPS/BDS等为周内毫秒，GLONASS为星期+日内毫秒）
+    int multiple;          // 多电文标志：1表示本历元还有后续观测电文
+};
+
+// 基准站坐标（1005/1006）
+struct rtcm_station {
+    int msg_type;          // 电文号
+    int station_id;        // 参考站ID
+    double ecef[3];        // 天线参考点ECEF坐标（米）
+    double height;         // 天线高（米，仅1006）
+};
+
+// 帧回调：frame指向完整帧（含帧头和CRC），len为帧长度
+typedef void (*rtcm_frame_fn)(const unsigned char *frame, int len, void *arg);
+
+// 分帧器状态（只缓存跨读取边界的半帧）
+struct rtcm_framer {
+    unsigned char buf[RTCM3_MAX_FRAME];
+    int len;                   // 已缓存的字节数
+    uint64_t frames;           // 校验通过的帧数
+    uint64_t crc_errors;       // CRC错误次数
+    uint64_t skipped_bytes;    // 同步过程中丢弃的字节数
+};
+
+// 函数声明
+uint32_t rtcm_crc24q(const unsigned char *buf, size_t len);
+uint32_t rtcm_get_bits(const unsigned char *buf, int pos, int len);
+void rtcm_set_bits(unsigned char *buf, int pos, int len, uint32_t value);
+int rtcm_frame_encode(const unsigned char *payload, int payload_len, unsigned char *out, size_t size);
+void rtcm_framer_init(struct rtcm_framer *f);
+void rtcm_framer_push(struct rtcm_framer *f, const unsigned char *data, size_t len,
+                      rtcm_frame_fn cb, void *arg);
+int rtcm_msg_type(const unsigned char *frame, int len);
+int rtcm_msm_sys(int type);
+int rtcm_parse_obs_header(const unsigned char *frame, int len, struct rtcm_obs_header *hdr);
+int rtcm_parse_station(const unsigned char *frame, int len, struct rtcm_station *st);
+
+#endif /* BDS_RTCM_H */
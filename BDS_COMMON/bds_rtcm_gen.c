@@ -0,0 +1,777 @@
+/*
+ * bds_rtcm_gen.c
+ * RTCM3数据流生成工具
+ * 功能：按配置的卫星系统、卫星数、信号数和历元频率生成CRC正确的MSM4/5/7观测电文，
+ *       附带1005基准站坐标和星历电文，输出到标准输出、伪终端、TCP连接或文件，
+ *       配合基站/流动站程序复现高卫星数、多频点、高频率下的最坏负载
+ * 使用：bds_rtcm_gen [-s 系统] [-m 4|5|7] [-r 频率] [-o 输出] ...（-h查看全部参数）
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "bds_msm.h"
+#include "bds_time.h"
+
+// 生成配置
+#define GEN_MAX_SYS         RTCM_SYS_COUNT
+#define GEN_MAX_SIGS        4           // 每个系统可选的信号数
+#define GEN_DEFAULT_SYSTEMS "C:24:3,G:10:2,E:8:2,R:6:2"
+#define GEN_DEFAULT_XYZ     { -2148744.3969, 4426641.2099, 4044655.8564 }  // 北京附近的ECEF坐标（米）
+#define GEN_EPOCH_SIZE      (64 * 1024) // 单个历元的输出缓冲区
+
+// 时间换算
+#define GPS_UNIX_OFFSET     315964800LL // GPS时起点（1980-01-06）的Unix时间
+#define GPS_LEAP_SECONDS    18          // GPS时与UTC之差
+#define BDS_GPS_OFFSET      14          // GPS时与北斗时之差
+#define WEEK_MS             604800000LL
+#define DAY_MS              86400000LL
+#define LIGHT_MS            299792.458  // 光在1毫秒内走过的距离（米）
+
+// 各系统参数
+struct gen_sys_info {
+    char code;                          // 命令行代码（RINEX系统字母）
+    int msm_base;                       // MSM电文号基数（MSMn = 基数 + n）
+    int max_sats;                       // 卫星号上限
+    int eph_type;                       // 星历电文号，0表示不生成
+    int eph_len;                        // 星历电文长度（字节）
+    int sigs[GEN_MAX_SIGS];             // 可选信号号（MSM信号掩码位置），按常用程度排列
+};
+
+static const struct gen_sys_info gen_sys_table[GEN_MAX_SYS] = {
+    [RTCM_SYS_GPS] = { 'G', 1070, 32, 1019, 61, { 2, 10, 16, 23 } },  // 1C 2W 2L 5Q
+    [RTCM_SYS_GLO] = { 'R', 1080, 24, 1020, 45, { 2, 8, 3, 9 } },     // 1C 2C 1P 2P
+    [RTCM_SYS_GAL] = { 'E', 1090, 36, 1046, 63, { 2, 23, 15, 8 } },   // 1C 5Q 7Q 6C
+    [RTCM_SYS_SBS] = { 'S', 1100, 39, 0, 0, { 2, 23, 0, 0 } },        // 1C 5Q
+    [RTCM_SYS_QZS] = { 'J', 1110, 10, 1044, 61, { 2, 16, 23, 31 } },  // 1C 2L 5Q 1L
+    [RTCM_SYS_BDS] = { 'C', 1120, 63, 1042, 64, { 2, 8, 14, 23 } },   // 2I(B1I) 6I(B3I) 7I(B2I) 5P(B2a)
+    [RTCM_SYS_IRN] = { 'I', 1130, 14, 0, 0, { 22, 0, 0, 0 } },        // 5A
+};
+
+// 单颗卫星的模拟状态
+struct gen_sat {
+    double range0;                      // 起始距离（米）
+    double rate;                        // 距离变化率（米/秒）
+    int cnr;                            // 载噪比（dB-Hz）
+};
+
+// 单个系统的生成配置
+struct gen_sys {
+    int enabled;
+    int nsat;
+    int nsig;
+    uint8_t sig_id[GEN_MAX_SIGS];       // 选用的信号号（升序，供信号掩码使用）
+    struct gen_sat sats[MSM_MAX_SATS];
+};
+
+// 运行参数
+struct gen_options {
+    struct gen_sys sys[GEN_MAX_SYS];
+    int msm;                            // MSM等级
+    int rate;                           // 历元频率（Hz）
+    int arp_interval;                   // 1005间隔（秒），0表示不发送
+    int eph_interval;                   // 每颗卫星的星历发送周期（秒），0表示不发送
+    int station_id;
+    double xyz[3];                      // 基准站ECEF坐标（米）
+    long long epochs;                   // 生成的历元数，0表示不限
+    int fast;                           // 不按历元频率等待，尽快输出
+    const char *output;                 // 输出目标
+};
+
+// 统计
+struct gen_stats {
+    long long epochs;
+    long long msm_msgs;
+    long long aux_msgs;
+    long long bytes;
+    int max_epoch_bytes;
+};
+
+static volatile sig_atomic_t gen_stop = 0;
+
+/**
+ * @brief 退出信号处理
+ * @param sig 信号编号
+ */
+static void gen_signal_handler(int sig)
+{
+    (void)sig;
+    gen_stop = 1;
+}
+
+/**
+ * @brief 伪随机数（xorshift32），保证每次运行生成相同的卫星配置
+ * @param state 状态
+ * @return 随机数
+ */
+static uint32_t gen_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief 四舍五入取整
+ * @param x 数值
+ * @return 最接近的整数
+ */
+static int64_t gen_round(double x)
+{
+    return x >= 0 ? (int64_t)(x + 0.5) : -(int64_t)(-x + 0.5);
+}
+
+/**
+ * @brief 解析卫星系统配置，如"C:24:3,G:10:2"（系统:卫星数:信号数）
+ * @param list 配置字符串
+ * @param opts 输出的运行参数
+ * @return 成功返回0，格式错误返回-1
+ */
+static int gen_parse_systems(const char *list, struct gen_options *opts)
+{
+    const char *p = list;
+
+    for (int i = 0; i < GEN_MAX_SYS; i++) {
+        opts->sys[i].enabled = 0;
+    }
+
+    while (*p != '\0') {
+        char code;
+        int nsat, nsig = 1, used = 0;
+        if (sscanf(p, "%c:%d%n:%d%n", &code, &nsat, &used, &nsig, &used) < 2) {
+            fprintf(stderr, "bad system spec: %s\n", p);
+            return -1;
+        }
+
+        int s;
+        for (s = 0; s < GEN_MAX_SYS; s++) {
+            if (gen_sys_table[s].code == code) {
+                break;
+            }
+        }
+        if (s == GEN_MAX_SYS) {
+            fprintf(stderr, "unknown system '%c' (use C G R E J S I)\n", code);
+            return -1;
+        }
+        int max_sigs = 0;
+        while (max_sigs < GEN_MAX_SIGS && gen_sys_table[s].sigs[max_sigs] != 0) {
+            max_sigs++;
+        }
+        if (nsat < 1 || nsat > gen_sys_table[s].max_sats || nsig < 1 || nsig > max_sigs) {
+            fprintf(stderr, "bad system spec %c:%d:%d (satellites 1..%d, signals 1..%d)\n",
+                    code, nsat, nsig, gen_sys_table[s].max_sats, max_sigs);
+            return -1;
+        }
+
+        // 取最常用的nsig个信号，按信号号升序排列
+        struct gen_sys *sys = &opts->sys[s];
+        sys->enabled = 1;
+        sys->nsat = nsat;
+        sys->nsig = nsig;
+        for (int j = 0; j < nsig; j++) {
+            int k = j;
+            while (k > 0 && sys->sig_id[k - 1] > gen_sys_table[s].sigs[j]) {
+                sys->sig_id[k] = sys->sig_id[k - 1];
+                k--;
+            }
+            sys->sig_id[k] = gen_sys_table[s].sigs[j];
+        }
+
+        p += used;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            fprintf(stderr, "bad system spec: %s\n", p);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @param opts 输出的运行参数
+ * @return 成功返回0，失败返回-1
+ */
+static int gen_parse_options(int argc, char *argv[], struct gen_options *opts)
+{
+    static const double default_xyz[3] = GEN_DEFAULT_XYZ;
+    const char *systems = GEN_DEFAULT_SYSTEMS;
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->msm = 7;
+    opts->rate = 1;
+    opts->arp_interval = 10;
+    opts->eph_interval = 60;
+    opts->station_id = 1;
+    memcpy(opts->xyz, default_xyz, sizeof(opts->xyz));
+    opts->output = "-";
+
+    while ((c = getopt(argc, argv, "s:m:r:p:e:i:x:n:fo:h")) != -1) {
+        switch (c) {
+        case 's':
+            systems = optarg;
+            break;
+        case 'm':
+            opts->msm = atoi(optarg);
+            if (opts->msm != 4 && opts->msm != 5 && opts->msm != 7) {
+                fprintf(stderr, "MSM level must be 4, 5 or 7\n");
+                return -1;
+            }
+            break;
+        case 'r':
+            opts->rate = atoi(optarg);
+            if (opts->rate < 1 || opts->rate > 50) {
+                fprintf(stderr, "epoch rate must be 1..50 Hz\n");
+                return -1;
+            }
+            break;
+        case 'p':
+            opts->arp_interval = atoi(optarg);
+            break;
+        case 'e':
+            opts->eph_interval = atoi(optarg);
+            break;
+        case 'i':
+            opts->station_id = atoi(optarg) & 0xFFF;
+            break;
+        case 'x':
+            if (sscanf(optarg, "%lf,%lf,%lf", &opts->xyz[0], &opts->xyz[1], &opts->xyz[2]) != 3) {
+                fprintf(stderr, "station position must be X,Y,Z in metres\n");
+                return -1;
+            }
+            break;
+        case 'n':
+            opts->epochs = atoll(optarg);
+            break;
+        case 'f':
+            opts->fast = 1;
+            break;
+        case 'o':
+            opts->output = optarg;
+            break;
+        case 'h':
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-s systems] [-m 4|5|7] [-r rate_hz] [-p arp_interval_s] [-e eph_interval_s]\n"
+                    "       [-i station_id] [-x X,Y,Z] [-n epochs] [-f] [-o output]\n"
+                    "  -s  sys:sats:signals list, default %s\n"
+                    "      (C=BDS G=GPS R=GLONASS E=Galileo J=QZSS S=SBAS I=NavIC)\n"
+                    "  -p  1005 interval, -e per-satellite ephemeris period (0 disables)\n"
+                    "  -f  emit as fast as possible instead of at the epoch rate\n"
+                    "  -o  - (stdout, default) | pty[:link] | tcp:host:port | file or tty path\n",
+                    argv[0], GEN_DEFAULT_SYSTEMS);
+            return -1;
+        }
+    }
+
+    return gen_parse_systems(systems, opts);
+}
+
+/**
+ * @brief 初始化各卫星的距离、距离变化率和载噪比
+ * @param opts 运行参数
+ */
+static void gen_init_sats(struct gen_options *opts)
+{
+    uint32_t seed = 0x2545F491;
+
+    for (int s = 0; s < GEN_MAX_SYS; s++) {
+        struct gen_sys *sys = &opts->sys[s];
+        for (int i = 0; i < sys->nsat; i++) {
+            struct gen_sat *sat = &sys->sats[i];
+            // 北斗GEO/IGSO卫星（C01~C10）距离约36000~40000km，其余MEO约20000~26000km
+            if (s == RTCM_SYS_BDS && i < 10) {
+                sat->range0 = 36000e3 + (gen_rand(&seed) % 4000) * 1e3;
+                sat->rate = (gen_rand(&seed) % 2000) / 10.0 - 100.0;
+            } else {
+                sat->range0 = 20000e3 + (gen_rand(&seed) % 6000) * 1e3;
+                sat->rate = (gen_rand(&seed) % 16000) / 10.0 - 800.0;
+            }
+            sat->cnr = 35 + gen_rand(&seed) % 16;
+        }
+    }
+}
+
+/**
+ * @brief 计算各系统MSM电文中的历元时间
+ * @param sys 卫星系统
+ * @param gps_ms GPS时（自GPS时起点的毫秒数）
+ * @return 历元时间字段（GLONASS为星期(3位)+日内毫秒(27位)，其他为周内毫秒）
+ */
+static uint32_t gen_epoch_time(int sys, int64_t gps_ms)
+{
+    if (sys == RTCM_SYS_BDS) {
+        return (uint32_t)(((gps_ms - BDS_GPS_OFFSET * 1000) % WEEK_MS + WEEK_MS) % WEEK_MS);
+    }
+    if (sys == RTCM_SYS_GLO) {
+        // GLONASS时 = UTC + 3小时；GPS时起点为星期日
+        int64_t glo_ms = gps_ms - GPS_LEAP_SECONDS * 1000 + 3 * 3600 * 1000LL;
+        int64_t dow = (glo_ms / DAY_MS) % 7;
+        return (uint32_t)((dow << 27) | (glo_ms % DAY_MS));
+    }
+    return (uint32_t)(gps_ms % WEEK_MS);
+}
+
+/**
+ * @brief 把一条电文封装成帧追加到历元缓冲区
+ * @param payload 电文
+ * @param len 电文长度
+ * @param out 历元缓冲区
+ * @param out_len 已用长度（输入输出）
+ * @return 成功返回0，缓冲区不足返回-1
+ */
+static int gen_append_frame(const unsigned char *payload, int len, unsigned char *out, int *out_len)
+{
+    int n = rtcm_frame_encode(payload, len, out + *out_len, GEN_EPOCH_SIZE - *out_len);
+    if (n < 0) {
+        return -1;
+    }
+    *out_len += n;
+    return 0;
+}
+
+/**
+ * @brief 生成1005基准站坐标电文
+ * @param opts 运行参数
+ * @param payload 输出电文
+ * @return 电文长度
+ */
+static int gen_1005(const struct gen_options *opts, unsigned char *payload)
+{
+    int64_t x = (int64_t)(opts->xyz[0] * 10000.0);
+    int64_t y = (int64_t)(opts->xyz[1] * 10000.0);
+    int64_t z = (int64_t)(opts->xyz[2] * 10000.0);
+
+    memset(payload, 0, 19);
+    rtcm_set_bits(payload, 0, 12, 1005);
+    rtcm_set_bits(payload, 12, 12, opts->station_id);
+    rtcm_set_bits(payload, 30, 1, opts->sys[RTCM_SYS_GPS].enabled);
+    rtcm_set_bits(payload, 31, 1, opts->sys[RTCM_SYS_GLO].enabled);
+    rtcm_set_bits(payload, 32, 1, opts->sys[RTCM_SYS_GAL].enabled);
+    // 38位有符号坐标分高6位和低32位写入
+    rtcm_set_bits(payload, 34, 6, (uint32_t)(x >> 32) & 0x3F);
+    rtcm_set_bits(payload, 40, 32, (uint32_t)x);
+    rtcm_set_bits(payload, 74, 6, (uint32_t)(y >> 32) & 0x3F);
+    rtcm_set_bits(payload, 80, 32, (uint32_t)y);
+    rtcm_set_bits(payload, 114, 6, (uint32_t)(z >> 32) & 0x3F);
+    rtcm_set_bits(payload, 120, 32, (uint32_t)z);
+
+    return 19;
+}
+
+/**
+ * @brief 生成一条星历电文（电文号、卫星号正确，轨道参数为填充数据）
+ * @param info 系统参数
+ * @param prn 卫星号
+ * @param payload 输出电文
+ * @return 电文长度
+ */
+static int gen_ephemeris(const struct gen_sys_info *info, int prn, unsigned char *payload)
+{
+    uint32_t seed = 0x9E3779B9u ^ (uint32_t)(info->eph_type * 64 + prn);
+
+    for (int i = 0; i < info->eph_len; i++) {
+        payload[i] = (unsigned char)gen_rand(&seed);
+    }
+    rtcm_set_bits(payload, 0, 12, info->eph_type);
+    rtcm_set_bits(payload, 12, 6, prn);
+
+    return info->eph_len;
+}
+
+/**
+ * @brief 生成一个系统的MSM电文（单元数超过64时按卫星拆分为多条，设置多电文标志）
+ * @param opts 运行参数
+ * @param s 卫星系统
+ * @param gps_ms 历元的GPS时（毫秒）
+ * @param elapsed_ms 自开始生成的时间（毫秒）
+ * @param last 是否为本历元最后一个系统
+ * @param out 历元缓冲区
+ * @param out_len 已用长度（输入输出）
+ * @return 生成的电文数，失败返回-1
+ */
+static int gen_msm(const struct gen_options *opts, int s, int64_t gps_ms, uint64_t elapsed_ms,
+                   int last, unsigned char *out, int *out_len)
+{
+    static struct msm_obs obs;
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+    const struct gen_sys *sys = &opts->sys[s];
+    const struct gen_sys_info *info = &gen_sys_table[s];
+    int per_msg = MSM_MAX_CELLS / sys->nsig;
+    int msgs = 0;
+    double t = elapsed_ms / 1000.0;
+
+    for (int first = 0; first < sys->nsat; first += per_msg) {
+        int nsat = sys->nsat - first < per_msg ? sys->nsat - first : per_msg;
+
+        memset(&obs, 0, sizeof(obs));
+        obs.hdr.msg_type = info->msm_base + opts->msm;
+        obs.hdr.station_id = opts->station_id;
+        obs.hdr.epoch = gen_epoch_time(s, gps_ms);
+        obs.hdr.multiple = !(last && first + nsat >= sys->nsat);
+        obs.nsat = nsat;
+        obs.nsig = sys->nsig;
+        for (int j = 0; j < sys->nsig; j++) {
+            obs.sig_id[j] = sys->sig_id[j];
+        }
+
+        for (int i = 0; i < nsat; i++) {
+            const struct gen_sat *sat = &sys->sats[first + i];
+            double range = sat->range0 + sat->rate * t;
+            double ms = range / LIGHT_MS;
+            // 粗略距离取最近的2^-10毫秒，精细伪距在±2^-11毫秒内
+            int64_t rough_units = (int64_t)(ms * 1024.0 + 0.5);
+            double rough = rough_units / 1024.0;
+
+            obs.sat_id[i] = first + i + 1;
+            obs.rough_ms[i] = (uint8_t)(rough_units >> 10);
+            obs.rough_mod[i] = (uint16_t)(rough_units & 0x3FF);
+            obs.rough_rate[i] = (int16_t)gen_round(sat->rate);
+            obs.ext_info[i] = 0;
+
+            for (int j = 0; j < sys->nsig; j++) {
+                int c = obs.ncell++;
+                // 各信号加不同的码偏差，相位加固定的整周偏移
+                double pr_res = (ms - rough) + j * 1e-7;
+                obs.cell_sat[c] = i;
+                obs.cell_sig[c] = j;
+                obs.fine_pr[c] = (int32_t)(pr_res * (1 << 29));
+                obs.fine_phase[c] = (int32_t)(pr_res * 2147483648.0) + (j + 1) * 4096;
+                obs.lock[c] = msm_lock_indicator(elapsed_ms, opts->msm);
+                obs.half_cycle[c] = 0;
+                obs.cnr[c] = (sat->cnr - 3 * j) * 16;
+                obs.fine_rate[c] = (int16_t)((sat->rate - obs.rough_rate[i]) * 10000.0);
+            }
+        }
+
+        int len = msm_encode(&obs, payload, sizeof(payload));
+        if (len < 0 || gen_append_frame(payload, len, out, out_len) != 0) {
+            fprintf(stderr, "MSM%d encode failed (%c, %d satellites x %d signals)\n",
+                    opts->msm, info->code, nsat, sys->nsig);
+            return -1;
+        }
+        msgs++;
+    }
+
+    return msgs;
+}
+
+/**
+ * @brief 生成一个历元：1005和到期的星历在前，各系统MSM电文在后，最后一条的多电文标志为0
+ * @param opts 运行参数
+ * @param k 历元序号
+ * @param gps_ms0 第一个历元的GPS时（毫秒）
+ * @param out 历元缓冲区
+ * @param stats 统计
+ * @return 历元字节数，失败返回-1
+ */
+static int gen_epoch(const struct gen_options *opts, long long k, int64_t gps_ms0,
+                     unsigned char *out, struct gen_stats *stats)
+{
+    static int eph_sys = 0, eph_sat = 0;
+    static double eph_credit = 0.0;
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+    uint64_t elapsed_ms = (uint64_t)(k * 1000 / opts->rate);
+    int64_t gps_ms = gps_ms0 + (int64_t)elapsed_ms;
+    int out_len = 0;
+
+    // 基准站坐标
+    if (opts->arp_interval > 0 && k % ((long long)opts->arp_interval * opts->rate) == 0) {
+        gen_append_frame(payload, gen_1005(opts, payload), out, &out_len);
+        stats->aux_msgs++;
+    }
+
+    // 星历：每颗卫星在一个周期内发送一次，平均分散到各历元，不集中在同一时刻
+    if (opts->eph_interval > 0) {
+        int total = 0;
+        for (int s = 0; s < GEN_MAX_SYS; s++) {
+            if (opts->sys[s].enabled && gen_sys_table[s].eph_type != 0) {
+                total += opts->sys[s].nsat;
+            }
+        }
+        eph_credit += (double)total / ((double)opts->eph_interval * opts->rate);
+        for (int guard = 0; total > 0 && eph_credit >= 1.0 && guard < total; guard++) {
+            while (!opts->sys[eph_sys].enabled || gen_sys_table[eph_sys].eph_type == 0 ||
+                   eph_sat >= opts->sys[eph_sys].nsat) {
+                eph_sys = (eph_sys + 1) % GEN_MAX_SYS;
+                eph_sat = 0;
+            }
+            int len = gen_ephemeris(&gen_sys_table[eph_sys], eph_sat + 1, payload);
+            gen_append_frame(payload, len, out, &out_len);
+            stats->aux_msgs++;
+            eph_sat++;
+            eph_credit -= 1.0;
+        }
+    }
+
+    // 观测电文：北斗在前，其余按系统编号
+    static const int order[GEN_MAX_SYS] = {
+        RTCM_SYS_BDS, RTCM_SYS_GPS, RTCM_SYS_GLO, RTCM_SYS_GAL,
+        RTCM_SYS_QZS, RTCM_SYS_SBS, RTCM_SYS_IRN
+    };
+    int last = -1;
+    for (int i = 0; i < GEN_MAX_SYS; i++) {
+        if (opts->sys[order[i]].enabled) {
+            last = order[i];
+        }
+    }
+    for (int i = 0; i < GEN_MAX_SYS; i++) {
+        int s = order[i];
+        if (!opts->sys[s].enabled) {
+            continue;
+        }
+        int msgs = gen_msm(opts, s, gps_ms, elapsed_ms, s == last, out, &out_len);
+        if (msgs < 0) {
+            return -1;
+        }
+        stats->msm_msgs += msgs;
+    }
+
+    stats->epochs++;
+    stats->bytes += out_len;
+    if (out_len > stats->max_epoch_bytes) {
+        stats->max_epoch_bytes = out_len;
+    }
+    return out_len;
+}
+
+/**
+ * @brief 创建伪终端，从端按原始模式设置，供基站程序当作串口打开
+ * @param link 指向从端的符号链接路径，NULL表示不创建
+ * @param slave_fd 输出的从端描述符（保持打开，读取方关闭后写入不会失败）
+ * @return 成功返回主端描述符，失败返回-1
+ */
+static int gen_open_pty(const char *link, int *slave_fd)
+{
+    struct termios tio;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        perror("posix_openpt failed");
+        return -1;
+    }
+
+    const char *name = ptsname(fd);
+    *slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if (*slave_fd < 0 || tcgetattr(*slave_fd, &tio) != 0) {
+        perror("open pty slave failed");
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(*slave_fd, TCSANOW, &tio);
+
+    // 只替换已有的符号链接，不会误删真实的串口设备或文件
+    if (link != NULL) {
+        struct stat st;
+        if (lstat(link, &st) == 0 && !S_ISLNK(st.st_mode)) {
+            fprintf(stderr, "%s exists and is not a symlink, not replacing it\n", link);
+            link = NULL;
+        } else if ((unlink(link) != 0 && errno != ENOENT) || symlink(name, link) != 0) {
+            perror("symlink failed");
+            link = NULL;
+        }
+    }
+    fprintf(stderr, "Serial stream on %s%s%s\n", name, link ? " -> " : "", link ? link : "");
+
+    return fd;
+}
+
+/**
+ * @brief 连接TCP服务器
+ * @param spec 主机:端口
+ * @return 成功返回socket描述符，失败返回-1
+ */
+static int gen_connect(const char *spec)
+{
+    char host[256];
+    const char *colon = strrchr(spec, ':');
+    struct addrinfo hints, *res;
+
+    if (colon == NULL || colon - spec >= (int)sizeof(host)) {
+        fprintf(stderr, "TCP output must be tcp:host:port\n");
+        return -1;
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(host, colon + 1, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "getaddrinfo %s: %s\n", spec, gai_strerror(err));
+        return -1;
+    }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        perror("connect failed");
+        if (fd >= 0) {
+            close(fd);
+        }
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    fprintf(stderr, "Streaming to %s\n", spec);
+    return fd;
+}
+
+/**
+ * @brief 打开输出目标
+ * @param output 输出目标（-、pty[:link]、tcp:host:port或路径）
+ * @param slave_fd 伪终端从端描述符（仅pty输出时设置）
+ * @return 成功返回描述符，失败返回-1
+ */
+static int gen_open_output(const char *output, int *slave_fd)
+{
+    *slave_fd = -1;
+
+    if (strcmp(output, "-") == 0) {
+        return STDOUT_FILENO;
+    }
+    if (strcmp(output, "pty") == 0 || strncmp(output, "pty:", 4) == 0) {
+        return gen_open_pty(output[3] == ':' ? output + 4 : NULL, slave_fd);
+    }
+    if (strncmp(output, "tcp:", 4) == 0) {
+        return gen_connect(output + 4);
+    }
+
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+    if (fd < 0) {
+        perror(output);
+    }
+    return fd;
+}
+
+/**
+ * @brief 写出全部数据
+ * @param fd 描述符
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 成功返回0，失败返回-1
+ */
+static int gen_write_all(int fd, const unsigned char *buf, int len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                if (gen_stop) {
+                    return -1;
+                }
+                continue;
+            }
+            perror("write failed");
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回1
+ */
+int main(int argc, char *argv[])
+{
+    static unsigned char epoch_buf[GEN_EPOCH_SIZE];
+    struct gen_options opts;
+    struct gen_stats stats;
+    int slave_fd;
+
+    if (gen_parse_options(argc, argv, &opts) != 0) {
+        return 1;
+    }
+    gen_init_sats(&opts);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = gen_signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = gen_open_output(opts.output, &slave_fd);
+    if (fd < 0) {
+        return 1;
+    }
+
+    // 第一个历元对齐到下一个整历元，历元时间取自系统时钟，之后按单调时钟等待
+    uint64_t period_ns = 1000000000ULL / opts.rate;
+    uint64_t real_ns = bds_realtime_ns();
+    uint64_t start_real = (real_ns / period_ns + 1) * period_ns;
+    uint64_t start_mono = bds_now_ns() + (start_real - real_ns);
+    int64_t gps_ms0 = (int64_t)(start_real / 1000000ULL) - GPS_UNIX_OFFSET * 1000 + GPS_LEAP_SECONDS * 1000;
+
+    memset(&stats, 0, sizeof(stats));
+    int ret = 0;
+    for (long long k = 0; !gen_stop && (opts.epochs == 0 || k < opts.epochs); k++) {
+        if (!opts.fast) {
+            uint64_t due = start_mono + (uint64_t)k * 1000000000ULL / opts.rate;
+            struct timespec ts = { .tv_sec = due / 1000000000ULL, .tv_nsec = due % 1000000000ULL };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !gen_stop) {
+            }
+            if (gen_stop) {
+                break;
+            }
+        }
+
+        int len = gen_epoch(&opts, k, gps_ms0, epoch_buf, &stats);
+        if (len < 0 || gen_write_all(fd, epoch_buf, len) != 0) {
+            ret = gen_stop ? 0 : 1;
+            break;
+        }
+
+        // 第一个历元后给出所需的串口速率，便于判断是否超过接收机串口能力
+        if (k == 0) {
+            fprintf(stderr, "Epoch 0: %d bytes, %lld MSM%d messages, %d Hz -> %d bit/s on a serial line\n",
+                    len, stats.msm_msgs, opts.msm, opts.rate, len * opts.rate * 10);
+        }
+    }
+
+    fprintf(stderr, "Generated %lld epochs, %lld MSM + %lld other messages, %lld bytes "
+            "(avg %lld, max %d bytes per epoch)\n",
+            stats.epochs, stats.msm_msgs, stats.aux_msgs, stats.bytes,
+            stats.epochs > 0 ? stats.bytes / stats.epochs : 0, stats.max_epoch_bytes);
+
+    if (slave_fd >= 0) {
+        // 关闭主端会丢弃从端尚未读走的数据，先等待读取方读完（最多2秒）
+        int pending = 0;
+        for (int i = 0; i < 200 && !gen_stop; i++) {
+            if (ioctl(slave_fd, FIONREAD, &pending) != 0 || pending == 0) {
+                break;
+            }
+            usleep(10000);
+        }
+        close(slave_fd);
+    }
+    if (fd != STDOUT_FILENO) {
+        close(fd);
+    }
+    return ret;
+}
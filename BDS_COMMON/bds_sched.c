@@ -0,0 +1,201 @@
+/*
+ * bds_sched.c
+ * 发送调度源文件
+ * 功能：电文分类、按链路积压分级降级、延后类电文抽稀、MSM观测值改发MSM4
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_sched.h"
+
+// 基站描述类电文：坐标、天线、接收机、系统参数、文本、GLONASS码相位偏差
+static const int sched_station_types[SCHED_STATION_TYPES] = { 1005, 1006, 1007, 1008, 1013, 1029, 1033, 1230 };
+
+// 星历电文：GPS、GLONASS、NavIC、BDS、SBAS、QZSS、Galileo F/NAV、Galileo I/NAV
+static const int sched_eph_types[SCHED_EPH_TYPES] = { 1019, 1020, 1041, 1042, 1043, 1044, 1045, 1046 };
+
+// 各降级等级下延后类电文的抽稀倍数（每N条发1条）
+static const int sched_decimation[SCHED_MAX_LEVEL + 1] = { 1, 4, 4, 16 };
+
+static const char *sched_class_names[SCHED_CLASSES] = { "observation", "station", "ephemeris" };
+
+/**
+ * @brief 在电文号表中查找
+ * @return 下标，不在表中返回-1
+ */
+static int sched_find(const int *types, int count, int type)
+{
+    for (int i = 0; i < count; i++) {
+        if (types[i] == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 按电文号分类
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @return enum sched_class（无法识别的电文按观测值处理，不会被延后或丢弃）
+ */
+int sched_classify(const unsigned char *frame, int len)
+{
+    int type = rtcm_msg_type(frame, len);
+
+    if (sched_find(sched_eph_types, SCHED_EPH_TYPES, type) >= 0) {
+        return SCHED_EPH;
+    }
+    if (sched_find(sched_station_types, SCHED_STATION_TYPES, type) >= 0) {
+        return SCHED_STATION;
+    }
+    return SCHED_OBS;
+}
+
+/**
+ * @brief 取星历电文的卫星号
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @return 卫星号（0~63），不是星历电文返回-1
+ */
+int sched_sat(const unsigned char *frame, int len)
+{
+    int type = rtcm_msg_type(frame, len);
+
+    if (sched_find(sched_eph_types, SCHED_EPH_TYPES, type) < 0 || len < RTCM3_HEADER_LEN + 3) {
+        return -1;
+    }
+    // 卫星号紧跟在电文号之后（QZSS为4位，其余为6位）
+    return (int)rtcm_get_bits(&frame[RTCM3_HEADER_LEN], 12, type == 1044 ? 4 : 6);
+}
+
+/**
+ * @brief 初始化链路降级状态
+ * @param s 降级状态
+ * @param low_water 延后门限（字节）
+ */
+void sched_link_init(struct sched_link *s, int low_water)
+{
+    memset(s, 0, sizeof(*s));
+    s->low_water = low_water;
+}
+
+/**
+ * @brief 输入一次积压采样，按持续时间升降等级
+ * @param s 降级状态
+ * @param backlog 尚未发出的字节数（socket中未发送的部分加本端队列）
+ * @param now_ns 当前时间（单调时钟纳秒）
+ * @return 等级提高返回1，降低返回-1，不变返回0
+ */
+int sched_update(struct sched_link *s, int backlog, uint64_t now_ns)
+{
+    // 一次低于拥塞上限的采样即打断拥塞计时，一次超过畅通上限的采样即打断畅通计时
+    if (backlog > s->low_water * SCHED_HIGH_FACTOR) {
+        if (s->congested_ns == 0) {
+            s->congested_ns = now_ns;
+        }
+    } else {
+        s->congested_ns = 0;
+    }
+    if (backlog < s->low_water * SCHED_CLEAR_FACTOR) {
+        if (s->clear_ns == 0) {
+            s->clear_ns = now_ns;
+        }
+    } else {
+        s->clear_ns = 0;
+    }
+
+    if (s->congested_ns != 0 && now_ns - s->congested_ns >= SCHED_ESCALATE_MS * 1000000ULL &&
+        s->level < SCHED_MAX_LEVEL) {
+        s->level++;
+        s->congested_ns = now_ns;
+        return 1;
+    }
+    if (s->clear_ns != 0 && now_ns - s->clear_ns >= SCHED_RELAX_MS * 1000000ULL && s->level > 0) {
+        s->level--;
+        s->clear_ns = now_ns;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 按当前等级决定延后类电文是否发送（星历按卫星、基站描述按电文号分别抽稀，每颗卫星都能轮到）
+ * @param s 降级状态
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param cls 电文类别
+ * @return 发送返回1，抽掉返回0
+ */
+int sched_keep(struct sched_link *s, const unsigned char *frame, int len, int cls)
+{
+    int n = sched_decimation[s->level];
+    int type = rtcm_msg_type(frame, len);
+    uint8_t *seen = NULL;
+
+    if (cls == SCHED_EPH) {
+        int k = sched_find(sched_eph_types, SCHED_EPH_TYPES, type);
+        int sat = sched_sat(frame, len);
+        if (k < 0 || sat < 0) {
+            return 1;
+        }
+        seen = &s->eph_seen[k][sat % SCHED_EPH_SATS];
+    } else if (cls == SCHED_STATION) {
+        int k = sched_find(sched_station_types, SCHED_STATION_TYPES, type);
+        if (k < 0) {
+            return 1;
+        }
+        seen = &s->station_seen[k];
+    } else {
+        return 1;
+    }
+
+    // 计数器按256回绕，抽稀倍数都是2的幂，回绕不打乱节奏
+    return (*seen)++ % n == 0;
+}
+
+/**
+ * @brief 把一段完整帧中的MSM5/7电文改写为MSM4，其他电文原样保留
+ * @param buf 按顺序拼接的完整帧
+ * @param len 长度
+ * @param out 输出缓冲区（不小于len即可）
+ * @param size 输出缓冲区大小
+ * @return 输出长度，缓冲区不足返回-1
+ */
+int sched_lean(const unsigned char *buf, int len, unsigned char *out, int size)
+{
+    int pos = 0, out_len = 0;
+
+    while (pos < len) {
+        int frame_len = len - pos;
+        if (frame_len >= RTCM3_HEADER_LEN && buf[pos] == RTCM3_PREAMBLE) {
+            int n = RTCM3_HEADER_LEN + (((buf[pos + 1] & 0x03) << 8) | buf[pos + 2]) + RTCM3_CRC_LEN;
+            if (n <= frame_len) {
+                frame_len = n;
+            }
+        }
+
+        int n = msm_reduce(&buf[pos], frame_len, &out[out_len], size - out_len);
+        if (n <= 0) {
+            // 不是MSM5/7或无法改写：原样保留
+            if (out_len + frame_len > size) {
+                return -1;
+            }
+            memcpy(&out[out_len], &buf[pos], frame_len);
+            n = frame_len;
+        }
+        out_len += n;
+        pos += frame_len;
+    }
+    return out_len;
+}
+
+/**
+ * @brief 类别名称
+ * @param cls enum sched_class
+ * @return 名称字符串
+ */
+const char *sched_class_name(int cls)
+{
+    return cls >= 0 && cls < SCHED_CLASSES ? sched_class_names[cls] : "unknown";
+}
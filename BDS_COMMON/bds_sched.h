@@ -0,0 +1,60 @@
+/*
+ * bds_sched.h
+ * 发送调度头文件
+ * 功能：按电文类别区分实时观测值与可延后的基站描述、星历电文；按链路积压（socket发送队列深度）
+ *       分级降级：持续拥塞时对延后类电文抽稀，再把MSM5/7观测值改发更短的MSM4，畅通后逐级恢复
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_SCHED_H
+#define BDS_SCHED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bds_rtcm.h"
+#include "bds_msm.h"
+
+// 调度配置
+#define SCHED_HIGH_FACTOR     4       // 积压超过延后门限的该倍数视为拥塞
+#define SCHED_CLEAR_FACTOR    2       // 积压低于延后门限的该倍数视为畅通（一个历元刚写入时的积压不打断恢复）
+#define SCHED_ESCALATE_MS     3000    // 持续拥塞该时间后提高一级
+#define SCHED_RELAX_MS        10000   // 持续畅通该时间后降低一级
+#define SCHED_MAX_LEVEL       3       // 最高降级等级
+#define SCHED_LEAN_LEVEL      2       // 从该级起MSM5/7改发MSM4
+#define SCHED_POLL_MS         10      // 延后电文等待socket排空时的检查间隔
+#define SCHED_STATION_TYPES   8       // 基站描述类电文种数
+#define SCHED_EPH_TYPES       8       // 星历电文种数
+#define SCHED_EPH_SATS        64      // 每种星历电文的卫星号范围
+
+// 电文类别（数值越小越优先）
+enum sched_class {
+    SCHED_OBS = 0,             // 观测值及其他未归类电文：立即发送
+    SCHED_STATION,             // 基站坐标、天线和接收机描述、GLONASS码相位偏差：延后发送
+    SCHED_EPH,                 // 星历：延后发送
+    SCHED_CLASSES
+};
+
+// 一条链路（目的地）的降级状态
+struct sched_link {
+    int level;                                         // 当前降级等级（0为不降级）
+    int low_water;                                     // 延后门限（字节）：socket中未发出的字节低于该值才发延后电文
+    uint64_t congested_ns;                             // 积压持续超过上限的起点，0表示当前未拥塞
+    uint64_t clear_ns;                                 // 积压持续畅通的起点，0表示当前不畅通
+    uint8_t station_seen[SCHED_STATION_TYPES];         // 各类基站描述电文的出现次数（抽稀计数）
+    uint8_t eph_seen[SCHED_EPH_TYPES][SCHED_EPH_SATS]; // 各星历电文按卫星的出现次数
+};
+
+// 函数声明
+int sched_classify(const unsigned char *frame, int len);
+int sched_sat(const unsigned char *frame, int len);
+void sched_link_init(struct sched_link *s, int low_water);
+int sched_update(struct sched_link *s, int backlog, uint64_t now_ns);
+int sched_keep(struct sched_link *s, const unsigned char *frame, int len, int cls);
+int sched_lean(const unsigned char *buf, int len, unsigned char *out, int size);
+const char *sched_class_name(int cls);
+
+#endif /* BDS_SCHED_H */
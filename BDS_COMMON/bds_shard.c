@@ -0,0 +1,423 @@
+/*
+ * bds_shard.c
+ * 分片下游转发源文件
+ * 功能：分片线程的创建和退出、跨线程队列的写入和读出、队列写满时的恢复
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_shard.h"
+
+// 运行指标编号
+static int m_shards = -1;
+static int m_wakeups = -1;
+static int m_overruns = -1;
+static int m_queue_max = -1;
+static int m_images_sent = -1;
+static int m_image_bytes = -1;
+
+/**
+ * @brief 注册分片运行指标
+ */
+static void shard_metrics_init(void)
+{
+    m_shards = metrics_register("bds_shard_count",
+                                "Relay shards, each with its own thread and listening socket", METRIC_GAUGE);
+    m_wakeups = metrics_register("bds_shard_wakeups_total",
+                                 "Times the forwarding thread woke an idle shard", METRIC_COUNTER);
+    m_overruns = metrics_register("bds_shard_overruns_total",
+                                  "Times a shard fell a full queue behind and dropped its clients",
+                                  METRIC_COUNTER);
+    m_queue_max = metrics_register("bds_shard_queued_bytes_max",
+                                   "Most bytes waiting in one shard's queue", METRIC_GAUGE_MAX);
+    m_images_sent = metrics_register("bds_shard_join_images_total",
+                                     "Join data (static message snapshots) sent to new shard clients",
+                                     METRIC_COUNTER);
+    m_image_bytes = metrics_register("bds_shard_join_image_bytes_total",
+                                     "Bytes of join data sent to new shard clients", METRIC_COUNTER);
+}
+
+/**
+ * @brief 消息在队列中占用的字节数（按8字节对齐）
+ */
+static uint32_t shard_msg_space(uint32_t len)
+{
+    return (sizeof(struct shard_msg) + len + 7) & ~7U;
+}
+
+/**
+ * @brief 向队列指定位置拷贝数据（跨越末尾时分两段）
+ */
+static void shard_copy_in(struct shard_queue *q, uint32_t pos, const void *data, uint32_t len)
+{
+    uint32_t off = pos & (SHARD_QUEUE_SIZE - 1);
+    uint32_t first = SHARD_QUEUE_SIZE - off < len ? SHARD_QUEUE_SIZE - off : len;
+
+    memcpy(&q->buf[off], data, first);
+    memcpy(q->buf, (const unsigned char *)data + first, len - first);
+}
+
+/**
+ * @brief 从队列指定位置拷贝数据（跨越末尾时分两段）
+ */
+static void shard_copy_out(const struct shard_queue *q, uint32_t pos, void *data, uint32_t len)
+{
+    uint32_t off = pos & (SHARD_QUEUE_SIZE - 1);
+    uint32_t first = SHARD_QUEUE_SIZE - off < len ? SHARD_QUEUE_SIZE - off : len;
+
+    memcpy(data, &q->buf[off], first);
+    memcpy((unsigned char *)data + first, q->buf, len - first);
+}
+
+/**
+ * @brief 向一个分片写入一条消息，分片线程等待中时唤醒它
+ * @param s 分片
+ * @param type 消息类型
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 成功返回0，队列写满返回-1（该分片进入恢复，之后的消息丢弃直到分片线程清零overrun）
+ */
+static int shard_put(struct shard *s, int type, const void *buf, int len)
+{
+    struct shard_queue *q = s->q;
+    struct shard_msg msg = { .type = (uint32_t)type, .len = (uint32_t)len };
+    uint32_t space = shard_msg_space(len);
+
+    if (atomic_load_explicit(&q->overrun, memory_order_acquire)) {
+        return -1;
+    }
+
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (used + space > SHARD_QUEUE_SIZE) {
+        metrics_inc(m_overruns);
+        atomic_store_explicit(&q->overrun, 1, memory_order_release);
+    } else {
+        shard_copy_in(q, head, &msg, sizeof(msg));
+        shard_copy_in(q, head + sizeof(msg), buf, len);
+        metrics_max(m_queue_max, used + space);
+        atomic_store_explicit(&q->head, head + space, memory_order_seq_cst);
+    }
+
+    // 与分片线程的“先置等待标志、再检查队列”配对，不会漏掉唤醒；
+    // 写满时同样唤醒，分片线程取完队列后断开客户端并清零overrun
+    if (atomic_load_explicit(&q->sleeping, memory_order_seq_cst)) {
+        uint64_t one = 1;
+        atomic_store_explicit(&q->sleeping, 0, memory_order_relaxed);
+        if (write(s->wake_fd, &one, sizeof(one)) == sizeof(one)) {
+            metrics_inc(m_wakeups);
+        }
+    }
+    return atomic_load_explicit(&q->overrun, memory_order_relaxed) ? -1 : 0;
+}
+
+/**
+ * @brief 把数据广播给所有分片的客户端（转发线程调用，只写入各分片的队列，不做网络发送）
+ * @param set 分片集合，NULL时忽略
+ * @param buf 数据
+ * @param len 数据长度
+ */
+void shard_broadcast(struct shard_set *set, const void *buf, int len)
+{
+    if (set == NULL || len <= 0) {
+        return;
+    }
+    if (len > SHARD_MSG_MAX) {
+        log_warn("shard message of %d bytes exceeds %d", len, SHARD_MSG_MAX);
+        return;
+    }
+
+    for (int i = 0; i < set->count; i++) {
+        struct shard *s = &set->shards[i];
+        // 恢复后的分片先补上最新的加入数据，新客户端不会拿到过时的快照
+        if (s->image_stale && set->image_len > 0 &&
+            shard_put(s, SHARD_MSG_IMAGE, set->image, set->image_len) == 0) {
+            s->image_stale = 0;
+        }
+        shard_put(s, SHARD_MSG_DATA, buf, len);
+    }
+}
+
+/**
+ * @brief 更新新客户端加入时先收到的数据（转发线程调用，按队列顺序生效：
+ *        之后加入的客户端先收到它，再接上之后广播的数据）
+ * @param set 分片集合，NULL时忽略
+ * @param buf 数据
+ * @param len 数据长度，0表示不再发送
+ */
+void shard_set_image(struct shard_set *set, const void *buf, int len)
+{
+    if (set == NULL || len < 0 || len > SHARD_MSG_MAX) {
+        return;
+    }
+
+    memcpy(set->image, buf, len);
+    set->image_len = len;
+    for (int i = 0; i < set->count; i++) {
+        struct shard *s = &set->shards[i];
+        s->image_stale = shard_put(s, SHARD_MSG_IMAGE, set->image, len) != 0;
+    }
+}
+
+/**
+ * @brief 新客户端加入：先发本分片的加入数据（分片线程中调用）
+ * @param r 本分片的转发状态
+ * @param id 客户端编号
+ * @param arg 分片
+ */
+static void shard_join(struct relay *r, int id, void *arg)
+{
+    struct shard *s = arg;
+
+    if (s->image_len > 0) {
+        relay_send_to(r, id, s->image, s->image_len);
+        metrics_inc(m_images_sent);
+        metrics_add(m_image_bytes, s->image_len);
+    }
+}
+
+/**
+ * @brief 取出并处理队列中的全部消息
+ * @param s 分片
+ * @return 处理的消息数
+ */
+static int shard_drain(struct shard *s)
+{
+    struct shard_queue *q = s->q;
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    int count = 0;
+
+    while (tail != head) {
+        struct shard_msg msg;
+        shard_copy_out(q, tail, &msg, sizeof(msg));
+
+        // 数据连续时直接在队列中广播，跨越末尾时先拼接
+        uint32_t off = (tail + sizeof(msg)) & (SHARD_QUEUE_SIZE - 1);
+        const unsigned char *data = &q->buf[off];
+        if (off + msg.len > SHARD_QUEUE_SIZE) {
+            shard_copy_out(q, tail + sizeof(msg), s->scratch, msg.len);
+            data = s->scratch;
+        }
+
+        if (msg.type == SHARD_MSG_DATA) {
+            relay_broadcast(s->relay, data, msg.len);
+        } else if (msg.type == SHARD_MSG_IMAGE) {
+            memcpy(s->image, data, msg.len);
+            s->image_len = msg.len;
+        }
+        tail += shard_msg_space(msg.len);
+        count++;
+    }
+    atomic_store_explicit(&q->tail, tail, memory_order_release);
+
+    // 队列曾经写满：本分片的客户端少收了数据，全部断开让它们重连，然后恢复写入
+    if (atomic_load_explicit(&q->overrun, memory_order_acquire) &&
+        atomic_load_explicit(&q->head, memory_order_acquire) == tail) {
+        relay_drop_all(s->relay);
+        atomic_store_explicit(&q->overrun, 0, memory_order_release);
+    }
+    return count;
+}
+
+/**
+ * @brief 分片线程：等待本分片的客户端事件和队列中的新消息
+ * @param arg 分片
+ * @return NULL
+ */
+static void *shard_thread(void *arg)
+{
+    struct shard *s = arg;
+    struct shard_queue *q = s->q;
+    char name[16];
+
+    snprintf(name, sizeof(name), "relay%d", s->index);
+    pthread_setname_np(pthread_self(), name);
+
+    while (atomic_load(&s->set->running)) {
+        shard_drain(s);
+
+        // 先置等待标志再检查队列，与shard_put的“先写入再检查标志”配对
+        atomic_store_explicit(&q->sleeping, 1, memory_order_seq_cst);
+        if (atomic_load_explicit(&q->head, memory_order_seq_cst) !=
+            atomic_load_explicit(&q->tail, memory_order_relaxed)) {
+            atomic_store_explicit(&q->sleeping, 0, memory_order_relaxed);
+            continue;
+        }
+
+        struct pollfd pfd[2] = {
+            { .fd = s->relay->epoll_fd, .events = POLLIN },
+            { .fd = s->wake_fd, .events = POLLIN },
+        };
+        int n = poll(pfd, 2, SHARD_POLL_MS);
+        atomic_store_explicit(&q->sleeping, 0, memory_order_relaxed);
+        if (n < 0) {
+            if (errno != EINTR) {
+                log_errno("shard %d poll failed", s->index);
+            }
+            continue;
+        }
+        if (pfd[1].revents & POLLIN) {
+            uint64_t count;
+            if (read(s->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                log_errno("shard %d eventfd read failed", s->index);
+            }
+        }
+
+        // 先发出已排队的数据，再接受新连接，新客户端不会收到加入之前的数据
+        shard_drain(s);
+        if (pfd[0].revents & POLLIN) {
+            relay_poll(s->relay);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 创建一个分片的监听socket和客户端表
+ * @param s 分片
+ * @param port 监听端口
+ * @param listen_fd 热升级时接管的监听socket，-1表示新建
+ * @param max_clients 本分片的客户端数
+ * @param queue_blocks 本分片的待发队列块数
+ * @return 成功返回0，失败返回-1
+ */
+static int shard_open(struct shard *s, int port, int listen_fd, int max_clients, int queue_blocks)
+{
+    if (listen_fd < 0) {
+        listen_fd = relay_listen(port, 1);
+        if (listen_fd < 0) {
+            return -1;
+        }
+    }
+    s->relay = relay_start(listen_fd, max_clients, queue_blocks);
+    if (s->relay == NULL) {
+        return -1;
+    }
+    relay_set_join(s->relay, shard_join, s);
+
+    s->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->wake_fd < 0) {
+        perror("shard eventfd failed");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 启动分片：每个分片一个SO_REUSEPORT监听socket和一个线程，客户端槽位和队列块平均分配；
+ *        须在实时设置之前调用，分片线程不继承转发线程的SCHED_FIFO和CPU绑定
+ * @param port 监听端口
+ * @param count 分片数（1~SHARD_MAX）
+ * @param max_clients 全部分片的客户端数
+ * @param queue_blocks 全部分片的待发队列块数
+ * @param listen_fds 热升级时接管的监听socket（依次分给各分片，多出的关闭）
+ * @param listen_count 接管的监听socket数
+ * @return 成功返回分片集合，失败返回NULL（接管的监听socket已关闭）
+ */
+struct shard_set *shard_start(int port, int count, int max_clients, int queue_blocks,
+                              const int *listen_fds, int listen_count)
+{
+    static int metrics_ready = 0;
+
+    if (!metrics_ready) {
+        shard_metrics_init();
+        metrics_ready = 1;
+    }
+
+    struct shard_set *set = pool_alloc("shard", "shard set", sizeof(*set), 1, POOL_SHARED);
+    if (set != NULL) {
+        set->shards = pool_alloc("shard", "shard", sizeof(*set->shards), count, POOL_SHARED);
+        set->queues = pool_alloc("shard", "cross-shard queue", sizeof(*set->queues), count, POOL_SHARED);
+    }
+    if (set == NULL || set->shards == NULL || set->queues == NULL) {
+        for (int i = 0; i < listen_count; i++) {
+            close(listen_fds[i]);
+        }
+        if (set != NULL) {
+            pool_free(set->queues);
+            pool_free(set->shards);
+            pool_free(set);
+        }
+        return NULL;
+    }
+
+    set->count = count;
+    atomic_store(&set->running, 1);
+    for (int i = 0; i < count; i++) {
+        set->shards[i].wake_fd = -1;
+    }
+
+    int ret = 0;
+    for (int i = 0; i < count; i++) {
+        struct shard *s = &set->shards[i];
+        s->index = i;
+        s->set = set;
+        s->q = &set->queues[i];
+
+        // 余数分给前面的分片
+        int clients = max_clients / count + (i < max_clients % count);
+        int blocks = queue_blocks / count + (i < queue_blocks % count);
+        if (ret == 0 && shard_open(s, port, i < listen_count ? listen_fds[i] : -1, clients > 0 ? clients : 1,
+                                   blocks > 0 ? blocks : 1) != 0) {
+            ret = -1;
+        } else if (ret != 0 && i < listen_count) {
+            close(listen_fds[i]);
+        }
+    }
+    for (int i = count; i < listen_count; i++) {
+        close(listen_fds[i]);
+    }
+
+    // 分片线程屏蔽全部信号，退出信号总是交给主线程
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (int i = 0; i < count && ret == 0; i++) {
+        struct shard *s = &set->shards[i];
+        if (bds_thread_create(&s->tid, BDS_THREAD_STACK, 0, shard_thread, s) != 0) {
+            fprintf(stderr, "shard thread creation failed\n");
+            ret = -1;
+            break;
+        }
+        s->started = 1;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0) {
+        shard_stop(set);
+        return NULL;
+    }
+    metrics_set(m_shards, count);
+    return set;
+}
+
+/**
+ * @brief 停止分片线程，关闭各分片的客户端连接和监听socket
+ * @param set 分片集合，NULL时忽略
+ */
+void shard_stop(struct shard_set *set)
+{
+    if (set == NULL) {
+        return;
+    }
+
+    atomic_store(&set->running, 0);
+    for (int i = 0; i < set->count; i++) {
+        struct shard *s = &set->shards[i];
+        if (s->started) {
+            uint64_t one = 1;
+            if (write(s->wake_fd, &one, sizeof(one)) < 0) {
+                log_errno("shard wakeup failed");
+            }
+            pthread_join(s->tid, NULL);
+        }
+        relay_stop(s->relay);
+        if (s->wake_fd >= 0) {
+            close(s->wake_fd);
+        }
+    }
+    pool_free(set->queues);
+    pool_free(set->shards);
+    pool_free(set);
+}
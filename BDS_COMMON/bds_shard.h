@@ -0,0 +1,93 @@
+/*
+ * bds_shard.h
+ * 分片下游转发头文件
+ * 功能：把下游转发分成多个分片，每个分片一个工作线程，各自持有SO_REUSEPORT监听socket、
+ *       epoll和客户端表，由内核把新连接分散到各分片；转发线程把数据写入每个分片自己的
+ *       单生产者单消费者队列，分片线程取出后广播给本分片的客户端，线程之间不使用锁
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_SHARD_H
+#define BDS_SHARD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+
+#include "bds_metrics.h"
+#include "bds_thread.h"
+#include "bds_pool.h"
+#include "bds_relay.h"
+#include "bds_log.h"
+
+// 分片配置
+#define SHARD_MAX           16                  // 最多分片数
+#define SHARD_QUEUE_SIZE    (256 * 1024)        // 每个分片的跨线程队列（2的幂），约一分钟的差分数据
+#define SHARD_MSG_MAX       (32 * 1024)         // 单条消息上限（与静态电文快照上限相同）
+#define SHARD_POLL_MS       1000                // 分片线程空闲时检查退出标志的间隔（毫秒）
+
+// 队列中的消息类型
+enum shard_msg_type {
+    SHARD_MSG_DATA = 1,        // 广播给本分片的所有客户端
+    SHARD_MSG_IMAGE            // 新客户端加入时先收到的数据（如静态电文快照），替换之前的
+};
+
+// 消息头（消息按8字节对齐存放，跨越队列末尾时分两段拷贝）
+struct shard_msg {
+    uint32_t type;             // enum shard_msg_type
+    uint32_t len;              // 数据长度
+};
+
+// 跨线程队列：转发线程写入，分片线程读出
+struct shard_queue {
+    _Atomic uint32_t head __attribute__((aligned(64)));   // 已写入的字节数（转发线程）
+    _Atomic uint32_t tail __attribute__((aligned(64)));   // 已读出的字节数（分片线程）
+    _Atomic int sleeping;      // 分片线程即将等待，写入后需要唤醒
+    _Atomic int overrun;       // 队列曾经写满：分片线程断开本分片全部客户端后清零，之前不再写入
+    unsigned char buf[SHARD_QUEUE_SIZE] __attribute__((aligned(64)));
+};
+
+struct shard_set;
+
+// 一个分片
+struct shard {
+    int index;
+    struct shard_set *set;     // 所属集合
+    struct relay *relay;       // 本分片的监听socket、epoll和客户端
+    int wake_fd;               // eventfd，队列有新消息时唤醒分片线程
+    pthread_t tid;
+    int started;               // 线程已创建
+    int image_stale;           // 加入数据因队列写满未送达，恢复后重发（转发线程使用）
+    struct shard_queue *q;
+    int image_len;             // 本分片的加入数据（分片线程使用）
+    unsigned char image[SHARD_MSG_MAX];
+    unsigned char scratch[SHARD_MSG_MAX];  // 跨越队列末尾的消息拼接到这里
+};
+
+// 分片集合
+struct shard_set {
+    int count;
+    atomic_int running;
+    struct shard *shards;
+    struct shard_queue *queues;
+    int image_len;             // 最新的加入数据（写满恢复后重发）
+    unsigned char image[SHARD_MSG_MAX];
+};
+
+// 函数声明
+struct shard_set *shard_start(int port, int count, int max_clients, int queue_blocks,
+                              const int *listen_fds, int listen_count);
+void shard_broadcast(struct shard_set *set, const void *buf, int len);
+void shard_set_image(struct shard_set *set, const void *buf, int len);
+void shard_stop(struct shard_set *set);
+
+#endif /* BDS_SHARD_H */
@@ -0,0 +1,428 @@
+/*
+ * bds_shmring.c
+ * 共享内存环形缓冲区源文件
+ * 功能：写端发布记录、futex唤醒；读端按保留位置校验读取、等待新记录
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_shmring.h"
+
+// 运行指标编号
+static int m_records = -1;
+static int m_bytes = -1;
+static int m_wakeups = -1;
+
+/**
+ * @brief 注册共享内存输出运行指标
+ */
+static void shmring_metrics_init(void)
+{
+    m_records = metrics_register("bds_shmring_records_total",
+                                 "Records published to the shared-memory ring", METRIC_COUNTER);
+    m_bytes = metrics_register("bds_shmring_bytes_total",
+                               "Payload bytes published to the shared-memory ring", METRIC_COUNTER);
+    m_wakeups = metrics_register("bds_shmring_wakeups_total",
+                                 "futex wakeups issued to waiting readers", METRIC_COUNTER);
+}
+
+/**
+ * @brief 规范化共享内存名称（POSIX要求以'/'开头）
+ * @param name 名称
+ * @param out 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 成功返回0，名称无效返回-1
+ */
+static int shmring_name(const char *name, char *out, size_t size)
+{
+    int n = snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+    if (n <= 1 || (size_t)n >= size || strchr(out + 1, '/') != NULL) {
+        fprintf(stderr, "invalid shared memory name: %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 记录占用的字节数（含记录头，按8字节对齐）
+ * @param len 数据长度
+ * @return 字节数
+ */
+static inline uint64_t shmring_record_size(size_t len)
+{
+    return (sizeof(struct shmring_record) + len + SHMRING_ALIGN - 1) & ~(uint64_t)(SHMRING_ALIGN - 1);
+}
+
+/**
+ * @brief futex系统调用（跨进程，不能用FUTEX_PRIVATE_FLAG）
+ */
+static inline long shmring_futex(_Atomic uint32_t *addr, int op, uint32_t val, const struct timespec *ts)
+{
+    return syscall(SYS_futex, (uint32_t *)addr, op, val, ts, NULL, 0);
+}
+
+/**
+ * @brief 创建或接管写端。同名缓冲区布局一致时沿用其中的位置和序号继续写
+ *        （热升级和重启后读端无需重新打开），否则通知读端后删除重建
+ * @param name 共享内存名称（如"bds_sove.ring"，对应/dev/shm/bds_sove.ring）
+ * @param capacity 数据区大小（2的幂，不小于SHMRING_MIN_SIZE）
+ * @return 成功返回写端，失败返回NULL
+ */
+struct shmring *shmring_create(const char *name, size_t capacity)
+{
+    static int metrics_ready = 0;
+    char path[sizeof(((struct shmring *)0)->name)];
+    struct stat st;
+
+    if (capacity < SHMRING_MIN_SIZE || (capacity & (capacity - 1)) != 0) {
+        fprintf(stderr, "shared memory ring size must be a power of two >= %d\n", SHMRING_MIN_SIZE);
+        return NULL;
+    }
+    if (shmring_name(name, path, sizeof(path)) != 0) {
+        return NULL;
+    }
+    if (!metrics_ready) {
+        shmring_metrics_init();
+        metrics_ready = 1;
+    }
+
+    size_t map_len = SHMRING_DATA_OFFSET + capacity;
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("shm_open failed");
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        perror("fstat failed");
+        close(fd);
+        return NULL;
+    }
+
+    // 大小不同的旧缓冲区：标记关闭让读端重新打开，再删除重建（不能原地改变读端已映射的大小）
+    if (st.st_size != 0 && (size_t)st.st_size != map_len) {
+        struct shmring_header *old = mmap(NULL, sizeof(*old), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (old != MAP_FAILED) {
+            atomic_store(&old->closed, 1);
+            atomic_fetch_add(&old->wake, 1);
+            shmring_futex(&old->wake, FUTEX_WAKE, INT_MAX, NULL);
+            munmap(old, sizeof(*old));
+        }
+        close(fd);
+        shm_unlink(path);
+        fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror("shm_open failed");
+            return NULL;
+        }
+        st.st_size = 0;
+    }
+    if (st.st_size == 0 && ftruncate(fd, map_len) != 0) {
+        perror("ftruncate failed");
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap failed");
+        return NULL;
+    }
+
+    struct shmring *r = pool_alloc("shmring", "writer state", sizeof(*r), 1, POOL_SHARED);
+    if (r == NULL) {
+        munmap(map, map_len);
+        return NULL;
+    }
+    pool_account("shmring", "shared memory mapping", map, map_len, 1, POOL_SHARED);
+    r->hdr = map;
+    r->data = (unsigned char *)map + SHMRING_DATA_OFFSET;
+    r->map_len = map_len;
+    snprintf(r->name, sizeof(r->name), "%s", path);
+
+    struct shmring_header *h = r->hdr;
+    if (h->magic == SHMRING_MAGIC && h->version == SHMRING_VERSION && h->capacity == capacity &&
+        !atomic_load(&h->closed)) {
+        // 上一个写端可能在写记录途中退出：丢弃未发布的部分
+        atomic_store(&h->reserve, atomic_load(&h->head));
+        printf("Shared memory ring %s resumed at record %llu\n", path,
+               (unsigned long long)atomic_load(&h->seq));
+    } else {
+        h->version = SHMRING_VERSION;
+        h->capacity = capacity;
+        atomic_store(&h->closed, 0);
+        atomic_store(&h->reserve, 0);
+        atomic_store(&h->head, 0);
+        atomic_store(&h->seq, 0);
+        atomic_store(&h->waiters, 0);
+        atomic_thread_fence(memory_order_release);
+        h->magic = SHMRING_MAGIC;
+    }
+    h->writer_pid = (uint32_t)getpid();
+
+    return r;
+}
+
+/**
+ * @brief 按环形位置复制到数据区（记录不跨越末尾，无需分段）
+ */
+static inline void shmring_put(struct shmring *r, uint64_t pos, const void *src, size_t len)
+{
+    memcpy(&r->data[pos & (r->hdr->capacity - 1)], src, len);
+}
+
+/**
+ * @brief 发布一条记录（从不等待读端，读得慢的读端会发现被覆盖）
+ * @param r 写端
+ * @param data 数据
+ * @param len 数据长度（不超过数据区的1/4）
+ * @param time_ns 时间戳
+ * @return 成功返回0，记录过长返回-1
+ */
+int shmring_write(struct shmring *r, const void *data, size_t len, uint64_t time_ns)
+{
+    struct shmring_header *h = r->hdr;
+    uint64_t cap = h->capacity;
+    uint64_t size = shmring_record_size(len);
+
+    if (size > cap / 4) {
+        return -1;
+    }
+
+    // 只有写端修改位置，直接读取即可
+    uint64_t pos = atomic_load_explicit(&h->head, memory_order_relaxed);
+    uint64_t to_end = cap - (pos & (cap - 1));
+    uint64_t end = pos + (size > to_end ? to_end : 0) + size;
+
+    // 先登记覆盖范围，再写数据：读端复制完后检查reserve，就能发现复制期间被覆盖
+    atomic_store_explicit(&h->reserve, end, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (size > to_end) {
+        uint32_t pad = SHMRING_PAD;
+        shmring_put(r, pos, &pad, sizeof(pad));
+        pos += to_end;
+    }
+
+    struct shmring_record rec = {
+        .len = (uint32_t)len,
+        .seq = atomic_load_explicit(&h->seq, memory_order_relaxed),
+        .time_ns = time_ns,
+    };
+    shmring_put(r, pos, &rec, sizeof(rec));
+    shmring_put(r, pos + sizeof(rec), data, len);
+
+    atomic_store_explicit(&h->seq, rec.seq + 1, memory_order_relaxed);
+    atomic_store_explicit(&h->head, end, memory_order_release);
+
+    // 先递增wake再检查waiters，与读端的顺序配对，不会漏掉唤醒
+    atomic_fetch_add(&h->wake, 1);
+    if (atomic_load(&h->waiters) > 0) {
+        shmring_futex(&h->wake, FUTEX_WAKE, INT_MAX, NULL);
+        metrics_inc(m_wakeups);
+    }
+
+    metrics_inc(m_records);
+    metrics_add(m_bytes, len);
+    return 0;
+}
+
+/**
+ * @brief 关闭写端映射（缓冲区保留，下一个写端接着写，读端不受影响）
+ * @param r 写端，NULL时忽略
+ */
+void shmring_close(struct shmring *r)
+{
+    if (r == NULL) {
+        return;
+    }
+    munmap(r->hdr, r->map_len);
+    pool_free(r);
+}
+
+/**
+ * @brief 打开读端，从最新位置开始读取
+ * @param rd 读端
+ * @param name 共享内存名称（与写端相同）
+ * @return 成功返回0，缓冲区不存在或格式不符返回-1
+ */
+int shmring_reader_open(struct shmring_reader *rd, const char *name)
+{
+    char path[64];
+    struct stat st;
+
+    memset(rd, 0, sizeof(*rd));
+    if (shmring_name(name, path, sizeof(path)) != 0) {
+        return -1;
+    }
+
+    // 读端只写waiters计数，其余字段只读
+    int fd = shm_open(path, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("shm_open failed");
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size <= SHMRING_DATA_OFFSET) {
+        fprintf(stderr, "%s is not a ring buffer\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap failed");
+        return -1;
+    }
+
+    struct shmring_header *h = map;
+    if (h->magic != SHMRING_MAGIC || h->version != SHMRING_VERSION ||
+        h->capacity + SHMRING_DATA_OFFSET != (uint64_t)st.st_size) {
+        fprintf(stderr, "%s has an incompatible layout\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    rd->hdr = h;
+    rd->data = (const unsigned char *)map + SHMRING_DATA_OFFSET;
+    rd->map_len = st.st_size;
+    rd->capacity = h->capacity;
+    rd->pos = atomic_load_explicit(&h->head, memory_order_acquire);
+    rd->next_seq = atomic_load_explicit(&h->seq, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief 检查从pos开始复制的内容在复制期间是否被写端覆盖
+ * @param rd 读端
+ * @return 未被覆盖返回1
+ */
+static inline int shmring_valid(const struct shmring_reader *rd)
+{
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t reserve = atomic_load_explicit(&rd->hdr->reserve, memory_order_relaxed);
+    return reserve - rd->pos <= rd->capacity;
+}
+
+/**
+ * @brief 等待写端发布新记录
+ * @param rd 读端
+ * @param timeout_ms 超时（毫秒），-1表示一直等待
+ * @return 有新记录返回1，超时返回0
+ */
+static int shmring_wait(struct shmring_reader *rd, int timeout_ms)
+{
+    struct shmring_header *h = rd->hdr;
+    struct timespec ts, *tsp = NULL;
+
+    if (timeout_ms == 0) {
+        return 0;
+    }
+    if (timeout_ms > 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        tsp = &ts;
+    }
+
+    // 先取wake再检查head：写端在两者之间发布时wake已变化，futex立即返回
+    uint32_t w = atomic_load(&h->wake);
+    if (atomic_load(&h->head) != rd->pos || atomic_load(&h->closed)) {
+        return 1;
+    }
+    atomic_fetch_add(&h->waiters, 1);
+    long ret = shmring_futex(&h->wake, FUTEX_WAIT, w, tsp);
+    atomic_fetch_sub(&h->waiters, 1);
+
+    if (ret != 0 && errno == ETIMEDOUT) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief 读取下一条记录
+ * @param rd 读端
+ * @param buf 数据缓冲区
+ * @param size 缓冲区大小，记录更长时只复制前size字节（返回值仍为记录长度）
+ * @param info 输出的序号、时间戳和丢失数，可为NULL
+ * @param timeout_ms 没有新记录时的等待时间（毫秒），0表示不等待，-1表示一直等待
+ * @return 记录长度，超时返回0，写端已删除缓冲区（应重新打开）返回-1
+ */
+int shmring_read(struct shmring_reader *rd, void *buf, size_t size, struct shmring_info *info, int timeout_ms)
+{
+    struct shmring_header *h = rd->hdr;
+    uint64_t cap = rd->capacity;
+    struct shmring_record rec;
+
+    while (1) {
+        if (atomic_load_explicit(&h->closed, memory_order_acquire)) {
+            return -1;
+        }
+
+        uint64_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+        if (rd->pos == head) {
+            if (!shmring_wait(rd, timeout_ms)) {
+                return 0;
+            }
+            continue;
+        }
+
+        // 落后超过一圈，或写端重建后位置倒退：跳到最新位置，由序号差得出丢失数
+        if (head - rd->pos > cap || head < rd->pos) {
+            rd->overruns++;
+            rd->pos = head;
+            continue;
+        }
+
+        uint64_t off = rd->pos & (cap - 1);
+        memcpy(&rec, &rd->data[off], sizeof(uint32_t));
+        if (rec.len == SHMRING_PAD) {
+            if (!shmring_valid(rd)) {
+                rd->overruns++;
+                rd->pos = head;
+                continue;
+            }
+            rd->pos += cap - off;
+            continue;
+        }
+
+        // 先校验记录头，再按其中的长度复制数据，复制完再校验一次
+        memcpy(&rec, &rd->data[off], sizeof(rec));
+        uint64_t rec_size = shmring_record_size(rec.len);
+        if (!shmring_valid(rd) || rec_size > cap / 4 || off + rec_size > cap) {
+            rd->overruns++;
+            rd->pos = atomic_load_explicit(&h->head, memory_order_acquire);
+            continue;
+        }
+        size_t n = rec.len < size ? rec.len : size;
+        memcpy(buf, &rd->data[off + sizeof(rec)], n);
+        if (!shmring_valid(rd)) {
+            rd->overruns++;
+            rd->pos = atomic_load_explicit(&h->head, memory_order_acquire);
+            continue;
+        }
+
+        rd->pos += rec_size;
+        uint64_t lost = rec.seq > rd->next_seq ? rec.seq - rd->next_seq : 0;
+        rd->lost += lost;
+        rd->next_seq = rec.seq + 1;
+        if (info != NULL) {
+            info->seq = rec.seq;
+            info->time_ns = rec.time_ns;
+            info->lost = lost;
+        }
+        return (int)rec.len;
+    }
+}
+
+/**
+ * @brief 关闭读端
+ * @param rd 读端
+ */
+void shmring_reader_close(struct shmring_reader *rd)
+{
+    if (rd->hdr != NULL) {
+        munmap(rd->hdr, rd->map_len);
+        rd->hdr = NULL;
+    }
+}
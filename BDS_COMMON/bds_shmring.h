@@ -0,0 +1,104 @@
+/*
+ * bds_shmring.h
+ * 共享内存环形缓冲区头文件
+ * 功能：单写多读的POSIX共享内存环形缓冲区。写端（流动站程序）逐条发布记录（每条一个RTCM3帧），
+ *       带序号和单调时钟时间戳，从不等待读端；读端各自维护读取位置，不修改环形数据，
+ *       被写端覆盖时由保留位置校验发现并跳过，无新数据时在futex上等待
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_SHMRING_H
+#define BDS_SHMRING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "bds_metrics.h"
+#include "bds_pool.h"
+
+// 环形缓冲区配置
+#define SHMRING_MAGIC          0x474E5242          // "BRNG"
+#define SHMRING_VERSION        1                   // 布局不兼容时递增
+#define SHMRING_DEFAULT_SIZE   (1024 * 1024)       // 默认数据区大小（2的幂）
+#define SHMRING_MIN_SIZE       4096
+#define SHMRING_DATA_OFFSET    4096                // 数据区在共享内存中的偏移
+#define SHMRING_ALIGN          8                   // 记录按8字节对齐
+#define SHMRING_PAD            0xFFFFFFFFU         // 填充记录标记：读端跳到数据区开头
+
+// 共享内存头部（写端和读端各自写的字段分开放在不同缓存行）
+struct shmring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;                             // 数据区大小（2的幂）
+    uint32_t writer_pid;                           // 最近一次打开写端的进程
+    _Atomic uint32_t closed;                       // 写端已删除该缓冲区，读端应重新打开
+
+    // 写端：先登记要写到的位置，写完数据后再发布
+    _Atomic uint64_t reserve __attribute__((aligned(64)));   // 正在写入的记录结束位置
+    _Atomic uint64_t head;                         // 已发布的总字节数
+    _Atomic uint64_t seq;                          // 下一条记录的序号
+
+    // futex等待：写端每次发布后递增wake，有读端等待时才唤醒
+    _Atomic uint32_t wake __attribute__((aligned(64)));
+    _Atomic uint32_t waiters;                      // 正在等待的读端数
+};
+
+// 记录头（记录不跨越数据区末尾）
+struct shmring_record {
+    uint32_t len;                                  // 数据长度，SHMRING_PAD表示填充
+    uint32_t reserved;
+    uint64_t seq;                                  // 记录序号（连续递增）
+    uint64_t time_ns;                              // 写端收到数据的单调时钟时间
+};
+
+// 写端
+struct shmring {
+    struct shmring_header *hdr;
+    unsigned char *data;
+    size_t map_len;
+    char name[64];
+};
+
+// 读端
+struct shmring_reader {
+    struct shmring_header *hdr;
+    const unsigned char *data;
+    size_t map_len;
+    uint64_t capacity;
+    uint64_t pos;                                  // 下一条记录的位置
+    uint64_t next_seq;                             // 期望的下一条记录序号
+    uint64_t lost;                                 // 因读取太慢被覆盖的记录数
+    uint64_t overruns;                             // 发生覆盖的次数
+};
+
+// 读取结果
+struct shmring_info {
+    uint64_t seq;                                  // 记录序号
+    uint64_t time_ns;                              // 写端时间戳（与bds_now_ns同一时钟）
+    uint64_t lost;                                 // 本条之前丢失的记录数
+};
+
+// 写端函数
+struct shmring *shmring_create(const char *name, size_t capacity);
+int shmring_write(struct shmring *r, const void *data, size_t len, uint64_t time_ns);
+void shmring_close(struct shmring *r);
+
+// 读端函数（读端库：流动站本机的RTK引擎等进程直接链接bds_common使用）
+int shmring_reader_open(struct shmring_reader *rd, const char *name);
+int shmring_read(struct shmring_reader *rd, void *buf, size_t size, struct shmring_info *info, int timeout_ms);
+void shmring_reader_close(struct shmring_reader *rd);
+
+#endif /* BDS_SHMRING_H */
@@ -0,0 +1,171 @@
+/*
+ * bds_snapshot.c
+ * 静态电文缓存源文件
+ * 功能：缓存最新的基站描述和星历电文，生成给新连接的快照，抑制内容不变的重复电文，删除不再播发的电文
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_snapshot.h"
+
+/**
+ * @brief 初始化缓存
+ * @param s 缓存
+ * @param refresh_s 刷新周期（秒）
+ */
+void snap_init(struct snapshot *s, int refresh_s)
+{
+    s->count = 0;
+    s->refresh_ns = refresh_s * 1000000000ULL;
+    s->sweep_ns = 0;
+    s->dirty = 0;
+    s->image_len = 0;
+    s->image_frames = 0;
+}
+
+/**
+ * @brief 删除超过SNAP_EXPIRE_S没有再收到的电文
+ * @param s 缓存
+ * @param now_ns 当前时间（单调时钟纳秒）
+ */
+static void snap_expire(struct snapshot *s, uint64_t now_ns)
+{
+    int n = 0;
+
+    for (int i = 0; i < s->count; i++) {
+        if (now_ns - s->entries[i].seen_ns < SNAP_EXPIRE_S * 1000000000ULL) {
+            if (n != i) {
+                s->entries[n] = s->entries[i];
+            }
+            n++;
+        }
+    }
+    if (n != s->count) {
+        s->count = n;
+        s->dirty = 1;
+    }
+}
+
+/**
+ * @brief 转发前检查一帧：慢周期电文更新缓存，内容与缓存相同且未到刷新时间的不再转发
+ * @param s 缓存
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param now_ns 当前时间（单调时钟纳秒）
+ * @return 需要转发返回1（观测值等其他电文总是转发），重复电文返回0
+ */
+int snap_update(struct snapshot *s, const unsigned char *frame, int len, uint64_t now_ns)
+{
+    // 每秒清理一次过期电文，新连接不会拿到已不再播发的星历
+    if (now_ns - s->sweep_ns >= 1000000000ULL) {
+        snap_expire(s, now_ns);
+        s->sweep_ns = now_ns;
+    }
+
+    int cls = sched_classify(frame, len);
+
+    if (cls == SCHED_OBS || len > SNAP_FRAME_MAX) {
+        return 1;
+    }
+
+    int type = rtcm_msg_type(frame, len);
+    int sat = cls == SCHED_EPH ? sched_sat(frame, len) : -1;
+    struct snap_entry *e = NULL;
+    for (int i = 0; i < s->count; i++) {
+        if (s->entries[i].type == type && s->entries[i].sat == sat) {
+            e = &s->entries[i];
+            break;
+        }
+    }
+
+    if (e != NULL && e->len == len && memcmp(e->frame, frame, len) == 0) {
+        e->seen_ns = now_ns;
+        if (!e->resend && now_ns - e->fwd_ns < s->refresh_ns) {
+            return 0;
+        }
+        e->fwd_ns = now_ns;
+        e->resend = 0;
+        return 1;
+    }
+
+    // 缓存满时照常转发，只是新连接拿不到这一条
+    if (e == NULL) {
+        if (s->count == SNAP_MAX_ENTRIES) {
+            return 1;
+        }
+        e = &s->entries[s->count++];
+        e->type = type;
+        e->sat = sat;
+        e->cls = cls;
+    }
+    memcpy(e->frame, frame, len);
+    e->len = len;
+    e->fwd_ns = now_ns;
+    e->seen_ns = now_ns;
+    e->resend = 0;
+    s->dirty = 1;
+    return 1;
+}
+
+/**
+ * @brief 删除一类电文的缓存（如切换基站后旧基站的描述电文）
+ * @param s 缓存
+ * @param cls 电文类别
+ */
+void snap_forget(struct snapshot *s, int cls)
+{
+    int n = 0;
+
+    for (int i = 0; i < s->count; i++) {
+        if (s->entries[i].cls != cls) {
+            if (n != i) {
+                s->entries[n] = s->entries[i];
+            }
+            n++;
+        }
+    }
+    if (n != s->count) {
+        s->count = n;
+        s->dirty = 1;
+    }
+}
+
+/**
+ * @brief 切换基站后每种缓存的电文照常转发一次：接收机换用新基站的数据流，
+ *        不因旧基站播发过相同内容而等满刷新周期
+ * @param s 缓存
+ */
+void snap_rearm(struct snapshot *s)
+{
+    for (int i = 0; i < s->count; i++) {
+        s->entries[i].resend = 1;
+    }
+}
+
+/**
+ * @brief 取快照（缓存变化后重建一次，之后各新连接共用）：基站描述在前，接收机先得到坐标
+ * @param s 缓存
+ * @param len 输出快照长度
+ * @return 快照数据
+ */
+const unsigned char *snap_image(struct snapshot *s, int *len)
+{
+    if (s->dirty) {
+        s->image_len = 0;
+        s->image_frames = 0;
+        for (int cls = SCHED_STATION; cls < SCHED_CLASSES; cls++) {
+            for (int i = 0; i < s->count; i++) {
+                const struct snap_entry *e = &s->entries[i];
+                if (e->cls != cls || s->image_len + e->len > SNAP_IMAGE_SIZE) {
+                    continue;
+                }
+                memcpy(&s->image[s->image_len], e->frame, e->len);
+                s->image_len += e->len;
+                s->image_frames++;
+            }
+        }
+        s->dirty = 0;
+    }
+    *len = s->image_len;
+    return s->image;
+}
@@ -0,0 +1,60 @@
+/*
+ * bds_snapshot.h
+ * 静态电文缓存头文件
+ * 功能：保存转发过的每种慢周期电文（基站描述按电文号、星历按电文号和卫星）的最新一份，
+ *       新加入的流动站连接后立即拿到全部缓存（快照），不必等下一轮播发；
+ *       内容不变的重复电文在刷新周期内不再转发
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_SNAPSHOT_H
+#define BDS_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bds_rtcm.h"
+#include "bds_sched.h"
+
+// 缓存配置
+#define SNAP_MAX_ENTRIES    256             // 最多缓存的电文数（各系统星历约200条）
+#define SNAP_FRAME_MAX      512             // 缓存的单帧上限，更长的帧照常转发但不缓存
+#define SNAP_IMAGE_SIZE     (32 * 1024)     // 快照上限（与下游客户端待发队列相同）
+#define SNAP_REFRESH_S      30              // 默认刷新周期：内容不变的电文至少每隔该时间转发一次
+#define SNAP_EXPIRE_S       600             // 超过该时间没有再收到的电文（卫星已落下或基站不再播发）从缓存删除
+
+// 一条缓存的电文
+struct snap_entry {
+    int type;                  // 电文号
+    int sat;                   // 卫星号（基站描述类为-1）
+    int cls;                   // 电文类别（enum sched_class）
+    int len;                   // 帧长度
+    uint64_t fwd_ns;           // 最近一次转发的时间（单调时钟纳秒）
+    uint64_t seen_ns;          // 最近一次收到的时间（单调时钟纳秒）
+    int resend;                // 下一份相同内容的电文照常转发（切换基站后）
+    unsigned char frame[SNAP_FRAME_MAX];
+};
+
+// 静态电文缓存
+struct snapshot {
+    struct snap_entry entries[SNAP_MAX_ENTRIES];
+    int count;                 // 缓存的电文数
+    uint64_t refresh_ns;       // 刷新周期
+    uint64_t sweep_ns;         // 最近一次清理过期电文的时间
+    int dirty;                 // 缓存变化后快照需要重建
+    int image_len;             // 快照长度
+    int image_frames;          // 快照中的帧数
+    unsigned char image[SNAP_IMAGE_SIZE];  // 快照：基站描述在前、星历在后的完整帧
+};
+
+// 函数声明
+void snap_init(struct snapshot *s, int refresh_s);
+int snap_update(struct snapshot *s, const unsigned char *frame, int len, uint64_t now_ns);
+void snap_forget(struct snapshot *s, int cls);
+void snap_rearm(struct snapshot *s);
+const unsigned char *snap_image(struct snapshot *s, int *len);
+
+#endif /* BDS_SNAPSHOT_H */
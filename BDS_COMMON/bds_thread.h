@@ -0,0 +1,48 @@
+/*
+ * bds_thread.h
+ * 线程工具头文件
+ * 功能：以显式的小栈创建后台线程。实时模式下mlockall(MCL_FUTURE)会锁定每个线程的整个栈，
+ *       默认的8MB栈按线程数成倍占用常驻内存，因此后台线程统一按实际用量指定栈大小
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_THREAD_H
+#define BDS_THREAD_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// 后台线程默认栈大小：最深的调用（块压缩的哈希表、格式化输出）不超过几十KB
+#define BDS_THREAD_STACK    (128 * 1024)
+
+/**
+ * @brief 以指定栈大小创建线程
+ * @param tid 输出的线程号
+ * @param stack_size 栈大小（字节）
+ * @param detached 非0时创建为分离线程
+ * @param fn 线程函数
+ * @param arg 线程参数
+ * @return 成功返回0，失败返回错误码（与pthread_create相同）
+ */
+static inline int bds_thread_create(pthread_t *tid, size_t stack_size, int detached,
+                                    void *(*fn)(void *), void *arg)
+{
+    pthread_attr_t attr;
+
+    int err = pthread_attr_init(&attr);
+    if (err != 0) {
+        return err;
+    }
+    err = pthread_attr_setstacksize(&attr, stack_size);
+    if (err == 0 && detached) {
+        err = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    }
+    if (err == 0) {
+        err = pthread_create(tid, &attr, fn, arg);
+    }
+    pthread_attr_destroy(&attr);
+    return err;
+}
+
+#endif /* BDS_THREAD_H */
@@ -0,0 +1,37 @@
+/*
+ * bds_time.h
+ * 时间工具头文件
+ * 功能：单调时钟和系统时钟的纳秒读取
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_TIME_H
+#define BDS_TIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief 读取单调时钟
+ * @return 纳秒
+ */
+static inline uint64_t bds_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief 读取系统时钟（UTC）
+ * @return 纳秒
+ */
+static inline uint64_t bds_realtime_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* BDS_TIME_H */
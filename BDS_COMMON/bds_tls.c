@@ -0,0 +1,805 @@
+/*
+ * bds_tls.c
+ * 加密传输源文件
+ * 功能：TLS 1.3握手、流量密钥导出并装入内核TLS，内核不支持时启动用户态转发线程
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_tls.h"
+
+#ifdef BDS_HAVE_TLS
+
+#include <ctype.h>
+#include <signal.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+#include <openssl/x509v3.h>
+
+// 已得到的流量密钥
+#define TLS_HAVE_CLIENT_SECRET 0x1
+#define TLS_HAVE_SERVER_SECRET 0x2
+
+// 证书和密钥配置
+struct tls_config {
+    SSL_CTX *ctx;
+    int server;                // 1：服务端（流动站），0：客户端（基站、MQTT）
+};
+
+// 正在握手的连接
+struct tls_session {
+    SSL *ssl;
+    int fd;                    // TCP socket
+    int server;
+    int secrets;               // TLS_HAVE_*
+    int secret_len;
+    unsigned char client_secret[TLS_SECRET_MAX];  // 客户端应用流量密钥（client_application_traffic_secret_0）
+    unsigned char server_secret[TLS_SECRET_MAX];  // 服务端应用流量密钥
+    int peer_fd;               // 用户态转发：转发线程一侧的socketpair描述符
+};
+
+// 运行指标编号
+static int m_handshakes = -1;
+static int m_failures = -1;
+static int m_kernel = -1;
+static int m_relay = -1;
+
+/**
+ * @brief 注册加密传输运行指标（只注册一次）
+ */
+static void tls_metrics_init(void)
+{
+    if (m_handshakes >= 0) {
+        return;
+    }
+    m_handshakes = metrics_register("bds_tls_handshakes_total",
+                                    "Completed TLS handshakes", METRIC_COUNTER);
+    m_failures = metrics_register("bds_tls_handshake_failures_total",
+                                  "Failed or timed out TLS handshakes", METRIC_COUNTER);
+    m_kernel = metrics_register("bds_tls_kernel_sessions_total",
+                                "TLS connections whose keys were installed into kernel TLS", METRIC_COUNTER);
+    m_relay = metrics_register("bds_tls_relay_sessions_total",
+                               "TLS connections served by a userspace relay thread (no kernel TLS)",
+                               METRIC_COUNTER);
+}
+
+/**
+ * @brief 输出OpenSSL错误队列中的第一条错误（队列为空时输出errno）
+ * @param what 出错的操作
+ */
+static void tls_print_error(const char *what)
+{
+    unsigned long err = ERR_get_error();
+    char msg[256];
+
+    if (err == 0) {
+        snprintf(msg, sizeof(msg), "%s", strerror(errno));
+    } else if (ERR_reason_error_string(err) != NULL) {
+        snprintf(msg, sizeof(msg), "%s", ERR_reason_error_string(err));
+    } else {
+        ERR_error_string_n(err, msg, sizeof(msg));
+    }
+    log_error("%s: %s", what, msg);
+    ERR_clear_error();
+}
+
+/**
+ * @brief 解析十六进制字符串
+ * @param hex 十六进制字符串（遇到非十六进制字符结束）
+ * @param out 输出缓冲区
+ * @param size 输出缓冲区大小
+ * @return 输出的字节数
+ */
+static int tls_parse_hex(const char *hex, unsigned char *out, int size)
+{
+    int n = 0;
+    unsigned int byte;
+
+    while (n < size && isxdigit((unsigned char)hex[0]) && isxdigit((unsigned char)hex[1]) &&
+           sscanf(hex, "%2x", &byte) == 1) {
+        out[n++] = (unsigned char)byte;
+        hex += 2;
+    }
+    return n;
+}
+
+/**
+ * @brief 密钥日志回调：OpenSSL按NSS密钥日志格式给出各阶段的密钥，这里只取应用流量密钥
+ * @param ssl 连接
+ * @param line "标签 client_random 密钥"
+ */
+static void tls_keylog(const SSL *ssl, const char *line)
+{
+    struct tls_session *s = SSL_get_app_data(ssl);
+    unsigned char *secret;
+    int flag;
+
+    if (s == NULL) {
+        return;
+    }
+    if (strncmp(line, "CLIENT_TRAFFIC_SECRET_0 ", 24) == 0) {
+        secret = s->client_secret;
+        flag = TLS_HAVE_CLIENT_SECRET;
+    } else if (strncmp(line, "SERVER_TRAFFIC_SECRET_0 ", 24) == 0) {
+        secret = s->server_secret;
+        flag = TLS_HAVE_SERVER_SECRET;
+    } else {
+        return;
+    }
+
+    const char *hex = strrchr(line, ' ');
+    if (hex != NULL) {
+        s->secret_len = tls_parse_hex(hex + 1, secret, TLS_SECRET_MAX);
+        s->secrets |= flag;
+    }
+}
+
+/**
+ * @brief TLS 1.3 HKDF-Expand-Label（RFC 8446 7.1），上下文为空，输出不超过一个SHA-256块
+ * @param secret 流量密钥
+ * @param secret_len 密钥长度
+ * @param label 标签（不含"tls13 "前缀）
+ * @param out 输出
+ * @param out_len 输出长度
+ * @return 成功返回0，失败返回-1
+ */
+static int tls_expand_label(const unsigned char *secret, int secret_len, const char *label,
+                            unsigned char *out, int out_len)
+{
+    unsigned char info[64];
+    unsigned char block[EVP_MAX_MD_SIZE];
+    unsigned int block_len = 0;
+    int label_len = strlen(label);
+    int n = 0;
+
+    info[n++] = (unsigned char)(out_len >> 8);
+    info[n++] = (unsigned char)out_len;
+    info[n++] = (unsigned char)(6 + label_len);
+    memcpy(&info[n], "tls13 ", 6);
+    n += 6;
+    memcpy(&info[n], label, label_len);
+    n += label_len;
+    info[n++] = 0;             // 上下文长度
+    info[n++] = 1;             // HKDF-Expand第一块的计数
+
+    if (HMAC(EVP_sha256(), secret, secret_len, info, n, block, &block_len) == NULL ||
+        (int)block_len < out_len) {
+        return -1;
+    }
+    memcpy(out, block, out_len);
+    OPENSSL_cleanse(block, sizeof(block));
+    return 0;
+}
+
+/**
+ * @brief 由流量密钥导出内核TLS的AES-128-GCM参数（记录序号从0开始）：
+ *        write_iv的前4字节为salt、后8字节为iv，rec_seq为大端记录序号
+ * @param secret 流量密钥
+ * @param secret_len 密钥长度
+ * @param info 输出的内核参数
+ * @return 成功返回0，失败返回-1
+ */
+int tls_kernel_crypto_info(const unsigned char *secret, int secret_len,
+                           struct tls12_crypto_info_aes_gcm_128 *info)
+{
+    unsigned char key[TLS_CIPHER_AES_GCM_128_KEY_SIZE];
+    unsigned char iv[TLS_CIPHER_AES_GCM_128_SALT_SIZE + TLS_CIPHER_AES_GCM_128_IV_SIZE];
+
+    if (tls_expand_label(secret, secret_len, "key", key, sizeof(key)) != 0 ||
+        tls_expand_label(secret, secret_len, "iv", iv, sizeof(iv)) != 0) {
+        return -1;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->info.version = TLS_1_3_VERSION;
+    info->info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    memcpy(info->key, key, sizeof(key));
+    memcpy(info->salt, iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+    memcpy(info->iv, &iv[TLS_CIPHER_AES_GCM_128_SALT_SIZE], TLS_CIPHER_AES_GCM_128_IV_SIZE);
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(iv, sizeof(iv));
+    return 0;
+}
+
+/**
+ * @brief 把握手得到的密钥装入内核TLS
+ * @param s 已完成握手的连接
+ * @return 成功返回0；内核不支持或OpenSSL已读入应用数据返回-1（可退回用户态转发）；
+ *         发送方向已装入而接收方向失败返回-2（连接不可用）
+ */
+static int tls_install_kernel(struct tls_session *s)
+{
+    struct tls12_crypto_info_aes_gcm_128 tx, rx;
+    const unsigned char *tx_secret = s->server ? s->server_secret : s->client_secret;
+    const unsigned char *rx_secret = s->server ? s->client_secret : s->server_secret;
+    int ret = -1;
+
+    // OpenSSL缓冲区中已解密的数据内核拿不到，只能继续由用户态处理
+    if (s->secrets != (TLS_HAVE_CLIENT_SECRET | TLS_HAVE_SERVER_SECRET) || SSL_has_pending(s->ssl)) {
+        return -1;
+    }
+    if (tls_kernel_crypto_info(tx_secret, s->secret_len, &tx) != 0 ||
+        tls_kernel_crypto_info(rx_secret, s->secret_len, &rx) != 0) {
+        return -1;
+    }
+
+    // 内核未加载tls模块时返回ENOENT，附加ULP之前的socket不受影响
+    if (setsockopt(s->fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 &&
+        setsockopt(s->fd, SOL_TLS, TLS_TX, &tx, sizeof(tx)) == 0) {
+        ret = setsockopt(s->fd, SOL_TLS, TLS_RX, &rx, sizeof(rx)) == 0 ? 0 : -2;
+        if (ret != 0) {
+            log_errno("kernel TLS receive setup failed");
+        }
+    }
+
+    OPENSSL_cleanse(&tx, sizeof(tx));
+    OPENSSL_cleanse(&rx, sizeof(rx));
+    return ret;
+}
+
+/**
+ * @brief 创建OpenSSL上下文：只用TLS 1.3和内核支持的套件，不发会话票据
+ * @param method 服务端或客户端方法
+ * @return 成功返回上下文，失败返回NULL
+ */
+static SSL_CTX *tls_new_ctx(const SSL_METHOD *method)
+{
+    SSL_CTX *ctx = SSL_CTX_new(method);
+    if (ctx == NULL) {
+        tls_print_error("SSL_CTX_new failed");
+        return NULL;
+    }
+
+    if (SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION) != 1 ||
+        SSL_CTX_set_ciphersuites(ctx, TLS_CIPHER_SUITE) != 1) {
+        tls_print_error("TLS 1.3 setup failed");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+
+    // 握手结束后发出的票据会占用内核TLS的记录序号，不发送；转发线程使用非阻塞部分写
+    SSL_CTX_set_num_tickets(ctx, 0);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_keylog_callback(ctx, tls_keylog);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    return ctx;
+}
+
+/**
+ * @brief 创建服务端配置（流动站接受基站连接）
+ * @param cert_file 证书链文件（PEM）
+ * @param key_file 私钥文件（PEM）
+ * @return 成功返回配置，失败返回NULL
+ */
+struct tls_config *tls_server_config(const char *cert_file, const char *key_file)
+{
+    tls_metrics_init();
+
+    SSL_CTX *ctx = tls_new_ctx(TLS_server_method());
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        tls_print_error("load TLS certificate failed");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+
+    struct tls_config *cfg = calloc(1, sizeof(*cfg));
+    if (cfg == NULL) {
+        perror("malloc tls config failed");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    cfg->ctx = ctx;
+    cfg->server = 1;
+    return cfg;
+}
+
+/**
+ * @brief 创建客户端配置：用指定的CA校验服务器证书
+ * @param ca_file CA证书文件（PEM，自签名证书直接使用服务器证书）
+ * @return 成功返回配置，失败返回NULL
+ */
+struct tls_config *tls_client_config(const char *ca_file)
+{
+    tls_metrics_init();
+
+    SSL_CTX *ctx = tls_new_ctx(TLS_client_method());
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    if (SSL_CTX_load_verify_locations(ctx, ca_file, NULL) != 1) {
+        tls_print_error("load TLS CA failed");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+
+    struct tls_config *cfg = calloc(1, sizeof(*cfg));
+    if (cfg == NULL) {
+        perror("malloc tls config failed");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    cfg->ctx = ctx;
+    return cfg;
+}
+
+/**
+ * @brief 释放配置（已建立的连接不受影响）
+ * @param cfg 配置
+ */
+void tls_config_free(struct tls_config *cfg)
+{
+    if (cfg != NULL) {
+        SSL_CTX_free(cfg->ctx);
+        free(cfg);
+    }
+}
+
+/**
+ * @brief 在已连接的TCP socket上开始握手
+ * @param cfg 配置
+ * @param fd TCP socket（握手期间仍由调用方持有）
+ * @param peer 客户端：服务器的IP地址或主机名，用于校验证书；服务端：NULL
+ * @return 成功返回连接，失败返回NULL
+ */
+struct tls_session *tls_session_new(struct tls_config *cfg, int fd, const char *peer)
+{
+    struct tls_session *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        log_errno("malloc tls session failed");
+        return NULL;
+    }
+    s->fd = fd;
+    s->server = cfg->server;
+    s->peer_fd = -1;
+
+    s->ssl = SSL_new(cfg->ctx);
+    if (s->ssl == NULL || SSL_set_fd(s->ssl, fd) != 1 || SSL_set_app_data(s->ssl, s) != 1) {
+        tls_print_error("SSL_new failed");
+        tls_session_free(s);
+        return NULL;
+    }
+
+    if (s->server) {
+        SSL_set_accept_state(s->ssl);
+        return s;
+    }
+
+    // 按IP地址连接时校验证书中的IP地址，按主机名连接时校验主机名并发送SNI
+    if (peer != NULL) {
+        struct in_addr addr;
+        int ok = inet_pton(AF_INET, peer, &addr) == 1
+                 ? X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(s->ssl), peer)
+                 : SSL_set1_host(s->ssl, peer) && SSL_set_tlsext_host_name(s->ssl, peer);
+        if (ok != 1) {
+            tls_print_error("TLS peer name setup failed");
+            tls_session_free(s);
+            return NULL;
+        }
+    }
+    SSL_set_connect_state(s->ssl);
+    return s;
+}
+
+/**
+ * @brief 推进握手（socket可读或可写时调用）
+ * @param s 连接
+ * @param events 未完成时输出需要等待的epoll事件（EPOLLIN或EPOLLOUT）
+ * @return 握手完成返回1，需要等待返回0，失败返回-1
+ */
+int tls_session_step(struct tls_session *s, uint32_t *events)
+{
+    ERR_clear_error();
+    int ret = SSL_do_handshake(s->ssl);
+    if (ret == 1) {
+        metrics_inc(m_handshakes);
+        return 1;
+    }
+
+    switch (SSL_get_error(s->ssl, ret)) {
+    case SSL_ERROR_WANT_READ:
+        *events = EPOLLIN;
+        return 0;
+    case SSL_ERROR_WANT_WRITE:
+        *events = EPOLLOUT;
+        return 0;
+    default:
+        metrics_inc(m_failures);
+        if (SSL_get_verify_result(s->ssl) != X509_V_OK) {
+            log_error("TLS handshake failed: %s",
+                      X509_verify_cert_error_string(SSL_get_verify_result(s->ssl)));
+            ERR_clear_error();
+        } else {
+            tls_print_error("TLS handshake failed");
+        }
+        return -1;
+    }
+}
+
+/**
+ * @brief 用户态转发线程：明文侧是socketpair，密文侧是TCP socket，两个方向各一个缓冲区
+ * @param arg 已完成握手的连接（线程退出时释放，并关闭两个描述符）
+ * @return NULL
+ */
+static void *tls_relay_thread(void *arg)
+{
+    struct tls_session *s = arg;
+    unsigned char up[TLS_RELAY_BUFFER];     // 应用 -> 网络
+    unsigned char down[TLS_RELAY_BUFFER];   // 网络 -> 应用
+    int up_len = 0, up_off = 0;
+    int down_len = 0, down_off = 0;
+    sigset_t mask;
+
+    // SSL_write使用write()，对端关闭时的SIGPIPE只屏蔽在本线程
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (1) {
+        struct pollfd pfd[2] = {
+            { .fd = s->peer_fd, .events = 0 },
+            { .fd = s->fd, .events = 0 },
+        };
+        int progress = 0;
+        int err;
+
+        // 网络 -> 应用：先解密一个记录，再写给应用
+        if (down_len == 0) {
+            int n = SSL_read(s->ssl, down, sizeof(down));
+            if (n > 0) {
+                down_len = n;
+                down_off = 0;
+                progress = 1;
+            } else if ((err = SSL_get_error(s->ssl, n)) == SSL_ERROR_WANT_READ) {
+                pfd[1].events |= POLLIN;
+            } else if (err == SSL_ERROR_WANT_WRITE) {
+                pfd[1].events |= POLLOUT;
+            } else {
+                break;
+            }
+        }
+        if (down_len > 0) {
+            ssize_t n = send(s->peer_fd, &down[down_off], down_len - down_off, MSG_NOSIGNAL);
+            if (n > 0) {
+                down_off += n;
+                if (down_off == down_len) {
+                    down_len = 0;
+                }
+                progress = 1;
+            } else if (n < 0 && errno == EAGAIN) {
+                pfd[0].events |= POLLOUT;
+            } else {
+                break;
+            }
+        }
+
+        // 应用 -> 网络：应用关闭明文侧时结束
+        if (up_len == 0) {
+            ssize_t n = recv(s->peer_fd, up, sizeof(up), 0);
+            if (n > 0) {
+                up_len = n;
+                up_off = 0;
+                progress = 1;
+            } else if (n < 0 && errno == EAGAIN) {
+                pfd[0].events |= POLLIN;
+            } else {
+                break;
+            }
+        }
+        if (up_len > 0) {
+            int n = SSL_write(s->ssl, &up[up_off], up_len - up_off);
+            if (n > 0) {
+                up_off += n;
+                if (up_off == up_len) {
+                    up_len = 0;
+                }
+                progress = 1;
+            } else if ((err = SSL_get_error(s->ssl, n)) == SSL_ERROR_WANT_READ) {
+                pfd[1].events |= POLLIN;
+            } else if (err == SSL_ERROR_WANT_WRITE) {
+                pfd[1].events |= POLLOUT;
+            } else {
+                break;
+            }
+        }
+
+        if (!progress && poll(pfd, 2, -1) < 0 && errno != EINTR) {
+            break;
+        }
+    }
+
+    SSL_shutdown(s->ssl);
+    close(s->peer_fd);
+    close(s->fd);
+    s->peer_fd = -1;
+    tls_session_free(s);
+    return NULL;
+}
+
+/**
+ * @brief 启动用户态转发线程
+ * @param s 已完成握手的连接（成功后归转发线程所有）
+ * @return 成功返回应用使用的描述符（阻塞属性与TCP socket相同），失败返回-1
+ */
+static int tls_relay_start(struct tls_session *s)
+{
+    int sv[2];
+    pthread_t tid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        log_errno("tls relay socketpair failed");
+        return -1;
+    }
+
+    int flags = fcntl(s->fd, F_GETFL);
+    if (flags < 0 ||
+        fcntl(s->fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+        fcntl(sv[1], F_SETFL, O_NONBLOCK) < 0 ||
+        ((flags & O_NONBLOCK) && fcntl(sv[0], F_SETFL, O_NONBLOCK) < 0)) {
+        log_errno("tls relay fcntl failed");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    s->peer_fd = sv[1];
+
+    int err = bds_thread_create(&tid, TLS_RELAY_STACK, 1, tls_relay_thread, s);
+    if (err != 0) {
+        log_error("tls relay thread failed: %s", strerror(err));
+        close(sv[0]);
+        close(sv[1]);
+        s->peer_fd = -1;
+        if (!(flags & O_NONBLOCK)) {
+            fcntl(s->fd, F_SETFL, flags);
+        }
+        return -1;
+    }
+    pthread_setname_np(tid, "tls_relay");
+    return sv[0];
+}
+
+/**
+ * @brief 握手完成后切换到加密传输，释放连接
+ * 注：返回内核TLS的原socket或用户态转发的socketpair一端；后者时TCP socket归转发线程，
+ *     调用方不能再关闭它，并须先把它移出自己的epoll。失败时TCP socket仍由调用方关闭
+ * @param s 已完成握手的连接
+ * @return 成功返回应用使用的描述符，失败返回-1
+ */
+int tls_session_done(struct tls_session *s)
+{
+    int ret = tls_install_kernel(s);
+    int fd;
+
+    if (ret == 0) {
+        // 密钥已在内核中，不再需要SSL对象（也不能由它发送close_notify）
+        metrics_inc(m_kernel);
+        fd = s->fd;
+        tls_session_free(s);
+        return fd;
+    }
+
+    if (ret == -1) {
+        fd = tls_relay_start(s);
+        if (fd >= 0) {
+            metrics_inc(m_relay);
+            return fd;
+        }
+    }
+
+    metrics_inc(m_failures);
+    tls_session_free(s);
+    return -1;
+}
+
+/**
+ * @brief 放弃握手并释放连接（不关闭TCP socket）
+ * @param s 连接
+ */
+void tls_session_free(struct tls_session *s)
+{
+    if (s == NULL) {
+        return;
+    }
+    if (s->ssl != NULL) {
+        SSL_free(s->ssl);
+    }
+    OPENSSL_cleanse(s->client_secret, sizeof(s->client_secret));
+    OPENSSL_cleanse(s->server_secret, sizeof(s->server_secret));
+    free(s);
+}
+
+#else /* !BDS_HAVE_TLS */
+
+/**
+ * @brief 未启用OpenSSL时的占位实现：配置失败，调用方不会进入加密模式
+ */
+struct tls_config *tls_server_config(const char *cert_file, const char *key_file)
+{
+    (void)cert_file;
+    (void)key_file;
+    fprintf(stderr, "built without TLS support\n");
+    return NULL;
+}
+
+struct tls_config *tls_client_config(const char *ca_file)
+{
+    (void)ca_file;
+    fprintf(stderr, "built without TLS support\n");
+    return NULL;
+}
+
+void tls_config_free(struct tls_config *cfg)
+{
+    (void)cfg;
+}
+
+struct tls_session *tls_session_new(struct tls_config *cfg, int fd, const char *peer)
+{
+    (void)cfg;
+    (void)fd;
+    (void)peer;
+    return NULL;
+}
+
+int tls_session_step(struct tls_session *s, uint32_t *events)
+{
+    (void)s;
+    (void)events;
+    return -1;
+}
+
+int tls_session_done(struct tls_session *s)
+{
+    (void)s;
+    return -1;
+}
+
+void tls_session_free(struct tls_session *s)
+{
+    (void)s;
+}
+
+int tls_kernel_crypto_info(const unsigned char *secret, int secret_len,
+                           struct tls12_crypto_info_aes_gcm_128 *info)
+{
+    (void)secret;
+    (void)secret_len;
+    (void)info;
+    return -1;
+}
+
+#endif /* BDS_HAVE_TLS */
+
+/**
+ * @brief 阻塞握手（MQTT客户端连接后调用）
+ * @param cfg 配置
+ * @param fd 已连接的TCP socket
+ * @param peer 服务器的IP地址或主机名
+ * @param timeout_ms 握手超时（毫秒）
+ * @return 成功返回应用使用的描述符（见tls_session_done），失败返回-1（TCP socket仍由调用方关闭）
+ */
+int tls_handshake(struct tls_config *cfg, int fd, const char *peer, int timeout_ms)
+{
+    struct tls_session *s = tls_session_new(cfg, fd, peer);
+    uint64_t deadline = bds_now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    uint32_t events = 0;
+    int ret;
+
+    if (s == NULL) {
+        return -1;
+    }
+
+    while ((ret = tls_session_step(s, &events)) == 0) {
+        uint64_t now = bds_now_ns();
+        if (now >= deadline) {
+            log_warn("TLS handshake timed out");
+            ret = -1;
+            break;
+        }
+        struct pollfd pfd = { .fd = fd, .events = (events & EPOLLOUT) ? POLLOUT : POLLIN };
+        if (poll(&pfd, 1, (int)((deadline - now) / 1000000ULL) + 1) < 0 && errno != EINTR) {
+            log_errno("poll failed");
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret < 0) {
+        tls_session_free(s);
+        return -1;
+    }
+    return tls_session_done(s);
+}
+
+/**
+ * @brief 判断描述符的加密方式（热升级交接时用户态转发的连接不能交给新进程）
+ * @param fd 描述符
+ * @return enum tls_mode
+ */
+enum tls_mode tls_fd_mode(int fd)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    char ulp[16] = "";
+    socklen_t ulp_len = sizeof(ulp);
+
+    if (getsockname(fd, (struct sockaddr *)&addr, &addr_len) == 0 && addr.ss_family == AF_UNIX) {
+        return TLS_MODE_RELAY;
+    }
+    if (getsockopt(fd, SOL_TCP, TCP_ULP, ulp, &ulp_len) == 0 && strcmp(ulp, "tls") == 0) {
+        return TLS_MODE_KERNEL;
+    }
+    return TLS_MODE_NONE;
+}
+
+/**
+ * @brief 加密方式的名称
+ * @param mode enum tls_mode
+ * @return 名称
+ */
+const char *tls_mode_name(enum tls_mode mode)
+{
+    switch (mode) {
+    case TLS_MODE_KERNEL:
+        return "kernel TLS";
+    case TLS_MODE_RELAY:
+        return "userspace TLS relay";
+    default:
+        return "plaintext";
+    }
+}
+
+/**
+ * @brief 接收应用数据：内核TLS遇到非应用数据记录时recv返回EIO，改用recvmsg取出记录类型，
+ *        丢弃握手记录（会话票据），告警（close_notify）按对端关闭处理；其他方式等同recv
+ * @param fd 描述符
+ * @param buf 接收缓冲区
+ * @param len 缓冲区大小
+ * @param flags recv标志
+ * @return 同recv
+ */
+ssize_t tls_recv(int fd, void *buf, size_t len, int flags)
+{
+    while (1) {
+        ssize_t n = recv(fd, buf, len, flags);
+        if (n >= 0 || errno != EIO) {
+            return n;
+        }
+
+        char control[CMSG_SPACE(sizeof(unsigned char))];
+        struct iovec iov = { .iov_base = buf, .iov_len = len };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        n = recvmsg(fd, &msg, flags);
+        if (n < 0) {
+            return n;
+        }
+
+        unsigned char type = TLS_RECORD_DATA;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_TLS && cmsg->cmsg_type == TLS_GET_RECORD_TYPE) {
+            type = *CMSG_DATA(cmsg);
+        }
+        if (type == TLS_RECORD_DATA) {
+            return n;
+        }
+        if (type == TLS_RECORD_ALERT) {
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * bds_tls.h
+ * 加密传输头文件
+ * 功能：在用户态用OpenSSL完成TLS 1.3握手，把会话密钥装入内核TLS（kTLS），
+ *       之后连接仍是普通的socket描述符，原有的send/recv、epoll和描述符交接不变；
+ *       内核不支持kTLS时退化为用户态转发线程，调用方拿到socketpair的一端
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef BDS_TLS_H
+#define BDS_TLS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/tls.h>
+
+#include "bds_time.h"
+#include "bds_metrics.h"
+#include "bds_thread.h"
+#include "bds_log.h"
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+// 加密配置
+#define TLS_CIPHER_SUITE     "TLS_AES_128_GCM_SHA256"   // 内核和用户态都支持的套件
+#define TLS_SECRET_MAX       48                         // 流量密钥最大长度（SHA-384）
+#define TLS_RELAY_BUFFER     (16 * 1024)                // 用户态转发线程每个方向的缓冲区
+#define TLS_RELAY_STACK      (256 * 1024)               // 用户态转发线程的栈（两个方向的缓冲区加OpenSSL调用）
+#define TLS_RECORD_ALERT     21                         // TLS记录类型：告警
+#define TLS_RECORD_HANDSHAKE 22                         // TLS记录类型：握手（会话票据、密钥更新）
+#define TLS_RECORD_DATA      23                         // TLS记录类型：应用数据
+
+// 握手完成后连接的加密方式
+enum tls_mode {
+    TLS_MODE_NONE = 0,         // 明文TCP
+    TLS_MODE_KERNEL,           // 内核TLS：描述符仍是原来的TCP socket
+    TLS_MODE_RELAY             // 用户态转发：描述符是socketpair的一端，不能交给其他进程
+};
+
+// 证书和密钥配置（服务端或客户端，不透明）
+struct tls_config;
+
+// 正在握手的连接（不透明）
+struct tls_session;
+
+// 函数声明
+struct tls_config *tls_server_config(const char *cert_file, const char *key_file);
+struct tls_config *tls_client_config(const char *ca_file);
+void tls_config_free(struct tls_config *cfg);
+struct tls_session *tls_session_new(struct tls_config *cfg, int fd, const char *peer);
+int tls_session_step(struct tls_session *s, uint32_t *events);
+int tls_session_done(struct tls_session *s);
+void tls_session_free(struct tls_session *s);
+int tls_handshake(struct tls_config *cfg, int fd, const char *peer, int timeout_ms);
+enum tls_mode tls_fd_mode(int fd);
+const char *tls_mode_name(enum tls_mode mode);
+ssize_t tls_recv(int fd, void *buf, size_t len, int flags);
+int tls_kernel_crypto_info(const unsigned char *secret, int secret_len,
+                           struct tls12_crypto_info_aes_gcm_128 *info);
+
+#endif /* BDS_TLS_H */
@@ -0,0 +1,95 @@
+/*
+ * bds_unarchive.c
+ * 存档解压工具
+ * 功能：把bds_base生成的.bdz存档（包括未写完的.part文件）还原为原始数据流并输出到标准输出
+ * 使用：bds_unarchive 文件... > 输出文件
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_archive.h"
+
+/**
+ * @brief 读取32位小端整数
+ */
+static uint32_t get32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief 解压一个存档文件
+ * @param path 文件路径
+ * @param out 输出流
+ * @return 成功返回0，文件损坏返回-1
+ */
+static int unarchive_file(const char *path, FILE *out)
+{
+    static unsigned char comp[LZ_COMPRESS_BOUND(ARCHIVE_BLOCK_SIZE)];
+    static unsigned char raw[ARCHIVE_BLOCK_SIZE];
+    unsigned char hdr[ARCHIVE_HEADER_LEN];
+    int blocks = 0;
+
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    while (fread(hdr, 1, sizeof(hdr), in) == sizeof(hdr)) {
+        uint32_t raw_len = get32(hdr + 4);
+        uint32_t comp_len = get32(hdr + 8);
+
+        // .part文件末尾可能是未写入的空间
+        if (get32(hdr) != ARCHIVE_MAGIC) {
+            if (get32(hdr) != 0) {
+                fprintf(stderr, "%s: bad block header after %d blocks\n", path, blocks);
+            }
+            break;
+        }
+        if (raw_len > ARCHIVE_BLOCK_SIZE || comp_len > sizeof(comp) ||
+            fread(comp, 1, comp_len, in) != comp_len) {
+            fprintf(stderr, "%s: truncated block %d\n", path, blocks);
+            fclose(in);
+            return -1;
+        }
+
+        if (comp_len == raw_len) {
+            fwrite(comp, 1, comp_len, out);
+        } else if (lz_decompress(comp, comp_len, raw, sizeof(raw)) == (int)raw_len) {
+            fwrite(raw, 1, raw_len, out);
+        } else {
+            fprintf(stderr, "%s: corrupt block %d\n", path, blocks);
+            fclose(in);
+            return -1;
+        }
+        blocks++;
+    }
+
+    fclose(in);
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 存档文件列表
+ * @return 全部成功返回0
+ */
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s archive.bdz... > stream.rtcm3\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (unarchive_file(argv[i], stdout) != 0) {
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,113 @@
+/*
+ * demux_fuzz.c
+ * 串口数据分流模糊测试程序
+ * 功能：对分流器输入任意字节流，检查每个字节按原顺序恰好输出一次、分块方式不影响识别出的帧、
+ *       各通道输出的帧都通过各自的校验
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <assert.h>
+
+#include "bds_demux.h"
+
+#define FUZZ_MAX_OUT 65536
+
+// 输出记录
+struct fuzz_out {
+    unsigned char data[FUZZ_MAX_OUT];      // 全部输出按顺序拼接
+    size_t len;
+    unsigned char frames[FUZZ_MAX_OUT];    // 识别出的帧（不含无法识别的字节）按顺序拼接
+    size_t frames_len;
+    int count[DEMUX_CHANNELS];
+};
+
+/**
+ * @brief 通道回调：校验并记录
+ */
+static void record(int channel, const unsigned char *data, int len, void *arg)
+{
+    struct fuzz_out *out = arg;
+
+    assert(channel >= 0 && channel < DEMUX_CHANNELS && len > 0);
+    switch (channel) {
+    case DEMUX_RTCM: {
+        assert(data[0] == RTCM3_PREAMBLE && len <= RTCM3_MAX_FRAME);
+        uint32_t crc = rtcm_crc24q(data, len - RTCM3_CRC_LEN);
+        assert(data[len - 3] == ((crc >> 16) & 0xFF));
+        assert(data[len - 2] == ((crc >> 8) & 0xFF));
+        assert(data[len - 1] == (crc & 0xFF));
+        break;
+    }
+    case DEMUX_NMEA: {
+        assert(data[0] == '$' && data[len - 1] == '\n');
+        int line_len = data[len - 2] == '\r' ? len - 2 : len - 1;
+        assert(nmea_checksum_ok((const char *)data, line_len));
+        break;
+    }
+    case DEMUX_BINARY:
+        assert((data[0] == DEMUX_UBX_SYNC1 && data[1] == DEMUX_UBX_SYNC2) ||
+               (data[0] == DEMUX_OEM_SYNC1 && data[1] == DEMUX_OEM_SYNC2));
+        assert(len <= DEMUX_MAX_FRAME);
+        break;
+    default:
+        break;
+    }
+
+    assert(out->len + len <= FUZZ_MAX_OUT);
+    memcpy(&out->data[out->len], data, len);
+    out->len += len;
+    if (channel != DEMUX_OTHER) {
+        memcpy(&out->frames[out->frames_len], data, len);
+        out->frames_len += len;
+    }
+    out->count[channel]++;
+}
+
+/**
+ * @brief 模糊测试入口
+ * @param data 输入数据
+ * @param size 输入长度
+ * @return 固定返回0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static struct demux d;
+    static struct fuzz_out whole, split;
+
+    if (size < 1 || size > FUZZ_MAX_OUT) {
+        return 0;
+    }
+
+    // 第一个字节决定分块大小，其余为码流
+    size_t chunk = data[0] + 1;
+    data++;
+    size--;
+
+    // 整块输入：输出按原顺序覆盖全部输入，未输出的只有缓存中的半帧
+    demux_init(&d);
+    memset(&whole, 0, sizeof(whole));
+    demux_push(&d, data, size, record, &whole);
+    assert(whole.len + d.len == size);
+    assert(memcmp(whole.data, data, whole.len) == 0);
+    assert(d.len == 0 || memcmp(d.buf, data + whole.len, d.len) == 0);
+    int whole_pending = d.len;
+
+    // 分块输入：识别出的帧与整块输入一致（无法识别的字节可能在分块边界处分成多段）
+    demux_init(&d);
+    memset(&split, 0, sizeof(split));
+    for (size_t pos = 0; pos < size; pos += chunk) {
+        size_t n = size - pos < chunk ? size - pos : chunk;
+        demux_push(&d, data + pos, n, record, &split);
+    }
+    assert(split.len == whole.len && d.len == whole_pending);
+    assert(memcmp(split.data, data, split.len) == 0);
+    assert(split.frames_len == whole.frames_len);
+    assert(memcmp(split.frames, whole.frames, whole.frames_len) == 0);
+    for (int c = DEMUX_RTCM; c < DEMUX_OTHER; c++) {
+        assert(split.count[c] == whole.count[c]);
+        assert(d.frames[c] == (uint64_t)whole.count[c]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,388 @@
+/*
+ * fanout_test.c
+ * 多目的地发送测试程序
+ * 功能：以发送缓冲区很小的socketpair模拟慢速目的地，检查三种丢弃策略在字节数上限和
+ *       数据段上限处的行为（淘汰时不动已发出一部分的消息）、按字节预算发送不在消息中间停下、
+ *       待发队列环形数组回绕后对端收到的字节流与接受的消息逐字节一致、数据块没有泄漏
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_fanout.h"
+
+#define TEST_SNDBUF      4096                 // 慢速目的地的发送缓冲区（内核按两倍计）
+#define TEST_STREAM_MAX  (8 * 1024 * 1024)    // 期望字节流的最大长度
+#define TEST_WRAP_MSGS   4000                 // 回绕测试的消息数
+#define TEST_FLUSH_MAX   1000                 // 发完队列的最多尝试次数
+
+static struct fanout_pool pool;
+static unsigned char expect[TEST_STREAM_MAX];  // 对端应收到的字节流
+static size_t expect_len;                      // 期望字节流长度
+static size_t got_len;                         // 对端已收到并核对的字节数
+
+/**
+ * @brief 生成序号对应的消息内容
+ * @param seq 序号
+ * @param len 消息长度
+ * @param buf 输出缓冲区
+ */
+static void make_payload(int seq, int len, unsigned char *buf)
+{
+    for (int i = 0; i < len; i++) {
+        buf[i] = (unsigned char)(seq * 131 + i * 7 + (i >> 8));
+    }
+}
+
+/**
+ * @brief 记下对端应收到的一条消息
+ * @param seq 序号
+ * @param len 消息长度
+ */
+static void expect_msg(int seq, int len)
+{
+    if (expect_len + len <= sizeof(expect)) {
+        make_payload(seq, len, &expect[expect_len]);
+        expect_len += len;
+    }
+}
+
+/**
+ * @brief 生成消息并发往目的地（发布者随即释放自己的引用）
+ * @param q 待发队列
+ * @param fd 目的地socket
+ * @param seq 序号
+ * @param len 消息长度
+ * @return fanout_send的返回值，生成消息失败返回-3
+ */
+static int send_msg(struct fanout_queue *q, int fd, int seq, int len)
+{
+    static unsigned char buf[FANOUT_MSG_MAX];
+    struct fanout_msg m;
+
+    make_payload(seq, len, buf);
+    if (fanout_msg_build(&pool, &m, buf, len) != 0) {
+        return -3;
+    }
+    int ret = fanout_send(&pool, q, fd, &m);
+    fanout_msg_release(&pool, &m);
+    return ret;
+}
+
+/**
+ * @brief 生成消息并只排队不发送
+ * @return fanout_enqueue的返回值，生成消息失败返回-3
+ */
+static int enqueue_msg(struct fanout_queue *q, int seq, int len)
+{
+    static unsigned char buf[FANOUT_MSG_MAX];
+    struct fanout_msg m;
+
+    make_payload(seq, len, buf);
+    if (fanout_msg_build(&pool, &m, buf, len) != 0) {
+        return -3;
+    }
+    int ret = fanout_enqueue(&pool, q, &m);
+    fanout_msg_release(&pool, &m);
+    return ret;
+}
+
+/**
+ * @brief 对端读出已到达的数据（最多max字节）并与期望字节流核对
+ * @param name 用例名
+ * @param fd 对端socket
+ * @param max 最多读出的字节数
+ * @return 错误数
+ */
+static int drain(const char *name, int fd, size_t max)
+{
+    unsigned char buf[8192];
+
+    while (max > 0) {
+        ssize_t n = recv(fd, buf, max < sizeof(buf) ? max : sizeof(buf), MSG_DONTWAIT);
+        if (n <= 0) {
+            return 0;
+        }
+        if (got_len + n > expect_len || memcmp(buf, &expect[got_len], n) != 0) {
+            printf("%s: received stream differs from the accepted messages after byte %zu\n", name, got_len);
+            return 1;
+        }
+        got_len += n;
+        max -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 发完待发队列，对端边收边核对，最后检查收到的恰好是全部期望字节流
+ * @param name 用例名
+ * @param q 待发队列
+ * @param fd 目的地socket
+ * @param peer 对端socket
+ * @return 错误数
+ */
+static int flush_all(const char *name, struct fanout_queue *q, int fd, int peer)
+{
+    for (int i = 0; i < TEST_FLUSH_MAX && q->count > 0; i++) {
+        if (fanout_flush(&pool, q, fd) < 0) {
+            printf("%s: fanout_flush failed\n", name);
+            return 1;
+        }
+        if (drain(name, peer, SIZE_MAX) != 0) {
+            return 1;
+        }
+    }
+    if (drain(name, peer, SIZE_MAX) != 0) {
+        return 1;
+    }
+    if (q->count != 0 || q->bytes != 0 || q->head_started) {
+        printf("%s: queue not empty after flushing (%d segments, %d bytes)\n", name, q->count, q->bytes);
+        return 1;
+    }
+    if (got_len != expect_len) {
+        printf("%s: received %zu bytes, expected %zu\n", name, got_len, expect_len);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 检查全部数据块都已归还
+ * @param name 用例名
+ * @return 错误数
+ */
+static int check_chunks(const char *name)
+{
+    if (pool.blocks.free_count != pool.blocks.count) {
+        printf("%s: %d of %d chunks still referenced\n", name, pool.blocks.count - pool.blocks.free_count,
+               pool.blocks.count);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 建立一对本地socket，发送端使用指定的发送缓冲区
+ * @param sv 输出：sv[0]发送端，sv[1]对端
+ * @param sndbuf 发送缓冲区大小，0表示使用默认值
+ * @return 成功返回0，失败返回-1
+ */
+static int open_pair(int sv[2], int sndbuf)
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror("socketpair failed");
+        return -1;
+    }
+    if (sndbuf > 0 && setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) != 0) {
+        perror("setsockopt SO_SNDBUF failed");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    expect_len = 0;
+    got_len = 0;
+    return 0;
+}
+
+/**
+ * @brief 队列写满时的丢弃策略：先让一条最大消息只发出一部分，再排一条，第三条超过字节数上限；
+ *        之后用只有一个字节的消息填满数据段上限
+ * @param policy 丢弃策略
+ * @return 错误数
+ */
+static int test_policy(enum fanout_policy policy)
+{
+    const char *name = fanout_policy_name(policy);
+    struct fanout_queue q;
+    int sv[2];
+    int errors = 0;
+
+    if (open_pair(sv, TEST_SNDBUF) != 0) {
+        return 1;
+    }
+    fanout_queue_init(&q, 2 * FANOUT_MSG_MAX, policy);
+
+    // 空队列直接发送：发送缓冲区放不下整条消息，其余部分排队，队首消息已开始
+    int sent = send_msg(&q, sv[0], 0, FANOUT_MSG_MAX);
+    if (sent <= 0 || sent >= FANOUT_MSG_MAX || !q.head_started) {
+        printf("%s: direct send of %d bytes returned %d, expected a partial send\n", name, FANOUT_MSG_MAX, sent);
+        errors++;
+    }
+    expect_msg(0, FANOUT_MSG_MAX);
+
+    // 第二条放得下
+    if (send_msg(&q, sv[0], 1, FANOUT_MSG_MAX) != 0 || q.bytes != 2 * FANOUT_MSG_MAX - sent) {
+        printf("%s: second message not queued (%d bytes queued)\n", name, q.bytes);
+        errors++;
+    }
+
+    // 第三条超过字节数上限：drop-new丢弃它，drop-old淘汰第二条（已开始的第一条不动），disconnect要求断开
+    int ret = send_msg(&q, sv[0], 2, FANOUT_MSG_MAX);
+    int want = policy == FANOUT_DISCONNECT ? -2 : 0;
+    if (ret != want || q.bytes != 2 * FANOUT_MSG_MAX - sent || !q.head_started) {
+        printf("%s: full queue returned %d (expected %d), %d bytes queued\n", name, ret, want, q.bytes);
+        errors++;
+    }
+    expect_msg(policy == FANOUT_DROP_OLD ? 2 : 1, FANOUT_MSG_MAX);
+    errors += flush_all(name, &q, sv[0], sv[1]);
+
+    // 数据段上限：字节数远小于上限，第FANOUT_QUEUE_SEGS + 1条超出段数
+    for (int seq = 0; seq < FANOUT_QUEUE_SEGS; seq++) {
+        if (enqueue_msg(&q, seq, 1) != 0) {
+            printf("%s: message %d of %d not queued\n", name, seq, FANOUT_QUEUE_SEGS);
+            errors++;
+        }
+    }
+    ret = enqueue_msg(&q, FANOUT_QUEUE_SEGS, 1);
+    want = policy == FANOUT_DISCONNECT ? -2 : policy == FANOUT_DROP_NEW ? 1 : 0;
+    if (ret != want || q.count != FANOUT_QUEUE_SEGS) {
+        printf("%s: segment limit returned %d (expected %d), %d segments queued\n", name, ret, want, q.count);
+        errors++;
+    }
+    expect_len = 0;
+    got_len = 0;
+    for (int seq = policy == FANOUT_DROP_OLD; seq < FANOUT_QUEUE_SEGS + (policy == FANOUT_DROP_OLD); seq++) {
+        expect_msg(seq, 1);
+    }
+    errors += flush_all(name, &q, sv[0], sv[1]);
+
+    // 断开时清空队列
+    if (send_msg(&q, sv[0], 0, FANOUT_MSG_MAX) > 0 && fanout_queue_clear(&pool, &q) <= 0) {
+        printf("%s: fanout_queue_clear dropped nothing\n", name);
+        errors++;
+    }
+    errors += check_chunks(name);
+    close(sv[0]);
+    close(sv[1]);
+    return errors;
+}
+
+/**
+ * @brief 按字节预算发送：预算只决定是否开始下一条整消息，已开始的消息预算为0也要发完
+ * @return 错误数
+ */
+static int test_budget(void)
+{
+    struct fanout_queue q;
+    int sv[2];
+    int errors = 0;
+
+    // 发送缓冲区足够大：预算0不发，预算1发一条整消息，预算刚超过一条发两条
+    if (open_pair(sv, 0) != 0) {
+        return 1;
+    }
+    fanout_queue_init(&q, FANOUT_MSG_MAX, FANOUT_DROP_NEW);
+    for (int seq = 0; seq < 4; seq++) {
+        enqueue_msg(&q, seq, 3000);
+        expect_msg(seq, 3000);
+    }
+    static const struct { int budget; int sent; } steps[] = { { 0, 0 }, { 1, 3000 }, { 3001, 6000 }, { 0, 0 } };
+    for (unsigned int i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        int sent = fanout_flush_budget(&pool, &q, sv[0], steps[i].budget);
+        if (sent != steps[i].sent || q.head_started) {
+            printf("budget: budget %d sent %d bytes, expected %d whole messages\n", steps[i].budget, sent,
+                   steps[i].sent);
+            errors++;
+        }
+    }
+    errors += flush_all("budget", &q, sv[0], sv[1]);
+    close(sv[0]);
+    close(sv[1]);
+
+    // 慢速目的地：队首消息只发出一部分，预算为0时反复发送直到发完它，后面的消息不动
+    if (open_pair(sv, TEST_SNDBUF) != 0) {
+        return errors + 1;
+    }
+    fanout_queue_init(&q, 2 * FANOUT_MSG_MAX, FANOUT_DROP_NEW);
+    send_msg(&q, sv[0], 0, FANOUT_MSG_MAX);
+    expect_msg(0, FANOUT_MSG_MAX);
+    enqueue_msg(&q, 1, 1000);
+    for (int i = 0; i < TEST_FLUSH_MAX && q.head_started; i++) {
+        if (fanout_flush_budget(&pool, &q, sv[0], 0) < 0) {
+            break;
+        }
+        errors += drain("started message", sv[1], SIZE_MAX);
+    }
+    if (q.head_started || q.count != 1 || q.bytes != 1000 || got_len != expect_len) {
+        printf("started message: %d segments and %d bytes left, %zu of %zu bytes received\n",
+               q.count, q.bytes, got_len, expect_len);
+        errors++;
+    }
+    expect_msg(1, 1000);
+    errors += flush_all("started message", &q, sv[0], sv[1]);
+    errors += check_chunks("budget");
+    close(sv[0]);
+    close(sv[1]);
+    return errors;
+}
+
+/**
+ * @brief 环形数组回绕：慢速目的地，长度各异的消息边排队边按预算发送，对端每次读出不同的字节数，
+ *        队列写满时丢弃新消息；队首位置绕过数组若干遍后，对端收到的恰好是被接受的消息
+ * @return 错误数
+ */
+static int test_wrap(void)
+{
+    struct fanout_queue q;
+    int sv[2];
+    int errors = 0;
+    int dropped = 0;
+    long segs = 0;
+
+    if (open_pair(sv, TEST_SNDBUF) != 0) {
+        return 1;
+    }
+    fanout_queue_init(&q, 4 * FANOUT_MSG_MAX, FANOUT_DROP_NEW);
+
+    for (int seq = 0; seq < TEST_WRAP_MSGS && errors == 0; seq++) {
+        int len = 1 + (seq * 7919) % 6000;
+        int count = q.count;
+        int ret = enqueue_msg(&q, seq, len);
+        if (ret == 0) {
+            expect_msg(seq, len);
+            segs += q.count - count;
+        } else if (ret == 1) {
+            dropped++;
+        } else {
+            printf("wrap: fanout_enqueue returned %d\n", ret);
+            errors++;
+        }
+        if (fanout_flush_budget(&pool, &q, sv[0], seq % 3 * 2000) < 0) {
+            printf("wrap: fanout_flush_budget failed\n");
+            errors++;
+        }
+        errors += drain("wrap", sv[1], (size_t)(seq * 13) % 5000);
+    }
+    errors += flush_all("wrap", &q, sv[0], sv[1]);
+    if (dropped == 0 || segs < 4 * FANOUT_QUEUE_SEGS) {
+        printf("wrap: %d messages dropped, %ld segments queued: queue never filled or wrapped\n", dropped, segs);
+        errors++;
+    }
+    errors += check_chunks("wrap");
+    close(sv[0]);
+    close(sv[1]);
+    return errors;
+}
+
+/**
+ * @brief 主函数
+ * @return 全部通过返回0，否则返回1
+ */
+int main(void)
+{
+    int errors = 0;
+
+    // 一个目的地：整个队列的数据段加上发布中的一条消息
+    if (fanout_pool_init(&pool, "fanout_test", FANOUT_QUEUE_SEGS + FANOUT_MSG_CHUNKS) != 0) {
+        return 1;
+    }
+
+    errors += test_policy(FANOUT_DROP_NEW);
+    errors += test_policy(FANOUT_DROP_OLD);
+    errors += test_policy(FANOUT_DISCONNECT);
+    errors += test_budget();
+    errors += test_wrap();
+
+    fanout_pool_free(&pool);
+    printf("fanout_test: %s\n", errors ? "FAILED" : "passed");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * fuzz_driver.c
+ * 模糊测试独立驱动程序
+ * 功能：在没有libFuzzer的编译器（如gcc）下驱动LLVMFuzzerTestOneInput，
+ *       依次执行命令行给出的样本文件或标准输入，可直接配合AFL使用；
+ *       -random N 模式下自行生成N个随机样本做冒烟测试
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FUZZ_MAX_INPUT (1024 * 1024)  // 单个样本最大长度
+#define FUZZ_RANDOM_MAX 4096          // 随机样本最大长度
+
+// 由各模糊测试程序实现
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/**
+ * @brief 读取整个文件并执行一次测试
+ * @param fp 文件句柄
+ * @param buf 读取缓冲区
+ * @return 成功返回0，失败返回-1
+ */
+static int fuzz_run_file(FILE *fp, uint8_t *buf)
+{
+    size_t len = fread(buf, 1, FUZZ_MAX_INPUT, fp);
+    if (ferror(fp)) {
+        perror("fread failed");
+        return -1;
+    }
+
+    // 拷贝到精确大小的堆内存，便于AddressSanitizer检测越界
+    uint8_t *copy = malloc(len > 0 ? len : 1);
+    if (copy == NULL) {
+        perror("malloc failed");
+        return -1;
+    }
+    memcpy(copy, buf, len);
+    LLVMFuzzerTestOneInput(copy, len);
+    free(copy);
+
+    return 0;
+}
+
+/**
+ * @brief 随机样本模式：长度和内容随机，小字节值出现概率更高以触发边界分支
+ * @param runs 执行次数
+ * @param seed 随机种子
+ * @return 成功返回0
+ */
+static int fuzz_run_random(long runs, unsigned int seed)
+{
+    srand(seed);
+
+    for (long n = 0; n < runs; n++) {
+        size_t len = rand() % (FUZZ_RANDOM_MAX + 1);
+        if (rand() % 4 == 0) {
+            len %= 16;
+        }
+        uint8_t *data = malloc(len > 0 ? len : 1);
+        if (data == NULL) {
+            perror("malloc failed");
+            return -1;
+        }
+        for (size_t i = 0; i < len; i++) {
+            int r = rand();
+            data[i] = (r & 0x300) ? (uint8_t)(r & 0xFF) : (uint8_t)(r & 0x03);
+        }
+        LLVMFuzzerTestOneInput(data, len);
+        free(data);
+    }
+
+    printf("Executed %ld random input(s), seed %u\n", runs, seed);
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 样本文件列表（为空时读取标准输入），或 -random N [seed]
+ * @return 成功返回0，失败返回-1
+ */
+int main(int argc, char *argv[])
+{
+    static uint8_t buf[FUZZ_MAX_INPUT];
+
+    if (argc >= 3 && strcmp(argv[1], "-random") == 0) {
+        unsigned int seed = argc >= 4 ? (unsigned int)strtoul(argv[3], NULL, 10) : 1;
+        return fuzz_run_random(atol(argv[2]), seed);
+    }
+
+    if (argc < 2) {
+#ifdef __AFL_LOOP
+        // AFL持久模式：同一进程内循环执行多个样本
+        while (__AFL_LOOP(1000)) {
+            fuzz_run_file(stdin, buf);
+        }
+        return 0;
+#else
+        return fuzz_run_file(stdin, buf);
+#endif
+    }
+
+    for (int i = 1; i < argc; i++) {
+        FILE *fp = fopen(argv[i], "rb");
+        if (fp == NULL) {
+            perror(argv[i]);
+            return -1;
+        }
+        int rc = fuzz_run_file(fp, buf);
+        fclose(fp);
+        if (rc != 0) {
+            return -1;
+        }
+    }
+
+    printf("Executed %d input(s)\n", argc - 1);
+    return 0;
+}
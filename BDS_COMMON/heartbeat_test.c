@@ -0,0 +1,136 @@
+/*
+ * heartbeat_test.c
+ * 链路心跳测试程序
+ * 功能：检查心跳编码后解码各字段不变（含各字段的极值）；只有标识、版本、类型和长度都匹配的
+ *       4094电文被识别为心跳，接收机输出的其他4094电文（厂商专有数据）不被当作心跳，流动站原样转发
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_heartbeat.h"
+
+/**
+ * @brief 编码一个4094电文
+ * @param payload_len 电文长度
+ * @param magic 标识字段
+ * @param version 版本字段
+ * @param kind 类型字段
+ * @param frame 输出的帧
+ * @param size 输出缓冲区大小
+ * @return 帧长度
+ */
+static int make_4094(int payload_len, uint32_t magic, int version, int kind, unsigned char *frame, size_t size)
+{
+    unsigned char payload[64];
+
+    memset(payload, 0x5A, sizeof(payload));
+    rtcm_set_bits(payload, 0, 12, HEARTBEAT_MSG_TYPE);
+    rtcm_set_bits(payload, 12, 4, kind);
+    rtcm_set_bits(payload, 16, 32, magic);
+    rtcm_set_bits(payload, 48, 8, version);
+    return rtcm_frame_encode(payload, payload_len, frame, size);
+}
+
+/**
+ * @brief 检查一个4094电文的识别结果
+ * @param name 用例名
+ * @param frame 帧
+ * @param len 帧长度
+ * @param want 期望的heartbeat_decode返回值
+ * @return 错误数
+ */
+static int check_frame(const char *name, const unsigned char *frame, int len, int want)
+{
+    struct heartbeat hb;
+    int ret = heartbeat_decode(frame, len, &hb);
+
+    if (ret != want) {
+        printf("%s: heartbeat_decode returned %d, expected %d\n", name, ret, want);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 编码后解码，检查各字段不变
+ * @param hb 心跳内容
+ * @return 错误数
+ */
+static int check_round_trip(const struct heartbeat *hb)
+{
+    unsigned char frame[HEARTBEAT_FRAME_LEN];
+    struct heartbeat back;
+
+    int len = heartbeat_encode(hb, frame, sizeof(frame));
+    if (len != HEARTBEAT_FRAME_LEN) {
+        printf("heartbeat_encode returned %d, expected %d\n", len, HEARTBEAT_FRAME_LEN);
+        return 1;
+    }
+    memset(&back, 0, sizeof(back));
+    if (heartbeat_decode(frame, len, &back) != 1 || back.kind != hb->kind || back.seq != hb->seq ||
+        back.send_ns != hb->send_ns || back.echo_ns != hb->echo_ns || back.hold_us != hb->hold_us ||
+        back.queued != hb->queued) {
+        printf("round trip of kind %d seq %u send %llu echo %llu hold %u queued %u failed\n",
+               hb->kind, hb->seq, (unsigned long long)hb->send_ns, (unsigned long long)hb->echo_ns,
+               hb->hold_us, hb->queued);
+        return 1;
+    }
+
+    // 缓冲区不足时不写出
+    if (heartbeat_encode(hb, frame, sizeof(frame) - 1) != -1) {
+        printf("heartbeat_encode accepted a short buffer\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @return 全部通过返回0，否则返回1
+ */
+int main(void)
+{
+    unsigned char frame[128];
+    int errors = 0;
+    int len;
+
+    // 编码往返：典型值和各字段的极值
+    static const struct heartbeat cases[] = {
+        { HEARTBEAT_BEAT, 1, 1760000000123456789ULL, 0, 0, 0 },
+        { HEARTBEAT_ECHO, 42, 987654321ULL, 0, 0, 0 },
+        { HEARTBEAT_BEAT, 0xFFFFFFFFU, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFU, 0xFFFFFFFFU },
+        { HEARTBEAT_BEAT, 0x80000001U, 0x8000000000000001ULL, 0x00000001FFFFFFFFULL, 0x80000000U, 1 },
+        { HEARTBEAT_ECHO, 0, 0, 0, 0, 0 },
+    };
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        errors += check_round_trip(&cases[i]);
+    }
+
+    // 本程序的心跳
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN, HEARTBEAT_MAGIC, HEARTBEAT_VERSION, HEARTBEAT_BEAT, frame, sizeof(frame));
+    errors += check_frame("heartbeat", frame, len, 1);
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN, HEARTBEAT_MAGIC, HEARTBEAT_VERSION, HEARTBEAT_ECHO, frame, sizeof(frame));
+    errors += check_frame("echo", frame, len, 1);
+
+    // 其他4094电文：都不是心跳，流动站原样转发
+    len = make_4094(30, 0x12345678, 0, 1, frame, sizeof(frame));
+    errors += check_frame("vendor 4094", frame, len, 0);
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN, HEARTBEAT_MAGIC ^ 1, HEARTBEAT_VERSION, HEARTBEAT_BEAT, frame, sizeof(frame));
+    errors += check_frame("wrong magic", frame, len, 0);
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN, HEARTBEAT_MAGIC, HEARTBEAT_VERSION + 1, HEARTBEAT_BEAT, frame, sizeof(frame));
+    errors += check_frame("other version", frame, len, 0);
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN, HEARTBEAT_MAGIC, HEARTBEAT_VERSION, 0, frame, sizeof(frame));
+    errors += check_frame("unknown kind", frame, len, 0);
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN + 1, HEARTBEAT_MAGIC, HEARTBEAT_VERSION, HEARTBEAT_BEAT, frame, sizeof(frame));
+    errors += check_frame("longer payload", frame, len, 0);
+    len = make_4094(HEARTBEAT_PAYLOAD_LEN - 1, HEARTBEAT_MAGIC, HEARTBEAT_VERSION, HEARTBEAT_BEAT, frame, sizeof(frame));
+    errors += check_frame("shorter payload", frame, len, 0);
+    len = make_4094(2, 0, 0, 0, frame, sizeof(frame));
+    errors += check_frame("type only", frame, len, 0);
+
+    // 帧头不完整
+    errors += check_frame("truncated", frame, 4, -1);
+
+    printf("heartbeat_test: %s\n", errors ? "FAILED" : "passed");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * lz_fuzz.c
+ * 块压缩模糊测试程序
+ * 功能：对任意输入做解压（不得越界），并检查压缩/解压往返结果与输入一致
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <assert.h>
+
+#include "bds_lz.h"
+
+#define FUZZ_MAX_INPUT 65536
+
+/**
+ * @brief 模糊测试入口
+ * @param data 输入数据
+ * @param size 输入长度
+ * @return 固定返回0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static unsigned char comp[LZ_COMPRESS_BOUND(FUZZ_MAX_INPUT)];
+    static unsigned char raw[FUZZ_MAX_INPUT];
+
+    if (size > FUZZ_MAX_INPUT) {
+        return 0;
+    }
+
+    // 任意输入作为压缩数据：结果要么报错，要么落在输出缓冲区内
+    int n = lz_decompress(data, size, raw, sizeof(raw));
+    assert(n >= -1 && n <= (int)sizeof(raw));
+
+    // 往返：最坏情况下也能压缩成功，解压结果与输入一致
+    int comp_len = lz_compress(data, size, comp, LZ_COMPRESS_BOUND((int)size));
+    assert(comp_len > 0 && comp_len <= LZ_COMPRESS_BOUND((int)size));
+    assert(lz_decompress(comp, comp_len, raw, size) == (int)size);
+    assert(memcmp(raw, data, size) == 0);
+
+    // 输出缓冲区不足时必须报错而不是越界
+    if (size > 0) {
+        assert(lz_decompress(comp, comp_len, raw, size - 1) == -1);
+    }
+
+    return 0;
+}
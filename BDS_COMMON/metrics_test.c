@@ -0,0 +1,134 @@
+/*
+ * metrics_test.c
+ * 运行指标测试程序
+ * 功能：先后启动多于槽位数的短命线程，检查退出线程的槽位被回收（不落入溢出槽）、
+ *       计数器和高水位值仍计入总数、仪表值不再计入；同时存在的线程超过槽位数时共用溢出槽
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_metrics.h"
+
+#define TEST_ROUNDS  (3 * METRICS_MAX_THREADS)   // 先后启动的线程数
+
+static int m_counter = -1;
+static int m_gauge = -1;
+static int m_max = -1;
+
+static pthread_barrier_t barrier;
+
+/**
+ * @brief 短命线程：计数器加一、设置仪表值和高水位值后退出
+ * @param arg 线程序号
+ * @return NULL
+ */
+static void *worker(void *arg)
+{
+    int n = (int)(intptr_t)arg;
+
+    metrics_inc(m_counter);
+    metrics_set(m_gauge, 5);
+    metrics_max(m_max, (uint64_t)n);
+    return NULL;
+}
+
+/**
+ * @brief 同时存在的线程：更新指标后等其他线程都拿到槽位再退出
+ * @param arg 未使用
+ * @return NULL
+ */
+static void *holder(void *arg)
+{
+    (void)arg;
+    metrics_inc(m_counter);
+    metrics_set(m_gauge, 1);
+    pthread_barrier_wait(&barrier);
+    return NULL;
+}
+
+/**
+ * @brief 读取一个运行指标的值
+ * @param name 指标名称
+ * @return 指标值，没有该指标返回-1
+ */
+static long long metric_value(const char *name)
+{
+    static char text[METRICS_BODY_SIZE];
+    char key[METRICS_NAME_LEN + 2];
+
+    metrics_format(text, sizeof(text));
+    snprintf(key, sizeof(key), "\n%s ", name);
+    const char *p = strstr(text, key);
+    return p != NULL ? atoll(p + strlen(key)) : -1;
+}
+
+/**
+ * @brief 检查指标值
+ * @param name 用例名
+ * @param metric 指标名称
+ * @param want 期望值
+ * @return 错误数
+ */
+static int check_value(const char *name, const char *metric, long long want)
+{
+    long long v = metric_value(metric);
+
+    if (v != want) {
+        printf("%s: %s is %lld, expected %lld\n", name, metric, v, want);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @return 全部通过返回0，否则返回1
+ */
+int main(void)
+{
+    pthread_t tids[METRICS_MAX_THREADS + 2];
+    int errors = 0;
+
+    m_counter = metrics_register("test_events_total", "Events", METRIC_COUNTER);
+    m_gauge = metrics_register("test_active", "Active workers", METRIC_GAUGE);
+    m_max = metrics_register("test_max", "Highest worker index", METRIC_GAUGE_MAX);
+
+    // 先后启动的线程复用退出线程的槽位，不落入溢出槽
+    for (int i = 0; i < TEST_ROUNDS; i++) {
+        if (pthread_create(&tids[0], NULL, worker, (void *)(intptr_t)(i + 1)) != 0) {
+            perror("pthread_create failed");
+            return 1;
+        }
+        pthread_join(tids[0], NULL);
+    }
+    errors += check_value("sequential", "test_events_total", TEST_ROUNDS);
+    errors += check_value("sequential", "test_active", 0);
+    errors += check_value("sequential", "test_max", TEST_ROUNDS);
+    if (atomic_load(&metrics_shared_slot.value[m_counter]) != 0) {
+        printf("sequential: exited threads' slots not reused, overflow slot used\n");
+        errors++;
+    }
+
+    // 同时存在的线程多于槽位数：多出的线程共用溢出槽，退出后计数器仍然计入
+    int count = METRICS_MAX_THREADS + 2;
+    pthread_barrier_init(&barrier, NULL, count + 1);
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&tids[i], NULL, holder, NULL) != 0) {
+            perror("pthread_create failed");
+            return 1;
+        }
+    }
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < count; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    errors += check_value("concurrent", "test_events_total", TEST_ROUNDS + count);
+    if (atomic_load(&metrics_shared_slot.value[m_counter]) == 0) {
+        printf("concurrent: more threads than slots but overflow slot unused\n");
+        errors++;
+    }
+
+    printf("metrics_test: %s\n", errors ? "FAILED" : "passed");
+    return errors ? 1 : 0;
+}
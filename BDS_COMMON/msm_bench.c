@@ -0,0 +1,105 @@
+/*
+ * msm_bench.c
+ * MSM解码基准测试程序
+ * 功能：对比快速解码与逐位参考解码在MSM4/5/7、不同卫星数下的电文/秒
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_bench.h"
+#include "bds_msm.h"
+
+// 测试上下文
+struct msm_ctx {
+    unsigned char frame[RTCM3_MAX_FRAME];
+    int frame_len;
+    struct msm_obs obs;
+};
+
+/**
+ * @brief 生成一条BDS MSM电文：nsat颗卫星、3个信号，所有单元都有观测
+ * @param ctx 测试上下文
+ * @param msm MSM等级
+ * @param nsat 卫星数
+ */
+static void make_frame(struct msm_ctx *ctx, int msm, int nsat)
+{
+    static struct msm_obs obs;
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+
+    memset(&obs, 0, sizeof(obs));
+    obs.hdr.msg_type = 1120 + msm;
+    obs.hdr.station_id = 1;
+    obs.hdr.epoch = 345600000;
+    obs.nsat = nsat;
+    obs.nsig = 3;
+    for (int i = 0; i < nsat; i++) {
+        obs.sat_id[i] = i * 2 + 1;
+        obs.rough_ms[i] = 70 + i;
+        obs.rough_mod[i] = i * 37;
+        obs.rough_rate[i] = -300 + i * 29;
+    }
+    obs.sig_id[0] = 2;
+    obs.sig_id[1] = 8;
+    obs.sig_id[2] = 14;
+    for (int i = 0; i < nsat * 3; i++) {
+        obs.cell_sat[i] = i / 3;
+        obs.cell_sig[i] = i % 3;
+        obs.fine_pr[i] = (i * 7919) % 200000 - 100000;
+        obs.fine_phase[i] = (i * 104729) % 4000000 - 2000000;
+        obs.lock[i] = i % 16;
+        obs.cnr[i] = (35 + i % 15) * 16;
+        obs.fine_rate[i] = i * 11 - 200;
+    }
+    obs.ncell = nsat * 3;
+
+    int payload_len = msm_encode(&obs, payload, sizeof(payload));
+    ctx->frame_len = rtcm_frame_encode(payload, payload_len, ctx->frame, sizeof(ctx->frame));
+}
+
+/**
+ * @brief 快速解码
+ */
+static uint64_t bench_fast(void *arg)
+{
+    struct msm_ctx *ctx = arg;
+    msm_decode(ctx->frame, ctx->frame_len, &ctx->obs);
+    return ctx->obs.ncell + ctx->obs.cnr[0];
+}
+
+/**
+ * @brief 参考解码
+ */
+static uint64_t bench_reference(void *arg)
+{
+    struct msm_ctx *ctx = arg;
+    msm_decode_reference(ctx->frame, ctx->frame_len, &ctx->obs);
+    return ctx->obs.ncell + ctx->obs.cnr[0];
+}
+
+/**
+ * @brief 主函数
+ * @return 成功返回0
+ */
+int main()
+{
+    static struct msm_ctx ctx;
+    static const int levels[] = { 4, 5, 7 };
+    static const int sats[] = { 8, 21 };
+    char name[64];
+
+    bench_header();
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        for (size_t j = 0; j < sizeof(sats) / sizeof(sats[0]); j++) {
+            make_frame(&ctx, levels[i], sats[j]);
+
+            snprintf(name, sizeof(name), "msm_decode/msm%d/%dsat", levels[i], sats[j]);
+            double fast = bench_run(name, ctx.frame_len, bench_fast, &ctx);
+            snprintf(name, sizeof(name), "msm_decode_reference/msm%d/%dsat", levels[i], sats[j]);
+            double ref = bench_run(name, ctx.frame_len, bench_reference, &ctx);
+            printf("  -> %.0f msg/s vs %.0f msg/s (x%.1f)\n", 1e9 / fast, 1e9 / ref, ref / fast);
+        }
+    }
+
+    return 0;
+}
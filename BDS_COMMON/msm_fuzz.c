@@ -0,0 +1,118 @@
+/*
+ * msm_fuzz.c
+ * MSM解码模糊测试程序
+ * 功能：对任意电文比较快速解码与参考解码的结果；对解码成功的电文做编码/解码往返校验，
+ *       并检查MSM5/7改写为MSM4后卫星、信号和单元不变，观测值只差MSM4的分辨率
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <assert.h>
+
+#include "bds_msm.h"
+
+/**
+ * @brief 比较两份解码结果（只比较有效范围内的数组元素）
+ * @param a 解码结果
+ * @param b 解码结果
+ */
+static void assert_same(const struct msm_obs *a, const struct msm_obs *b)
+{
+    assert(memcmp(&a->hdr, &b->hdr, sizeof(a->hdr)) == 0);
+    assert(a->iods == b->iods && a->clk_steering == b->clk_steering);
+    assert(a->ext_clock == b->ext_clock && a->smoothing == b->smoothing);
+    assert(a->smoothing_interval == b->smoothing_interval);
+    assert(a->nsat == b->nsat && a->nsig == b->nsig && a->ncell == b->ncell);
+
+    int ext = a->hdr.msm != 4;
+    for (int i = 0; i < a->nsat; i++) {
+        assert(a->sat_id[i] == b->sat_id[i]);
+        assert(a->rough_ms[i] == b->rough_ms[i]);
+        assert(a->rough_mod[i] == b->rough_mod[i]);
+        assert(!ext || (a->ext_info[i] == b->ext_info[i] && a->rough_rate[i] == b->rough_rate[i]));
+    }
+    for (int i = 0; i < a->nsig; i++) {
+        assert(a->sig_id[i] == b->sig_id[i]);
+    }
+    for (int i = 0; i < a->ncell; i++) {
+        assert(a->cell_sat[i] == b->cell_sat[i] && a->cell_sig[i] == b->cell_sig[i]);
+        assert(a->fine_pr[i] == b->fine_pr[i]);
+        assert(a->fine_phase[i] == b->fine_phase[i]);
+        assert(a->lock[i] == b->lock[i]);
+        assert(a->half_cycle[i] == b->half_cycle[i]);
+        assert(a->cnr[i] == b->cnr[i]);
+        assert(!ext || a->fine_rate[i] == b->fine_rate[i]);
+    }
+}
+
+/**
+ * @brief 模糊测试入口
+ * @param data 输入数据（作为电文内容，前两个字节被改写为MSM4/5/7电文号以提高覆盖率）
+ * @param size 输入长度
+ * @return 固定返回0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static const int levels[3] = { 4, 5, 7 };
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+    unsigned char frame[RTCM3_MAX_FRAME];
+    static struct msm_obs fast, ref, again, lean;
+
+    if (size < 2 || size > RTCM3_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    // 第一个字节选择卫星系统和MSM等级
+    memcpy(payload, data, size);
+    int type = 1071 + (data[0] % 7) * 10 + levels[data[1] % 3] - 1;
+    rtcm_set_bits(payload, 0, 12, type);
+    int frame_len = rtcm_frame_encode(payload, size, frame, sizeof(frame));
+
+    int rc_fast = msm_decode(frame, frame_len, &fast);
+    int rc_ref = msm_decode_reference(frame, frame_len, &ref);
+    assert(rc_fast == rc_ref);
+    if (rc_fast < 0) {
+        return 0;
+    }
+    assert_same(&fast, &ref);
+    assert(fast.ncell <= MSM_MAX_CELLS && fast.nsat * fast.nsig <= MSM_MAX_CELLS);
+
+    // 解码结果重新编码后再解码，结果不变
+    int len = msm_encode(&fast, payload, sizeof(payload));
+    assert(len > 0 && (size_t)len <= size);
+    frame_len = rtcm_frame_encode(payload, len, frame, sizeof(frame));
+    assert(msm_decode(frame, frame_len, &again) == 0);
+    assert_same(&fast, &again);
+
+    // 改写为MSM4：电文不变长，结构和不受分辨率影响的字段不变
+    unsigned char reduced[RTCM3_MAX_FRAME];
+    int reduced_len = msm_reduce(frame, frame_len, reduced, sizeof(reduced));
+    if (fast.hdr.msm == 4) {
+        assert(reduced_len == 0);
+        return 0;
+    }
+    assert(reduced_len > 0 && reduced_len <= frame_len);
+    assert(msm_decode(reduced, reduced_len, &lean) == 0);
+    assert(lean.hdr.msm == 4 && lean.hdr.sys == fast.hdr.sys && lean.hdr.epoch == fast.hdr.epoch);
+    assert(lean.hdr.multiple == fast.hdr.multiple && lean.hdr.station_id == fast.hdr.station_id);
+    assert(lean.nsat == fast.nsat && lean.nsig == fast.nsig && lean.ncell == fast.ncell);
+    for (int i = 0; i < fast.nsat; i++) {
+        assert(lean.sat_id[i] == fast.sat_id[i] && lean.rough_ms[i] == fast.rough_ms[i]);
+        assert(lean.rough_mod[i] == fast.rough_mod[i]);
+    }
+    for (int i = 0; i < fast.ncell; i++) {
+        assert(lean.cell_sat[i] == fast.cell_sat[i] && lean.cell_sig[i] == fast.cell_sig[i]);
+        assert(lean.half_cycle[i] == fast.half_cycle[i] && lean.lock[i] <= 15);
+        assert((fast.fine_pr[i] == MSM_INVALID_FINE_PR) == (lean.fine_pr[i] == MSM_INVALID_FINE_PR));
+        assert((fast.fine_phase[i] == MSM_INVALID_FINE_PHASE) == (lean.fine_phase[i] == MSM_INVALID_FINE_PHASE));
+        if (fast.fine_pr[i] != MSM_INVALID_FINE_PR) {
+            assert(abs(lean.fine_pr[i] - fast.fine_pr[i]) <= 32);
+        }
+        if (fast.fine_phase[i] != MSM_INVALID_FINE_PHASE) {
+            assert(abs(lean.fine_phase[i] - fast.fine_phase[i]) <= 4);
+        }
+        assert(abs((int)lean.cnr[i] - (int)fast.cnr[i]) <= 16);
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * msm_lock_test.c
+ * MSM锁定时间指示测试程序
+ * 功能：检查数据流生成工具使用的锁定时间编码（msm_lock_indicator）与解码换算（msm_lock_ms）往返一致：
+ *       每个有效指示值编码后不变，连续跟踪时间增长时指示值不回退，且取的是不超过跟踪时间的最大指示值
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "bds_msm.h"
+
+/**
+ * @brief 检查一种锁定时间指示（DF402或DF407）
+ * @param msm MSM等级（4表示DF402，7表示DF407）
+ * @param max_lock 最大有效指示值
+ * @return 错误数
+ */
+static int check_lock(int msm, int max_lock)
+{
+    int errors = 0;
+
+    // 指示值 -> 最短锁定时间 -> 指示值
+    for (int lock = 0; lock <= max_lock; lock++) {
+        uint32_t ms = msm_lock_ms(lock, msm);
+        int back = msm_lock_indicator(ms, msm);
+        if (back != lock) {
+            printf("MSM%d: indicator %d -> %u ms -> %d\n", msm, lock, ms, back);
+            errors++;
+        }
+    }
+
+    // 连续跟踪时间 -> 指示值：单调不减，最短锁定时间不超过跟踪时间，下一个指示值则超过
+    int prev = 0;
+    for (uint64_t ms = 0; ms < (1ULL << 27); ms += ms < (1U << 20) ? 1 : 997) {
+        int lock = msm_lock_indicator(ms, msm);
+        if (lock < prev || lock > max_lock || msm_lock_ms(lock, msm) > ms ||
+            (lock < max_lock && msm_lock_ms(lock + 1, msm) <= ms)) {
+            printf("MSM%d: %llu ms -> indicator %d (previous %d)\n", msm, (unsigned long long)ms, lock, prev);
+            if (++errors > 20) {
+                break;
+            }
+        }
+        prev = lock;
+    }
+    return errors;
+}
+
+/**
+ * @brief 主函数
+ * @return 全部通过返回0，否则返回1
+ */
+int main(void)
+{
+    int errors = check_lock(4, 15) + check_lock(7, 704);
+
+    // 规范中的几个取值：DF407的64~95为2i-64，96~127为4i-256
+    static const struct { int lock; uint32_t ms; } df407[] = {
+        { 63, 63 }, { 64, 64 }, { 95, 126 }, { 96, 128 }, { 127, 252 }, { 128, 256 }, { 704, 1U << 26 }
+    };
+    for (unsigned int i = 0; i < sizeof(df407) / sizeof(df407[0]); i++) {
+        if (msm_lock_ms(df407[i].lock, 7) != df407[i].ms) {
+            printf("DF407 %d: %u ms, expected %u\n", df407[i].lock, msm_lock_ms(df407[i].lock, 7), df407[i].ms);
+            errors++;
+        }
+    }
+
+    printf("msm_lock_test: %s\n", errors ? "FAILED" : "passed");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * nmea_fuzz.c
+ * NMEA语句处理模糊测试程序
+ * 功能：对语句提取输入任意字节流，检查每条输出都是校验通过的完整语句、分块方式不影响输出；
+ *       对GGA解析输入任意语句，检查不越界读取、解析成功的坐标都在有效范围内
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <assert.h>
+
+#include "bds_nmea.h"
+
+#define FUZZ_MAX_OUT 65536
+
+// 输出记录
+struct fuzz_out {
+    char data[FUZZ_MAX_OUT];   // 全部语句按顺序拼接（以'\n'分隔）
+    size_t len;
+    int count;
+};
+
+/**
+ * @brief 检查GGA解析结果
+ * @param line 以'\0'结尾的语句
+ */
+static void check_gga(const char *line)
+{
+    struct nmea_gga gga;
+    double ecef[3];
+
+    if (nmea_parse_gga(line, &gga) != 0) {
+        return;
+    }
+    assert(gga.quality > 0);
+    assert(gga.lat >= -90.0 && gga.lat <= 90.0);
+    assert(gga.lon >= -180.0 && gga.lon <= 180.0);
+    assert(gga.height >= NMEA_HEIGHT_MIN && gga.height <= NMEA_HEIGHT_MAX);
+
+    // 坐标转换得到地球附近的有限值，基线计算不会出现NaN
+    nmea_llh_to_ecef(gga.lat, gga.lon, gga.height, ecef);
+    double r = sqrt(ecef[0] * ecef[0] + ecef[1] * ecef[1] + ecef[2] * ecef[2]);
+    assert(r > 6300000.0 && r < 6400000.0);
+}
+
+/**
+ * @brief 语句回调：校验、记录并解析
+ */
+static void record(const char *line, int len, void *arg)
+{
+    struct fuzz_out *out = arg;
+
+    assert(len > 0 && len <= NMEA_MAX_LINE);
+    assert(line[0] == '$' && (int)strlen(line) == len);
+    assert(memchr(line, '\r', len) == NULL && memchr(line, '\n', len) == NULL);
+    assert(nmea_checksum_ok(line, len));
+
+    assert(out->len + len + 1 <= sizeof(out->data));
+    memcpy(&out->data[out->len], line, len);
+    out->len += len;
+    out->data[out->len++] = '\n';
+    out->count++;
+
+    check_gga(line);
+}
+
+/**
+ * @brief 模糊测试入口
+ * @param data 输入数据
+ * @param size 输入长度
+ * @return 固定返回0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static struct nmea_reader reader;
+    static struct fuzz_out whole, split;
+    static char line[FUZZ_MAX_OUT + 1];
+
+    if (size == 0 || size > FUZZ_MAX_OUT / 2) {
+        return 0;
+    }
+
+    // 一次输入
+    memset(&whole, 0, sizeof(whole));
+    nmea_reader_init(&reader);
+    nmea_reader_push(&reader, data, size, record, &whole);
+    assert(reader.sentences == (uint64_t)whole.count);
+
+    // 按首字节决定的大小分块输入，输出的语句相同
+    memset(&split, 0, sizeof(split));
+    nmea_reader_init(&reader);
+    size_t step = data[0] % 17 + 1;
+    for (size_t off = 0; off < size; off += step) {
+        size_t n = size - off < step ? size - off : step;
+        nmea_reader_push(&reader, data + off, n, record, &split);
+    }
+    assert(split.count == whole.count);
+    assert(split.len == whole.len && memcmp(split.data, whole.data, whole.len) == 0);
+
+    // 整个输入作为一条语句直接解析（不经过校验，覆盖字段切分和数值转换）
+    memcpy(line, data, size);
+    line[size] = '\0';
+    check_gga(line);
+
+    return 0;
+}
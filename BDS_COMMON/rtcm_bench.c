@@ -0,0 +1,153 @@
+/*
+ * rtcm_bench.c
+ * RTCM3帧处理基准测试程序
+ * 功能：测量CRC-24Q、不同读取块大小下的分帧以及分帧+历元组装的ns/op与MB/s
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "bds_bench.h"
+#include "bds_rtcm.h"
+#include "bds_epoch.h"
+
+#define BENCH_EPOCHS        64
+#define BENCH_STREAM_SIZE   (BENCH_EPOCHS * 4 * RTCM3_MAX_FRAME)
+
+// 测试上下文
+struct rtcm_ctx {
+    unsigned char stream[BENCH_STREAM_SIZE];
+    int stream_len;
+    int chunk;
+    struct rtcm_framer framer;
+    struct epoch_assembler epoch;
+    uint64_t sink;
+};
+
+/**
+ * @brief 生成一帧MSM观测电文
+ * @param out 输出缓冲区
+ * @param type 电文号
+ * @param epoch 历元时间
+ * @param multiple 多电文标志
+ * @param payload_len 电文长度
+ * @return 帧长度
+ */
+static int make_msm(unsigned char *out, int type, uint32_t epoch, int multiple, int payload_len)
+{
+    unsigned char payload[RTCM3_MAX_PAYLOAD];
+
+    for (int i = 0; i < payload_len; i++) {
+        payload[i] = (unsigned char)(i * 131 + type);
+    }
+    rtcm_set_bits(payload, 0, 12, type);
+    rtcm_set_bits(payload, 12, 12, 1);
+    rtcm_set_bits(payload, 24, 30, epoch);
+    rtcm_set_bits(payload, 54, 1, multiple);
+    return rtcm_frame_encode(payload, payload_len, out, RTCM3_MAX_FRAME);
+}
+
+/**
+ * @brief 分帧回调（只累计长度）
+ */
+static void count_frame(const unsigned char *frame, int len, void *arg)
+{
+    struct rtcm_ctx *ctx = arg;
+    ctx->sink += len + frame[3];
+}
+
+/**
+ * @brief 历元输出回调（只累计长度）
+ */
+static void count_epoch(const unsigned char *buf, int len, int reason, uint64_t first_ns, void *arg)
+{
+    struct rtcm_ctx *ctx = arg;
+    (void)first_ns;
+    ctx->sink += len + reason + buf[0];
+}
+
+/**
+ * @brief 分帧回调：送入历元组装器
+ */
+static void push_epoch(const unsigned char *frame, int len, void *arg)
+{
+    struct rtcm_ctx *ctx = arg;
+    epoch_push(&ctx->epoch, frame, len, 0);
+}
+
+/**
+ * @brief CRC-24Q：1KB数据
+ */
+static uint64_t bench_crc(void *arg)
+{
+    struct rtcm_ctx *ctx = arg;
+    return rtcm_crc24q(ctx->stream, 1024);
+}
+
+/**
+ * @brief 分帧：按块大小输入整个码流
+ */
+static uint64_t bench_framer(void *arg)
+{
+    struct rtcm_ctx *ctx = arg;
+
+    for (int pos = 0; pos < ctx->stream_len; pos += ctx->chunk) {
+        int n = ctx->stream_len - pos < ctx->chunk ? ctx->stream_len - pos : ctx->chunk;
+        rtcm_framer_push(&ctx->framer, &ctx->stream[pos], n, count_frame, ctx);
+    }
+    return ctx->sink;
+}
+
+/**
+ * @brief 分帧+历元组装：按块大小输入整个码流
+ */
+static uint64_t bench_framer_epoch(void *arg)
+{
+    struct rtcm_ctx *ctx = arg;
+
+    for (int pos = 0; pos < ctx->stream_len; pos += ctx->chunk) {
+        int n = ctx->stream_len - pos < ctx->chunk ? ctx->stream_len - pos : ctx->chunk;
+        rtcm_framer_push(&ctx->framer, &ctx->stream[pos], n, push_epoch, ctx);
+    }
+    return ctx->sink;
+}
+
+/**
+ * @brief 主函数
+ * @return 成功返回0
+ */
+int main()
+{
+    static struct rtcm_ctx ctx;
+    static const int chunks[] = { 64, 512, 4096 };
+    char name[64];
+
+    // 每个历元：GPS/GLONASS/BDS三条MSM7加一条1005
+    for (int e = 0; e < BENCH_EPOCHS; e++) {
+        unsigned char *p = &ctx.stream[ctx.stream_len];
+        uint32_t t = e * 1000;
+        p += make_msm(p, 1077, t, 1, 400);
+        p += make_msm(p, 1087, t, 1, 300);
+        p += make_msm(p, 1127, t, 0, 350);
+        if (e % 10 == 0) {
+            unsigned char station[19] = { 0 };
+            rtcm_set_bits(station, 0, 12, 1005);
+            p += rtcm_frame_encode(station, sizeof(station), p, RTCM3_MAX_FRAME);
+        }
+        ctx.stream_len = p - ctx.stream;
+    }
+
+    rtcm_framer_init(&ctx.framer);
+    epoch_init(&ctx.epoch, 1000, count_epoch, &ctx);
+
+    bench_header();
+    bench_run("rtcm_crc24q/1024", 1024, bench_crc, &ctx);
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        ctx.chunk = chunks[i];
+        snprintf(name, sizeof(name), "rtcm_framer_push/chunk%d", chunks[i]);
+        bench_run(name, ctx.stream_len, bench_framer, &ctx);
+        snprintf(name, sizeof(name), "framer+epoch_push/chunk%d", chunks[i]);
+        bench_run(name, ctx.stream_len, bench_framer_epoch, &ctx);
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * rtcm_fuzz.c
+ * RTCM3帧处理模糊测试程序
+ * 功能：对分帧器输入任意字节流，检查分块方式不影响结果、输出帧均通过CRC；
+ *       对历元组装器检查输出字节与输入帧一一对应
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <assert.h>
+
+#include "bds_rtcm.h"
+#include "bds_epoch.h"
+
+#define FUZZ_MAX_OUT 65536
+
+// 输出记录
+struct fuzz_out {
+    unsigned char data[FUZZ_MAX_OUT];
+    size_t len;
+    int frames;
+};
+
+/**
+ * @brief 分帧回调：校验并记录帧
+ */
+static void record_frame(const unsigned char *frame, int len, void *arg)
+{
+    struct fuzz_out *out = arg;
+
+    assert(len >= RTCM3_HEADER_LEN + RTCM3_CRC_LEN && len <= RTCM3_MAX_FRAME);
+    assert(frame[0] == RTCM3_PREAMBLE);
+    uint32_t crc = rtcm_crc24q(frame, len - RTCM3_CRC_LEN);
+    assert(frame[len - 3] == ((crc >> 16) & 0xFF));
+    assert(frame[len - 2] == ((crc >> 8) & 0xFF));
+    assert(frame[len - 1] == (crc & 0xFF));
+
+    if (out->len + len <= FUZZ_MAX_OUT) {
+        memcpy(&out->data[out->len], frame, len);
+    }
+    out->len += len;
+    out->frames++;
+}
+
+/**
+ * @brief 历元输出回调：拼接输出
+ */
+static void record_epoch(const unsigned char *buf, int len, int reason, uint64_t first_ns, void *arg)
+{
+    struct fuzz_out *out = arg;
+    (void)first_ns;
+
+    assert(reason >= EPOCH_COMPLETE && reason <= EPOCH_PASSTHROUGH);
+    assert(len > 0 && len <= EPOCH_BUFFER_SIZE);
+    if (out->len + len <= FUZZ_MAX_OUT) {
+        memcpy(&out->data[out->len], buf, len);
+    }
+    out->len += len;
+}
+
+/**
+ * @brief 分帧回调：送入历元组装器，时间取帧序号
+ */
+static void feed_epoch(const unsigned char *frame, int len, void *arg)
+{
+    struct epoch_assembler *ea = arg;
+    static uint64_t now;
+    now += 1000000;
+    epoch_push(ea, frame, len, now);
+    epoch_poll(ea, now);
+}
+
+/**
+ * @brief 模糊测试入口
+ * @param data 输入数据
+ * @param size 输入长度
+ * @return 固定返回0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static struct rtcm_framer f;
+    static struct fuzz_out whole, split, epoch_out;
+    static struct epoch_assembler ea;
+
+    if (size < 1 || size > FUZZ_MAX_OUT) {
+        return 0;
+    }
+
+    // 第一个字节决定分块大小，其余为码流
+    size_t chunk = data[0] + 1;
+    data++;
+    size--;
+
+    // 整块输入
+    rtcm_framer_init(&f);
+    whole.len = 0;
+    whole.frames = 0;
+    rtcm_framer_push(&f, data, size, record_frame, &whole);
+    uint64_t whole_skipped = f.skipped_bytes;
+    int whole_pending = f.len;
+
+    // 分块输入：输出的帧必须与整块输入一致
+    rtcm_framer_init(&f);
+    split.len = 0;
+    split.frames = 0;
+    for (size_t pos = 0; pos < size; pos += chunk) {
+        size_t n = size - pos < chunk ? size - pos : chunk;
+        rtcm_framer_push(&f, data + pos, n, record_frame, &split);
+    }
+    assert(split.frames == whole.frames);
+    assert(split.len == whole.len);
+    assert(memcmp(split.data, whole.data, whole.len) == 0);
+    assert(f.skipped_bytes == whole_skipped && f.len == whole_pending);
+
+    // 所有输入字节要么成为帧、要么被丢弃、要么仍在缓存中
+    assert(whole.len + f.skipped_bytes + f.len <= size);
+
+    // 历元组装：输出是输入帧按原顺序的拼接，不丢不重
+    rtcm_framer_init(&f);
+    epoch_init(&ea, 5, record_epoch, &epoch_out);
+    epoch_out.len = 0;
+    rtcm_framer_push(&f, data, size, feed_epoch, &ea);
+    epoch_flush(&ea, EPOCH_DEADLINE);
+    assert(epoch_out.len == whole.len);
+    assert(memcmp(epoch_out.data, whole.data, whole.len) == 0);
+
+    return 0;
+}
@@ -0,0 +1,392 @@
+/*
+ * shard_test.c
+ * 分片下游转发测试程序
+ * 功能：stream：新客户端先收到加入数据；长度各异的消息连续写过跨线程队列若干遍
+ *       （含跨越队列末尾的消息），客户端逐字节收到，之后加入的客户端只收到新的加入数据和之后的广播；
+ *       overrun：转发线程以SCHED_FIFO与分片线程绑定在同一个CPU上，分片线程不能运行，队列写满，
+ *       之后分片线程断开全部客户端并恢复写入，写满期间更新的加入数据在恢复后重发给新客户端；
+ *       不允许使用SCHED_FIFO时返回77（跳过）
+ * 用法：shard_test stream|overrun
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <sched.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "bds_shard.h"
+
+#define SHARD_TEST_SKIP        77      // ctest的SKIP_RETURN_CODE
+#define SHARD_TEST_TIMEOUT_MS  5000    // 等待分片线程、客户端读取的超时（毫秒）
+#define SHARD_TEST_CLIENTS     4       // 客户端槽位数
+#define SHARD_TEST_BLOCKS      4       // 待发队列块数
+#define SHARD_TEST_IMAGE_LEN   1000    // 加入数据长度
+
+static unsigned char payload[SHARD_MSG_MAX];
+static unsigned char recv_buf[SHARD_MSG_MAX];
+
+/**
+ * @brief 生成序号对应的消息内容
+ * @param seq 序号
+ * @param len 消息长度
+ * @return 内容（payload缓冲区）
+ */
+static const unsigned char *make_payload(int seq, int len)
+{
+    for (int i = 0; i < len; i++) {
+        payload[i] = (unsigned char)(seq * 131 + i * 7 + (i >> 8));
+    }
+    return payload;
+}
+
+/**
+ * @brief 启动一个分片，监听本机的临时端口
+ * @param port 输出：监听端口
+ * @return 分片集合，失败返回NULL
+ */
+static struct shard_set *start_shard(int *port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    int fd = relay_listen(0, 1);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        perror("getsockname failed");
+        close(fd);
+        return NULL;
+    }
+    *port = ntohs(addr.sin_port);
+    return shard_start(*port, 1, SHARD_TEST_CLIENTS, SHARD_TEST_BLOCKS, &fd, 1);
+}
+
+/**
+ * @brief 等待分片线程的客户端数达到count
+ * @param set 分片集合
+ * @param count 期望的客户端数
+ * @return 达到返回0，超时返回-1
+ */
+static int wait_clients(struct shard_set *set, int count)
+{
+    for (int ms = 0; ms < SHARD_TEST_TIMEOUT_MS; ms++) {
+        if (__atomic_load_n(&set->shards[0].relay->count, __ATOMIC_ACQUIRE) == count) {
+            return 0;
+        }
+        usleep(1000);
+    }
+    printf("shard has %d clients, expected %d\n", set->shards[0].relay->count, count);
+    return -1;
+}
+
+/**
+ * @brief 等待分片线程取完队列并清除写满标志
+ * @param set 分片集合
+ * @return 取完返回0，超时返回-1
+ */
+static int wait_drained(struct shard_set *set)
+{
+    struct shard_queue *q = &set->queues[0];
+
+    for (int ms = 0; ms < SHARD_TEST_TIMEOUT_MS; ms++) {
+        if (atomic_load(&q->tail) == atomic_load(&q->head) && !atomic_load(&q->overrun)) {
+            return 0;
+        }
+        usleep(1000);
+    }
+    printf("shard queue not drained (%u bytes left, overrun %d)\n",
+           atomic_load(&q->head) - atomic_load(&q->tail), atomic_load(&q->overrun));
+    return -1;
+}
+
+/**
+ * @brief 连接分片并等待分片线程接受连接
+ * @param set 分片集合
+ * @param port 监听端口
+ * @param count 连接后分片的客户端数
+ * @return 客户端socket，失败返回-1
+ */
+static int connect_client(struct shard_set *set, int port, int count)
+{
+    struct sockaddr_in addr;
+    struct timeval tv = { SHARD_TEST_TIMEOUT_MS / 1000, 0 };
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("client socket creation failed");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("client connect failed");
+        close(fd);
+        return -1;
+    }
+    if (wait_clients(set, count) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 客户端读出len字节，检查与序号对应的消息内容一致
+ * @param name 用例名
+ * @param fd 客户端socket
+ * @param seq 期望的消息序号
+ * @param len 期望的消息长度
+ * @return 错误数
+ */
+static int expect_msg(const char *name, int fd, int seq, int len)
+{
+    int got = 0;
+
+    while (got < len) {
+        ssize_t n = recv(fd, recv_buf + got, len - got, 0);
+        if (n <= 0) {
+            printf("%s: %s after %d of %d bytes of message %d\n", name, n == 0 ? "connection closed" : "timed out",
+                   got, len, seq);
+            return 1;
+        }
+        got += n;
+    }
+    if (memcmp(recv_buf, make_payload(seq, len), len) != 0) {
+        printf("%s: message %d of %d bytes differs\n", name, seq, len);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 客户端读到连接关闭（之前收到的数据不检查）
+ * @param name 用例名
+ * @param fd 客户端socket
+ * @return 错误数
+ */
+static int expect_eof(const char *name, int fd)
+{
+    for (;;) {
+        ssize_t n = recv(fd, recv_buf, sizeof(recv_buf), 0);
+        if (n == 0) {
+            return 0;
+        }
+        if (n < 0) {
+            printf("%s: connection not closed\n", name);
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief 读取一个运行指标的值
+ * @param name 指标名称
+ * @return 指标值，没有该指标返回-1
+ */
+static long long metric_value(const char *name)
+{
+    static char text[METRICS_BODY_SIZE];
+    char key[METRICS_NAME_LEN + 2];
+
+    metrics_format(text, sizeof(text));
+    snprintf(key, sizeof(key), "\n%s ", name);
+    const char *p = strstr(text, key);
+    return p != NULL ? atoll(p + strlen(key)) : -1;
+}
+
+/**
+ * @brief 加入数据与队列回绕
+ * @return 错误数
+ */
+static int test_stream(void)
+{
+    int port, errors = 0;
+    int seq = 0;
+
+    struct shard_set *set = start_shard(&port);
+    if (set == NULL) {
+        return 1;
+    }
+
+    // 新客户端先收到加入数据
+    shard_set_image(set, make_payload(seq++, SHARD_TEST_IMAGE_LEN), SHARD_TEST_IMAGE_LEN);
+    if (wait_drained(set) != 0) {
+        shard_stop(set);
+        return 1;
+    }
+    int c1 = connect_client(set, port, 1);
+    if (c1 < 0) {
+        shard_stop(set);
+        return 1;
+    }
+    errors += expect_msg("join image", c1, 0, SHARD_TEST_IMAGE_LEN);
+
+    // 写过队列四遍：长度不按8字节对齐，最长的消息接近队列的1/8，总有消息跨越队列末尾
+    uint32_t start = atomic_load(&set->queues[0].head);
+    while (atomic_load(&set->queues[0].head) - start < 4 * SHARD_QUEUE_SIZE && errors == 0) {
+        int len = 1 + (seq * 7919) % SHARD_MSG_MAX;
+        shard_broadcast(set, make_payload(seq, len), len);
+        errors += expect_msg("wrap", c1, seq, len);
+        seq++;
+    }
+
+    // 更新加入数据后加入的客户端只收到新的加入数据和之后的广播
+    int image = seq++;
+    shard_set_image(set, make_payload(image, SHARD_TEST_IMAGE_LEN), SHARD_TEST_IMAGE_LEN);
+    int before = seq++;
+    shard_broadcast(set, make_payload(before, 500), 500);
+    if (wait_drained(set) == 0) {
+        int c2 = connect_client(set, port, 2);
+        if (c2 >= 0) {
+            int after = seq++;
+            shard_broadcast(set, make_payload(after, 700), 700);
+            errors += expect_msg("new image", c2, image, SHARD_TEST_IMAGE_LEN);
+            errors += expect_msg("after new image", c2, after, 700);
+            errors += expect_msg("before new image", c1, before, 500);
+            errors += expect_msg("after new image", c1, after, 700);
+            close(c2);
+        } else {
+            errors++;
+        }
+    } else {
+        errors++;
+    }
+
+    shard_stop(set);
+    errors += expect_eof("stop", c1);
+    close(c1);
+    return errors;
+}
+
+/**
+ * @brief 队列写满后的恢复：断开全部客户端，恢复后重发写满期间更新的加入数据
+ * @return 通过返回0，不允许使用SCHED_FIFO返回77，失败返回1
+ */
+static int test_overrun(void)
+{
+    struct sched_param param = { .sched_priority = 1 };
+    struct sched_param other = { .sched_priority = 0 };
+    cpu_set_t cpus;
+    int port, errors = 0;
+
+    // 分片线程继承创建者的CPU绑定，与转发线程在同一个CPU上
+    CPU_ZERO(&cpus);
+    CPU_SET(sched_getcpu(), &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        perror("sched_setaffinity failed");
+        return 1;
+    }
+
+    struct shard_set *set = start_shard(&port);
+    if (set == NULL) {
+        return 1;
+    }
+    struct shard *s = &set->shards[0];
+    struct shard_queue *q = &set->queues[0];
+
+    shard_set_image(set, make_payload(0, SHARD_TEST_IMAGE_LEN), SHARD_TEST_IMAGE_LEN);
+    if (wait_drained(set) != 0) {
+        shard_stop(set);
+        return 1;
+    }
+    int c1 = connect_client(set, port, 1);
+    int c2 = connect_client(set, port, 2);
+    if (c1 < 0 || c2 < 0) {
+        errors++;
+        goto out;
+    }
+    errors += expect_msg("join image", c1, 0, SHARD_TEST_IMAGE_LEN);
+    errors += expect_msg("join image", c2, 0, SHARD_TEST_IMAGE_LEN);
+    long long overruns = metric_value("bds_shard_overruns_total");
+
+    // 转发线程SCHED_FIFO时分片线程得不到CPU：写入超过队列大小的数据，写满期间更新加入数据
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        printf("SCHED_FIFO not permitted, skipping\n");
+        close(c1);
+        close(c2);
+        shard_stop(set);
+        return SHARD_TEST_SKIP;
+    }
+    for (int seq = 1; seq <= SHARD_QUEUE_SIZE / SHARD_MSG_MAX + 1; seq++) {
+        shard_broadcast(set, make_payload(seq, SHARD_MSG_MAX), SHARD_MSG_MAX);
+    }
+    shard_set_image(set, make_payload(100, SHARD_TEST_IMAGE_LEN), SHARD_TEST_IMAGE_LEN);
+    int overrun = atomic_load(&q->overrun);
+    int stale = s->image_stale;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &other);
+
+    if (!overrun || !stale) {
+        printf("overrun: queue overrun %d, join image pending %d after writing past the queue\n", overrun, stale);
+        errors++;
+    }
+
+    // 分片线程取完队列后断开全部客户端，清除写满标志
+    errors += expect_eof("overrun", c1);
+    errors += expect_eof("overrun", c2);
+    if (wait_drained(set) != 0 || wait_clients(set, 0) != 0) {
+        errors++;
+    }
+    if (metric_value("bds_shard_overruns_total") != overruns + 1) {
+        printf("overrun: bds_shard_overruns_total went from %lld to %lld\n", overruns,
+               metric_value("bds_shard_overruns_total"));
+        errors++;
+    }
+
+    // 恢复后的下一次广播先补上写满期间更新的加入数据，新客户端收到的是它而不是旧的
+    shard_broadcast(set, make_payload(101, 300), 300);
+    if (s->image_stale) {
+        printf("overrun: join image not resent after recovery\n");
+        errors++;
+    }
+    if (wait_drained(set) == 0) {
+        int c3 = connect_client(set, port, 1);
+        if (c3 >= 0) {
+            shard_broadcast(set, make_payload(102, 400), 400);
+            errors += expect_msg("resent image", c3, 100, SHARD_TEST_IMAGE_LEN);
+            errors += expect_msg("after resent image", c3, 102, 400);
+            close(c3);
+        } else {
+            errors++;
+        }
+    } else {
+        errors++;
+    }
+
+out:
+    if (c1 >= 0) {
+        close(c1);
+    }
+    if (c2 >= 0) {
+        close(c2);
+    }
+    shard_stop(set);
+    return errors ? 1 : 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 通过返回0，跳过返回77，失败返回1
+ */
+int main(int argc, char *argv[])
+{
+    int ret;
+
+    if (argc == 2 && strcmp(argv[1], "stream") == 0) {
+        ret = test_stream() ? 1 : 0;
+    } else if (argc == 2 && strcmp(argv[1], "overrun") == 0) {
+        ret = test_overrun();
+    } else {
+        fprintf(stderr, "Usage: %s stream|overrun\n", argv[0]);
+        return 1;
+    }
+
+    printf("shard_test %s: %s\n", argv[1], ret == 0 ? "passed" : ret == SHARD_TEST_SKIP ? "skipped" : "FAILED");
+    return ret;
+}
@@ -0,0 +1,243 @@
+/*
+ * tls_bench.c
+ * 加密传输基准测试程序
+ * 功能：在回环上用同一个发送循环分别传输明文和TLS数据，比较吞吐和进程CPU时间（两端及转发线程合计），
+ *       并输出TLS连接实际使用的方式（内核TLS或用户态转发）
+ * 用法：openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes -days 365 \
+ *           -subj /CN=bds -addext subjectAltName=IP:127.0.0.1 -keyout key.pem -out cert.pem
+ *       tls_bench -c cert.pem -k key.pem [-n MB] [-s chunk_bytes]
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include "bds_tls.h"
+
+#define TLS_BENCH_MB         256          // 默认传输量（MB）
+#define TLS_BENCH_CHUNK      1200         // 默认每次发送的字节数（约一个历元）
+#define TLS_BENCH_TIMEOUT_MS 5000         // 握手超时
+
+// 一次测量的上下文
+struct tls_bench_run {
+    struct tls_config *server;         // 服务端配置（NULL为明文）
+    int listen_fd;
+    uint64_t received;                 // 接收端收到的字节数
+    enum tls_mode rx_mode;             // 接收端连接的方式
+};
+
+/**
+ * @brief 获取进程CPU时间（用户态+内核态，所有线程）
+ * @return CPU时间（微秒）
+ */
+static uint64_t cpu_time_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL +
+           ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/**
+ * @brief 接收线程：接受一个连接，按需握手，读到对端关闭为止
+ * @param arg 测量上下文
+ * @return NULL
+ */
+static void *tls_bench_receiver(void *arg)
+{
+    struct tls_bench_run *run = arg;
+    unsigned char buf[64 * 1024];
+
+    int fd = accept(run->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        perror("accept failed");
+        return NULL;
+    }
+    if (run->server != NULL) {
+        int app_fd = tls_handshake(run->server, fd, NULL, TLS_BENCH_TIMEOUT_MS);
+        if (app_fd < 0) {
+            close(fd);
+            return NULL;
+        }
+        fd = app_fd;
+    }
+    run->rx_mode = tls_fd_mode(fd);
+
+    ssize_t n;
+    while ((n = tls_recv(fd, buf, sizeof(buf), 0)) > 0) {
+        run->received += n;
+    }
+    if (n < 0) {
+        perror("recv failed");
+    }
+    close(fd);
+    return NULL;
+}
+
+/**
+ * @brief 测量一种传输方式
+ * @param name 名称
+ * @param server 服务端配置（NULL为明文）
+ * @param client 客户端配置（NULL为明文）
+ * @param total 传输字节数
+ * @param chunk 每次发送的字节数
+ * @param base_cpu 明文的每MB CPU时间（0表示本项就是明文）
+ * @return 每MB CPU时间（微秒），失败返回-1
+ */
+static double tls_bench_one(const char *name, struct tls_config *server, struct tls_config *client,
+                            uint64_t total, int chunk, double base_cpu)
+{
+    struct tls_bench_run run = { .server = server, .listen_fd = -1 };
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    pthread_t tid;
+    unsigned char *buf = malloc(chunk);
+
+    if (buf == NULL) {
+        perror("malloc failed");
+        return -1;
+    }
+    memset(buf, 0xD3, chunk);
+
+    // 回环上的临时端口
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    run.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (run.listen_fd < 0 || bind(run.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(run.listen_fd, 1) < 0 || getsockname(run.listen_fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        perror("listen failed");
+        free(buf);
+        return -1;
+    }
+    if (pthread_create(&tid, NULL, tls_bench_receiver, &run) != 0) {
+        perror("pthread_create failed");
+        close(run.listen_fd);
+        free(buf);
+        return -1;
+    }
+
+    uint64_t cpu_start = cpu_time_us();
+    uint64_t wall_start = bds_now_ns();
+    uint64_t sent = 0;
+    enum tls_mode tx_mode = TLS_MODE_NONE;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        int app_fd = client != NULL ? tls_handshake(client, fd, "127.0.0.1", TLS_BENCH_TIMEOUT_MS) : fd;
+        if (app_fd < 0) {
+            close(fd);
+        } else {
+            tx_mode = tls_fd_mode(app_fd);
+            while (sent < total) {
+                size_t len = total - sent < (uint64_t)chunk ? total - sent : (size_t)chunk;
+                ssize_t n = send(app_fd, buf, len, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    perror("send failed");
+                    break;
+                }
+                sent += n;
+            }
+            close(app_fd);
+        }
+    } else {
+        perror("connect failed");
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    pthread_join(tid, NULL);
+    uint64_t wall = bds_now_ns() - wall_start;
+    uint64_t cpu = cpu_time_us() - cpu_start;
+    close(run.listen_fd);
+    free(buf);
+
+    if (run.received != total) {
+        fprintf(stderr, "%s: received %llu of %llu bytes\n", name,
+                (unsigned long long)run.received, (unsigned long long)total);
+        return -1;
+    }
+
+    double mb = total / 1e6;
+    double cpu_per_mb = cpu / mb;
+    printf("%-12s %-22s %-22s %10.1f %12.1f %10.1f", name, tls_mode_name(tx_mode), tls_mode_name(run.rx_mode),
+           mb * 1e9 / wall, cpu_per_mb, 100.0 * cpu / (wall / 1000.0));
+    if (base_cpu > 0) {
+        printf(" %9.2fx", cpu_per_mb / base_cpu);
+    }
+    printf("\n");
+    return cpu_per_mb;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回-1
+ */
+int main(int argc, char *argv[])
+{
+    const char *cert = NULL;
+    const char *key = NULL;
+    int total_mb = TLS_BENCH_MB;
+    int chunk = TLS_BENCH_CHUNK;
+    int c;
+
+    while ((c = getopt(argc, argv, "c:k:n:s:h")) != -1) {
+        switch (c) {
+        case 'c':
+            cert = optarg;
+            break;
+        case 'k':
+            key = optarg;
+            break;
+        case 'n':
+            total_mb = atoi(optarg);
+            break;
+        case 's':
+            chunk = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [-c cert.pem -k key.pem] [-n MB] [-s chunk_bytes]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (total_mb <= 0 || chunk <= 0) {
+        fprintf(stderr, "transfer size and chunk size must be positive\n");
+        return -1;
+    }
+
+#ifndef __OPTIMIZE__
+    printf("Warning: built without optimization, numbers are not representative\n");
+#endif
+    uint64_t total = (uint64_t)total_mb * 1000000ULL;
+    printf("loopback transfer: %d MB in %d byte sends\n", total_mb, chunk);
+    printf("%-12s %-22s %-22s %10s %12s %10s %10s\n", "transport", "sender", "receiver", "MB/s",
+           "CPU us/MB", "CPU %", "vs plain");
+
+    double base = tls_bench_one("plaintext", NULL, NULL, total, chunk, 0);
+    if (base < 0) {
+        return -1;
+    }
+
+    if (cert == NULL || key == NULL) {
+        printf("no certificate given (-c/-k), TLS not measured\n");
+        return 0;
+    }
+
+    // 自签名证书同时作为客户端的CA
+    struct tls_config *server = tls_server_config(cert, key);
+    struct tls_config *client = tls_client_config(cert);
+    if (server == NULL || client == NULL) {
+        tls_config_free(server);
+        tls_config_free(client);
+        return -1;
+    }
+    double tls = tls_bench_one("TLS 1.3", server, client, total, chunk, base);
+    tls_config_free(server);
+    tls_config_free(client);
+    return tls < 0 ? -1 : 0;
+}
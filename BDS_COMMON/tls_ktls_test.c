@@ -0,0 +1,321 @@
+/*
+ * tls_ktls_test.c
+ * 内核TLS参数测试程序
+ * 功能：layout  用RFC 8448的服务端应用流量密钥检查tls_kernel_crypto_info导出的key/salt/iv/rec_seq布局；
+ *       loopback 在回环上用tls_handshake接受一个独立OpenSSL客户端的TLS 1.3连接，安装内核TLS后双向收发，
+ *                检查内核按导出的参数加解密且记录序号衔接正确。内核没有tls模块时照样经用户态转发收发，
+ *                通过后返回77（跳过）
+ * 用法：tls_ktls_test layout|loopback
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "bds_tls.h"
+
+#define KTLS_TEST_SKIP        77           // ctest的SKIP_RETURN_CODE
+#define KTLS_TEST_TIMEOUT_MS  5000         // 握手超时
+#define KTLS_TEST_RECORDS     8            // 客户端发送的记录数
+
+// RFC 8448 "Simple 1-RTT Handshake"：服务端应用流量密钥及其导出的key/iv
+static const unsigned char rfc8448_secret[32] = {
+    0xa1, 0x1a, 0xf9, 0xf0, 0x55, 0x31, 0xf8, 0x56, 0xad, 0x47, 0x11, 0x6b, 0x45, 0xa9, 0x50, 0x32,
+    0x82, 0x04, 0xb4, 0xf4, 0x4b, 0xfb, 0x6b, 0x3a, 0x4b, 0x4f, 0x1f, 0x3f, 0xcb, 0x63, 0x16, 0x43
+};
+static const unsigned char rfc8448_key[16] = {
+    0x9f, 0x02, 0x28, 0x3b, 0x6c, 0x9c, 0x07, 0xef, 0xc2, 0x6b, 0xb9, 0xf2, 0xac, 0x92, 0xe3, 0x56
+};
+static const unsigned char rfc8448_iv[12] = {
+    0xcf, 0x78, 0x2b, 0x88, 0xdd, 0x83, 0x54, 0x9a, 0xad, 0xf1, 0xe9, 0x84
+};
+
+// 回环测试的上下文
+struct ktls_test_run {
+    struct sockaddr_in addr;           // 服务端地址
+    int errors;                        // 客户端发现的错误数
+};
+
+/**
+ * @brief 比较一个字段
+ * @param name 字段名
+ * @param got 实际值
+ * @param want 期望值
+ * @param len 长度
+ * @return 一致返回0，否则返回1
+ */
+static int check_bytes(const char *name, const unsigned char *got, const unsigned char *want, size_t len)
+{
+    if (memcmp(got, want, len) == 0) {
+        return 0;
+    }
+    printf("%s mismatch:", name);
+    for (size_t i = 0; i < len; i++) {
+        printf(" %02x", got[i]);
+    }
+    printf("\n");
+    return 1;
+}
+
+/**
+ * @brief 检查内核参数布局：salt为write_iv前4字节，iv为后8字节，rec_seq从0开始
+ * @return 错误数
+ */
+static int test_layout(void)
+{
+    struct tls12_crypto_info_aes_gcm_128 info;
+    static const unsigned char zero_seq[TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE];
+    int errors = 0;
+
+    memset(&info, 0xA5, sizeof(info));
+    if (tls_kernel_crypto_info(rfc8448_secret, sizeof(rfc8448_secret), &info) != 0) {
+        printf("tls_kernel_crypto_info failed\n");
+        return 1;
+    }
+    if (info.info.version != TLS_1_3_VERSION || info.info.cipher_type != TLS_CIPHER_AES_GCM_128) {
+        printf("version 0x%04x cipher %u, expected 0x%04x %u\n", info.info.version, info.info.cipher_type,
+               TLS_1_3_VERSION, TLS_CIPHER_AES_GCM_128);
+        errors++;
+    }
+    errors += check_bytes("key", info.key, rfc8448_key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+    errors += check_bytes("salt", info.salt, rfc8448_iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+    errors += check_bytes("iv", info.iv, rfc8448_iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+                          TLS_CIPHER_AES_GCM_128_IV_SIZE);
+    errors += check_bytes("rec_seq", info.rec_seq, zero_seq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+    return errors;
+}
+
+/**
+ * @brief 生成临时的P-256自签名证书和私钥文件
+ * @param cert_path 证书文件名模板（mkstemp），返回实际文件名
+ * @param key_path 私钥文件名模板（mkstemp），返回实际文件名
+ * @return 成功返回0，失败返回-1
+ */
+static int make_cert(char *cert_path, char *key_path)
+{
+    EVP_PKEY *pkey = EVP_EC_gen("P-256");
+    X509 *x509 = X509_new();
+    int ret = -1;
+
+    if (pkey == NULL || x509 == NULL) {
+        goto out;
+    }
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(x509), "CN", MBSTRING_ASC,
+                               (const unsigned char *)"bds", -1, -1, 0);
+    X509_set_issuer_name(x509, X509_get_subject_name(x509));
+    if (X509_sign(x509, pkey, EVP_sha256()) == 0) {
+        goto out;
+    }
+
+    int cert_fd = mkstemp(cert_path);
+    int key_fd = mkstemp(key_path);
+    FILE *cert_fp = cert_fd >= 0 ? fdopen(cert_fd, "w") : NULL;
+    FILE *key_fp = key_fd >= 0 ? fdopen(key_fd, "w") : NULL;
+    if (cert_fp != NULL && key_fp != NULL && PEM_write_X509(cert_fp, x509) &&
+        PEM_write_PrivateKey(key_fp, pkey, NULL, NULL, 0, NULL, NULL)) {
+        ret = 0;
+    }
+    if (cert_fp != NULL) {
+        fclose(cert_fp);
+    } else if (cert_fd >= 0) {
+        close(cert_fd);
+    }
+    if (key_fp != NULL) {
+        fclose(key_fp);
+    } else if (key_fd >= 0) {
+        close(key_fd);
+    }
+
+out:
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+
+/**
+ * @brief 客户端线程：用独立的OpenSSL连接握手，先读服务端经内核TLS发出的记录，再发送若干记录
+ * @param arg 回环测试上下文
+ * @return NULL
+ */
+static void *ktls_test_client(void *arg)
+{
+    struct ktls_test_run *run = arg;
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL *ssl = NULL;
+    char buf[64];
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ctx == NULL || fd < 0 || connect(fd, (struct sockaddr *)&run->addr, sizeof(run->addr)) != 0) {
+        perror("client connect failed");
+        run->errors++;
+        goto out;
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256");
+    ssl = SSL_new(ctx);
+    if (ssl == NULL || SSL_set_fd(ssl, fd) != 1 || SSL_connect(ssl) != 1) {
+        printf("client handshake failed\n");
+        run->errors++;
+        goto out;
+    }
+
+    // 服务端发送方向：内核加密的第一条记录
+    int n = SSL_read(ssl, buf, sizeof(buf) - 1);
+    if (n != 5 || memcmp(buf, "ready", 5) != 0) {
+        printf("client read %d bytes instead of \"ready\"\n", n);
+        run->errors++;
+        goto out;
+    }
+
+    // 服务端接收方向：多条记录检查序号递增
+    for (int i = 0; i < KTLS_TEST_RECORDS; i++) {
+        int len = snprintf(buf, sizeof(buf), "record %d", i);
+        if (SSL_write(ssl, buf, len) != len) {
+            printf("client write %d failed\n", i);
+            run->errors++;
+            break;
+        }
+    }
+    SSL_shutdown(ssl);
+
+out:
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 回环测试：服务端经tls_handshake安装内核TLS，与独立OpenSSL客户端双向收发
+ * @return 成功返回0，内核不支持返回77，失败返回1
+ */
+static int test_loopback(void)
+{
+    struct ktls_test_run run = { .errors = 0 };
+    char cert_path[] = "/tmp/ktls_cert_XXXXXX";
+    char key_path[] = "/tmp/ktls_key_XXXXXX";
+    socklen_t addr_len = sizeof(run.addr);
+    pthread_t tid;
+    int ret = 1;
+
+    if (make_cert(cert_path, key_path) != 0) {
+        printf("certificate generation failed\n");
+        unlink(cert_path);
+        unlink(key_path);
+        return 1;
+    }
+    struct tls_config *server = tls_server_config(cert_path, key_path);
+    unlink(cert_path);
+    unlink(key_path);
+    if (server == NULL) {
+        return 1;
+    }
+
+    memset(&run.addr, 0, sizeof(run.addr));
+    run.addr.sin_family = AF_INET;
+    run.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&run.addr, sizeof(run.addr)) < 0 ||
+        listen(listen_fd, 1) < 0 || getsockname(listen_fd, (struct sockaddr *)&run.addr, &addr_len) < 0) {
+        perror("listen failed");
+        tls_config_free(server);
+        return 1;
+    }
+    if (pthread_create(&tid, NULL, ktls_test_client, &run) != 0) {
+        perror("pthread_create failed");
+        close(listen_fd);
+        tls_config_free(server);
+        return 1;
+    }
+
+    int fd = accept(listen_fd, NULL, NULL);
+    int app_fd = fd >= 0 ? tls_handshake(server, fd, NULL, KTLS_TEST_TIMEOUT_MS) : -1;
+    if (app_fd < 0) {
+        printf("server handshake failed\n");
+        if (fd >= 0) {
+            close(fd);
+        }
+        pthread_join(tid, NULL);
+        goto out;
+    }
+
+    // 退回用户态转发时照样收发，但内核参数没有被验证，结果记为跳过
+    enum tls_mode mode = tls_fd_mode(app_fd);
+    int errors = 0;
+    if (send(app_fd, "ready", 5, MSG_NOSIGNAL) != 5) {
+        perror("server send failed");
+        errors++;
+    }
+
+    // 客户端的记录可能被合并读出，按字节流比较
+    char want[KTLS_TEST_RECORDS * 16];
+    char got[sizeof(want)];
+    size_t want_len = 0;
+    size_t got_len = 0;
+    for (int i = 0; i < KTLS_TEST_RECORDS; i++) {
+        want_len += snprintf(want + want_len, sizeof(want) - want_len, "record %d", i);
+    }
+    while (errors == 0 && got_len < want_len) {
+        ssize_t n = tls_recv(app_fd, got + got_len, sizeof(got) - got_len, 0);
+        if (n <= 0) {
+            printf("server recv returned %zd after %zu of %zu bytes (%s)\n", n, got_len, want_len,
+                   n < 0 ? strerror(errno) : "closed");
+            errors++;
+            break;
+        }
+        got_len += n;
+    }
+    if (errors == 0 && (got_len != want_len || memcmp(got, want, want_len) != 0)) {
+        printf("server received unexpected data\n");
+        errors++;
+    }
+
+    close(app_fd);
+    pthread_join(tid, NULL);
+    if (errors + run.errors) {
+        ret = 1;
+    } else if (mode != TLS_MODE_KERNEL) {
+        printf("kernel TLS not available (connection uses %s), skipped\n", tls_mode_name(mode));
+        ret = KTLS_TEST_SKIP;
+    } else {
+        ret = 0;
+    }
+
+out:
+    close(listen_fd);
+    tls_config_free(server);
+    return ret;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 通过返回0，跳过返回77，失败返回1
+ */
+int main(int argc, char *argv[])
+{
+    int ret;
+
+    if (argc == 2 && strcmp(argv[1], "layout") == 0) {
+        ret = test_layout() ? 1 : 0;
+    } else if (argc == 2 && strcmp(argv[1], "loopback") == 0) {
+        ret = test_loopback();
+    } else {
+        fprintf(stderr, "Usage: %s layout|loopback\n", argv[0]);
+        return 1;
+    }
+
+    printf("tls_ktls_test %s: %s\n", argv[1], ret == 0 ? "passed" : ret == KTLS_TEST_SKIP ? "skipped" : "FAILED");
+    return ret;
+}
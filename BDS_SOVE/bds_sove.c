@@ -1,13 +1,107 @@
 /*
  * bds_sove.c
  * 流动站程序源文件
- * 功能：通过互联网接受基站发送来的数据，然后发送给ttyS1
+ * 功能：通过互联网接受基站发送来的数据，然后发送给ttyS1；
+ *       同时保持多个候选基站连接，按串口GGA位置选择基线最短的健康基站，在历元边界切换
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-13
+ * 最后修改时间：2026-10-18
  */
 
 #include "bds_sove.h"
 
+// 运行指标编号
+static int m_net_bytes_in = -1;
+static int m_net_recvs = -1;
+static int m_net_recv_errors = -1;
+static int m_serial_bytes_out = -1;
+static int m_serial_write_errors = -1;
+static int m_serial_dropped_bytes = -1;
+static int m_client_connects = -1;
+static int m_client_disconnects = -1;
+static int m_chunk_bytes_max = -1;
+static int m_bases_connected = -1;
+static int m_base_switches = -1;
+static int m_base_stale = -1;
+static int m_baseline_m = -1;
+static int m_gga = -1;
+static int m_heartbeats = -1;
+static int m_heartbeats_lost = -1;
+static int m_data_age_ms = -1;
+static int m_data_age_ms_max = -1;
+static int m_link_rtt_us = -1;
+static int m_base_queued = -1;
+static int m_age_flushes = -1;
+static int m_age_flushed_bytes = -1;
+static int m_age_resets = -1;
+static int m_snap_sent = -1;
+static int m_snap_bytes = -1;
+static int m_snap_frames = -1;
+static int m_dedup_frames = -1;
+static int m_dedup_bytes = -1;
+
+/**
+ * @brief 注册流动站运行指标
+ */
+static void sove_metrics_init(void)
+{
+    m_net_bytes_in = metrics_register("bds_sove_net_in_bytes_total",
+                                      "Bytes received from the base station", METRIC_COUNTER);
+    m_net_recvs = metrics_register("bds_sove_net_recvs_total",
+                                   "Non-empty recv calls", METRIC_COUNTER);
+    m_net_recv_errors = metrics_register("bds_sove_net_recv_errors_total",
+                                         "Failed recv calls", METRIC_COUNTER);
+    m_serial_bytes_out = metrics_register("bds_sove_serial_out_bytes_total",
+                                          "Bytes written to the rover serial port", METRIC_COUNTER);
+    m_serial_write_errors = metrics_register("bds_sove_serial_write_errors_total",
+                                             "Failed serial write calls", METRIC_COUNTER);
+    m_serial_dropped_bytes = metrics_register("bds_sove_serial_dropped_bytes_total",
+                                              "Bytes lost by incomplete serial writes", METRIC_COUNTER);
+    m_client_connects = metrics_register("bds_sove_client_connects_total",
+                                         "Accepted base station connections (reconnects)", METRIC_COUNTER);
+    m_client_disconnects = metrics_register("bds_sove_client_disconnects_total",
+                                            "Closed base station connections", METRIC_COUNTER);
+    m_chunk_bytes_max = metrics_register("bds_sove_net_chunk_bytes_max",
+                                         "Largest single recv (backlog high-water mark)", METRIC_GAUGE_MAX);
+    m_bases_connected = metrics_register("bds_sove_bases_connected",
+                                         "Candidate base stations currently connected", METRIC_GAUGE);
+    m_base_switches = metrics_register("bds_sove_base_switches_total",
+                                       "Switches of the forwarded base station", METRIC_COUNTER);
+    m_base_stale = metrics_register("bds_sove_base_stale_total",
+                                    "Times the forwarded base station went stale", METRIC_COUNTER);
+    m_baseline_m = metrics_register("bds_sove_baseline_meters",
+                                    "Baseline to the forwarded base station (0 if unknown)", METRIC_GAUGE);
+    m_gga = metrics_register("bds_sove_gga_total",
+                             "Valid GGA positions read from the rover serial port", METRIC_COUNTER);
+    m_heartbeats = metrics_register("bds_sove_heartbeats_total",
+                                    "Heartbeats received from base stations", METRIC_COUNTER);
+    m_heartbeats_lost = metrics_register("bds_sove_heartbeats_lost_total",
+                                         "Heartbeats missing from the sequence", METRIC_COUNTER);
+    m_data_age_ms = metrics_register("bds_sove_data_age_ms",
+                                     "Age of the forwarded base's latest heartbeat on arrival", METRIC_GAUGE);
+    m_data_age_ms_max = metrics_register("bds_sove_data_age_ms_max",
+                                         "Worst heartbeat age of the forwarded base", METRIC_GAUGE_MAX);
+    m_link_rtt_us = metrics_register("bds_sove_link_rtt_us",
+                                     "Round-trip time to the forwarded base", METRIC_GAUGE);
+    m_base_queued = metrics_register("bds_sove_base_queued_bytes",
+                                     "Bytes the forwarded base had not yet sent", METRIC_GAUGE);
+    m_age_flushes = metrics_register("bds_sove_age_flushes_total",
+                                     "Backlogs dropped because the data age exceeded the limit", METRIC_COUNTER);
+    m_age_flushed_bytes = metrics_register("bds_sove_age_flushed_bytes_total",
+                                           "Bytes dropped by age flushes", METRIC_COUNTER);
+    m_age_resets = metrics_register("bds_sove_age_resets_total",
+                                    "Base connections reset because the age stayed over the limit", METRIC_COUNTER);
+    m_snap_sent = metrics_register("bds_sove_snapshot_sent_total",
+                                   "Static message snapshots sent to newly connected relay clients", METRIC_COUNTER);
+    m_snap_bytes = metrics_register("bds_sove_snapshot_bytes_total",
+                                    "Bytes of static message snapshots sent", METRIC_COUNTER);
+    m_snap_frames = metrics_register("bds_sove_snapshot_frames",
+                                     "Station and ephemeris frames in the latest snapshot", METRIC_GAUGE);
+    m_dedup_frames = metrics_register("bds_sove_dedup_frames_total",
+                                      "Unchanged static messages not forwarded again", METRIC_COUNTER);
+    m_dedup_bytes = metrics_register("bds_sove_dedup_saved_bytes_total",
+                                     "Bytes saved by not forwarding unchanged static messages", METRIC_COUNTER);
+}
+
 /**
  * @brief 初始化串口
  * @param port 串口设备路径
@@ -109,85 +203,1520 @@ int init_server_socket(int port)
 }
 
 /**
- * @brief 从网络接收数据并发送到串口
- * @param sock_fd socket描述符
- * @param serial_fd 串口文件描述符
+ * @brief 更新已连接的候选基站数
+ * @param ctx 流动站转发上下文
+ */
+static void sove_update_connected(struct sove_ctx *ctx)
+{
+    int n = 0;
+
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        if (ctx->bases[i].state == SOVE_BASE_STREAMING) {
+            n++;
+        }
+    }
+    metrics_set(m_bases_connected, n);
+}
+
+/**
+ * @brief 解析主动连接的候选基站
+ * @param spec 格式为host:port[=lat,lon,h]，坐标为WGS84度和椭球高（米），
+ *             基站数据流中的1005/1006到达后以电文为准
+ * @param b 输出的候选基站
+ * @return 成功返回0，失败返回-1
+ */
+int sove_parse_base(const char *spec, struct sove_base *b)
+{
+    char host[INET_ADDRSTRLEN];
+    const char *colon = strchr(spec, ':');
+    const char *eq = strchr(spec, '=');
+
+    memset(b, 0, sizeof(*b));
+    b->fd = -1;
+    b->station_id = -1;
+    b->configured = 1;
+    rtcm_framer_init(&b->framer);
+
+    if (colon == NULL || colon - spec >= (int)sizeof(host) || (eq != NULL && eq < colon)) {
+        fprintf(stderr, "base must be host:port[=lat,lon,h]: %s\n", spec);
+        return -1;
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+
+    int port = atoi(colon + 1);
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "invalid base port: %s\n", spec);
+        return -1;
+    }
+    b->addr.sin_family = AF_INET;
+    b->addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &b->addr.sin_addr) <= 0) {
+        fprintf(stderr, "invalid base address: %s\n", host);
+        return -1;
+    }
+    snprintf(b->name, sizeof(b->name), "%s:%d", host, port);
+
+    if (eq != NULL) {
+        double lat, lon, height = 0.0;
+        if (sscanf(eq + 1, "%lf,%lf,%lf", &lat, &lon, &height) < 2 || fabs(lat) > 90.0 || fabs(lon) > 180.0) {
+            fprintf(stderr, "base position must be lat,lon[,h] in degrees: %s\n", eq + 1);
+            return -1;
+        }
+        nmea_llh_to_ecef(lat, lon, height, b->ecef);
+        b->has_pos = 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 基站连接建立后开始接收数据
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ */
+static void sove_base_streaming(struct sove_ctx *ctx, int i)
+{
+    struct sove_base *b = &ctx->bases[i];
+
+    // 基站按完整历元发送，连接开始处即历元边界
+    b->state = SOVE_BASE_STREAMING;
+    b->at_boundary = 1;
+    b->last_epoch_ns = 0;
+    b->hb_seen = 0;
+    b->resync = 0;
+    b->age_flushed = 0;
+    b->age_action = SOVE_AGE_NONE;
+    rtcm_framer_init(&b->framer);
+    metrics_inc(m_client_connects);
+    sove_update_connected(ctx);
+    log_info("Base connected: %s", b->name);
+}
+
+/**
+ * @brief 关闭基站连接：主动连接的基站定时重连，接受的连接释放槽位
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_base_close(struct sove_ctx *ctx, int i, uint64_t now)
+{
+    struct sove_base *b = &ctx->bases[i];
+
+    if (b->state == SOVE_BASE_STREAMING) {
+        metrics_inc(m_client_disconnects);
+    }
+    if (b->tls_sess != NULL) {
+        tls_session_free(b->tls_sess);
+        b->tls_sess = NULL;
+    }
+    close(b->fd);
+    b->fd = -1;
+    b->state = SOVE_BASE_IDLE;
+    b->at_boundary = 0;
+    b->last_epoch_ns = 0;
+
+    if (b->configured) {
+        b->deadline_ns = now + SOVE_RECONNECT_MS * 1000000ULL;
+    } else {
+        // 接受的连接没有固定身份，坐标和缓存的电文随槽位释放
+        b->has_pos = 0;
+        b->station_id = -1;
+        b->station_len = 0;
+    }
+
+    if (ctx->active == i) {
+        ctx->active = -1;
+    }
+    if (ctx->pending == i) {
+        ctx->pending = -1;
+    }
+    sove_update_connected(ctx);
+}
+
+/**
+ * @brief 发起到候选基站的非阻塞连接
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_base_connect(struct sove_ctx *ctx, int i, uint64_t now)
+{
+    struct sove_base *b = &ctx->bases[i];
+
+    b->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (b->fd < 0) {
+        log_errno("socket creation failed");
+        b->deadline_ns = now + SOVE_RECONNECT_MS * 1000000ULL;
+        return;
+    }
+
+    if (connect(b->fd, (struct sockaddr *)&b->addr, sizeof(b->addr)) == 0) {
+        sove_base_streaming(ctx, i);
+    } else if (errno == EINPROGRESS) {
+        b->state = SOVE_BASE_CONNECTING;
+        b->deadline_ns = now + SOVE_CONNECT_TIMEOUT_MS * 1000000ULL;
+    } else {
+        log_errno("connect to %s failed", b->name);
+        sove_base_close(ctx, i, now);
+    }
+}
+
+/**
+ * @brief 主动连接完成（可写或出错）
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_base_connected(struct sove_ctx *ctx, int i, uint64_t now)
+{
+    struct sove_base *b = &ctx->bases[i];
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) {
+        err = errno;
+    }
+    if (err != 0) {
+        errno = err;
+        log_errno("connect to %s failed", b->name);
+        sove_base_close(ctx, i, now);
+        return;
+    }
+    sove_base_streaming(ctx, i);
+}
+
+/**
+ * @brief 推进接受的连接的TLS握手，完成后换成加密后的描述符开始接收
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_base_handshake(struct sove_ctx *ctx, int i, uint64_t now)
+{
+    struct sove_base *b = &ctx->bases[i];
+
+    int ret = tls_session_step(b->tls_sess, &b->tls_events);
+    if (ret == 0) {
+        return;
+    }
+    if (ret < 0) {
+        log_error("TLS handshake with %s failed", b->name);
+        sove_base_close(ctx, i, now);
+        return;
+    }
+
+    // 用户态转发时描述符换成socketpair的一端，TCP socket归转发线程
+    struct tls_session *sess = b->tls_sess;
+    b->tls_sess = NULL;
+    int fd = tls_session_done(sess);
+    if (fd < 0) {
+        sove_base_close(ctx, i, now);
+        return;
+    }
+    b->fd = fd;
+    log_info("TLS established with %s (%s)", b->name, tls_mode_name(tls_fd_mode(fd)));
+    sove_base_streaming(ctx, i);
+}
+
+/**
+ * @brief 处理主动连接的重连和连接超时，以及接受的连接的握手超时
+ * @param ctx 流动站转发上下文
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_base_timers(struct sove_ctx *ctx, uint64_t now)
+{
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        struct sove_base *b = &ctx->bases[i];
+
+        if (b->state == SOVE_BASE_HANDSHAKE) {
+            if (now >= b->deadline_ns) {
+                log_warn("TLS handshake with %s timed out", b->name);
+                sove_base_close(ctx, i, now);
+            }
+            continue;
+        }
+        if (!b->configured || now < b->deadline_ns) {
+            continue;
+        }
+        if (b->state == SOVE_BASE_IDLE) {
+            sove_base_connect(ctx, i, now);
+        } else if (b->state == SOVE_BASE_CONNECTING) {
+            log_warn("connect to %s timed out", b->name);
+            sove_base_close(ctx, i, now);
+        }
+    }
+}
+
+/**
+ * @brief 接受基站连接（作为候选基站）
+ * @param ctx 流动站转发上下文
  */
-void network_to_serial(int sock_fd, int serial_fd)
+static void sove_accept(struct sove_ctx *ctx)
 {
-    char buffer[BUFFER_SIZE];
-    int bytes_received, bytes_written;
     struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
 
-    // 接受客户端连接
-    int client_fd = accept(sock_fd, (struct sockaddr *)&client_addr, &client_len);
-    if (client_fd < 0) {
-        perror("accept failed");
+    int fd = accept4(ctx->listen_fd, (struct sockaddr *)&client_addr, &client_len, SOCK_NONBLOCK);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EINTR && errno != ECONNABORTED) {
+            log_errno("accept failed");
+        }
         return;
     }
 
-    printf("Client connected: %s:%d\n", 
-           inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+    // 主动连接的基站占用固定槽位，其余槽位给接受的连接
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        struct sove_base *b = &ctx->bases[i];
+        if (!b->configured && b->fd < 0) {
+            b->fd = fd;
+            snprintf(b->name, sizeof(b->name), "%s:%d",
+                     inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+            if (ctx->tls == NULL) {
+                sove_base_streaming(ctx, i);
+                return;
+            }
 
-    while (1) {
-        // 从网络接收数据
-        bytes_received = recv(client_fd, buffer, BUFFER_SIZE, 0);
-        if (bytes_received > 0) {
-            // 发送到串口
-            bytes_written = write(serial_fd, buffer, bytes_received);
-            if (bytes_written < 0) {
-                perror("write failed");
-                break;
-            } else if (bytes_written != bytes_received) {
-                fprintf(stderr, "write incomplete data\n");
-            }
-        } else if (bytes_received == 0) {
-            printf("Client disconnected\n");
+            // 加密传输：握手完成前不接收数据，超时后释放槽位
+            uint64_t now = bds_now_ns();
+            b->tls_sess = tls_session_new(ctx->tls, fd, NULL);
+            if (b->tls_sess == NULL) {
+                sove_base_close(ctx, i, now);
+                return;
+            }
+            b->state = SOVE_BASE_HANDSHAKE;
+            b->deadline_ns = now + SOVE_CONNECT_TIMEOUT_MS * 1000000ULL;
+            sove_base_handshake(ctx, i, now);
+            return;
+        }
+    }
+
+    log_warn("Too many base connections, rejecting %s:%d",
+             inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+    close(fd);
+}
+
+/**
+ * @brief 计算流动站到基站的基线长度
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @return 基线长度（米），流动站或基站位置未知返回-1
+ */
+static double sove_baseline(const struct sove_ctx *ctx, int i)
+{
+    const struct sove_base *b = &ctx->bases[i];
+
+    if (!ctx->has_rover_pos || !b->has_pos) {
+        return -1.0;
+    }
+    return nmea_distance(ctx->rover_ecef, b->ecef);
+}
+
+/**
+ * @brief 判断基站是否健康：已连接且在过期时间内收到过完整历元
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param now 当前时间（单调时钟纳秒）
+ * @return 健康返回1，否则返回0
+ */
+static int sove_healthy(const struct sove_ctx *ctx, int i, uint64_t now)
+{
+    const struct sove_base *b = &ctx->bases[i];
+
+    return b->state == SOVE_BASE_STREAMING && b->last_epoch_ns != 0 &&
+           now <= b->last_epoch_ns + ctx->stale_ns;
+}
+
+/**
+ * @brief 比较两个健康基站的优先级：基线已知的优先且越短越好，都未知时数据越新越好
+ * @param ctx 流动站转发上下文
+ * @param a 基站编号
+ * @param b 基站编号
+ * @return a优于b返回1，否则返回0
+ */
+static int sove_better(const struct sove_ctx *ctx, int a, int b)
+{
+    double da = sove_baseline(ctx, a);
+    double db = sove_baseline(ctx, b);
+
+    if (da >= 0 && db >= 0) {
+        return da < db;
+    }
+    if (da >= 0 || db >= 0) {
+        return da >= 0;
+    }
+    return ctx->bases[a].last_epoch_ns > ctx->bases[b].last_epoch_ns;
+}
+
+/**
+ * @brief 追加一帧到本次转发的数据，同时发布到共享内存（启用缓存时跳过重复的静态电文）
+ * @param ctx 流动站转发上下文
+ * @param frame 完整帧
+ * @param len 帧长度
+ */
+static void sove_emit(struct sove_ctx *ctx, const unsigned char *frame, int len)
+{
+    if (ctx->out_len + len > SOVE_OUT_SIZE) {
+        return;
+    }
+
+    // 内容不变的基站描述和星历在刷新周期内不再转发（已连接的接收机和客户端都有这一份）
+    if (ctx->snap != NULL && !snap_update(ctx->snap, frame, len, ctx->rx_ns)) {
+        metrics_inc(m_dedup_frames);
+        metrics_add(m_dedup_bytes, len);
+        return;
+    }
+    memcpy(&ctx->out[ctx->out_len], frame, len);
+    ctx->out_len += len;
+
+    if (ctx->ring != NULL) {
+        shmring_write(ctx->ring, frame, len, ctx->rx_ns);
+    }
+}
+
+/**
+ * @brief 切换到候选基站（调用时两个基站都处于历元边界，或当前基站已不可用）
+ * @param ctx 流动站转发上下文
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_switch(struct sove_ctx *ctx, uint64_t now)
+{
+    int i = ctx->pending;
+    struct sove_base *b = &ctx->bases[i];
+    double baseline = sove_baseline(ctx, i);
+    char desc[64];
+    int n = 0;
+
+    if (b->station_id >= 0) {
+        n = snprintf(desc, sizeof(desc), "station %d, ", b->station_id);
+    }
+    if (baseline >= 0) {
+        snprintf(desc + n, sizeof(desc) - n, "baseline %.1f km", baseline / 1000.0);
+    } else {
+        snprintf(desc + n, sizeof(desc) - n, "baseline unknown");
+    }
+    if (ctx->active >= 0) {
+        log_info("Switching from base %s to %s (%s)", ctx->bases[ctx->active].name, b->name, desc);
+    } else {
+        log_info("Forwarding base %s (%s)", b->name, desc);
+    }
+
+    ctx->active = i;
+    ctx->pending = -1;
+    ctx->active_stale = 0;
+    ctx->switch_ns = now;
+    metrics_inc(m_base_switches);
+    metrics_set(m_baseline_m, baseline > 0 ? (uint64_t)baseline : 0);
+
+    // 旧基站的描述电文不再适用；星历与基站无关，继续留给新客户端，
+    // 但新基站播发的第一份照常转发，不因与旧基站的内容相同而被抑制
+    if (ctx->snap != NULL) {
+        snap_forget(ctx->snap, SCHED_STATION);
+        snap_rearm(ctx->snap);
+    }
+
+    // 接收机先拿到新基站的坐标，再收到它的观测电文
+    if (b->station_len > 0) {
+        sove_emit(ctx, b->station_frame, b->station_len);
+    }
+}
+
+/**
+ * @brief 候选基站和当前基站都处于历元边界（或当前基站已不可用）时完成切换
+ * @param ctx 流动站转发上下文
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_try_switch(struct sove_ctx *ctx, uint64_t now)
+{
+    int p = ctx->pending;
+    int a = ctx->active;
+
+    if (p < 0 || !ctx->bases[p].at_boundary) {
+        return;
+    }
+    if (a < 0 || !sove_healthy(ctx, a, now) || ctx->bases[a].at_boundary) {
+        sove_switch(ctx, now);
+    }
+}
+
+/**
+ * @brief 选择基站：基线最短的健康基站，当前基站健康时须明显更短且已保持足够时间才切换
+ * @param ctx 流动站转发上下文
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void sove_select(struct sove_ctx *ctx, uint64_t now)
+{
+    int a = ctx->active;
+    int a_ok = a >= 0 && sove_healthy(ctx, a, now);
+    int best = -1;
+
+    if (a >= 0) {
+        double d = sove_baseline(ctx, a);
+        metrics_set(m_baseline_m, d > 0 ? (uint64_t)d : 0);
+        if (!a_ok && ctx->bases[a].last_epoch_ns != 0 && !ctx->active_stale) {
+            ctx->active_stale = 1;
+            metrics_inc(m_base_stale);
+            log_warn("Base %s went stale", ctx->bases[a].name);
+        }
+    }
+
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        if (sove_healthy(ctx, i, now) && (best < 0 || sove_better(ctx, i, best))) {
+            best = i;
+        }
+    }
+
+    // 没有在转发的基站时，刚连接、尚无完整历元的基站也立即转发，不让接收机空等；
+    // 这种选择不计保持时间，更好的基站一出现就切换
+    if (best < 0 && a < 0) {
+        for (int i = 0; i < SOVE_MAX_BASES; i++) {
+            if (ctx->bases[i].state == SOVE_BASE_STREAMING && ctx->bases[i].at_boundary) {
+                ctx->pending = i;
+                sove_switch(ctx, now);
+                ctx->switch_ns = 0;
+                return;
+            }
+        }
+    }
+    if (best < 0 || best == a) {
+        ctx->pending = -1;
+        return;
+    }
+
+    if (a_ok) {
+        double da = sove_baseline(ctx, a);
+        double db = sove_baseline(ctx, best);
+        int shorter = db >= 0 && (da < 0 || db + SOVE_SWITCH_MARGIN_M < da);
+        if (!shorter || now < ctx->switch_ns + SOVE_SWITCH_HOLD_MS * 1000000ULL) {
+            ctx->pending = -1;
+            return;
+        }
+    }
+
+    ctx->pending = best;
+    sove_try_switch(ctx, now);
+}
+
+/**
+ * @brief 记录基站数据流中的坐标电文（1005/1006）
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param st 解析出的基准站坐标
+ * @param frame 完整帧
+ * @param len 帧长度
+ */
+static void sove_base_station(struct sove_ctx *ctx, int i, const struct rtcm_station *st,
+                              const unsigned char *frame, int len)
+{
+    struct sove_base *b = &ctx->bases[i];
+
+    if (!b->has_pos || b->station_id != st->station_id || nmea_distance(b->ecef, st->ecef) > 1.0) {
+        log_info("Base %s is station %d at %.3f,%.3f,%.3f",
+                 b->name, st->station_id, st->ecef[0], st->ecef[1], st->ecef[2]);
+    }
+    memcpy(b->ecef, st->ecef, sizeof(b->ecef));
+    b->has_pos = 1;
+    b->station_id = st->station_id;
+    memcpy(b->station_frame, frame, len);
+    b->station_len = len;
+}
+
+/**
+ * @brief 处理基站心跳：立即回送应答，统计数据龄期和往返时延，龄期超限时安排清空或重连
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ * @param hb 心跳内容
+ */
+static void sove_heartbeat(struct sove_ctx *ctx, int i, const struct heartbeat *hb)
+{
+    struct sove_base *b = &ctx->bases[i];
+    struct heartbeat echo;
+    unsigned char frame[HEARTBEAT_FRAME_LEN];
+
+    metrics_inc(m_heartbeats);
+    uint32_t gap = hb->seq - b->hb_seq - 1;
+    if (b->hb_seen && gap > 0 && gap < SOVE_HB_MAX_GAP) {
+        metrics_add(m_heartbeats_lost, gap);
+    }
+    b->hb_seen = 1;
+    b->hb_seq = hb->seq;
+
+    // 应答带回本机收到心跳的时间，应答丢失只影响往返时延统计，发送缓冲区满时不等待
+    memset(&echo, 0, sizeof(echo));
+    echo.kind = HEARTBEAT_ECHO;
+    echo.seq = hb->seq;
+    echo.send_ns = ctx->rx_ns;
+    int n = heartbeat_encode(&echo, frame, sizeof(frame));
+    if (n > 0) {
+        send(b->fd, frame, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    // 龄期依赖两端时钟同步，明显不同步时只提示一次
+    int64_t age_ms = ((int64_t)(bds_realtime_ns() - hb->send_ns)) / 1000000;
+    if (age_ms < SOVE_AGE_CLOCK_MIN_MS || age_ms > SOVE_AGE_CLOCK_MAX_MS) {
+        if (!b->clock_warned) {
+            log_warn("Clock of base %s is off by %lld ms, check time sync; data age not enforced",
+                     b->name, (long long)age_ms);
+            b->clock_warned = 1;
+        }
+        return;
+    }
+    if (age_ms < 0) {
+        age_ms = 0;
+    }
+
+    if (i == ctx->active) {
+        // 往返时延 = 本机两次时间戳之差 - 基站驻留时间，不依赖时钟同步
+        uint64_t back_ns = hb->echo_ns + hb->hold_us * 1000ULL;
+        if (hb->echo_ns != 0 && ctx->rx_ns > back_ns && ctx->rx_ns - back_ns < SOVE_RTT_MAX_MS * 1000000ULL) {
+            metrics_set(m_link_rtt_us, (ctx->rx_ns - back_ns) / 1000);
+        }
+        metrics_set(m_data_age_ms, age_ms);
+        metrics_max(m_data_age_ms_max, age_ms);
+        metrics_set(m_base_queued, hb->queued);
+    }
+
+    if (ctx->max_age_ns == 0) {
+        return;
+    }
+    if ((uint64_t)age_ms * 1000000ULL <= ctx->max_age_ns) {
+        b->age_flushed = 0;
+        return;
+    }
+    b->age_action = b->age_flushed ? SOVE_AGE_RESET : SOVE_AGE_FLUSH;
+    log_warn("Data from base %s is %lld ms old%s", b->name, (long long)age_ms,
+             b->age_flushed ? " after a flush, reconnecting" : ", dropping the backlog");
+}
+
+/**
+ * @brief 执行龄期超限的处理：丢弃socket接收缓冲区、半帧和串口输出队列中的积压，
+ *        从下一个完整历元重新开始；清空后仍超限时关闭连接（基站随之丢弃发送队列并重连）
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ */
+static void sove_age_recover(struct sove_ctx *ctx, int i)
+{
+    struct sove_base *b = &ctx->bases[i];
+    unsigned char buffer[BUFFER_SIZE];
+    int action = b->age_action;
+
+    b->age_action = SOVE_AGE_NONE;
+    if (action == SOVE_AGE_RESET) {
+        metrics_inc(m_age_resets);
+        sove_base_close(ctx, i, ctx->rx_ns);
+        if (b->configured) {
+            b->deadline_ns = ctx->rx_ns;
+        }
+        return;
+    }
+
+    // 只丢弃已到达的数据，发送方持续发送时不会一直读下去
+    long dropped = b->framer.len;
+    int avail = 0;
+    if (ioctl(b->fd, FIONREAD, &avail) != 0) {
+        avail = 0;
+    }
+    while (avail > 0) {
+        ssize_t n = tls_recv(b->fd, buffer, avail < BUFFER_SIZE ? avail : BUFFER_SIZE, MSG_DONTWAIT);
+        if (n <= 0) {
             break;
+        }
+        dropped += n;
+        avail -= n;
+    }
+    rtcm_framer_init(&b->framer);
+
+    if (i == ctx->active) {
+        int queued = 0;
+        if (ioctl(ctx->serial_fd, TIOCOUTQ, &queued) == 0) {
+            dropped += queued;
+        }
+        tcflush(ctx->serial_fd, TCOFLUSH);
+    }
+
+    // 丢弃的积压中的心跳不计入丢失
+    b->resync = 1;
+    b->at_boundary = 0;
+    b->age_flushed = 1;
+    b->hb_seen = 0;
+    metrics_inc(m_age_flushes);
+    metrics_add(m_age_flushed_bytes, dropped);
+    log_info("Dropped %ld queued bytes from base %s", dropped, b->name);
+}
+
+/**
+ * @brief 分帧回调：更新基站的坐标和历元边界，选中的基站的帧转发出去
+ * @param frame 完整帧
+ * @param len 帧长度
+ * @param arg 流动站转发上下文
+ */
+static void sove_frame(const unsigned char *frame, int len, void *arg)
+{
+    struct sove_ctx *ctx = arg;
+    int i = ctx->cur;
+    struct sove_base *b = &ctx->bases[i];
+    struct rtcm_obs_header hdr;
+    struct rtcm_station st;
+    struct heartbeat hb;
+
+    // 心跳只在基站和本机之间使用，不写串口、不转发、不影响历元边界；
+    // 标识或版本不符的4094电文是接收机的专有数据，与其他电文一样转发
+    if (ctx->heartbeat && heartbeat_decode(frame, len, &hb) == 1) {
+        if (hb.kind == HEARTBEAT_BEAT) {
+            sove_heartbeat(ctx, i, &hb);
+        }
+        return;
+    }
+
+    int obs = rtcm_parse_obs_header(frame, len, &hdr);
+    if (obs == 0 && rtcm_parse_station(frame, len, &st) == 1) {
+        sove_base_station(ctx, i, &st, frame, len);
+    }
+
+    if (i == ctx->active && !b->resync) {
+        sove_emit(ctx, frame, len);
+    }
+
+    // 多电文标志为0的观测电文结束一个历元，此时是切换基站的时机
+    if (obs == 1) {
+        b->station_id = hdr.station_id;
+        b->at_boundary = !hdr.multiple;
+        if (b->at_boundary) {
+            b->resync = 0;
+            b->last_epoch_ns = ctx->rx_ns;
+            if (i == ctx->active || i == ctx->pending) {
+                sove_try_switch(ctx, ctx->rx_ns);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 下游客户端加入：先发静态电文快照，接收机不必等下一轮基站坐标和星历播发
+ * @param r 下游转发状态
+ * @param id 客户端编号
+ * @param arg 流动站转发上下文
+ */
+static void sove_relay_join(struct relay *r, int id, void *arg)
+{
+    struct sove_ctx *ctx = arg;
+    int len;
+
+    const unsigned char *image = snap_image(ctx->snap, &len);
+    if (len > 0) {
+        relay_send_to(r, id, image, len);
+        metrics_inc(m_snap_sent);
+        metrics_add(m_snap_bytes, len);
+    }
+    metrics_set(m_snap_frames, ctx->snap->image_frames);
+}
+
+/**
+ * @brief 把本次转发的数据发给下游客户端和串口
+ * @param ctx 流动站转发上下文
+ */
+static void sove_flush(struct sove_ctx *ctx)
+{
+    int len = ctx->out_len;
+
+    if (len == 0) {
+        return;
+    }
+    ctx->out_len = 0;
+
+    // 分片时快照随数据进入各分片的队列，之后加入的客户端先收到新快照
+    if (ctx->shards != NULL && ctx->snap != NULL && ctx->snap->dirty) {
+        int image_len;
+        const unsigned char *image = snap_image(ctx->snap, &image_len);
+        shard_set_image(ctx->shards, image, image_len);
+        metrics_set(m_snap_frames, ctx->snap->image_frames);
+    }
+
+    // 先转发给下游客户端，不受串口写入快慢影响
+    relay_broadcast(ctx->relay, ctx->out, len);
+    shard_broadcast(ctx->shards, ctx->out, len);
+
+    int bytes_written = write(ctx->serial_fd, ctx->out, len);
+    if (bytes_written < 0) {
+        metrics_inc(m_serial_write_errors);
+        metrics_add(m_serial_dropped_bytes, len);
+        log_errno("serial write failed");
+    } else if (bytes_written != len) {
+        metrics_add(m_serial_bytes_out, bytes_written);
+        metrics_add(m_serial_dropped_bytes, len - bytes_written);
+        log_warn("serial write incomplete: %d of %d bytes", bytes_written, len);
+    } else {
+        metrics_add(m_serial_bytes_out, bytes_written);
+    }
+}
+
+/**
+ * @brief 从基站接收数据并分帧
+ * @param ctx 流动站转发上下文
+ * @param i 基站编号
+ */
+static void sove_read_base(struct sove_ctx *ctx, int i)
+{
+    struct sove_base *b = &ctx->bases[i];
+    unsigned char buffer[BUFFER_SIZE];
+
+    int bytes_received = tls_recv(b->fd, buffer, BUFFER_SIZE, 0);
+    ctx->rx_ns = bds_now_ns();
+    if (bytes_received > 0) {
+        metrics_inc(m_net_recvs);
+        metrics_add(m_net_bytes_in, bytes_received);
+        metrics_max(m_chunk_bytes_max, bytes_received);
+
+        ctx->cur = i;
+        rtcm_framer_push(&b->framer, buffer, bytes_received, sove_frame, ctx);
+        if (b->age_action != SOVE_AGE_NONE) {
+            sove_age_recover(ctx, i);
+        }
+        return;
+    }
+
+    if (bytes_received == 0) {
+        log_info("Base disconnected: %s", b->name);
+    } else if (errno == EAGAIN || errno == EINTR) {
+        return;
+    } else {
+        metrics_inc(m_net_recv_errors);
+        log_errno("recv from %s failed", b->name);
+    }
+    sove_base_close(ctx, i, ctx->rx_ns);
+}
+
+/**
+ * @brief NMEA语句回调：GGA更新流动站位置
+ * @param line 语句
+ * @param len 语句长度
+ * @param arg 流动站转发上下文
+ */
+static void sove_nmea_line(const char *line, int len, void *arg)
+{
+    struct sove_ctx *ctx = arg;
+    struct nmea_gga gga;
+
+    (void)len;
+    if (nmea_parse_gga(line, &gga) != 0) {
+        return;
+    }
+
+    metrics_inc(m_gga);
+    if (!ctx->has_rover_pos) {
+        log_info("Rover position %.6f,%.6f (fix quality %d)", gga.lat, gga.lon, gga.quality);
+    }
+    nmea_llh_to_ecef(gga.lat, gga.lon, gga.height, ctx->rover_ecef);
+    ctx->has_rover_pos = 1;
+}
+
+/**
+ * @brief 读取串口上接收机输出的NMEA语句
+ * @param ctx 流动站转发上下文
+ */
+static void sove_read_serial(struct sove_ctx *ctx)
+{
+    unsigned char buffer[BUFFER_SIZE];
+
+    while (1) {
+        int bytes_read = read(ctx->serial_fd, buffer, BUFFER_SIZE);
+        if (bytes_read > 0) {
+            nmea_reader_push(&ctx->nmea, buffer, bytes_read, sove_nmea_line, ctx);
+            continue;
+        }
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        // 挂断后继续等待会使poll反复就绪，转发不受影响
+        log_warn("serial port stopped delivering GGA, base selection uses the last position");
+        ctx->serial_eof = 1;
+        return;
+    }
+}
+
+/**
+ * @brief 计算poll的等待时间：主动连接的重连/超时、握手超时，当前和候选基站的过期时间
+ * @param ctx 流动站转发上下文
+ * @param now 当前时间（单调时钟纳秒）
+ * @return 毫秒，没有定时事件返回-1
+ */
+static int sove_timeout_ms(const struct sove_ctx *ctx, uint64_t now)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        const struct sove_base *b = &ctx->bases[i];
+        uint64_t t = UINT64_MAX;
+
+        if ((b->configured && b->state != SOVE_BASE_STREAMING) || b->state == SOVE_BASE_HANDSHAKE) {
+            t = b->deadline_ns;
+        } else if ((i == ctx->active || i == ctx->pending) && b->last_epoch_ns != 0 &&
+                   b->last_epoch_ns + ctx->stale_ns >= now) {
+            t = b->last_epoch_ns + ctx->stale_ns + 1000000ULL;
+        }
+        if (t < next) {
+            next = t;
+        }
+    }
+
+    if (next == UINT64_MAX) {
+        return -1;
+    }
+    if (next <= now) {
+        return 0;
+    }
+    return (int)((next - now + 999999ULL) / 1000000ULL);
+}
+
+/**
+ * @brief 处理新进程的热升级请求：交出监听socket、基站连接和串口
+ *        （下游客户端数量可能超过单次交接上限，只交出其监听socket，客户端由新进程重新接受）
+ * @param ctx 流动站转发上下文
+ * @return 新进程已接管返回0（当前进程应停止转发并退出），没有请求或交接失败返回-1
+ */
+int sove_handoff(struct sove_ctx *ctx)
+{
+    static struct handoff_state st;
+
+    int conn_fd = handoff_accept(ctx->handoff_fd);
+    if (conn_fd < 0) {
+        return -1;
+    }
+
+    log_info("Hot upgrade requested, handing off");
+    handoff_init(&st);
+    if (handoff_add_fd(&st, HANDOFF_FD_CONTROL, ctx->handoff_fd) != 0 ||
+        handoff_add_fd(&st, HANDOFF_FD_METRICS, metrics_http_fd()) != 0 ||
+        handoff_add_fd(&st, HANDOFF_FD_SERIAL, ctx->serial_fd) != 0 ||
+        handoff_add_fd(&st, HANDOFF_FD_LISTEN, ctx->listen_fd) != 0 ||
+        handoff_add_fd(&st, HANDOFF_FD_RELAY, ctx->relay ? ctx->relay->listen_fd : -1) != 0) {
+        close(conn_fd);
+        return -1;
+    }
+    for (int i = 0; ctx->shards != NULL && i < ctx->shards->count; i++) {
+        if (handoff_add_fd(&st, HANDOFF_FD_RELAY, ctx->shards->shards[i].relay->listen_fd) != 0) {
+            close(conn_fd);
+            return -1;
+        }
+    }
+
+    // 尚未recv的数据留在连接的内核缓冲区中，由新进程继续读取；
+    // 每个基站连接附带选择状态、半帧和缓存的坐标电文，新进程不需要重新等待1005和历元边界
+    struct sove_handoff_header hdr = {
+        .magic = SOVE_HANDOFF_MAGIC,
+        .switch_ns = ctx->switch_ns,
+        .has_rover_pos = ctx->has_rover_pos,
+    };
+    memcpy(hdr.rover_ecef, ctx->rover_ecef, sizeof(hdr.rover_ecef));
+    if (handoff_add_data(&st, &hdr, sizeof(hdr)) != 0) {
+        close(conn_fd);
+        return -1;
+    }
+
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        struct sove_base *b = &ctx->bases[i];
+        if (b->state != SOVE_BASE_STREAMING) {
+            continue;
+        }
+        // 用户态转发的TLS连接依赖本进程的转发线程，交给新进程后由基站重新连接
+        if (tls_fd_mode(b->fd) == TLS_MODE_RELAY) {
+            log_info("%s uses a userspace TLS relay, it will reconnect to the new process", b->name);
+            continue;
+        }
+
+        struct sove_base_record rec = {
+            .configured = b->configured,
+            .active = (i == ctx->active),
+            .has_pos = b->has_pos,
+            .station_id = b->station_id,
+            .at_boundary = b->at_boundary,
+            .framer_len = b->framer.len,
+            .station_len = b->station_len,
+            .last_epoch_ns = b->last_epoch_ns,
+        };
+        memcpy(rec.ecef, b->ecef, sizeof(rec.ecef));
+        memcpy(rec.name, b->name, sizeof(rec.name));
+
+        if (handoff_add_fd(&st, HANDOFF_FD_CLIENT, b->fd) != 0 ||
+            handoff_add_data(&st, &rec, sizeof(rec)) != 0 ||
+            handoff_add_data(&st, b->framer.buf, b->framer.len) != 0 ||
+            handoff_add_data(&st, b->station_frame, b->station_len) != 0) {
+            close(conn_fd);
+            return -1;
+        }
+    }
+
+    if (handoff_send(conn_fd, &st) != 0) {
+        return -1;
+    }
+
+    log_info("Handed off to the new process");
+    return 0;
+}
+
+/**
+ * @brief 为交接来的基站连接找槽位：主动连接的基站按地址对应到本进程的配置
+ * @param ctx 流动站转发上下文
+ * @param rec 旧进程的基站状态
+ * @return 槽位编号，没有空闲槽位返回-1
+ */
+static int sove_adopt_slot(struct sove_ctx *ctx, const struct sove_base_record *rec)
+{
+    if (rec->configured) {
+        for (int i = 0; i < SOVE_MAX_BASES; i++) {
+            struct sove_base *b = &ctx->bases[i];
+            if (b->configured && b->fd < 0 && strcmp(b->name, rec->name) == 0) {
+                return i;
+            }
+        }
+    }
+
+    // 接受的连接，或新版本不再配置的基站（作为接受的连接使用到断开为止）
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        if (!ctx->bases[i].configured && ctx->bases[i].fd < 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 接管旧进程的基站连接和选择状态
+ * @param ctx 流动站转发上下文
+ * @param st 交接内容
+ */
+static void sove_takeover_bases(struct sove_ctx *ctx, struct handoff_state *st)
+{
+    struct sove_handoff_header hdr;
+    int pos = sizeof(hdr);
+    int valid;
+    int fd;
+
+    // 交接格式版本已由handoff_request校验，版本一致的旧进程总是先写状态头
+    valid = st->data_len >= (int)sizeof(hdr);
+    if (valid) {
+        memcpy(&hdr, st->data, sizeof(hdr));
+        valid = hdr.magic == SOVE_HANDOFF_MAGIC;
+    }
+    if (valid) {
+        ctx->switch_ns = hdr.switch_ns;
+        ctx->has_rover_pos = hdr.has_rover_pos;
+        memcpy(ctx->rover_ecef, hdr.rover_ecef, sizeof(ctx->rover_ecef));
+    }
+
+    // 每个连接跟一条记录；数据无效时之后的连接都关闭，由基站重新连接
+    while ((fd = handoff_take_fd(st, HANDOFF_FD_CLIENT)) >= 0) {
+        struct sove_base_record rec;
+
+        if (valid && pos + (int)sizeof(rec) <= st->data_len) {
+            memcpy(&rec, &st->data[pos], sizeof(rec));
+            pos += sizeof(rec);
+            valid = rec.framer_len >= 0 && rec.framer_len <= RTCM3_MAX_FRAME &&
+                    rec.station_len >= 0 && rec.station_len <= RTCM3_MAX_FRAME &&
+                    pos + rec.framer_len + rec.station_len <= st->data_len;
         } else {
-            perror("recv failed");
+            valid = 0;
+        }
+        if (!valid) {
+            close(fd);
+            continue;
+        }
+        rec.name[sizeof(rec.name) - 1] = '\0';
+
+        int i = sove_adopt_slot(ctx, &rec);
+        if (i < 0) {
+            close(fd);
+            continue;
+        }
+
+        struct sove_base *b = &ctx->bases[i];
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        b->fd = fd;
+        b->state = SOVE_BASE_STREAMING;
+        rtcm_framer_init(&b->framer);
+        if (!b->configured) {
+            memcpy(b->name, rec.name, sizeof(b->name));
+        }
+        if (rec.has_pos) {
+            memcpy(b->ecef, rec.ecef, sizeof(b->ecef));
+            b->has_pos = 1;
+        }
+        b->station_id = rec.station_id;
+        b->at_boundary = rec.at_boundary;
+        b->last_epoch_ns = rec.last_epoch_ns;
+        memcpy(b->framer.buf, &st->data[pos], rec.framer_len);
+        b->framer.len = rec.framer_len;
+        pos += rec.framer_len;
+        memcpy(b->station_frame, &st->data[pos], rec.station_len);
+        b->station_len = rec.station_len;
+        pos += rec.station_len;
+        if (rec.active) {
+            ctx->active = i;
+        }
+
+        // 沿用旧进程已建立的连接，基站看不到断线
+        log_info("Took over the base station connection %s", b->name);
+    }
+    if (!valid) {
+        fprintf(stderr, "invalid base state in handoff\n");
+    }
+    sove_update_connected(ctx);
+}
+
+/**
+ * @brief 热升级：从运行中的旧进程接管监听socket、基站连接、串口和指标端点
+ * @param ctx 流动站转发上下文（候选基站须已按配置初始化）
+ * @return 成功返回0，失败返回-1（旧进程继续运行）
+ */
+int sove_takeover(struct sove_ctx *ctx)
+{
+    static struct handoff_state st;
+
+    if (handoff_request(HANDOFF_NAME, &st) != 0) {
+        return -1;
+    }
+
+    ctx->serial_fd = handoff_take_fd(&st, HANDOFF_FD_SERIAL);
+    ctx->listen_fd = handoff_take_fd(&st, HANDOFF_FD_LISTEN);
+    if (ctx->serial_fd < 0 || ctx->listen_fd < 0) {
+        fprintf(stderr, "handoff carried no serial port or listening socket\n");
+        if (ctx->serial_fd >= 0) {
+            close(ctx->serial_fd);
+        }
+        if (ctx->listen_fd >= 0) {
+            close(ctx->listen_fd);
+        }
+        handoff_release(&st);
+        return -1;
+    }
+    ctx->handoff_fd = handoff_take_fd(&st, HANDOFF_FD_CONTROL);
+
+    int metrics_fd = handoff_take_fd(&st, HANDOFF_FD_METRICS);
+    if (metrics_fd >= 0 && metrics_serve_fd(metrics_fd) != 0) {
+        close(metrics_fd);
+    }
+
+    // 下游客户端由新进程在同一监听socket上重新接受（分片时每个分片一个，按新的分片数重新分配）
+    int relay_fd;
+    while (ctx->relay_fd_count < SHARD_MAX && (relay_fd = handoff_take_fd(&st, HANDOFF_FD_RELAY)) >= 0) {
+        ctx->relay_fds[ctx->relay_fd_count++] = relay_fd;
+    }
+
+    sove_takeover_bases(ctx, &st);
+
+    handoff_release(&st);
+    return 0;
+}
+
+/**
+ * @brief 从各候选基站接收数据，把选中基站的数据发送到串口、下游客户端和共享内存
+ *        （同时接受新的基站连接、维护主动连接、读取串口GGA并响应热升级请求）
+ * @param ctx 流动站转发上下文
+ * @return 已交给新进程返回1，出错返回-1
+ */
+int network_to_serial(struct sove_ctx *ctx)
+{
+    // 固定项：监听socket、交接请求、下游转发、串口GGA，之后每个基站一项（-1时poll忽略）
+    struct pollfd pfd[4 + SOVE_MAX_BASES];
+
+    while (1) {
+        uint64_t now = bds_now_ns();
+        sove_base_timers(ctx, now);
+
+        pfd[0] = (struct pollfd){ .fd = ctx->listen_fd, .events = POLLIN };
+        pfd[1] = (struct pollfd){ .fd = ctx->handoff_fd, .events = POLLIN };
+        pfd[2] = (struct pollfd){ .fd = ctx->relay ? ctx->relay->epoll_fd : -1, .events = POLLIN };
+        pfd[3] = (struct pollfd){ .fd = ctx->serial_eof ? -1 : ctx->serial_fd, .events = POLLIN };
+        for (int i = 0; i < SOVE_MAX_BASES; i++) {
+            struct sove_base *b = &ctx->bases[i];
+            short events = POLLIN;
+            if (b->state == SOVE_BASE_CONNECTING ||
+                (b->state == SOVE_BASE_HANDSHAKE && (b->tls_events & EPOLLOUT))) {
+                events = POLLOUT;
+            }
+            pfd[4 + i] = (struct pollfd){ .fd = b->fd, .events = events };
+        }
+
+        if (poll(pfd, 4 + SOVE_MAX_BASES, sove_timeout_ms(ctx, now)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_errno("poll failed");
+            return -1;
+        }
+        now = bds_now_ns();
+
+        if (pfd[2].revents & POLLIN) {
+            relay_poll(ctx->relay);
+        }
+        if ((pfd[1].revents & POLLIN) && sove_handoff(ctx) == 0) {
+            return 1;
+        }
+        if (pfd[3].revents) {
+            sove_read_serial(ctx);
+        }
+        for (int i = 0; i < SOVE_MAX_BASES; i++) {
+            struct sove_base *b = &ctx->bases[i];
+            if (pfd[4 + i].revents == 0 || b->fd != pfd[4 + i].fd) {
+                continue;
+            }
+            if (b->state == SOVE_BASE_CONNECTING) {
+                sove_base_connected(ctx, i, now);
+            } else if (b->state == SOVE_BASE_HANDSHAKE) {
+                sove_base_handshake(ctx, i, now);
+            } else {
+                sove_read_base(ctx, i);
+            }
+        }
+        if (pfd[0].revents & POLLIN) {
+            sove_accept(ctx);
+        }
+
+        sove_select(ctx, bds_now_ns());
+        sove_flush(ctx);
+    }
+}
+
+/**
+ * @brief 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @param opts 输出的运行参数
+ * @return 成功返回0，失败返回-1
+ */
+int parse_options(int argc, char *argv[], struct sove_options *opts)
+{
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->serial_port = SERIAL_PORT;
+    opts->stale_ms = SOVE_STALE_MS;
+    opts->relay_clients = RELAY_MAX_CLIENTS;
+    opts->relay_queues = RELAY_QUEUE_BLOCKS;
+
+    while ((c = getopt(argc, argv, "m:r:c:ud:l:L:S:s:b:t:HA:T:K:M:C::G:h")) != -1) {
+        switch (c) {
+        case 'm':
+            opts->metrics_port = atoi(optarg);
+            break;
+        case 'r':
+            opts->rt.priority = atoi(optarg);
+            if (opts->rt.priority < 1 || opts->rt.priority > 99) {
+                fprintf(stderr, "SCHED_FIFO priority must be 1..99\n");
+                return -1;
+            }
+            break;
+        case 'c':
+            if (rt_parse_cpus(optarg, &opts->rt) != 0) {
+                return -1;
+            }
+            break;
+        case 'u':
+            opts->upgrade = 1;
+            break;
+        case 'd':
+            opts->serial_port = optarg;
+            break;
+        case 'l':
+            opts->relay_port = atoi(optarg);
+            if (opts->relay_port <= 0 || opts->relay_port > 65535) {
+                fprintf(stderr, "relay port must be 1..65535\n");
+                return -1;
+            }
+            break;
+        case 'L':
+            // 客户端槽位数[:待发队列块数]，两者都在启动时一次分配
+            if (sscanf(optarg, "%d:%d", &opts->relay_clients, &opts->relay_queues) < 1 ||
+                opts->relay_clients <= 0 || opts->relay_queues <= 0) {
+                fprintf(stderr, "relay limits must be clients[:queue_blocks], both positive\n");
+                return -1;
+            }
+            break;
+        case 'S':
+            opts->shards = atoi(optarg);
+            if (opts->shards < 1 || opts->shards > SHARD_MAX) {
+                fprintf(stderr, "relay shards must be 1..%d\n", SHARD_MAX);
+                return -1;
+            }
+            break;
+        case 's':
+            opts->ring_name = optarg;
+            break;
+        case 'b':
+            if (opts->base_count >= SOVE_MAX_BASES) {
+                fprintf(stderr, "at most %d candidate bases\n", SOVE_MAX_BASES);
+                return -1;
+            }
+            opts->bases[opts->base_count++] = optarg;
+            break;
+        case 't':
+            opts->stale_ms = atoi(optarg);
+            if (opts->stale_ms <= 0) {
+                fprintf(stderr, "stale time must be positive\n");
+                return -1;
+            }
+            break;
+        case 'H':
+            opts->heartbeat = 1;
+            break;
+        case 'A':
+            opts->max_age_ms = atoi(optarg);
+            if (opts->max_age_ms <= 0) {
+                fprintf(stderr, "maximum data age must be positive\n");
+                return -1;
+            }
+            opts->heartbeat = 1;
+            break;
+        case 'T':
+            opts->tls_cert = optarg;
             break;
+        case 'K':
+            opts->tls_key = optarg;
+            break;
+        case 'M':
+            opts->budget_kb = atoi(optarg);
+            if (opts->budget_kb <= 0) {
+                fprintf(stderr, "memory budget must be positive\n");
+                return -1;
+            }
+            break;
+        case 'C':
+            // 刷新周期可省略（取SNAP_REFRESH_S），可写作 -C 60 或 -C60
+            if (optarg == NULL && optind < argc && isdigit((unsigned char)argv[optind][0])) {
+                optarg = argv[optind++];
+            }
+            opts->snap_refresh_s = optarg != NULL ? atoi(optarg) : SNAP_REFRESH_S;
+            if (opts->snap_refresh_s < 1 || opts->snap_refresh_s > 3600) {
+                fprintf(stderr, "static message refresh must be 1..3600 seconds\n");
+                return -1;
+            }
+            break;
+        case 'G':
+            opts->log_file = optarg;
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [-m metrics_port] [-r rt_priority] [-c cpu_list] [-u] [-d serial_device] "
+                    "[-l relay_port] [-L clients[:queue_blocks]] [-S shards] [-s shm_ring_name] [-b host:port[=lat,lon,h]]... "
+                    "[-t stale_ms] [-H] [-A max_age_ms] [-T tls_cert.pem -K tls_key.pem] [-M budget_kb] [-C [refresh_s]] "
+                    "[-G log_file]\n", argv[0]);
+            return -1;
         }
     }
 
-    close(client_fd);
+    if ((opts->tls_cert == NULL) != (opts->tls_key == NULL)) {
+        fprintf(stderr, "TLS needs both a certificate (-T) and a key (-K)\n");
+        return -1;
+    }
+    if (opts->shards > 0 && opts->relay_port == 0) {
+        fprintf(stderr, "relay shards (-S) need a relay port (-l)\n");
+        return -1;
+    }
+
+    return 0;
 }
 
 /**
  * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
  * @return 成功返回0，失败返回-1
  */
-int main()
+int main(int argc, char *argv[])
 {
-    int serial_fd, sock_fd;
+    struct sove_options opts;
+    static struct sove_ctx ctx;
 
-    // 初始化串口
-    serial_fd = init_serial(SERIAL_PORT, BAUD_RATE);
-    if (serial_fd < 0) {
-        fprintf(stderr, "init_serial failed\n");
+    if (parse_options(argc, argv, &opts) != 0) {
         return -1;
     }
 
-    // 初始化服务器socket
-    sock_fd = init_server_socket(LISTEN_PORT);
-    if (sock_fd < 0) {
-        fprintf(stderr, "init_server_socket failed\n");
-        close(serial_fd);
+    ctx.listen_fd = -1;
+    ctx.serial_fd = -1;
+    ctx.handoff_fd = -1;
+    ctx.active = -1;
+    ctx.pending = -1;
+    ctx.stale_ns = opts.stale_ms * 1000000ULL;
+    ctx.heartbeat = opts.heartbeat;
+    ctx.max_age_ns = opts.max_age_ms * 1000000ULL;
+    ctx.relay_clients = opts.relay_clients;
+    ctx.relay_queues = opts.relay_queues;
+    nmea_reader_init(&ctx.nmea);
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        ctx.bases[i].fd = -1;
+        ctx.bases[i].station_id = -1;
+    }
+
+    // 主动连接的候选基站占用前面的槽位，首次进入转发循环时发起连接
+    for (int i = 0; i < opts.base_count; i++) {
+        if (sove_parse_base(opts.bases[i], &ctx.bases[i]) != 0) {
+            return -1;
+        }
+    }
+
+    // 注册运行指标
+    sove_metrics_init();
+
+    // 异步日志：转发路径上的错误和状态变化只写入本线程的环形缓冲区，由后台线程格式化输出
+    if (log_start("bds_sove", opts.log_file) != 0) {
         return -1;
     }
 
-    printf("BDS rover station started. Listening on port %d, sending to %s\n", 
-           LISTEN_PORT, SERIAL_PORT);
+    // 加密传输：接受的基站连接先握手，密钥装入内核TLS后接收路径不变
+    if (opts.tls_cert != NULL) {
+        ctx.tls = tls_server_config(opts.tls_cert, opts.tls_key);
+        if (ctx.tls == NULL) {
+            return -1;
+        }
+        printf("TLS enabled for accepted base connections\n");
+    }
 
-    // 开始数据转发
-    while (1) {
-        network_to_serial(sock_fd, serial_fd);
+    if (ctx.heartbeat) {
+        printf("Consuming base heartbeats%s\n", ctx.max_age_ns > 0 ? ", enforcing the data age limit" : "");
+    }
+
+    // 热升级：接管旧进程的描述符（含指标监听套接字，指标线程须在实时设置之前创建）
+    if (opts.upgrade && sove_takeover(&ctx) != 0) {
+        fprintf(stderr, "hot upgrade failed\n");
+        return -1;
+    }
+
+    // 按需启动HTTP指标端点（热升级时已沿用旧进程的监听套接字）
+    if (opts.metrics_port > 0 && metrics_http_fd() < 0 && metrics_start_http(opts.metrics_port) != 0) {
+        fprintf(stderr, "Warning: metrics endpoint disabled\n");
     }
 
-    // 关闭资源
-    close(serial_fd);
-    close(sock_fd);
+    // 下游转发：旧进程未启用时新建监听，新版本不再启用时关闭接管来的监听；
+    // 分片线程须在实时设置之前创建，不继承转发线程的SCHED_FIFO和CPU绑定
+    if (opts.relay_port > 0 && opts.shards > 0) {
+        ctx.shards = shard_start(opts.relay_port, opts.shards, ctx.relay_clients, ctx.relay_queues,
+                                 ctx.relay_fds, ctx.relay_fd_count);
+        if (ctx.shards == NULL) {
+            fprintf(stderr, "relay shard setup failed\n");
+            return -1;
+        }
+        printf("Relaying to rover clients on port %d with %d shards\n", opts.relay_port, opts.shards);
+    } else if (opts.relay_port > 0) {
+        int relay_fd = ctx.relay_fd_count > 0 ? ctx.relay_fds[0] : relay_listen(opts.relay_port, 0);
+        for (int i = 1; i < ctx.relay_fd_count; i++) {
+            close(ctx.relay_fds[i]);
+        }
+        if (relay_fd < 0 || (ctx.relay = relay_start(relay_fd, ctx.relay_clients, ctx.relay_queues)) == NULL) {
+            fprintf(stderr, "relay setup failed\n");
+            return -1;
+        }
+        printf("Relaying to rover clients on port %d\n", opts.relay_port);
+    } else {
+        for (int i = 0; i < ctx.relay_fd_count; i++) {
+            close(ctx.relay_fds[i]);
+        }
+    }
+
+    // 实时模式：锁定内存、预缺页，转发线程绑核并切换到SCHED_FIFO
+    if (opts.rt.priority > 0 || opts.rt.cpu_count > 0) {
+        if (rt_setup_process() != 0 || rt_setup_thread(&opts.rt, "forward") != 0) {
+            fprintf(stderr, "real-time setup failed\n");
+            return -1;
+        }
+        rt_start_monitor(&opts.rt);
+    }
+
+    if (!opts.upgrade) {
+        // 初始化串口
+        ctx.serial_fd = init_serial(opts.serial_port, BAUD_RATE);
+        if (ctx.serial_fd < 0) {
+            fprintf(stderr, "init_serial failed\n");
+            return -1;
+        }
+
+        // 初始化服务器socket
+        ctx.listen_fd = init_server_socket(LISTEN_PORT);
+        if (ctx.listen_fd < 0) {
+            fprintf(stderr, "init_server_socket failed\n");
+            close(ctx.serial_fd);
+            return -1;
+        }
+
+        // 接受以后新版本程序的热升级请求
+        ctx.handoff_fd = handoff_listen(HANDOFF_NAME);
+    }
+
+    // 本机共享内存输出：同名缓冲区已存在时接着写，读端不受重启和热升级影响
+    if (opts.ring_name != NULL) {
+        ctx.ring = shmring_create(opts.ring_name, SHMRING_DEFAULT_SIZE);
+        if (ctx.ring == NULL) {
+            fprintf(stderr, "shared memory ring setup failed\n");
+            return -1;
+        }
+        printf("Publishing RTCM3 frames to shared memory %s\n", ctx.ring->name);
+    }
+
+    // 静态电文缓存：新的下游客户端先收到快照，重复的基站描述和星历按刷新周期转发
+    if (opts.snap_refresh_s > 0) {
+        ctx.snap = pool_alloc("sove", "static message cache", sizeof(*ctx.snap), 1, POOL_SHARED);
+        if (ctx.snap == NULL) {
+            relay_stop(ctx.relay);
+            shard_stop(ctx.shards);
+            shmring_close(ctx.ring);
+            return -1;
+        }
+        snap_init(ctx.snap, opts.snap_refresh_s);
+        if (ctx.relay != NULL) {
+            relay_set_join(ctx.relay, sove_relay_join, &ctx);
+        }
+        printf("Caching station and ephemeris messages, unchanged repeats forwarded every %d s\n",
+               opts.snap_refresh_s);
+    }
+
+    // 初始化结束：输出内存预算，超出预算时退出，之后转发路径不再分配内存
+    pool_account("sove", "base connection", ctx.bases, sizeof(ctx.bases[0]), SOVE_MAX_BASES, POOL_PER_CONN);
+    if (pool_seal("bds_sove", opts.budget_kb) != 0) {
+        relay_stop(ctx.relay);
+        shard_stop(ctx.shards);
+        shmring_close(ctx.ring);
+        return -1;
+    }
+
+    // 实时模式：各池的大小已确定，逐页预缺页下游转发队列块、分片队列和静态电文缓存
+    // （分片线程已在运行，预缺页不改变内容）
+    if (opts.rt.priority > 0 || opts.rt.cpu_count > 0) {
+        if (ctx.relay != NULL) {
+            rt_prefault(ctx.relay->queues.base, ctx.relay->queues.size * ctx.relay->queues.count);
+        }
+        if (ctx.shards != NULL) {
+            rt_prefault(ctx.shards->queues, sizeof(*ctx.shards->queues) * ctx.shards->count);
+            for (int i = 0; i < ctx.shards->count; i++) {
+                struct relay *r = ctx.shards->shards[i].relay;
+                rt_prefault(r->queues.base, r->queues.size * r->queues.count);
+            }
+        }
+        rt_prefault(ctx.snap, ctx.snap != NULL ? sizeof(*ctx.snap) : 0);
+    }
+
+    printf("BDS rover station started. Listening on port %d, %d candidate base(s) configured, sending to %s\n",
+           LISTEN_PORT, opts.base_count, opts.serial_port);
+
+    // 开始数据转发，交给新进程后退出
+    network_to_serial(&ctx);
+
+    // 关闭资源（只关闭本进程的副本，新进程继续使用）
+    close(ctx.serial_fd);
+    close(ctx.listen_fd);
+    for (int i = 0; i < SOVE_MAX_BASES; i++) {
+        if (ctx.bases[i].fd >= 0) {
+            close(ctx.bases[i].fd);
+        }
+    }
+    if (ctx.handoff_fd >= 0) {
+        close(ctx.handoff_fd);
+    }
+    relay_stop(ctx.relay);
+    shard_stop(ctx.shards);
+    shmring_close(ctx.ring);
+    log_stop();
 
     return 0;
 }
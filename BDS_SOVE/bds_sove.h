@@ -3,7 +3,7 @@
  * 流动站程序头文件
  * 功能：定义常量、结构体和函数声明
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-13
+ * 最后修改时间：2026-10-18
  */
 
 #ifndef BDS_SOVE_H
@@ -12,12 +12,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+
+#include "bds_metrics.h"
+#include "bds_rt.h"
+#include "bds_handoff.h"
+#include "bds_relay.h"
+#include "bds_pool.h"
+#include "bds_rtcm.h"
+#include "bds_shmring.h"
+#include "bds_nmea.h"
+#include "bds_heartbeat.h"
+#include "bds_time.h"
+#include "bds_tls.h"
+#include "bds_snapshot.h"
+#include "bds_log.h"
+#include "bds_shard.h"
 
 // 串口配置
 #define SERIAL_PORT "/dev/ttyS1"
@@ -27,9 +47,150 @@
 #define LISTEN_PORT 8888       // 监听端口号
 #define BUFFER_SIZE 1024       // 缓冲区大小
 
+// 多基站选择配置
+#define SOVE_MAX_BASES 8                 // 同时保持的候选基站连接数（接受的和主动连接的合计）
+#define SOVE_STALE_MS 3000               // 默认过期时间：超过该时间没有完整历元的基站视为不健康
+#define SOVE_SWITCH_MARGIN_M 1000.0      // 候选基站的基线须比当前基站短出该距离（米）才切换
+#define SOVE_SWITCH_HOLD_MS 10000        // 切换后至少保持的时间（当前基站过期时不受限制）
+#define SOVE_RECONNECT_MS 1000           // 主动连接断开后的重连间隔（毫秒）
+#define SOVE_CONNECT_TIMEOUT_MS 5000     // 主动连接和加密握手的超时时间（毫秒）
+#define SOVE_OUT_SIZE (BUFFER_SIZE + 2 * RTCM3_MAX_FRAME)  // 一次接收产生的最大转发字节数
+
+// 心跳配置
+#define SOVE_AGE_CLOCK_MIN_MS (-1000)    // 数据龄期低于该值视为两端时钟不同步（只提示，不处理）
+#define SOVE_AGE_CLOCK_MAX_MS 600000     // 数据龄期高于该值视为两端时钟不同步（只提示，不处理）
+#define SOVE_HB_MAX_GAP 1000             // 心跳序号跳变超过该值或倒退视为基站重启，不计入丢失
+#define SOVE_RTT_MAX_MS 60000            // 超过该值的往返时延视为无效（应答时间戳来自别的进程）
+
+// 数据龄期超限后的处理（分帧结束后执行）
+enum sove_age_action {
+    SOVE_AGE_NONE = 0,
+    SOVE_AGE_FLUSH,            // 丢弃本地积压，从下一个完整历元重新开始
+    SOVE_AGE_RESET             // 清空后仍超限：重建连接，让基站丢弃发送队列
+};
+
+// 热升级配置
+#define HANDOFF_NAME "bds_sove.handoff"  // 交接套接字名称（抽象命名空间）
+#define SOVE_HANDOFF_MAGIC 0x45564F53    // "SOVE"：交接数据带基站选择状态
+
+// 候选基站连接状态
+enum sove_base_state {
+    SOVE_BASE_IDLE = 0,        // 未连接（接受的连接表示空闲槽位，主动连接表示等待重连）
+    SOVE_BASE_CONNECTING,      // 主动连接尚未完成
+    SOVE_BASE_HANDSHAKE,       // 接受的连接正在进行TLS握手
+    SOVE_BASE_STREAMING        // 正在接收数据
+};
+
+// 候选基站
+struct sove_base {
+    int fd;                    // 连接描述符，-1表示未连接
+    int state;                 // 连接状态（enum sove_base_state）
+    int configured;            // 由-b配置（断开后重连），0表示接受的基站连接
+    char name[64];             // 地址（日志和热升级时对应配置）
+    struct sockaddr_in addr;   // 主动连接的目标地址
+    int has_pos;               // 基站坐标是否已知（1005/1006或配置）
+    double ecef[3];            // 基站坐标（ECEF，米）
+    int station_id;            // 参考站ID，-1表示未知
+    struct rtcm_framer framer; // 分帧器（按帧转发，切换只发生在帧和历元边界）
+    int at_boundary;           // 最近的观测电文结束了一个历元
+    uint64_t last_epoch_ns;    // 最近一个完整历元的到达时间，0表示尚未收到
+    uint64_t deadline_ns;      // 主动连接的重连时间或连接超时时间，握手中为握手超时时间
+    struct tls_session *tls_sess;  // 正在进行的TLS握手
+    uint32_t tls_events;       // 握手等待的事件（EPOLLIN或EPOLLOUT）
+    int hb_seen;               // 本连接是否已收到心跳
+    uint32_t hb_seq;           // 最近的心跳序号
+    int resync;                // 已丢弃积压，下一个历元结束之前不转发
+    int age_flushed;           // 超限后已清空过积压，再次超限时重建连接
+    int age_action;            // 分帧结束后执行的龄期处理（enum sove_age_action）
+    int clock_warned;          // 已提示过两端时钟不同步
+    int station_len;           // 缓存的1005/1006帧长度
+    unsigned char station_frame[RTCM3_MAX_FRAME];  // 最近的1005/1006帧，切换后先发给接收机
+};
+
+// 流动站转发上下文
+struct sove_ctx {
+    int listen_fd;             // 监听socket
+    int serial_fd;             // 串口
+    int serial_eof;            // 串口已挂断，不再读取GGA
+    int handoff_fd;            // 热升级交接监听描述符，-1表示不支持热升级
+    struct relay *relay;       // 下游流动站客户端转发，NULL表示不启用
+    int relay_clients;         // 下游客户端槽位数
+    int relay_queues;          // 下游待发队列块数（同时积压的客户端数上限）
+    struct shard_set *shards;  // 分片下游转发（各分片线程发送），NULL表示由转发线程发送
+    int relay_fd_count;        // 热升级时接管的下游监听socket数
+    int relay_fds[SHARD_MAX];  // 热升级时接管的下游监听socket（分片时每个分片一个）
+    struct tls_config *tls;    // 接受基站连接的加密配置，NULL表示明文
+    struct shmring *ring;      // 本机共享内存输出，NULL表示不启用
+    struct snapshot *snap;     // 静态电文缓存（新客户端的快照和重复电文抑制），NULL表示不启用
+    uint64_t rx_ns;            // 当前数据块的接收时间（记录时间戳）
+    struct sove_base bases[SOVE_MAX_BASES];  // 候选基站
+    int cur;                   // 正在分帧的基站（帧回调使用）
+    int active;                // 当前转发的基站，-1表示没有
+    int pending;               // 等待历元边界切换过去的基站，-1表示没有
+    int active_stale;          // 当前基站已过期（只统计一次）
+    uint64_t switch_ns;        // 最近一次切换的时间
+    uint64_t stale_ns;         // 基站过期时间
+    int heartbeat;             // 是否剥离并应答基站心跳（否则4094电文全部原样转发）
+    uint64_t max_age_ns;       // 数据龄期上限，0表示只统计不处理
+    int has_rover_pos;         // 是否已从GGA得到流动站位置
+    double rover_ecef[3];      // 流动站位置（ECEF，米）
+    struct nmea_reader nmea;   // 串口GGA语句提取
+    int out_len;               // 本次待转发的字节数
+    unsigned char out[SOVE_OUT_SIZE];  // 选中基站的完整帧（一次写串口和下游）
+};
+
+// 热升级交接数据头（之后每个基站连接一条记录，记录后接半帧和坐标电文）
+struct sove_handoff_header {
+    uint32_t magic;            // SOVE_HANDOFF_MAGIC
+    int32_t has_rover_pos;
+    uint64_t switch_ns;
+    double rover_ecef[3];
+};
+
+// 热升级时每个基站连接的状态（与HANDOFF_FD_CLIENT描述符顺序一致）
+struct sove_base_record {
+    int32_t configured;
+    int32_t active;
+    int32_t has_pos;
+    int32_t station_id;
+    int32_t at_boundary;
+    int32_t framer_len;
+    int32_t station_len;
+    uint64_t last_epoch_ns;
+    double ecef[3];
+    char name[64];
+};
+
+// 运行参数（命令行可覆盖）
+struct sove_options {
+    int metrics_port;          // 指标HTTP端口，0表示不启用
+    struct rt_options rt;      // 实时模式参数
+    int upgrade;               // 是否从运行中的旧进程接管（热升级）
+    const char *serial_port;   // 串口设备路径
+    int relay_port;            // 下游客户端监听端口，0表示不启用
+    const char *ring_name;     // 共享内存环形缓冲区名称，NULL表示不启用
+    int base_count;            // 主动连接的候选基站数
+    const char *bases[SOVE_MAX_BASES];  // 主动连接的候选基站（host:port[=lat,lon,h]）
+    int stale_ms;              // 基站过期时间（毫秒）
+    int heartbeat;             // 是否剥离并应答基站心跳（-A隐含）
+    int max_age_ms;            // 数据龄期上限（毫秒），0表示只统计不处理
+    const char *tls_cert;      // 接受基站连接的证书文件，与tls_key同时给出时加密传输
+    const char *tls_key;       // 证书私钥文件
+    int relay_clients;         // 下游客户端槽位数
+    int relay_queues;          // 下游待发队列块数
+    int shards;                // 下游转发分片数，0表示由转发线程直接发送
+    int budget_kb;             // 内存预算上限（KB），0表示只输出预算不检查
+    int snap_refresh_s;        // 静态电文缓存的刷新周期（秒），0表示不缓存
+    const char *log_file;      // 二进制日志文件，NULL表示只输出文本
+};
+
 // 函数声明
 int init_serial(const char *port, speed_t baud);
 int init_server_socket(int port);
-void network_to_serial(int sock_fd, int serial_fd);
+int sove_parse_base(const char *spec, struct sove_base *b);
+int network_to_serial(struct sove_ctx *ctx);
+int sove_handoff(struct sove_ctx *ctx);
+int sove_takeover(struct sove_ctx *ctx);
+int parse_options(int argc, char *argv[], struct sove_options *opts);
 
 #endif /* BDS_SOVE_H */
@@ -2,23 +2,45 @@
 
 """
 模拟MQTT服务器
-功能：接收MQTT客户端连接和发布的消息
+功能：接收MQTT客户端连接和发布的消息，QoS 1消息回复PUBACK；
+      支持MQTT 5（CONNACK给出主题别名上限，按连接解析主题别名和消息过期时间）
+用法：python3 mock_mqtt_server.py [端口]
 代码作者：ClancyShang
-最后修改时间：2026-01-20
+最后修改时间：2026-10-18
 """
 
 import socket
 import struct
+import sys
 import threading
 
 # MQTT消息类型
 MQTT_CONNECT = 1
 MQTT_PUBLISH = 3
 MQTT_CONNACK = 2
+MQTT_PUBACK = 4
 
 # 连接返回码
 CONNACK_ACCEPTED = 0
 
+# MQTT 5
+MQTT_VERSION_5 = 5
+PROP_MESSAGE_EXPIRY = 0x02
+PROP_TOPIC_ALIAS_MAX = 0x22
+PROP_TOPIC_ALIAS = 0x23
+TOPIC_ALIAS_MAX = 10
+
+# 属性值长度（字符串、二进制和字符串对另行处理）
+PROP_FIXED_LENGTH = {
+    0x01: 1, 0x17: 1, 0x19: 1, 0x24: 1, 0x25: 1, 0x28: 1, 0x29: 1, 0x2A: 1,
+    0x13: 2, 0x21: 2, 0x22: 2, 0x23: 2,
+    0x02: 4, 0x11: 4, 0x18: 4, 0x27: 4,
+}
+PROP_STRING = (0x03, 0x08, 0x09, 0x12, 0x15, 0x16, 0x1A, 0x1C, 0x1F)
+
+# 剩余长度最多4字节
+MQTT_MAX_LENGTH_BYTES = 4
+
 class MockMQTTServer:
     def __init__(self, host='0.0.0.0', port=1883):
         self.host = host
@@ -60,12 +82,15 @@ class MockMQTTServer:
     
     def handle_client(self, client_socket, client_addr):
         """处理客户端连接"""
+        # 连接状态：协议级别和MQTT 5主题别名映射
+        session = {'version': 4, 'aliases': {}}
         try:
             while True:
                 # 读取MQTT固定头
-                fixed_header = client_socket.recv(2)
+                fixed_header = client_socket.recv(1)
                 if not fixed_header:
                     break
+                fixed_header += self.recv_exact(client_socket, 1)
                 
                 # 解析固定头
                 msg_type = (fixed_header[0] >> 4) & 0x0F
@@ -75,38 +100,87 @@ class MockMQTTServer:
                 
                 # 根据消息类型处理
                 if msg_type == MQTT_CONNECT:
-                    self.handle_connect(client_socket, remaining_length)
+                    self.handle_connect(client_socket, remaining_length, session)
                 elif msg_type == MQTT_PUBLISH:
-                    self.handle_publish(client_socket, remaining_length)
+                    self.handle_publish(client_socket, fixed_header[0], remaining_length, session)
                 else:
                     print(f"Unknown message type: {msg_type}")
                     # 读取剩余数据
-                    client_socket.recv(remaining_length)
+                    self.recv_exact(client_socket, remaining_length)
         except Exception as e:
             print(f"Error handling client {client_addr}: {e}")
         finally:
             print(f"Client disconnected: {client_addr}")
             client_socket.close()
     
+    def recv_exact(self, client_socket, length):
+        """读取固定长度数据，连接关闭时抛出异常"""
+        data = bytearray()
+        while len(data) < length:
+            chunk = client_socket.recv(length - len(data))
+            if not chunk:
+                raise ConnectionError("connection closed in the middle of a packet")
+            data.extend(chunk)
+        return bytes(data)
+    
     def decode_remaining_length(self, client_socket, first_byte):
-        """解码MQTT剩余长度"""
+        """解码MQTT剩余长度（与mqtt_codec.c中mqtt_decode_length规则一致，最多4字节）"""
         remaining_length = 0
         multiplier = 1
         
         byte = first_byte
-        while True:
+        for _ in range(MQTT_MAX_LENGTH_BYTES):
             remaining_length += (byte & 0x7F) * multiplier
             if (byte & 0x80) == 0:
-                break
+                return remaining_length
             multiplier *= 128
-            byte = client_socket.recv(1)[0]
+            byte = self.recv_exact(client_socket, 1)[0]
         
-        return remaining_length
+        raise ValueError("malformed remaining length")
     
-    def handle_connect(self, client_socket, remaining_length):
+    def decode_varint(self, data, pos):
+        """从缓冲区解码变长整数，返回(值, 新位置)"""
+        value = 0
+        multiplier = 1
+        for _ in range(MQTT_MAX_LENGTH_BYTES):
+            byte = data[pos]
+            pos += 1
+            value += (byte & 0x7F) * multiplier
+            if (byte & 0x80) == 0:
+                return value, pos
+            multiplier *= 128
+        raise ValueError("malformed variable byte integer")
+    
+    def parse_properties(self, data, pos):
+        """解析MQTT 5属性，返回(属性字典, 新位置)"""
+        length, pos = self.decode_varint(data, pos)
+        end = pos + length
+        props = {}
+        while pos < end:
+            prop_id = data[pos]
+            pos += 1
+            if prop_id in PROP_FIXED_LENGTH:
+                n = PROP_FIXED_LENGTH[prop_id]
+                props[prop_id] = int.from_bytes(data[pos:pos+n], 'big')
+                pos += n
+            elif prop_id == 0x0B:
+                props[prop_id], pos = self.decode_varint(data, pos)
+            elif prop_id in PROP_STRING:
+                n = struct.unpack('!H', data[pos:pos+2])[0]
+                props[prop_id] = data[pos+2:pos+2+n]
+                pos += 2 + n
+            elif prop_id == 0x26:
+                for _ in range(2):
+                    n = struct.unpack('!H', data[pos:pos+2])[0]
+                    pos += 2 + n
+            else:
+                raise ValueError(f"unknown property {prop_id:#x}")
+        return props, end
+    
+    def handle_connect(self, client_socket, remaining_length, session):
         """处理连接请求"""
         # 读取连接数据包
-        conn_data = client_socket.recv(remaining_length)
+        conn_data = self.recv_exact(client_socket, remaining_length)
         
         # 解析协议名
         proto_len = struct.unpack('!H', conn_data[0:2])[0]
@@ -116,36 +190,78 @@ class MockMQTTServer:
         print(f"  Protocol: {proto_name}")
         print(f"  Protocol level: {conn_data[2+proto_len]}")
         print(f"  Connect flags: {hex(conn_data[3+proto_len])}")
+        session['version'] = conn_data[2+proto_len]
+        session['aliases'] = {}
         
-        # 发送连接确认
+        # 发送连接确认（MQTT 5带主题别名上限属性）
         connack_packet = bytearray()
         connack_packet.append((MQTT_CONNACK << 4) | 0x00)  # 固定头
-        connack_packet.append(0x02)  # 剩余长度
-        connack_packet.append(0x00)  # 保留位
-        connack_packet.append(CONNACK_ACCEPTED)  # 连接返回码
+        if session['version'] == MQTT_VERSION_5:
+            connack_packet.append(0x06)  # 剩余长度
+            connack_packet.append(0x00)  # 会话标志
+            connack_packet.append(CONNACK_ACCEPTED)  # 原因码
+            connack_packet.append(0x03)  # 属性长度
+            connack_packet.append(PROP_TOPIC_ALIAS_MAX)
+            connack_packet.extend(struct.pack('!H', TOPIC_ALIAS_MAX))
+        else:
+            connack_packet.append(0x02)  # 剩余长度
+            connack_packet.append(0x00)  # 保留位
+            connack_packet.append(CONNACK_ACCEPTED)  # 连接返回码
         
         client_socket.send(connack_packet)
         print("Sent CONNACK packet (connection accepted)")
     
-    def handle_publish(self, client_socket, remaining_length):
+    def handle_publish(self, client_socket, flags, remaining_length, session):
         """处理发布消息"""
         # 读取发布数据包
-        publish_data = client_socket.recv(remaining_length)
+        publish_data = self.recv_exact(client_socket, remaining_length)
+        qos = (flags >> 1) & 0x03
+        dup = (flags >> 3) & 0x01
         
         # 解析主题
         topic_len = struct.unpack('!H', publish_data[0:2])[0]
         topic = publish_data[2:2+topic_len].decode()
+        pos = 2 + topic_len
+        
+        # QoS 1/2的消息带消息ID
+        packet_id = None
+        if qos > 0:
+            packet_id = struct.unpack('!H', publish_data[pos:pos+2])[0]
+            pos += 2
+        
+        # MQTT 5属性：带主题时建立别名映射，主题为空时按别名查找
+        expiry = None
+        if session['version'] == MQTT_VERSION_5:
+            props, pos = self.parse_properties(publish_data, pos)
+            expiry = props.get(PROP_MESSAGE_EXPIRY)
+            alias = props.get(PROP_TOPIC_ALIAS)
+            if alias is not None:
+                if alias == 0 or alias > TOPIC_ALIAS_MAX:
+                    raise ValueError(f"topic alias {alias} out of range")
+                if topic:
+                    session['aliases'][alias] = topic
+                elif alias in session['aliases']:
+                    topic = session['aliases'][alias]
+                else:
+                    raise ValueError(f"unknown topic alias {alias}")
+                topic = f"{topic} (alias {alias})"
         
         # 解析消息内容
-        message = publish_data[2+topic_len:].decode()
+        message = publish_data[pos:].decode()
         
         print(f"Received PUBLISH message")
         print(f"  Topic: {topic}")
+        print(f"  QoS: {qos}, DUP: {dup}, Packet ID: {packet_id}, Expiry: {expiry}")
         print(f"  Message: {message}")
         print(f"  Message length: {len(message)}")
+        
+        # QoS 1回复PUBACK
+        if qos == 1:
+            client_socket.send(struct.pack('!BBH', MQTT_PUBACK << 4, 0x02, packet_id))
 
 if __name__ == "__main__":
-    server = MockMQTTServer()
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 1883
+    server = MockMQTTServer(port=port)
     try:
         server.start()
     except KeyboardInterrupt:
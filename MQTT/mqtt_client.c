@@ -3,11 +3,39 @@
  * MQTT客户端源文件
  * 功能：实现MQTT客户端的连接、发布等功能
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-20
+ * 最后修改时间：2026-10-18
  */
 
 #include "mqtt_client.h"
 
+// 运行指标编号
+static int m_connects = -1;
+static int m_connect_errors = -1;
+static int m_publishes = -1;
+static int m_publish_errors = -1;
+static int m_bytes_out = -1;
+
+// 非实时消息的存储转发队列和补发线程（队列由发布方写入、补发线程读出和确认，用锁保护）
+static struct mqtt_spool *client_spool = NULL;
+static struct mqtt_drain client_drain = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * @brief 注册MQTT客户端运行指标
+ */
+void mqtt_client_metrics_init(void)
+{
+    m_connects = metrics_register("bds_mqtt_connects_total",
+                                  "MQTT sessions established (reconnects)", METRIC_COUNTER);
+    m_connect_errors = metrics_register("bds_mqtt_connect_errors_total",
+                                        "Failed MQTT connection attempts", METRIC_COUNTER);
+    m_publishes = metrics_register("bds_mqtt_publishes_total",
+                                   "Messages published", METRIC_COUNTER);
+    m_publish_errors = metrics_register("bds_mqtt_publish_errors_total",
+                                        "Failed publishes", METRIC_COUNTER);
+    m_bytes_out = metrics_register("bds_mqtt_out_payload_bytes_total",
+                                   "Payload bytes published", METRIC_COUNTER);
+}
+
 /**
  * @brief 创建MQTT客户端
  * @return 成功返回MQTT客户端句柄，失败返回NULL
@@ -52,9 +80,11 @@ int connect_mqtt_client(MQTTClient client)
     // 连接到MQTT服务器
     rc = MQTTClient_connect(client, &conn_opts);
     if (rc != MQTTCLIENT_SUCCESS) {
+        metrics_inc(m_connect_errors);
         fprintf(stderr, "MQTTClient_connect failed: %d\n", rc);
         return -1;
     }
+    metrics_inc(m_connects);
 
     printf("Connected to MQTT server: %s\n", MQTT_SERVER);
     return 0;
@@ -87,6 +117,7 @@ int publish_mqtt_message(MQTTClient client, const char *message)
     // 发布消息
     rc = MQTTClient_publishMessage(client, MQTT_TOPIC, &pubmsg, &token);
     if (rc != MQTTCLIENT_SUCCESS) {
+        metrics_inc(m_publish_errors);
         fprintf(stderr, "MQTTClient_publishMessage failed: %d\n", rc);
         return -1;
     }
@@ -94,9 +125,12 @@ int publish_mqtt_message(MQTTClient client, const char *message)
     // 等待消息发布完成
     rc = MQTTClient_waitForCompletion(client, token, 10000L);
     if (rc != MQTTCLIENT_SUCCESS) {
+        metrics_inc(m_publish_errors);
         fprintf(stderr, "MQTTClient_waitForCompletion failed: %d\n", rc);
         return -1;
     }
+    metrics_inc(m_publishes);
+    metrics_add(m_bytes_out, pubmsg.payloadlen);
 
     printf("Message published to topic %s: %s\n", MQTT_TOPIC, message);
     return 0;
@@ -116,6 +150,12 @@ int disconnect_mqtt_client(MQTTClient client)
 
     int rc;
 
+    // 先停止补发线程，之后才能销毁客户端
+    if (client_drain.client == client) {
+        stop_mqtt_spool_drain();
+        client_drain.client = NULL;
+    }
+
     // 断开连接
     rc = MQTTClient_disconnect(client, 10000L);
     if (rc != MQTTCLIENT_SUCCESS) {
@@ -129,3 +169,222 @@ int disconnect_mqtt_client(MQTTClient client)
     printf("Disconnected from MQTT server\n");
     return 0;
 }
+
+/**
+ * @brief 设置非实时消息的存储转发队列
+ * @param spool mqtt_spool_open打开的队列
+ */
+void mqtt_client_set_spool(struct mqtt_spool *spool)
+{
+    client_spool = spool;
+}
+
+/**
+ * @brief 确认队首的补发消息：只在补发线程中等待，每次最多等待一个轮询周期
+ * @param d 补发状态
+ * @return 队首消息已确认返回1，尚未确认返回0，超时未确认返回-1（需要重发）
+ */
+static int mqtt_drain_ack(struct mqtt_drain *d)
+{
+    if (MQTTClient_waitForCompletion(d->client, d->inflight_token[0], MQTT_DRAIN_POLL_MS) != MQTTCLIENT_SUCCESS) {
+        return bds_now_ns() - d->inflight_ns[0] > MQTT_DRAIN_ACK_TIMEOUT_S * 1000000000ULL ? -1 : 0;
+    }
+
+    pthread_mutex_lock(&d->lock);
+    mqtt_spool_ack(client_spool, d->inflight_seq[0]);
+    pthread_mutex_unlock(&d->lock);
+
+    d->inflight--;
+    memmove(d->inflight_token, &d->inflight_token[1], d->inflight * sizeof(d->inflight_token[0]));
+    memmove(d->inflight_seq, &d->inflight_seq[1], d->inflight * sizeof(d->inflight_seq[0]));
+    memmove(d->inflight_ns, &d->inflight_ns[1], d->inflight * sizeof(d->inflight_ns[0]));
+    return 1;
+}
+
+/**
+ * @brief 补发一轮：按令牌桶发出队列中的消息（不等待确认），再处理已到达的确认
+ * @param d 补发状态
+ * @return 本轮确认的消息数
+ */
+static int mqtt_drain_step(struct mqtt_drain *d)
+{
+    struct mqtt_spool_record rec;
+    char topic[256];
+    uint64_t now = bds_now_ns();
+    int acked = 0;
+
+    // 断线后已发出未确认的消息不会再有确认，从最早未确认的记录重新补发
+    if (!MQTTClient_isConnected(d->client)) {
+        if (d->inflight > 0) {
+            d->inflight = 0;
+            pthread_mutex_lock(&d->lock);
+            mqtt_spool_rewind(client_spool);
+            pthread_mutex_unlock(&d->lock);
+        }
+        d->tokens = 0;
+        d->tokens_ns = now;
+        return 0;
+    }
+
+    // 令牌桶：按速率补充，最多积累一个发送窗口
+    d->tokens += (double)(now - d->tokens_ns) * d->rate / 1e9;
+    if (d->tokens > MQTT_DRAIN_INFLIGHT) {
+        d->tokens = MQTT_DRAIN_INFLIGHT;
+    }
+    d->tokens_ns = now;
+
+    while (d->tokens >= 1 && d->inflight < MQTT_DRAIN_INFLIGHT) {
+        pthread_mutex_lock(&d->lock);
+        int have = mqtt_spool_next(client_spool, &rec);
+        if (have && rec.topic_len < (int)sizeof(topic)) {
+            memcpy(topic, rec.topic, rec.topic_len);
+            topic[rec.topic_len] = '\0';
+        } else if (have && d->inflight == 0) {
+            // 放不下的主题直接确认丢弃（确认是累积的，前面还有未确认的消息时留到重发）
+            mqtt_spool_ack(client_spool, rec.seq);
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (!have) {
+            break;
+        }
+        if (rec.topic_len >= (int)sizeof(topic)) {
+            continue;
+        }
+
+        // QoS 1发出即返回，确认由后面的mqtt_drain_ack处理（payload指向队列映射，仍在队列中）
+        MQTTClient_deliveryToken token;
+        int rc = MQTTClient_publish(d->client, topic, rec.payload_len, (void *)rec.payload, MQTT_QOS, 0, &token);
+        if (rc != MQTTCLIENT_SUCCESS) {
+            metrics_inc(m_publish_errors);
+            fprintf(stderr, "spooled message %llu not sent: %d\n", (unsigned long long)rec.seq, rc);
+            d->inflight = 0;
+            pthread_mutex_lock(&d->lock);
+            mqtt_spool_rewind(client_spool);
+            pthread_mutex_unlock(&d->lock);
+            return 0;
+        }
+        metrics_inc(m_publishes);
+        metrics_add(m_bytes_out, rec.payload_len);
+
+        d->inflight_token[d->inflight] = token;
+        d->inflight_seq[d->inflight] = rec.seq;
+        d->inflight_ns[d->inflight] = now;
+        d->inflight++;
+        d->tokens -= 1;
+    }
+
+    while (d->inflight > 0) {
+        int rc = mqtt_drain_ack(d);
+        if (rc < 0) {
+            metrics_inc(m_publish_errors);
+            fprintf(stderr, "spooled message %llu not acknowledged, resending\n",
+                    (unsigned long long)d->inflight_seq[0]);
+            d->inflight = 0;
+            pthread_mutex_lock(&d->lock);
+            mqtt_spool_rewind(client_spool);
+            pthread_mutex_unlock(&d->lock);
+        }
+        if (rc <= 0) {
+            break;
+        }
+        acked++;
+    }
+    return acked;
+}
+
+/**
+ * @brief 补发线程：与实时发布分开，实时消息从不等待补发
+ * @param arg 补发状态
+ * @return NULL
+ */
+static void *mqtt_drain_thread(void *arg)
+{
+    struct mqtt_drain *d = arg;
+    const struct timespec idle = { 0, MQTT_DRAIN_POLL_MS * 1000000L };
+
+    pthread_setname_np(pthread_self(), "mqtt-drain");
+    while (atomic_load(&d->running)) {
+        if (mqtt_drain_step(d) == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 启动补发线程：按rate条/秒的速率补发队列中的消息，最多MQTT_DRAIN_INFLIGHT条未确认
+ * @param client MQTT客户端句柄（补发线程运行期间不能销毁）
+ * @param rate 补发速率上限（条/秒）
+ * @return 成功返回0，失败返回-1
+ */
+int start_mqtt_spool_drain(MQTTClient client, int rate)
+{
+    struct mqtt_drain *d = &client_drain;
+
+    if (client == NULL || client_spool == NULL || rate <= 0) {
+        fprintf(stderr, "Invalid parameters\n");
+        return -1;
+    }
+    if (atomic_load(&d->running)) {
+        return 0;
+    }
+
+    d->client = client;
+    d->rate = rate;
+    d->tokens = 0;
+    d->tokens_ns = bds_now_ns();
+    d->inflight = 0;
+    atomic_store(&d->running, 1);
+    if (bds_thread_create(&d->tid, BDS_THREAD_STACK, 0, mqtt_drain_thread, d) != 0) {
+        fprintf(stderr, "spool drain thread creation failed\n");
+        atomic_store(&d->running, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 停止补发线程（已发出未确认的消息留在队列中，下次启动后重发）
+ */
+void stop_mqtt_spool_drain(void)
+{
+    struct mqtt_drain *d = &client_drain;
+
+    if (!atomic_load(&d->running)) {
+        return;
+    }
+    atomic_store(&d->running, 0);
+    pthread_join(d->tid, NULL);
+    d->inflight = 0;
+    pthread_mutex_lock(&d->lock);
+    mqtt_spool_rewind(client_spool);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 发布非实时消息：只写入存储转发队列，由补发线程按速率发出（服务器不可达时消息留在队列中）
+ * @param topic 主题
+ * @param message 要发布的消息
+ * @return 成功写入队列返回0，失败返回-1
+ */
+int queue_mqtt_message(const char *topic, const char *message)
+{
+    if (topic == NULL || message == NULL) {
+        fprintf(stderr, "Invalid parameters\n");
+        return -1;
+    }
+
+    if (client_spool == NULL) {
+        fprintf(stderr, "No spool configured\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&client_drain.lock);
+    int rc = mqtt_spool_append(client_spool, topic, message, strlen(message), bds_realtime_ns());
+    pthread_mutex_unlock(&client_drain.lock);
+    if (rc != 0) {
+        fprintf(stderr, "Message too large for the spool\n");
+        return -1;
+    }
+    return 0;
+}
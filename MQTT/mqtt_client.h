@@ -3,7 +3,7 @@
  * MQTT客户端头文件
  * 功能：定义MQTT客户端的常量、结构体和函数声明
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-20
+ * 最后修改时间：2026-10-18
  */
 
 #ifndef MQTT_CLIENT_H
@@ -13,8 +13,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <MQTTClient.h>
 
+#include "bds_metrics.h"
+#include "bds_time.h"
+#include "bds_thread.h"
+#include "mqtt_spool.h"
+
 // MQTT服务器配置
 #define MQTT_SERVER      "tcp://bjfzkj.com.cn:1883"
 #define MQTT_CLIENT_ID   "bds_rtk_client"
@@ -23,10 +31,36 @@
 #define MQTT_TOPIC       "BDS-RTK/test"
 #define MQTT_QOS         1
 
+// 存储转发队列的补发（在独立线程中进行，实时消息不排在补发积压之后）
+#define MQTT_DRAIN_RATE          20     // 默认补发速率上限（条/秒）
+#define MQTT_DRAIN_INFLIGHT      16     // 已发出未确认的补发消息上限
+#define MQTT_DRAIN_POLL_MS       50     // 补发线程的轮询周期（毫秒），也是每次等待确认的上限
+#define MQTT_DRAIN_ACK_TIMEOUT_S 10     // 补发消息超过该时间未确认时从队列重发
+
+// 补发线程状态
+struct mqtt_drain {
+    MQTTClient client;
+    pthread_t tid;
+    atomic_int running;
+    pthread_mutex_t lock;      // 保护存储转发队列：发布方追加，补发线程读出和确认
+    int rate;                  // 补发速率上限（条/秒）
+    double tokens;             // 可补发的消息数（令牌桶）
+    uint64_t tokens_ns;        // 上次补充令牌的时间
+    int inflight;              // 已发出未确认的补发消息数
+    MQTTClient_deliveryToken inflight_token[MQTT_DRAIN_INFLIGHT];   // 按发送顺序排列
+    uint64_t inflight_seq[MQTT_DRAIN_INFLIGHT];                     // 对应的队列记录序号
+    uint64_t inflight_ns[MQTT_DRAIN_INFLIGHT];                      // 发出时间
+};
+
 // 函数声明
+void mqtt_client_metrics_init(void);
 MQTTClient create_mqtt_client();
 int connect_mqtt_client(MQTTClient client);
 int publish_mqtt_message(MQTTClient client, const char *message);
 int disconnect_mqtt_client(MQTTClient client);
+void mqtt_client_set_spool(struct mqtt_spool *spool);
+int start_mqtt_spool_drain(MQTTClient client, int rate);
+void stop_mqtt_spool_drain(void);
+int queue_mqtt_message(const char *topic, const char *message);
 
 #endif /* MQTT_CLIENT_H */
@@ -0,0 +1,505 @@
+/*
+ * mqtt_codec.c
+ * MQTT报文编解码源文件
+ * 功能：实现剩余长度编解码、CONNECT/PUBLISH报文编码以及报文解析（MQTT 3.1.1和MQTT 5）
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "mqtt_codec.h"
+
+/**
+ * @brief 计算MQTT消息长度编码
+ * @param length 消息长度
+ * @param buffer 存储编码后的长度（至少4字节）
+ * @return 编码后的长度字节数，长度超出范围返回-1
+ */
+int mqtt_encode_length(int length, unsigned char *buffer)
+{
+    int i = 0;
+
+    if (length < 0 || length > MQTT_MAX_REMAINING_LENGTH) {
+        return -1;
+    }
+
+    do {
+        unsigned char byte = length % 128;
+        length = length / 128;
+        if (length > 0) {
+            byte |= 0x80;
+        }
+        buffer[i++] = byte;
+    } while (length > 0);
+    return i;
+}
+
+/**
+ * @brief 解码MQTT剩余长度
+ * @param buf 输入缓冲区（从剩余长度第一个字节开始）
+ * @param len 输入缓冲区长度
+ * @param value 输出的剩余长度
+ * @return 成功返回消耗的字节数，数据不足返回0，格式错误（超过4字节）返回-1
+ */
+int mqtt_decode_length(const unsigned char *buf, size_t len, int *value)
+{
+    int result = 0;
+    int multiplier = 1;
+
+    for (int i = 0; i < MQTT_MAX_LENGTH_BYTES; i++) {
+        if ((size_t)i >= len) {
+            return 0;
+        }
+        result += (buf[i] & 0x7F) * multiplier;
+        if ((buf[i] & 0x80) == 0) {
+            *value = result;
+            return i + 1;
+        }
+        multiplier *= 128;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief 写入带2字节长度前缀的字符串
+ * @param buffer 输出位置
+ * @param str 字符串
+ * @param len 字符串长度
+ * @return 写入的字节数
+ */
+static int mqtt_put_string(unsigned char *buffer, const char *str, int len)
+{
+    buffer[0] = (len >> 8) & 0xFF;
+    buffer[1] = len & 0xFF;
+    memcpy(&buffer[2], str, len);
+    return len + 2;
+}
+
+/**
+ * @brief 编码MQTT连接数据包
+ * @param buffer 存储连接数据包
+ * @param size 缓冲区大小
+ * @param client_id 客户端ID
+ * @param username 用户名
+ * @param password 密码
+ * @param version 协议级别（MQTT_VERSION_311或MQTT_VERSION_5）
+ * @return 连接数据包长度，缓冲区不足或字段过长返回-1
+ */
+static int mqtt_encode_connect(unsigned char *buffer, size_t size, const char *client_id,
+                               const char *username, const char *password, int version)
+{
+    int client_id_len = strlen(client_id);
+    int username_len = strlen(username);
+    int password_len = strlen(password);
+    unsigned char length_buf[MQTT_MAX_LENGTH_BYTES];
+
+    if (client_id_len > 0xFFFF || username_len > 0xFFFF || password_len > 0xFFFF) {
+        return -1;
+    }
+
+    // 先算出剩余长度，直接按最终位置写入，避免整体搬移（MQTT 5多一个字节的空属性长度）
+    int props_len = (version == MQTT_VERSION_5) ? 1 : 0;
+    int remaining_length = 10 + props_len + (2 + client_id_len) + (2 + username_len) + (2 + password_len);
+    int length_len = mqtt_encode_length(remaining_length, length_buf);
+    if (length_len < 0 || (size_t)(1 + length_len + remaining_length) > size) {
+        return -1;
+    }
+
+    int pos = 0;
+
+    // 固定头
+    buffer[pos++] = MQTT_CONNECT << 4;  // 消息类型
+    memcpy(&buffer[pos], length_buf, length_len);
+    pos += length_len;
+
+    // 协议名（MQTT）
+    pos += mqtt_put_string(&buffer[pos], "MQTT", 4);
+
+    // 协议级别
+    buffer[pos++] = version;
+
+    // 连接标志
+    buffer[pos++] = 0xC0;  // 用户名和密码标志
+
+    // 保持连接时间
+    buffer[pos++] = 0x00; buffer[pos++] = 0x14;  // 20秒
+
+    // 属性（MQTT 5，不带属性）
+    if (props_len > 0) {
+        buffer[pos++] = 0x00;
+    }
+
+    // 客户端ID、用户名、密码
+    pos += mqtt_put_string(&buffer[pos], client_id, client_id_len);
+    pos += mqtt_put_string(&buffer[pos], username, username_len);
+    pos += mqtt_put_string(&buffer[pos], password, password_len);
+
+    return pos;
+}
+
+/**
+ * @brief 创建MQTT连接数据包（MQTT 3.1.1）
+ * @param buffer 存储连接数据包
+ * @param size 缓冲区大小
+ * @param client_id 客户端ID
+ * @param username 用户名
+ * @param password 密码
+ * @return 连接数据包长度，缓冲区不足或字段过长返回-1
+ */
+int mqtt_create_connect_packet(unsigned char *buffer, size_t size, const char *client_id,
+                               const char *username, const char *password)
+{
+    return mqtt_encode_connect(buffer, size, client_id, username, password, MQTT_VERSION_311);
+}
+
+/**
+ * @brief 创建MQTT连接数据包（MQTT 5，服务器在CONNACK中给出主题别名上限）
+ * @param buffer 存储连接数据包
+ * @param size 缓冲区大小
+ * @param client_id 客户端ID
+ * @param username 用户名
+ * @param password 密码
+ * @return 连接数据包长度，缓冲区不足或字段过长返回-1
+ */
+int mqtt_create_connect_packet_v5(unsigned char *buffer, size_t size, const char *client_id,
+                                  const char *username, const char *password)
+{
+    return mqtt_encode_connect(buffer, size, client_id, username, password, MQTT_VERSION_5);
+}
+
+/**
+ * @brief 编码MQTT发布数据包
+ * @param buffer 存储发布数据包
+ * @param size 缓冲区大小
+ * @param topic 主题
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @param flags 固定头标志（MQTT_PUBLISH_DUP、MQTT_PUBLISH_QOS1）
+ * @param packet_id 消息ID（QoS 0时忽略）
+ * @param props 属性（含属性长度前缀，MQTT 3.1.1为NULL）
+ * @param props_len 属性字节数
+ * @return 发布数据包长度，缓冲区不足或字段过长返回-1
+ */
+static int mqtt_encode_publish(unsigned char *buffer, size_t size, const char *topic,
+                               const unsigned char *payload, int payload_len, int flags, int packet_id,
+                               const unsigned char *props, int props_len)
+{
+    int topic_len = strlen(topic);
+    int id_len = (flags & MQTT_PUBLISH_QOS1) ? 2 : 0;
+    unsigned char length_buf[MQTT_MAX_LENGTH_BYTES];
+
+    if (topic_len > 0xFFFF || payload_len < 0) {
+        return -1;
+    }
+
+    // 主题 + 消息ID（仅QoS 1） + 属性（仅MQTT 5） + 消息内容
+    int remaining_length = 2 + topic_len + id_len + props_len + payload_len;
+    int length_len = mqtt_encode_length(remaining_length, length_buf);
+    if (length_len < 0 || (size_t)(1 + length_len + remaining_length) > size) {
+        return -1;
+    }
+
+    int pos = 0;
+
+    // 固定头
+    buffer[pos++] = (MQTT_PUBLISH << 4) | flags;  // 消息类型和标志
+    memcpy(&buffer[pos], length_buf, length_len);
+    pos += length_len;
+
+    // 主题
+    pos += mqtt_put_string(&buffer[pos], topic, topic_len);
+
+    // 消息ID
+    if (id_len > 0) {
+        buffer[pos++] = (packet_id >> 8) & 0xFF;
+        buffer[pos++] = packet_id & 0xFF;
+    }
+
+    // 属性
+    if (props_len > 0) {
+        memcpy(&buffer[pos], props, props_len);
+        pos += props_len;
+    }
+
+    // 消息内容
+    memcpy(&buffer[pos], payload, payload_len);
+    pos += payload_len;
+
+    return pos;
+}
+
+/**
+ * @brief 创建MQTT发布数据包（QoS 0）
+ * @param buffer 存储发布数据包
+ * @param size 缓冲区大小
+ * @param topic 主题
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @return 发布数据包长度，缓冲区不足或字段过长返回-1
+ */
+int mqtt_create_publish_packet(unsigned char *buffer, size_t size, const char *topic,
+                               const unsigned char *payload, int payload_len)
+{
+    return mqtt_encode_publish(buffer, size, topic, payload, payload_len, 0, 0, NULL, 0);
+}
+
+/**
+ * @brief 创建MQTT发布数据包（QoS 1，服务器收到后回复PUBACK）
+ * @param buffer 存储发布数据包
+ * @param size 缓冲区大小
+ * @param topic 主题
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @param packet_id 消息ID（1~65535）
+ * @param dup 是否为重发（断线前已发出但未确认）
+ * @return 发布数据包长度，缓冲区不足、字段过长或消息ID无效返回-1
+ */
+int mqtt_create_publish_packet_qos1(unsigned char *buffer, size_t size, const char *topic,
+                                    const unsigned char *payload, int payload_len, int packet_id, int dup)
+{
+    if (packet_id <= 0 || packet_id > 0xFFFF) {
+        return -1;
+    }
+    return mqtt_encode_publish(buffer, size, topic, payload, payload_len,
+                               MQTT_PUBLISH_QOS1 | (dup ? MQTT_PUBLISH_DUP : 0), packet_id, NULL, 0);
+}
+
+/**
+ * @brief 创建MQTT 5发布数据包
+ * @param buffer 存储发布数据包
+ * @param size 缓冲区大小
+ * @param topic 主题（已用topic_alias建立过映射时传""，只带2字节别名）
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @param flags 固定头标志（MQTT_PUBLISH_DUP、MQTT_PUBLISH_QOS1）
+ * @param packet_id 消息ID（QoS 1时为1~65535，QoS 0时忽略）
+ * @param topic_alias 主题别名（1~服务器上限，0表示不用别名）
+ * @param message_expiry 消息过期时间（秒，0表示不过期）
+ * @return 发布数据包长度，缓冲区不足、字段过长或参数无效返回-1
+ */
+int mqtt_create_publish_packet_v5(unsigned char *buffer, size_t size, const char *topic,
+                                  const unsigned char *payload, int payload_len, int flags, int packet_id,
+                                  int topic_alias, uint32_t message_expiry)
+{
+    unsigned char props[1 + 5 + 3];
+    int pos = 1;
+
+    if (topic_alias < 0 || topic_alias > 0xFFFF || (topic[0] == '\0' && topic_alias == 0)) {
+        return -1;
+    }
+    if ((flags & MQTT_PUBLISH_QOS1) && (packet_id <= 0 || packet_id > 0xFFFF)) {
+        return -1;
+    }
+
+    // 属性长度（不超过127，单字节）+ 属性
+    if (message_expiry > 0) {
+        props[pos++] = MQTT_PROP_MESSAGE_EXPIRY;
+        props[pos++] = (message_expiry >> 24) & 0xFF;
+        props[pos++] = (message_expiry >> 16) & 0xFF;
+        props[pos++] = (message_expiry >> 8) & 0xFF;
+        props[pos++] = message_expiry & 0xFF;
+    }
+    if (topic_alias > 0) {
+        props[pos++] = MQTT_PROP_TOPIC_ALIAS;
+        props[pos++] = (topic_alias >> 8) & 0xFF;
+        props[pos++] = topic_alias & 0xFF;
+    }
+    props[0] = pos - 1;
+
+    return mqtt_encode_publish(buffer, size, topic, payload, payload_len,
+                               flags & (MQTT_PUBLISH_QOS1 | MQTT_PUBLISH_DUP), packet_id, props, pos);
+}
+
+/**
+ * @brief 解析MQTT 5属性，取出主题别名、消息过期时间和主题别名上限，其余属性跳过
+ * @param buf 属性长度字段开始的位置
+ * @param len 可用字节数
+ * @param pkt 输出的报文描述
+ * @return 属性总长度（含长度字段），格式错误返回-1
+ */
+static int mqtt_parse_props(const unsigned char *buf, int len, struct mqtt_packet *pkt)
+{
+    int props_len;
+    int used = mqtt_decode_length(buf, len, &props_len);
+
+    if (used <= 0 || props_len > len - used) {
+        return -1;
+    }
+
+    const unsigned char *p = buf + used;
+    const unsigned char *end = p + props_len;
+    while (p < end) {
+        int id = *p++;
+        int n;
+
+        switch (id) {
+        // 1字节属性
+        case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+            n = 1;
+            break;
+        // 2字节属性
+        case 0x13: case 0x21: case MQTT_PROP_TOPIC_ALIAS_MAX: case MQTT_PROP_TOPIC_ALIAS:
+            n = 2;
+            break;
+        // 4字节属性
+        case MQTT_PROP_MESSAGE_EXPIRY: case 0x11: case 0x18: case 0x27:
+            n = 4;
+            break;
+        // 变长整数（订阅标识）
+        case 0x0B: {
+            int value;
+            n = mqtt_decode_length(p, end - p, &value);
+            if (n <= 0) {
+                return -1;
+            }
+            break;
+        }
+        // 带2字节长度的字符串或二进制数据
+        case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+            if (end - p < 2) {
+                return -1;
+            }
+            n = 2 + ((p[0] << 8) | p[1]);
+            break;
+        // 用户属性（字符串对）
+        case 0x26:
+            if (end - p < 2) {
+                return -1;
+            }
+            n = 2 + ((p[0] << 8) | p[1]);
+            if (end - p < n + 2) {
+                return -1;
+            }
+            n += 2 + ((p[n] << 8) | p[n + 1]);
+            break;
+        default:
+            return -1;
+        }
+        if (end - p < n) {
+            return -1;
+        }
+
+        if (id == MQTT_PROP_MESSAGE_EXPIRY) {
+            pkt->message_expiry = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        } else if (id == MQTT_PROP_TOPIC_ALIAS) {
+            pkt->topic_alias = (p[0] << 8) | p[1];
+        } else if (id == MQTT_PROP_TOPIC_ALIAS_MAX) {
+            pkt->topic_alias_max = (p[0] << 8) | p[1];
+        }
+        p += n;
+    }
+
+    return used + props_len;
+}
+
+/**
+ * @brief 解析一个完整的MQTT报文
+ * @param buf 输入缓冲区
+ * @param len 输入缓冲区长度
+ * @param version 协议级别（MQTT 5的CONNACK、PUBLISH和PUBACK带属性）
+ * @param pkt 输出的报文描述（字段指向输入缓冲区）
+ * @return 成功返回报文总长度，数据不足返回0，格式错误返回-1
+ */
+static int mqtt_parse(const unsigned char *buf, size_t len, int version, struct mqtt_packet *pkt)
+{
+    if (len < 2) {
+        return 0;
+    }
+
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->type = (buf[0] >> 4) & 0x0F;
+    pkt->flags = buf[0] & 0x0F;
+
+    int length_len = mqtt_decode_length(&buf[1], len - 1, &pkt->remaining_length);
+    if (length_len <= 0) {
+        return length_len;
+    }
+
+    pkt->header_length = 1 + length_len;
+    if ((size_t)pkt->header_length + pkt->remaining_length > len) {
+        return 0;
+    }
+    pkt->body = &buf[pkt->header_length];
+
+    switch (pkt->type) {
+    case MQTT_CONNACK:
+        if (pkt->remaining_length < 2) {
+            return -1;
+        }
+        pkt->return_code = pkt->body[1];
+        if (version == MQTT_VERSION_5 && pkt->remaining_length > 2 &&
+            mqtt_parse_props(&pkt->body[2], pkt->remaining_length - 2, pkt) < 0) {
+            return -1;
+        }
+        break;
+    case MQTT_PUBACK:
+        if (pkt->remaining_length < 2) {
+            return -1;
+        }
+        pkt->packet_id = (pkt->body[0] << 8) | pkt->body[1];
+        // MQTT 5：原因码为0（成功）时可以省略
+        if (version == MQTT_VERSION_5 && pkt->remaining_length > 2) {
+            pkt->reason_code = pkt->body[2];
+        }
+        break;
+    case MQTT_PUBLISH: {
+        int qos = (pkt->flags >> 1) & 0x03;
+        int pos = 0;
+
+        if (qos == 3 || pkt->remaining_length < 2) {
+            return -1;
+        }
+        pkt->topic_len = (pkt->body[0] << 8) | pkt->body[1];
+        pos = 2 + pkt->topic_len;
+        // QoS 1/2带2字节消息ID
+        if (qos > 0) {
+            pos += 2;
+        }
+        if (pos > pkt->remaining_length) {
+            return -1;
+        }
+        if (qos > 0) {
+            pkt->packet_id = (pkt->body[pos - 2] << 8) | pkt->body[pos - 1];
+        }
+        if (version == MQTT_VERSION_5) {
+            int props_len = mqtt_parse_props(&pkt->body[pos], pkt->remaining_length - pos, pkt);
+            if (props_len < 0) {
+                return -1;
+            }
+            pos += props_len;
+        }
+        pkt->topic = (const char *)&pkt->body[2];
+        pkt->payload = &pkt->body[pos];
+        pkt->payload_len = pkt->remaining_length - pos;
+        break;
+    }
+    default:
+        break;
+    }
+
+    return pkt->header_length + pkt->remaining_length;
+}
+
+/**
+ * @brief 解析一个完整的MQTT 3.1.1报文
+ * @param buf 输入缓冲区
+ * @param len 输入缓冲区长度
+ * @param pkt 输出的报文描述（字段指向输入缓冲区）
+ * @return 成功返回报文总长度，数据不足返回0，格式错误返回-1
+ */
+int mqtt_parse_packet(const unsigned char *buf, size_t len, struct mqtt_packet *pkt)
+{
+    return mqtt_parse(buf, len, MQTT_VERSION_311, pkt);
+}
+
+/**
+ * @brief 解析一个完整的MQTT 5报文（主题别名到主题的映射由接收方按连接维护）
+ * @param buf 输入缓冲区
+ * @param len 输入缓冲区长度
+ * @param pkt 输出的报文描述（字段指向输入缓冲区）
+ * @return 成功返回报文总长度，数据不足返回0，格式错误返回-1
+ */
+int mqtt_parse_packet_v5(const unsigned char *buf, size_t len, struct mqtt_packet *pkt)
+{
+    return mqtt_parse(buf, len, MQTT_VERSION_5, pkt);
+}
@@ -0,0 +1,83 @@
+/*
+ * mqtt_codec.h
+ * MQTT报文编解码头文件
+ * 功能：MQTT 3.1.1/5 CONNECT/PUBLISH报文编码、剩余长度编解码和报文解析（带缓冲区边界检查）；
+ *       MQTT 5支持主题别名和消息过期时间属性
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef MQTT_CODEC_H
+#define MQTT_CODEC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// 协议级别
+#define MQTT_VERSION_311 4   // MQTT 3.1.1
+#define MQTT_VERSION_5   5   // MQTT 5
+
+// MQTT固定头标志位
+#define MQTT_CONNECT     1   // 连接请求
+#define MQTT_CONNACK     2   // 连接确认
+#define MQTT_PUBLISH     3   // 发布消息
+#define MQTT_PUBACK      4   // 发布确认（QoS 1）
+
+// PUBLISH固定头标志
+#define MQTT_PUBLISH_DUP  0x08   // 重发
+#define MQTT_PUBLISH_QOS1 0x02   // QoS 1（需要PUBACK确认）
+
+// MQTT 5属性标识
+#define MQTT_PROP_MESSAGE_EXPIRY  0x02   // 消息过期时间（4字节，秒）：超时未投递的消息由服务器丢弃
+#define MQTT_PROP_TOPIC_ALIAS_MAX 0x22   // 主题别名上限（2字节，CONNACK）：0表示服务器不接受别名
+#define MQTT_PROP_TOPIC_ALIAS     0x23   // 主题别名（2字节，PUBLISH）：代替主题字符串
+
+// 连接返回码
+#define CONNACK_ACCEPTED 0   // 连接成功
+
+// 剩余长度编码上限（4字节变长整数）
+#define MQTT_MAX_REMAINING_LENGTH 268435455
+#define MQTT_MAX_LENGTH_BYTES     4
+
+// 解析后的报文（指针指向输入缓冲区，不拷贝）
+struct mqtt_packet {
+    int type;                        // 报文类型
+    int flags;                       // 固定头低4位
+    int remaining_length;            // 剩余长度
+    int header_length;               // 固定头长度（类型字节+剩余长度字节）
+    const unsigned char *body;       // 可变头和有效载荷
+    // PUBLISH字段
+    const char *topic;               // 主题（不以'\0'结尾）
+    int topic_len;                   // 主题长度
+    const unsigned char *payload;    // 消息内容
+    int payload_len;                 // 消息长度
+    int topic_alias;                 // 主题别名（MQTT 5，0表示未带）
+    uint32_t message_expiry;         // 消息过期时间（MQTT 5，秒，0表示未带）
+    // PUBLISH（QoS>0）和PUBACK字段
+    int packet_id;                   // 消息ID
+    int reason_code;                 // PUBACK原因码（MQTT 5，省略时为0）
+    // CONNACK字段
+    int return_code;                 // 连接返回码（MQTT 5为原因码）
+    int topic_alias_max;             // 服务器接受的主题别名上限（MQTT 5）
+};
+
+// 函数声明
+int mqtt_encode_length(int length, unsigned char *buffer);
+int mqtt_decode_length(const unsigned char *buf, size_t len, int *value);
+int mqtt_create_connect_packet(unsigned char *buffer, size_t size, const char *client_id,
+                               const char *username, const char *password);
+int mqtt_create_publish_packet(unsigned char *buffer, size_t size, const char *topic,
+                               const unsigned char *payload, int payload_len);
+int mqtt_create_publish_packet_qos1(unsigned char *buffer, size_t size, const char *topic,
+                                    const unsigned char *payload, int payload_len, int packet_id, int dup);
+int mqtt_create_connect_packet_v5(unsigned char *buffer, size_t size, const char *client_id,
+                                  const char *username, const char *password);
+int mqtt_create_publish_packet_v5(unsigned char *buffer, size_t size, const char *topic,
+                                  const unsigned char *payload, int payload_len, int flags, int packet_id,
+                                  int topic_alias, uint32_t message_expiry);
+int mqtt_parse_packet(const unsigned char *buf, size_t len, struct mqtt_packet *pkt);
+int mqtt_parse_packet_v5(const unsigned char *buf, size_t len, struct mqtt_packet *pkt);
+
+#endif /* MQTT_CODEC_H */
@@ -0,0 +1,127 @@
+/*
+ * mqtt_codec_fuzz.c
+ * MQTT编解码模糊测试程序
+ * 功能：对剩余长度解码和报文解析（MQTT 3.1.1/5）输入任意字节；用输入数据构造报文做编码/解析往返校验
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <assert.h>
+
+#include "mqtt_codec.h"
+
+#define FUZZ_PACKET_SIZE 2048   // 往返测试的输出缓冲区（故意偏小以触发容量检查）
+
+/**
+ * @brief 用输入构造PUBLISH报文，解析后与原始字段逐一比较
+ * @param data 输入数据
+ * @param size 输入长度
+ */
+static void fuzz_publish_roundtrip(const uint8_t *data, size_t size)
+{
+    unsigned char packet[FUZZ_PACKET_SIZE];
+    char topic[256];
+    struct mqtt_packet pkt;
+
+    if (size < 1) {
+        return;
+    }
+
+    // 第一个字节决定主题长度，主题中不能有'\0'（编码按strlen取长度）
+    size_t topic_len = data[0] % sizeof(topic);
+    if (topic_len > size - 1) {
+        topic_len = size - 1;
+    }
+    for (size_t i = 0; i < topic_len; i++) {
+        topic[i] = data[1 + i] ? (char)data[1 + i] : 'x';
+    }
+    topic[topic_len] = '\0';
+
+    const unsigned char *payload = data + 1 + topic_len;
+    int payload_len = (int)(size - 1 - topic_len);
+
+    int len = mqtt_create_publish_packet(packet, sizeof(packet), topic, payload, payload_len);
+    if (len < 0) {
+        // 只有确实放不下时才允许失败
+        unsigned char enc[MQTT_MAX_LENGTH_BYTES];
+        int remaining = 2 + (int)topic_len + payload_len;
+        assert(1 + mqtt_encode_length(remaining, enc) + remaining > (int)sizeof(packet));
+        return;
+    }
+
+    int parsed = mqtt_parse_packet(packet, len, &pkt);
+    assert(parsed == len);
+    assert(pkt.type == MQTT_PUBLISH);
+    assert(pkt.topic_len == (int)topic_len);
+    assert(memcmp(pkt.topic, topic, topic_len) == 0);
+    assert(pkt.payload_len == payload_len);
+    assert(memcmp(pkt.payload, payload, payload_len) == 0);
+
+    // 截断的报文必须报告数据不足而不是越界
+    if (len > 1) {
+        assert(mqtt_parse_packet(packet, len - 1, &pkt) == 0);
+    }
+
+    // MQTT 5：用输入的前几个字节决定QoS、别名和过期时间，主题为空时必须带别名
+    int flags = (data[0] & 0x01) ? MQTT_PUBLISH_QOS1 : 0;
+    int packet_id = 1 + data[0];
+    int alias = (data[0] & 0x02) ? 1 + (data[0] >> 2) : 0;
+    uint32_t expiry = (data[0] & 0x04) ? 0x01020304u * data[0] : 0;
+    len = mqtt_create_publish_packet_v5(packet, sizeof(packet), topic, payload, payload_len, flags, packet_id,
+                                        alias, expiry);
+    if (len < 0) {
+        // 只有空主题不带别名或确实放不下时才允许失败
+        unsigned char enc[MQTT_MAX_LENGTH_BYTES];
+        int props = 1 + (expiry ? 5 : 0) + (alias ? 3 : 0);
+        int remaining = 2 + (int)topic_len + (flags ? 2 : 0) + props + payload_len;
+        assert((topic_len == 0 && alias == 0) ||
+               1 + mqtt_encode_length(remaining, enc) + remaining > (int)sizeof(packet));
+        return;
+    }
+    parsed = mqtt_parse_packet_v5(packet, len, &pkt);
+    assert(parsed == len);
+    assert(pkt.topic_len == (int)topic_len && memcmp(pkt.topic, topic, topic_len) == 0);
+    assert(pkt.payload_len == payload_len && memcmp(pkt.payload, payload, payload_len) == 0);
+    assert(pkt.topic_alias == alias && pkt.message_expiry == expiry);
+    assert(pkt.packet_id == (flags ? packet_id : 0));
+    if (len > 1) {
+        assert(mqtt_parse_packet_v5(packet, len - 1, &pkt) == 0);
+    }
+}
+
+/**
+ * @brief 模糊测试入口
+ * @param data 输入数据
+ * @param size 输入长度
+ * @return 固定返回0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    struct mqtt_packet pkt;
+    int value = 0;
+
+    // 剩余长度解码：消耗的字节数不能超过输入和4字节上限
+    int used = mqtt_decode_length(data, size, &value);
+    assert(used <= MQTT_MAX_LENGTH_BYTES && (used <= 0 || (size_t)used <= size));
+    if (used > 0) {
+        unsigned char enc[MQTT_MAX_LENGTH_BYTES];
+        int n = mqtt_encode_length(value, enc);
+        assert(n > 0 && n <= used);
+    }
+
+    // 报文解析（两种协议级别）：返回的长度和字段必须落在输入范围内
+    for (int v = 0; v < 2; v++) {
+        int len = v ? mqtt_parse_packet_v5(data, size, &pkt) : mqtt_parse_packet(data, size, &pkt);
+        if (len > 0) {
+            assert((size_t)len <= size);
+            if (pkt.type == MQTT_PUBLISH) {
+                assert(pkt.topic_len >= 0 && pkt.payload_len >= 0);
+                assert((const uint8_t *)pkt.topic + pkt.topic_len <= data + len);
+                assert(pkt.payload + pkt.payload_len == data + len);
+            }
+        }
+    }
+
+    fuzz_publish_roundtrip(data, size);
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * mqtt_overhead.c
+ * MQTT报文开销测量程序
+ * 功能：读取RTCM3改正数流，按电文或按历元封装为PUBLISH，
+ *       比较MQTT 3.1.1与MQTT 5（主题别名、消息过期时间）在线路上的字节数
+ * 用法：bds_rtcm_gen -f -n 600 -o corr.rtcm && mqtt_overhead [-t topic] [-E expiry_s] corr.rtcm
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include <getopt.h>
+
+#include "bds_rtcm.h"
+#include "bds_epoch.h"
+#include "mqtt_codec.h"
+
+#define OVERHEAD_TOPIC       "BDS-RTK/test"
+#define OVERHEAD_EXPIRY_SEC  5
+#define OVERHEAD_TCPIP_BYTES 52        // 每个报文单独成段时的IPv4+TCP头（含时间戳选项）
+#define OVERHEAD_PACKET_SIZE (EPOCH_BUFFER_SIZE + 256)
+#define OVERHEAD_READ_SIZE   4096
+
+// 比较的封装方式
+enum overhead_mode {
+    MODE_V311 = 0,           // MQTT 3.1.1：每个报文带完整主题
+    MODE_V5,                 // MQTT 5：不带属性（多1字节属性长度）
+    MODE_V5_ALIAS,           // MQTT 5：首个报文建立别名，之后只带2字节别名
+    MODE_V5_ALIAS_EXPIRY,    // MQTT 5：别名 + 消息过期时间
+    MODE_COUNT
+};
+
+static const char *mode_names[MODE_COUNT] = {
+    "MQTT 3.1.1", "MQTT 5", "MQTT 5 + alias", "MQTT 5 + alias + expiry"
+};
+
+// 一种发布粒度的统计
+struct overhead_stats {
+    const char *name;                  // 粒度名称
+    uint64_t packets;                  // 发布次数
+    uint64_t payload;                  // 载荷字节数
+    uint64_t bytes[MODE_COUNT];        // 各封装方式的报文字节数
+};
+
+// 测量上下文
+struct overhead_ctx {
+    const char *topic;                 // 主题
+    uint32_t expiry;                   // 消息过期时间（秒）
+    struct rtcm_framer framer;         // 分帧器
+    struct epoch_assembler epoch;      // 历元组装器
+    struct overhead_stats frame;       // 每条电文一个PUBLISH
+    struct overhead_stats epochs;      // 每个历元一个PUBLISH
+    unsigned char packet[OVERHEAD_PACKET_SIZE];
+};
+
+/**
+ * @brief 把一段载荷按各封装方式编码，累计报文长度
+ * @param ctx 测量上下文
+ * @param st 统计
+ * @param payload 载荷
+ * @param len 载荷长度
+ */
+static void overhead_publish(struct overhead_ctx *ctx, struct overhead_stats *st,
+                             const unsigned char *payload, int len)
+{
+    // 别名在第一个报文中随主题建立，之后的报文主题为空
+    const char *alias_topic = st->packets == 0 ? ctx->topic : "";
+    int n[MODE_COUNT];
+
+    n[MODE_V311] = mqtt_create_publish_packet(ctx->packet, sizeof(ctx->packet), ctx->topic, payload, len);
+    n[MODE_V5] = mqtt_create_publish_packet_v5(ctx->packet, sizeof(ctx->packet), ctx->topic, payload, len,
+                                               0, 0, 0, 0);
+    n[MODE_V5_ALIAS] = mqtt_create_publish_packet_v5(ctx->packet, sizeof(ctx->packet), alias_topic,
+                                                     payload, len, 0, 0, 1, 0);
+    n[MODE_V5_ALIAS_EXPIRY] = mqtt_create_publish_packet_v5(ctx->packet, sizeof(ctx->packet), alias_topic,
+                                                            payload, len, 0, 0, 1, ctx->expiry);
+
+    for (int m = 0; m < MODE_COUNT; m++) {
+        if (n[m] < 0) {
+            fprintf(stderr, "%s: %d byte payload does not fit\n", st->name, len);
+            return;
+        }
+    }
+    for (int m = 0; m < MODE_COUNT; m++) {
+        st->bytes[m] += n[m];
+    }
+    st->packets++;
+    st->payload += len;
+}
+
+/**
+ * @brief 历元输出回调：整个历元作为一个PUBLISH
+ */
+static void overhead_epoch(const unsigned char *buf, int len, int reason, uint64_t first_ns, void *arg)
+{
+    struct overhead_ctx *ctx = arg;
+    (void)reason;
+    (void)first_ns;
+    overhead_publish(ctx, &ctx->epochs, buf, len);
+}
+
+/**
+ * @brief 分帧回调：每条电文作为一个PUBLISH，同时送入历元组装
+ */
+static void overhead_frame(const unsigned char *frame, int len, void *arg)
+{
+    struct overhead_ctx *ctx = arg;
+    overhead_publish(ctx, &ctx->frame, frame, len);
+    epoch_push(&ctx->epoch, frame, len, 0);
+}
+
+/**
+ * @brief 输出一种粒度的比较结果
+ * @param st 统计
+ */
+static void overhead_report(const struct overhead_stats *st)
+{
+    if (st->packets == 0) {
+        return;
+    }
+
+    uint64_t base = st->bytes[MODE_V311] + st->packets * OVERHEAD_TCPIP_BYTES;
+    printf("\n%s: %llu PUBLISH, %.1f payload bytes each\n", st->name,
+           (unsigned long long)st->packets, (double)st->payload / st->packets);
+    printf("%-26s %12s %10s %10s %12s %10s\n", "protocol", "MQTT bytes", "hdr/pkt", "hdr %",
+           "+TCP/IP", "saved");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        uint64_t hdr = st->bytes[m] - st->payload;
+        uint64_t wire = st->bytes[m] + st->packets * OVERHEAD_TCPIP_BYTES;
+        printf("%-26s %12llu %10.2f %9.2f%% %12llu %9.2f%%\n", mode_names[m],
+               (unsigned long long)st->bytes[m], (double)hdr / st->packets, 100.0 * hdr / st->bytes[m],
+               (unsigned long long)wire, 100.0 * ((double)base - wire) / base);
+    }
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回-1
+ */
+int main(int argc, char *argv[])
+{
+    static struct overhead_ctx ctx;
+    unsigned char buf[OVERHEAD_READ_SIZE];
+    uint64_t total = 0;
+    FILE *fp = stdin;
+    int c;
+
+    ctx.topic = OVERHEAD_TOPIC;
+    ctx.expiry = OVERHEAD_EXPIRY_SEC;
+    while ((c = getopt(argc, argv, "t:E:h")) != -1) {
+        switch (c) {
+        case 't':
+            ctx.topic = optarg;
+            break;
+        case 'E':
+            ctx.expiry = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [-t topic] [-E expiry_s] [rtcm_file]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (optind < argc) {
+        fp = fopen(argv[optind], "rb");
+        if (fp == NULL) {
+            perror("open input failed");
+            return -1;
+        }
+    }
+
+    ctx.frame.name = "per RTCM message";
+    ctx.epochs.name = "per epoch (1005/ephemeris published separately)";
+    rtcm_framer_init(&ctx.framer);
+    epoch_init(&ctx.epoch, 1000, overhead_epoch, &ctx);
+
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        rtcm_framer_push(&ctx.framer, buf, n, overhead_frame, &ctx);
+        total += n;
+    }
+    epoch_flush(&ctx.epoch, EPOCH_DEADLINE);
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    // 一次性的连接开销（MQTT 5的CONNECT多1字节属性长度，CONNACK多主题别名上限属性）
+    int connect311 = mqtt_create_connect_packet(ctx.packet, sizeof(ctx.packet), "bds_rtk_client",
+                                                "mqttgnss", "feizhou@500127");
+    int connect5 = mqtt_create_connect_packet_v5(ctx.packet, sizeof(ctx.packet), "bds_rtk_client",
+                                                 "mqttgnss", "feizhou@500127");
+
+    printf("input: %llu bytes, %llu RTCM3 frames, topic \"%s\" (%zu bytes), expiry %u s\n",
+           (unsigned long long)total, (unsigned long long)ctx.framer.frames, ctx.topic, strlen(ctx.topic),
+           ctx.expiry);
+    printf("CONNECT: %d bytes (3.1.1), %d bytes (5); TCP/IP column assumes %d bytes per PUBLISH segment\n",
+           connect311, connect5, OVERHEAD_TCPIP_BYTES);
+    overhead_report(&ctx.frame);
+    overhead_report(&ctx.epochs);
+    return 0;
+}
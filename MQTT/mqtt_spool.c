@@ -0,0 +1,461 @@
+/*
+ * mqtt_spool.c
+ * MQTT存储转发队列源文件
+ * 功能：内存映射的定长环形队列文件：追加、按序读出、确认出队、写满淘汰最旧记录、打开时按序号和CRC恢复
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "mqtt_spool.h"
+
+#define SPOOL_REC_HDR ((uint64_t)sizeof(struct mqtt_spool_rec_header))
+
+// CRC-32（IEEE 802.3，反射多项式0xEDB88320）查找表，首次使用时生成
+static uint32_t spool_crc_table[256];
+static int spool_crc_ready = 0;
+
+/**
+ * @brief 计算CRC-32
+ * @param buf 数据
+ * @param len 数据长度
+ * @return 校验值
+ */
+static uint32_t spool_crc32(const unsigned char *buf, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    if (!spool_crc_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            spool_crc_table[i] = c;
+        }
+        spool_crc_ready = 1;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        crc = spool_crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * @brief 计算记录占用的字节数（含记录头，按8字节对齐）
+ * @param topic_len 主题长度
+ * @param payload_len 消息长度
+ * @return 字节数
+ */
+static uint64_t spool_rec_size(uint64_t topic_len, uint64_t payload_len)
+{
+    return (SPOOL_REC_HDR + topic_len + payload_len + MQTT_SPOOL_ALIGN - 1) & ~(uint64_t)(MQTT_SPOOL_ALIGN - 1);
+}
+
+/**
+ * @brief 取数据区中指定位置的记录头
+ * @param sp 队列
+ * @param off 位置
+ * @return 记录头指针
+ */
+static struct mqtt_spool_rec_header *spool_at(const struct mqtt_spool *sp, uint64_t off)
+{
+    return (struct mqtt_spool_rec_header *)(sp->data + off);
+}
+
+/**
+ * @brief 跳过数据区末尾放不下记录头的空间和序号匹配的回绕标记
+ * @param sp 队列
+ * @param off 位置
+ * @param seq 该位置上应有的记录序号
+ * @return 记录实际所在的位置
+ */
+static uint64_t spool_skip_wrap(const struct mqtt_spool *sp, uint64_t off, uint64_t seq)
+{
+    if (off + SPOOL_REC_HDR > sp->size) {
+        return 0;
+    }
+
+    const struct mqtt_spool_rec_header *h = spool_at(sp, off);
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == MQTT_SPOOL_WRAP_MAGIC && h->seq == seq) {
+        return 0;
+    }
+    return off;
+}
+
+/**
+ * @brief 读取指定位置上指定序号的记录
+ * @param sp 队列
+ * @param off 位置（可以是回绕标记的位置）
+ * @param seq 期望的序号
+ * @param rec 输出的记录，可为NULL
+ * @param next_off 输出的下一条记录的位置
+ * @return 记录完整且序号一致返回1，否则返回0（队尾、旧记录或写了一半的记录）
+ */
+static int spool_read(const struct mqtt_spool *sp, uint64_t off, uint64_t seq,
+                      struct mqtt_spool_record *rec, uint64_t *next_off)
+{
+    off = spool_skip_wrap(sp, off, seq);
+
+    const struct mqtt_spool_rec_header *h = spool_at(sp, off);
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != MQTT_SPOOL_REC_MAGIC || h->seq != seq) {
+        return 0;
+    }
+
+    uint64_t total = spool_rec_size(h->topic_len, h->payload_len);
+    if (off + total > sp->size) {
+        return 0;
+    }
+
+    const unsigned char *body = (const unsigned char *)h + SPOOL_REC_HDR;
+    uint32_t crc = spool_crc32((const unsigned char *)&h->seq,
+                               SPOOL_REC_HDR - offsetof(struct mqtt_spool_rec_header, seq) +
+                               h->topic_len + h->payload_len);
+    if (crc != h->crc) {
+        return 0;
+    }
+
+    if (rec != NULL) {
+        rec->seq = h->seq;
+        rec->time_ns = h->time_ns;
+        rec->topic = (const char *)body;
+        rec->topic_len = h->topic_len;
+        rec->payload = body + h->topic_len;
+        rec->payload_len = h->payload_len;
+    }
+    *next_off = off + total;
+    return 1;
+}
+
+/**
+ * @brief 移出队首记录（确认或淘汰）
+ * @param sp 队列
+ * @return 成功返回0，队列为空返回-1
+ */
+static int spool_pop(struct mqtt_spool *sp)
+{
+    struct mqtt_spool_file_header *hdr = sp->hdr;
+    uint64_t next;
+
+    if (hdr->head_seq >= sp->next_seq) {
+        return -1;
+    }
+
+    if (!spool_read(sp, hdr->head_off, hdr->head_seq, NULL, &next)) {
+        // 队首记录损坏（文件被外部改写）：放弃剩余记录
+        fprintf(stderr, "spool record %llu is corrupt, dropping %llu records\n",
+                (unsigned long long)hdr->head_seq, (unsigned long long)(sp->next_seq - hdr->head_seq));
+        __atomic_store_n(&hdr->head_seq, sp->next_seq, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->head_off, sp->tail_off, __ATOMIC_RELEASE);
+    } else {
+        // 先更新序号再更新位置，崩溃时位置最多落后一条记录
+        uint64_t seq = hdr->head_seq + 1;
+        __atomic_store_n(&hdr->head_seq, seq, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->head_off, spool_skip_wrap(sp, next, seq), __ATOMIC_RELEASE);
+    }
+
+    if (sp->send_seq < hdr->head_seq) {
+        sp->send_seq = hdr->head_seq;
+        sp->send_off = hdr->head_off;
+    }
+    return 0;
+}
+
+/**
+ * @brief 打开（不存在时创建）队列文件并恢复队列状态
+ * @param path 文件路径
+ * @param size 数据区大小（向上取整到页，不小于MQTT_SPOOL_MIN_SIZE）
+ * @return 成功返回队列，失败返回NULL
+ *
+ * 文件大小与配置不一致或文件头无效时重建（原有记录丢弃）；
+ * 队尾从队首开始按连续的序号和CRC扫描得到，写了一半的记录不会被读出
+ */
+struct mqtt_spool *mqtt_spool_open(const char *path, uint64_t size)
+{
+    struct stat st;
+
+    if (size < MQTT_SPOOL_MIN_SIZE) {
+        size = MQTT_SPOOL_MIN_SIZE;
+    }
+    size = (size + MQTT_SPOOL_HEADER_SIZE - 1) & ~(uint64_t)(MQTT_SPOOL_HEADER_SIZE - 1);
+    uint64_t total = MQTT_SPOOL_HEADER_SIZE + size;
+
+    struct mqtt_spool *sp = pool_alloc("spool", "spool state", sizeof(*sp), 1, POOL_SHARED);
+    if (sp == NULL) {
+        return NULL;
+    }
+
+    sp->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (sp->fd < 0) {
+        perror("open spool failed");
+        pool_free(sp);
+        return NULL;
+    }
+    if (fstat(sp->fd, &st) != 0) {
+        perror("fstat spool failed");
+        goto fail;
+    }
+
+    // 大小不一致时截断为0再分配，旧记录全部清零，不会被误认为新记录
+    int fresh = 0;
+    if ((uint64_t)st.st_size != total) {
+        if (st.st_size > 0) {
+            fprintf(stderr, "spool %s has a different size, recreating\n", path);
+        }
+        if (ftruncate(sp->fd, 0) != 0) {
+            perror("ftruncate spool failed");
+            goto fail;
+        }
+        fresh = 1;
+    }
+
+    // 预先分配磁盘空间，写映射区时不会因磁盘满收到SIGBUS
+    int err = posix_fallocate(sp->fd, 0, total);
+    if (err != 0) {
+        fprintf(stderr, "posix_fallocate spool failed: %s\n", strerror(err));
+        goto fail;
+    }
+
+    sp->map = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, sp->fd, 0);
+    if (sp->map == MAP_FAILED) {
+        perror("mmap spool failed");
+        sp->map = NULL;
+        goto fail;
+    }
+    sp->hdr = (struct mqtt_spool_file_header *)sp->map;
+    sp->data = sp->map + MQTT_SPOOL_HEADER_SIZE;
+    sp->size = size;
+    pool_account("spool", "spool file mapping", sp->map, total, 1, POOL_SHARED);
+
+    struct mqtt_spool_file_header *hdr = sp->hdr;
+    if (!fresh && (hdr->magic != MQTT_SPOOL_MAGIC || hdr->version != MQTT_SPOOL_VERSION ||
+                   hdr->data_size != size || hdr->head_off >= size ||
+                   hdr->head_off % MQTT_SPOOL_ALIGN != 0 || hdr->head_seq == 0)) {
+        fprintf(stderr, "spool %s has an invalid header, recreating\n", path);
+        memset(sp->data, 0, size);
+        fresh = 1;
+    }
+    if (fresh) {
+        memset(hdr, 0, MQTT_SPOOL_HEADER_SIZE);
+        hdr->version = MQTT_SPOOL_VERSION;
+        hdr->data_size = size;
+        hdr->head_off = 0;
+        hdr->head_seq = 1;
+        __atomic_store_n(&hdr->magic, MQTT_SPOOL_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    // 确认时先更新序号：位置可能还停在刚确认的那条记录上
+    uint64_t off = hdr->head_off;
+    uint64_t seq = hdr->head_seq;
+    uint64_t next;
+    if (spool_read(sp, off, seq - 1, NULL, &next)) {
+        off = next;
+    }
+    off = spool_skip_wrap(sp, off, seq);
+    hdr->head_off = off;
+
+    while (spool_read(sp, off, seq, NULL, &next)) {
+        off = next;
+        seq++;
+    }
+    sp->tail_off = off;
+    sp->next_seq = seq;
+    mqtt_spool_rewind(sp);
+
+    return sp;
+
+fail:
+    close(sp->fd);
+    pool_free(sp);
+    return NULL;
+}
+
+/**
+ * @brief 追加一条消息，空间不足时淘汰最旧的记录（含已发出未确认的记录）
+ * @param sp 队列
+ * @param topic 主题
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @param time_ns 入队时间（UTC纳秒）
+ * @return 成功返回0，消息超过数据区的1/4返回-1
+ */
+int mqtt_spool_append(struct mqtt_spool *sp, const char *topic, const void *payload, int payload_len,
+                      uint64_t time_ns)
+{
+    struct mqtt_spool_file_header *hdr = sp->hdr;
+    size_t topic_len = strlen(topic);
+    uint64_t wrap_at = sp->size;
+    uint64_t off;
+
+    if (topic_len > 0xFFFF || payload_len < 0) {
+        return -1;
+    }
+    uint64_t need = spool_rec_size(topic_len, payload_len);
+    if (need > sp->size / 4) {
+        return -1;
+    }
+
+    while (1) {
+        uint64_t head = hdr->head_off;
+        uint64_t tail = sp->tail_off;
+
+        if (hdr->head_seq == sp->next_seq) {
+            // 队列为空：从数据区开头写
+            off = 0;
+            __atomic_store_n(&hdr->head_off, 0, __ATOMIC_RELEASE);
+            break;
+        }
+        if (tail > head) {
+            if (tail + need <= sp->size) {
+                off = tail;
+                break;
+            }
+            if (need <= head) {
+                off = 0;
+                wrap_at = tail;
+                break;
+            }
+        } else if (tail < head && tail + need <= head) {
+            off = tail;
+            break;
+        }
+        spool_pop(sp);
+        sp->evicted++;
+    }
+
+    // 发送位置停在队尾时直接指向新记录，不依赖之后可能被覆盖的回绕标记
+    if (sp->send_seq >= sp->next_seq) {
+        sp->send_seq = sp->next_seq;
+        sp->send_off = off;
+    }
+
+    // 回绕标记带下一条记录的序号，残留的旧标记不会被误用
+    if (wrap_at + SPOOL_REC_HDR <= sp->size) {
+        struct mqtt_spool_rec_header *w = spool_at(sp, wrap_at);
+        __atomic_store_n(&w->magic, 0, __ATOMIC_RELAXED);
+        w->seq = sp->next_seq;
+        __atomic_store_n(&w->magic, MQTT_SPOOL_WRAP_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    // 先清除magic，写完内容和CRC后再写入，崩溃时写了一半的记录不会被读出
+    struct mqtt_spool_rec_header *h = spool_at(sp, off);
+    unsigned char *body = (unsigned char *)h + SPOOL_REC_HDR;
+    __atomic_store_n(&h->magic, 0, __ATOMIC_RELAXED);
+    h->seq = sp->next_seq;
+    h->time_ns = time_ns;
+    h->topic_len = topic_len;
+    h->reserved = 0;
+    h->payload_len = payload_len;
+    memcpy(body, topic, topic_len);
+    memcpy(body + topic_len, payload, payload_len);
+    h->crc = spool_crc32((const unsigned char *)&h->seq,
+                         SPOOL_REC_HDR - offsetof(struct mqtt_spool_rec_header, seq) + topic_len + payload_len);
+    __atomic_store_n(&h->magic, MQTT_SPOOL_REC_MAGIC, __ATOMIC_RELEASE);
+
+    sp->tail_off = off + need;
+    sp->next_seq++;
+    sp->appended++;
+    return 0;
+}
+
+/**
+ * @brief 读出下一条待发送的记录并移动发送位置（记录仍在队列中，确认后才出队）
+ * @param sp 队列
+ * @param rec 输出的记录
+ * @return 有记录返回1，没有待发送的记录返回0
+ */
+int mqtt_spool_next(struct mqtt_spool *sp, struct mqtt_spool_record *rec)
+{
+    uint64_t next;
+
+    if (sp->send_seq >= sp->next_seq) {
+        return 0;
+    }
+    if (!spool_read(sp, sp->send_off, sp->send_seq, rec, &next)) {
+        fprintf(stderr, "spool record %llu is corrupt, skipping to the tail\n",
+                (unsigned long long)sp->send_seq);
+        sp->send_seq = sp->next_seq;
+        sp->send_off = sp->tail_off;
+        return 0;
+    }
+
+    // 下一条记录已写入时越过回绕标记（标记所在空间之后会被新记录覆盖）
+    sp->send_seq++;
+    sp->send_off = sp->send_seq < sp->next_seq ? spool_skip_wrap(sp, next, sp->send_seq) : next;
+    return 1;
+}
+
+/**
+ * @brief 确认序号不大于seq的全部记录，移出队列
+ * @param sp 队列
+ * @param seq 已确认的记录序号
+ */
+void mqtt_spool_ack(struct mqtt_spool *sp, uint64_t seq)
+{
+    while (sp->hdr->head_seq <= seq && spool_pop(sp) == 0) {
+        sp->acked++;
+    }
+}
+
+/**
+ * @brief 重连后从最旧的未确认记录重新发送
+ * @param sp 队列
+ */
+void mqtt_spool_rewind(struct mqtt_spool *sp)
+{
+    sp->send_off = sp->hdr->head_off;
+    sp->send_seq = sp->hdr->head_seq;
+}
+
+/**
+ * @brief 队列中的记录数（含已发出未确认的记录）
+ * @param sp 队列
+ * @return 记录数
+ */
+uint64_t mqtt_spool_count(const struct mqtt_spool *sp)
+{
+    return sp->next_seq - sp->hdr->head_seq;
+}
+
+/**
+ * @brief 队列占用的数据区字节数
+ * @param sp 队列
+ * @return 字节数
+ */
+uint64_t mqtt_spool_bytes(const struct mqtt_spool *sp)
+{
+    uint64_t head = sp->hdr->head_off;
+
+    if (mqtt_spool_count(sp) == 0) {
+        return 0;
+    }
+    return sp->tail_off > head ? sp->tail_off - head : sp->size - head + sp->tail_off;
+}
+
+/**
+ * @brief 发起映射区回写（不等待完成）：进程崩溃不丢数据，掉电最多丢失上次回写之后的记录
+ * @param sp 队列
+ */
+void mqtt_spool_sync(struct mqtt_spool *sp)
+{
+    if (msync(sp->map, MQTT_SPOOL_HEADER_SIZE + sp->size, MS_ASYNC) != 0) {
+        perror("msync spool failed");
+    }
+}
+
+/**
+ * @brief 回写并关闭队列
+ * @param sp 队列，可为NULL
+ */
+void mqtt_spool_close(struct mqtt_spool *sp)
+{
+    if (sp == NULL) {
+        return;
+    }
+    if (msync(sp->map, MQTT_SPOOL_HEADER_SIZE + sp->size, MS_SYNC) != 0) {
+        perror("msync spool failed");
+    }
+    munmap(sp->map, MQTT_SPOOL_HEADER_SIZE + sp->size);
+    close(sp->fd);
+    pool_free(sp);
+}
@@ -0,0 +1,93 @@
+/*
+ * mqtt_spool.h
+ * MQTT存储转发队列头文件
+ * 功能：服务器不可达期间非实时主题（状态、存档类遥测）的消息写入内存映射的磁盘环形队列，
+ *       重连后按QoS 1补发，收到PUBACK后才出队；文件大小固定，写满时淘汰最旧的消息
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#ifndef MQTT_SPOOL_H
+#define MQTT_SPOOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bds_pool.h"
+
+// 文件格式
+#define MQTT_SPOOL_MAGIC       0x5053514D   // "MQSP"：文件头
+#define MQTT_SPOOL_REC_MAGIC   0x5253514D   // "MQSR"：消息记录
+#define MQTT_SPOOL_WRAP_MAGIC  0x5753514D   // "MQSW"：回绕标记，下一条记录从数据区开头开始
+#define MQTT_SPOOL_VERSION     1
+#define MQTT_SPOOL_HEADER_SIZE 4096         // 文件头占一页，数据区页对齐
+#define MQTT_SPOOL_ALIGN       8            // 记录按8字节对齐
+#define MQTT_SPOOL_MIN_SIZE    (64 * 1024)  // 数据区最小值
+
+// 文件头（队首位置只在确认或淘汰后更新，队尾在打开时按序号扫描得到）
+struct mqtt_spool_file_header {
+    uint32_t magic;            // MQTT_SPOOL_MAGIC
+    uint32_t version;          // MQTT_SPOOL_VERSION
+    uint64_t data_size;        // 数据区大小
+    uint64_t head_off;         // 最旧的未确认记录的位置
+    uint64_t head_seq;         // 最旧的未确认记录的序号（先于位置更新）
+};
+
+// 记录头（magic最后写入，进程崩溃时写了一半的记录由magic和CRC识别）
+struct mqtt_spool_rec_header {
+    uint32_t magic;            // MQTT_SPOOL_REC_MAGIC或MQTT_SPOOL_WRAP_MAGIC
+    uint32_t crc;              // 从seq到消息内容末尾的CRC-32
+    uint64_t seq;              // 序号（回绕标记为下一条记录的序号）
+    uint64_t time_ns;          // 入队时间（UTC纳秒）
+    uint16_t topic_len;        // 主题长度
+    uint16_t reserved;
+    uint32_t payload_len;      // 消息长度
+};
+
+// 读出的记录（指针指向映射区，下一次写入前有效）
+struct mqtt_spool_record {
+    uint64_t seq;
+    uint64_t time_ns;
+    const char *topic;
+    int topic_len;
+    const unsigned char *payload;
+    int payload_len;
+};
+
+// 存储转发队列
+struct mqtt_spool {
+    int fd;                            // 队列文件
+    unsigned char *map;                // 整个文件的映射
+    struct mqtt_spool_file_header *hdr;  // 文件头
+    unsigned char *data;               // 数据区
+    uint64_t size;                     // 数据区大小
+    uint64_t tail_off;                 // 下一条记录的写入位置
+    uint64_t next_seq;                 // 下一条记录的序号
+    uint64_t send_off;                 // 下一条待发送记录的位置
+    uint64_t send_seq;                 // 下一条待发送记录的序号
+    uint64_t appended;                 // 入队的记录数
+    uint64_t evicted;                  // 写满时淘汰的未确认记录数
+    uint64_t acked;                    // 已确认出队的记录数
+};
+
+// 函数声明
+struct mqtt_spool *mqtt_spool_open(const char *path, uint64_t size);
+int mqtt_spool_append(struct mqtt_spool *sp, const char *topic, const void *payload, int payload_len,
+                      uint64_t time_ns);
+int mqtt_spool_next(struct mqtt_spool *sp, struct mqtt_spool_record *rec);
+void mqtt_spool_ack(struct mqtt_spool *sp, uint64_t seq);
+void mqtt_spool_rewind(struct mqtt_spool *sp);
+uint64_t mqtt_spool_count(const struct mqtt_spool *sp);
+uint64_t mqtt_spool_bytes(const struct mqtt_spool *sp);
+void mqtt_spool_sync(struct mqtt_spool *sp);
+void mqtt_spool_close(struct mqtt_spool *sp);
+
+#endif /* MQTT_SPOOL_H */
@@ -0,0 +1,301 @@
+/*
+ * mqtt_spool_test.c
+ * MQTT存储转发队列测试程序
+ * 功能：写入记录后关闭重开，检查补发的记录：确认后出队、确认中途崩溃（位置落后一条）、
+ *       写了一半的队尾记录、内容损坏的记录、数据区回绕、写满时从最旧的记录开始淘汰、
+ *       文件被截断或文件头损坏时重建
+ * 代码作者：ClancyShang
+ * 最后修改时间：2026-10-18
+ */
+
+#include "mqtt_spool.h"
+
+#define TEST_SIZE   MQTT_SPOOL_MIN_SIZE  // 数据区大小
+#define TEST_TOPIC  "BDS-RTK/status"
+
+static char spool_path[] = "/tmp/mqtt_spool_test.XXXXXX";
+
+/**
+ * @brief 生成序号对应的消息内容（长度随序号变化，覆盖不同的对齐填充）
+ * @param seq 序号
+ * @param buf 输出缓冲区（不小于128字节）
+ * @return 消息长度
+ */
+static int make_payload(uint64_t seq, unsigned char *buf)
+{
+    int len = snprintf((char *)buf, 128, "record %llu ", (unsigned long long)seq);
+    int pad = (int)(seq % 13) * 7;
+
+    for (int i = 0; i < pad; i++) {
+        buf[len++] = (unsigned char)('a' + (seq + i) % 26);
+    }
+    return len;
+}
+
+/**
+ * @brief 追加count条记录（内容由各自的序号决定）
+ * @param sp 队列
+ * @param count 记录数
+ * @return 错误数
+ */
+static int append_records(struct mqtt_spool *sp, int count)
+{
+    unsigned char payload[128];
+
+    for (int i = 0; i < count; i++) {
+        uint64_t seq = sp->next_seq;
+        int len = make_payload(seq, payload);
+        if (mqtt_spool_append(sp, TEST_TOPIC, payload, len, seq * 1000) != 0) {
+            printf("append of record %llu failed\n", (unsigned long long)seq);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 从最旧的未确认记录开始读出全部记录，检查恰好是first~last且内容完整
+ * @param name 用例名
+ * @param sp 队列
+ * @param first 期望的第一条记录序号
+ * @param last 期望的最后一条记录序号（小于first表示队列为空）
+ * @return 错误数
+ */
+static int check_replay(const char *name, struct mqtt_spool *sp, uint64_t first, uint64_t last)
+{
+    struct mqtt_spool_record rec;
+    unsigned char payload[128];
+    uint64_t want = last >= first ? last - first + 1 : 0;
+
+    if (mqtt_spool_count(sp) != want) {
+        printf("%s: %llu records queued, expected %llu\n", name,
+               (unsigned long long)mqtt_spool_count(sp), (unsigned long long)want);
+        return 1;
+    }
+
+    mqtt_spool_rewind(sp);
+    for (uint64_t seq = first; seq <= last; seq++) {
+        if (mqtt_spool_next(sp, &rec) != 1) {
+            printf("%s: record %llu not replayed\n", name, (unsigned long long)seq);
+            return 1;
+        }
+        int len = make_payload(seq, payload);
+        if (rec.seq != seq || rec.time_ns != seq * 1000 || rec.topic_len != (int)strlen(TEST_TOPIC) ||
+            memcmp(rec.topic, TEST_TOPIC, rec.topic_len) != 0 || rec.payload_len != len ||
+            memcmp(rec.payload, payload, len) != 0) {
+            printf("%s: replayed record %llu, expected %llu with its original content\n", name,
+                   (unsigned long long)rec.seq, (unsigned long long)seq);
+            return 1;
+        }
+    }
+    if (mqtt_spool_next(sp, &rec) != 0) {
+        printf("%s: unexpected record %llu after %llu\n", name,
+               (unsigned long long)rec.seq, (unsigned long long)last);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 找到指定序号的记录头
+ * @param sp 队列
+ * @param seq 序号
+ * @return 记录头，没有该记录返回NULL
+ */
+static struct mqtt_spool_rec_header *find_record(struct mqtt_spool *sp, uint64_t seq)
+{
+    struct mqtt_spool_record rec;
+
+    mqtt_spool_rewind(sp);
+    while (mqtt_spool_next(sp, &rec) == 1) {
+        if (rec.seq == seq) {
+            return (struct mqtt_spool_rec_header *)(rec.topic - sizeof(struct mqtt_spool_rec_header));
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 关闭后重新打开（模拟进程重启）
+ * @param sp 队列
+ * @return 重新打开的队列，失败返回NULL
+ */
+static struct mqtt_spool *reopen(struct mqtt_spool *sp)
+{
+    mqtt_spool_close(sp);
+    sp = mqtt_spool_open(spool_path, TEST_SIZE);
+    if (sp == NULL) {
+        printf("reopening %s failed\n", spool_path);
+    }
+    return sp;
+}
+
+/**
+ * @brief 主函数
+ * @return 全部通过返回0，否则返回1
+ */
+int main(void)
+{
+    struct mqtt_spool *sp;
+    struct mqtt_spool_rec_header *h;
+    struct mqtt_spool_record rec;
+    int errors = 0;
+
+    int fd = mkstemp(spool_path);
+    if (fd < 0) {
+        perror("mkstemp failed");
+        return 1;
+    }
+    close(fd);
+
+    // 重开后补发全部未确认的记录，确认过的记录不再补发
+    sp = mqtt_spool_open(spool_path, TEST_SIZE);
+    if (sp == NULL) {
+        unlink(spool_path);
+        return 1;
+    }
+    errors += append_records(sp, 10);
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("reopen", sp, 1, 10);
+    mqtt_spool_ack(sp, 3);
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("ack 1-3", sp, 4, 10);
+
+    // 确认时先写序号后写位置：在两次写之间崩溃，位置还停在刚确认的记录上
+    h = find_record(sp, 4);
+    mqtt_spool_ack(sp, 4);
+    if (h != NULL) {
+        sp->hdr->head_off = (unsigned char *)h - sp->data;
+    }
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("crash during ack", sp, 5, 10);
+
+    // 写了一半的队尾记录（magic尚未写入）：不补发，序号由下一条新记录使用
+    errors += append_records(sp, 1);
+    h = find_record(sp, 11);
+    if (h != NULL) {
+        h->magic = 0;
+    }
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("torn tail", sp, 5, 10);
+    errors += append_records(sp, 3);
+    errors += check_replay("append after torn tail", sp, 5, 13);
+
+    // 内容损坏的记录（CRC不符）：扫描在此停止，之前的记录补发，之后的记录丢弃
+    h = find_record(sp, 9);
+    if (h != NULL) {
+        ((unsigned char *)h)[sizeof(*h) + h->topic_len] ^= 0x40;
+    }
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("corrupt record", sp, 5, 8);
+
+    // 回绕：边写边确认，队列始终保留最近的40条，写过数据区若干遍；
+    // 队尾回绕到数据区开头之后重开，补发的记录跨过回绕标记且顺序不变
+    int wraps = 0;
+    mqtt_spool_ack(sp, sp->next_seq - 1);
+    while (wraps < 6 && errors == 0) {
+        errors += append_records(sp, 1);
+        if (mqtt_spool_count(sp) > 40) {
+            mqtt_spool_ack(sp, sp->next_seq - 41);
+        }
+        if (sp->tail_off < sp->hdr->head_off && mqtt_spool_count(sp) == 40) {
+            uint64_t last = sp->next_seq - 1;
+            sp = reopen(sp);
+            if (sp == NULL) {
+                goto out;
+            }
+            errors += check_replay("wrapped", sp, last - 39, last);
+            // 下一次回绕之前不再重开
+            while (sp->tail_off < sp->hdr->head_off && errors == 0) {
+                errors += append_records(sp, 1);
+                mqtt_spool_ack(sp, sp->next_seq - 41);
+            }
+            wraps++;
+        }
+    }
+
+    // 写满：不确认地写入约三倍于数据区的记录，从最旧的记录开始淘汰，剩下的是连续的最新记录
+    mqtt_spool_ack(sp, sp->next_seq - 1);
+    uint64_t first = sp->next_seq;
+    uint64_t evicted = sp->evicted;
+    mqtt_spool_rewind(sp);
+    errors += append_records(sp, 2);
+    mqtt_spool_next(sp, &rec);
+    mqtt_spool_next(sp, &rec);
+    while (sp->next_seq - first < 3 * TEST_SIZE / 100 && errors == 0) {
+        errors += append_records(sp, 1);
+    }
+    uint64_t last = sp->next_seq - 1;
+    uint64_t oldest = sp->hdr->head_seq;
+    if (sp->evicted - evicted != oldest - first || oldest <= first + 2) {
+        printf("eviction: %llu records evicted, oldest remaining %llu, first written %llu\n",
+               (unsigned long long)(sp->evicted - evicted), (unsigned long long)oldest,
+               (unsigned long long)first);
+        errors++;
+    }
+    // 已发出未确认的两条被淘汰后，发送位置移到最旧的剩余记录
+    if (mqtt_spool_next(sp, &rec) != 1 || rec.seq != oldest) {
+        printf("eviction: send position not moved to the oldest record %llu\n", (unsigned long long)oldest);
+        errors++;
+    }
+    errors += check_replay("eviction", sp, oldest, last);
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("eviction after reopen", sp, oldest, last);
+
+    // 超过数据区1/4的消息不入队
+    static unsigned char big[TEST_SIZE / 4];
+    if (mqtt_spool_append(sp, TEST_TOPIC, big, sizeof(big), 0) != -1) {
+        printf("oversized message accepted\n");
+        errors++;
+    }
+
+    // 文件被截断：大小不符，重建为空队列，序号从1开始
+    mqtt_spool_close(sp);
+    if (truncate(spool_path, MQTT_SPOOL_HEADER_SIZE + TEST_SIZE / 2) != 0) {
+        perror("truncate failed");
+        errors++;
+    }
+    sp = mqtt_spool_open(spool_path, TEST_SIZE);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("truncated file", sp, 1, 0);
+    errors += append_records(sp, 5);
+    errors += check_replay("append after truncation", sp, 1, 5);
+
+    // 文件头损坏：重建为空队列
+    sp->hdr->magic ^= 1;
+    sp = reopen(sp);
+    if (sp == NULL) {
+        goto out;
+    }
+    errors += check_replay("corrupt header", sp, 1, 0);
+    mqtt_spool_close(sp);
+
+    unlink(spool_path);
+    printf("mqtt_spool_test: %s\n", errors ? "FAILED" : "passed");
+    return errors ? 1 : 0;
+
+out:
+    unlink(spool_path);
+    printf("mqtt_spool_test: FAILED\n");
+    return 1;
+}
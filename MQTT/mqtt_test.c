@@ -3,7 +3,7 @@
  * MQTT客户端测试程序
  * 功能：连接MQTT服务器并发送"BDS-RTKtest"消息
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-20
+ * 最后修改时间：2026-10-18
  */
 
 #include "mqtt_client.h"
@@ -17,6 +17,8 @@ int main()
     MQTTClient client = NULL;
     int rc = 0;
 
+    mqtt_client_metrics_init();
+
     // 创建MQTT客户端
     client = create_mqtt_client();
     if (client == NULL) {
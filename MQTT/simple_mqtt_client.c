@@ -1,167 +1,192 @@
 /*
  * simple_mqtt_client.c
  * 简单MQTT客户端源文件
- * 功能：使用socket实现基本的MQTT连接和发布功能，不需要外部库
+ * 功能：使用socket实现基本的MQTT连接和发布功能，不需要外部库；
+ *       非实时主题先写入磁盘存储转发队列，服务器恢复后限速补发，不影响实时消息；
+ *       可选MQTT 5：重复的主题用2字节主题别名代替，实时消息带过期时间；
+ *       可选转发基站分流出的NMEA语句（从共享内存读取，合并后按实时消息发布）
  * 代码作者：ClancyShang
- * 最后修改时间：2026-01-20
+ * 最后修改时间：2026-10-18
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
+#include "bds_metrics.h"
+#include "bds_time.h"
+#include "bds_tls.h"
+#include "bds_shmring.h"
+#include "bds_log.h"
+#include "mqtt_codec.h"
+#include "mqtt_spool.h"
 
 // MQTT服务器配置
 #define MQTT_SERVER      "www.bjfzkj.com.cn"
 #define MQTT_PORT        1883
+#define MQTT_TLS_PORT    8883   // 加密传输（-T）时的默认端口
 #define MQTT_CLIENT_ID   "bds_rtk_client"
 #define MQTT_USERNAME    "mqttgnss"
 #define MQTT_PASSWORD    "feizhou@500127"
 #define MQTT_TOPIC       "BDS-RTK/test"
+#define MQTT_SEND_COUNT  5      // 默认发送次数（0表示一直运行）
 
-// MQTT固定头标志位
-#define MQTT_CONNECT     1   // 连接请求
-#define MQTT_PUBLISH     3   // 发布消息
-#define MQTT_CONNACK     2   // 连接确认
+// 指标HTTP端口（0表示不启用）
+#define MQTT_METRICS_PORT 0
 
-// 连接返回码
-#define CONNACK_ACCEPTED 0   // 连接成功
+// 存储转发配置
+#define MQTT_STATUS_TOPIC   "BDS-RTK/status"     // 非实时主题：先写入磁盘队列，按QoS 1补发
+#define MQTT_SPOOL_PATH     "bds_mqtt.spool"     // 队列文件默认路径
+#define MQTT_SPOOL_SIZE     (16 * 1024 * 1024)   // 队列数据区大小（写满时淘汰最旧的消息）
+#define MQTT_DRAIN_RATE     20                   // 默认补发速率上限（条/秒）
+#define MQTT_DRAIN_INFLIGHT 16                   // 已发出未确认的补发消息上限
+#define MQTT_DRAIN_OUTQ_MAX 2048                 // socket发送缓冲区积压超过该值时暂停补发
+#define MQTT_RECONNECT_SEC  5                    // 断线后的重连间隔（秒）
+#define MQTT_IO_TIMEOUT_SEC 5                    // 连接、发送和等待CONNACK的超时（秒）
+#define MQTT_SYNC_SEC       5                    // 队列文件回写间隔（秒）
+#define MQTT_PACKET_SIZE    1024                 // 报文缓冲区大小
 
-/**
- * @brief 计算MQTT消息长度编码
- * @param length 消息长度
- * @param buffer 存储编码后的长度
- * @return 编码后的长度字节数
- */
-int mqtt_encode_length(int length, unsigned char *buffer)
-{
-    int i = 0;
-    do {
-        unsigned char byte = length % 128;
-        length = length / 128;
-        if (length > 0) {
-            byte |= 0x80;
-        }
-        buffer[i++] = byte;
-    } while (length > 0 && i < 4);
-    return i;
-}
+// 共享内存遥测配置（实时消息，断线时丢弃）
+#define MQTT_NMEA_TOPIC     "BDS-RTK/nmea"       // 基站NMEA语句
+#define MQTT_OBSQ_TOPIC     "BDS-RTK/obsq"       // 基站观测质量摘要
+#define MQTT_FEED_PAYLOAD   (MQTT_PACKET_SIZE - 128)  // 一次发布合并的记录总长度上限（留出报文头和属性）
+#define MQTT_FEED_POLL_MS   100                  // 读取共享内存的间隔（毫秒）
+
+// 从共享内存转发的遥测
+enum mqtt_feed_id {
+    MQTT_FEED_NMEA = 0,        // 基站NMEA语句（bds_base -n）
+    MQTT_FEED_OBSQ,            // 基站观测质量摘要（bds_base -Q）
+    MQTT_FEEDS
+};
+
+// 一路共享内存遥测
+struct mqtt_feed {
+    const char *name;          // 基站发布的共享内存名称，NULL表示不转发
+    const char *topic;         // 发布主题
+    const char *what;          // 内容说明（提示信息）
+    int open;                  // 共享内存已打开
+    struct shmring_reader rd;  // 读端
+    uint64_t retry_ns;         // 下次尝试打开共享内存的时间
+};
+
+// MQTT 5配置
+#define MQTT_LIVE_EXPIRY_SEC 5                   // 实时消息默认过期时间（秒）：服务器不再投递过时的改正数
+#define MQTT_ALIAS_SLOTS     8                   // 本端最多使用的主题别名数（另受服务器上限约束）
+#define MQTT_ALIAS_TOPIC_MAX 64                  // 使用别名的主题最大长度
+
+// 客户端状态
+struct mqtt_ctx {
+    int sock_fd;                       // 到服务器的连接，-1表示未连接
+    struct tls_config *tls;            // 加密传输配置，NULL表示明文
+    struct mqtt_spool *spool;          // 非实时消息队列
+    int drain_rate;                    // 补发速率上限（条/秒）
+    double tokens;                     // 可补发的消息数（令牌桶）
+    uint64_t tokens_ns;                // 上次补充令牌的时间
+    uint16_t next_id;                  // 下一个消息ID
+    int inflight;                      // 已发出未确认的补发消息数
+    uint16_t inflight_id[MQTT_DRAIN_INFLIGHT];   // 按发送顺序排列的消息ID
+    uint64_t inflight_seq[MQTT_DRAIN_INFLIGHT];  // 对应的队列记录序号
+    uint64_t sent_seq;                 // 发出过的最大记录序号（之前的记录重发时带DUP标志）
+    int draining;                      // 重连时队列中有积压，补发完成后提示一次
+    int version;                       // 协议级别（MQTT_VERSION_311或MQTT_VERSION_5）
+    uint32_t live_expiry;              // 实时消息过期时间（秒，MQTT 5，0表示不过期）
+    int alias_max;                     // 服务器接受的主题别名上限（CONNACK给出，按连接有效）
+    int alias_count;                   // 本连接已建立的主题别名数
+    char alias_topic[MQTT_ALIAS_SLOTS][MQTT_ALIAS_TOPIC_MAX];  // 别名i+1对应的主题
+    struct mqtt_feed feeds[MQTT_FEEDS];          // 共享内存遥测
+    int in_len;                        // 接收缓冲区中的字节数
+    unsigned char in_buf[MQTT_PACKET_SIZE];      // 服务器下发的报文（PUBACK）
+};
+
+// 运行参数（命令行可覆盖）
+struct mqtt_options {
+    const char *host;          // 服务器地址
+    int port;                  // 服务器端口
+    int count;                 // 发送次数，0表示一直运行
+    const char *spool_path;    // 存储转发队列文件
+    int drain_rate;            // 补发速率上限（条/秒）
+    int metrics_port;          // 指标HTTP端口，0表示不启用
+    int version;               // 协议级别
+    int live_expiry;           // 实时消息过期时间（秒）
+    const char *tls_ca;        // 校验服务器证书的CA文件，非NULL时加密传输
+    int budget_kb;             // 内存预算上限（KB），0表示只输出预算不检查
+    const char *nmea_ring;     // 基站发布NMEA语句的共享内存名称，NULL表示不转发
+    const char *obs_ring;      // 基站发布观测质量摘要的共享内存名称，NULL表示不转发
+    const char *log_file;      // 二进制日志文件，NULL表示只输出文本
+};
+
+static volatile sig_atomic_t mqtt_stop = 0;
+
+// 运行指标编号
+static int m_connects = -1;
+static int m_connect_errors = -1;
+static int m_publishes = -1;
+static int m_publish_errors = -1;
+static int m_bytes_out = -1;
+static int m_bytes_in = -1;
+static int m_live_dropped = -1;
+static int m_spooled = -1;
+static int m_spool_acked = -1;
+static int m_spool_evicted = -1;
+static int m_spool_records = -1;
+static int m_spool_bytes = -1;
+static int m_alias_saved = -1;
 
 /**
- * @brief 创建MQTT连接数据包
- * @param buffer 存储连接数据包
- * @param client_id 客户端ID
- * @param username 用户名
- * @param password 密码
- * @return 连接数据包长度
+ * @brief 注册MQTT客户端运行指标
  */
-int mqtt_create_connect_packet(unsigned char *buffer, const char *client_id, const char *username, const char *password)
+static void mqtt_metrics_init(void)
 {
-    int pos = 0;
-    int remaining_length = 0;
-    
-    // 固定头
-    buffer[pos++] = MQTT_CONNECT << 4;  // 消息类型
-    
-    // 可变头和有效载荷
-    int var_pos = pos;
-    
-    // 协议名（MQTT）
-    buffer[var_pos++] = 0x00; buffer[var_pos++] = 0x04;  // 长度
-    buffer[var_pos++] = 'M'; buffer[var_pos++] = 'Q'; buffer[var_pos++] = 'T'; buffer[var_pos++] = 'T';
-    
-    // 协议级别（MQTT 3.1.1）
-    buffer[var_pos++] = 0x04;
-    
-    // 连接标志
-    buffer[var_pos++] = 0xC0;  // 用户名和密码标志
-    
-    // 保持连接时间
-    buffer[var_pos++] = 0x00; buffer[var_pos++] = 0x14;  // 20秒
-    
-    // 客户端ID
-    int client_id_len = strlen(client_id);
-    buffer[var_pos++] = (client_id_len >> 8) & 0xFF;
-    buffer[var_pos++] = client_id_len & 0xFF;
-    memcpy(&buffer[var_pos], client_id, client_id_len);
-    var_pos += client_id_len;
-    
-    // 用户名
-    int username_len = strlen(username);
-    buffer[var_pos++] = (username_len >> 8) & 0xFF;
-    buffer[var_pos++] = username_len & 0xFF;
-    memcpy(&buffer[var_pos], username, username_len);
-    var_pos += username_len;
-    
-    // 密码
-    int password_len = strlen(password);
-    buffer[var_pos++] = (password_len >> 8) & 0xFF;
-    buffer[var_pos++] = password_len & 0xFF;
-    memcpy(&buffer[var_pos], password, password_len);
-    var_pos += password_len;
-    
-    // 计算剩余长度
-    remaining_length = var_pos - pos;
-    
-    // 编码剩余长度
-    unsigned char length_buf[4];
-    int length_len = mqtt_encode_length(remaining_length, length_buf);
-    
-    // 插入编码后的剩余长度
-    memmove(&buffer[pos + length_len], &buffer[var_pos - remaining_length], remaining_length);
-    memcpy(&buffer[pos], length_buf, length_len);
-    
-    return pos + length_len + remaining_length;
+    m_connects = metrics_register("bds_mqtt_connects_total",
+                                  "MQTT sessions established (reconnects)", METRIC_COUNTER);
+    m_connect_errors = metrics_register("bds_mqtt_connect_errors_total",
+                                        "Failed MQTT connection attempts", METRIC_COUNTER);
+    m_publishes = metrics_register("bds_mqtt_publishes_total",
+                                   "PUBLISH packets sent", METRIC_COUNTER);
+    m_publish_errors = metrics_register("bds_mqtt_publish_errors_total",
+                                        "Failed PUBLISH sends", METRIC_COUNTER);
+    m_bytes_out = metrics_register("bds_mqtt_out_bytes_total",
+                                   "Bytes sent to the MQTT broker", METRIC_COUNTER);
+    m_bytes_in = metrics_register("bds_mqtt_in_bytes_total",
+                                  "Bytes received from the MQTT broker", METRIC_COUNTER);
+    m_live_dropped = metrics_register("bds_mqtt_live_dropped_total",
+                                      "Real-time messages dropped while disconnected", METRIC_COUNTER);
+    m_spooled = metrics_register("bds_mqtt_spooled_total",
+                                 "Non-real-time messages written to the spool", METRIC_COUNTER);
+    m_spool_acked = metrics_register("bds_mqtt_spool_acked_total",
+                                     "Spooled messages acknowledged by the broker", METRIC_COUNTER);
+    m_spool_evicted = metrics_register("bds_mqtt_spool_evicted_total",
+                                       "Oldest spooled messages evicted by a full spool", METRIC_COUNTER);
+    m_spool_records = metrics_register("bds_mqtt_spool_records",
+                                       "Messages waiting in the spool", METRIC_GAUGE);
+    m_spool_bytes = metrics_register("bds_mqtt_spool_bytes",
+                                     "Spool bytes in use", METRIC_GAUGE);
+    m_alias_saved = metrics_register("bds_mqtt_alias_saved_bytes_total",
+                                     "PUBLISH bytes saved by MQTT 5 topic aliases", METRIC_COUNTER);
 }
 
 /**
- * @brief 创建MQTT发布数据包
- * @param buffer 存储发布数据包
- * @param topic 主题
- * @param message 消息内容
- * @return 发布数据包长度
+ * @brief 设置发送和接收超时
+ * @param sock_fd socket描述符
  */
-int mqtt_create_publish_packet(unsigned char *buffer, const char *topic, const char *message)
+static void set_socket_timeouts(int sock_fd)
 {
-    int pos = 0;
-    int remaining_length = 0;
-    
-    // 固定头
-    buffer[pos++] = MQTT_PUBLISH << 4;  // 消息类型
-    
-    // 可变头和有效载荷
-    int var_pos = pos;
-    
-    // 主题
-    int topic_len = strlen(topic);
-    buffer[var_pos++] = (topic_len >> 8) & 0xFF;
-    buffer[var_pos++] = topic_len & 0xFF;
-    memcpy(&buffer[var_pos], topic, topic_len);
-    var_pos += topic_len;
-    
-    // 消息ID（QoS 0不需要）
-    
-    // 消息内容
-    int message_len = strlen(message);
-    memcpy(&buffer[var_pos], message, message_len);
-    var_pos += message_len;
-    
-    // 计算剩余长度
-    remaining_length = var_pos - pos;
-    
-    // 编码剩余长度
-    unsigned char length_buf[4];
-    int length_len = mqtt_encode_length(remaining_length, length_buf);
-    
-    // 插入编码后的剩余长度
-    memmove(&buffer[pos + length_len], &buffer[var_pos - remaining_length], remaining_length);
-    memcpy(&buffer[pos], length_buf, length_len);
-    
-    return pos + length_len + remaining_length;
+    struct timeval tv = { .tv_sec = MQTT_IO_TIMEOUT_SEC, .tv_usec = 0 };
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0 ||
+        setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) {
+        log_errno("setsockopt timeout failed");
+    }
 }
 
 /**
@@ -174,15 +199,7 @@ int connect_to_mqtt_server(const char *server, int port)
 {
     int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (sock_fd < 0) {
-        perror("socket creation failed");
-        return -1;
-    }
-    
-    // 获取服务器地址信息
-    struct hostent *host = gethostbyname(server);
-    if (host == NULL) {
-        fprintf(stderr, "Failed to resolve host: %s\n", server);
-        close(sock_fd);
+        log_errno("socket creation failed");
         return -1;
     }
     
@@ -190,126 +207,786 @@ int connect_to_mqtt_server(const char *server, int port)
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
-    memcpy(&server_addr.sin_addr, host->h_addr, host->h_length);
+
+    // 获取服务器地址信息（数字地址不经过解析器，解析器在libc内部分配内存）
+    if (inet_pton(AF_INET, server, &server_addr.sin_addr) != 1) {
+        struct hostent *host = gethostbyname(server);
+        if (host == NULL) {
+            log_error("Failed to resolve host: %s", server);
+            close(sock_fd);
+            return -1;
+        }
+        memcpy(&server_addr.sin_addr, host->h_addr, host->h_length);
+    }
+    
+    // 服务器不可达时连接、发送和等待CONNACK都在超时后返回，不会长时间阻塞
+    set_socket_timeouts(sock_fd);
     
     // 连接到服务器
     if (connect(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("connect failed");
+        log_errno("connect failed");
         close(sock_fd);
         return -1;
     }
     
-    printf("Connected to MQTT server: %s:%d\n", server, port);
+    log_info("Connected to MQTT server: %s:%d", server, port);
     return sock_fd;
 }
 
 /**
  * @brief 发送MQTT连接请求
  * @param sock_fd socket描述符
+ * @param version 协议级别（MQTT_VERSION_311或MQTT_VERSION_5）
+ * @param alias_max 输出的服务器主题别名上限（MQTT 3.1.1为0）
  * @return 成功返回0，失败返回-1
  */
-int send_mqtt_connect(int sock_fd)
+int send_mqtt_connect(int sock_fd, int version, int *alias_max)
 {
-    unsigned char buffer[1024];
-    int packet_len = mqtt_create_connect_packet(buffer, MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD);
-    
-    int bytes_sent = send(sock_fd, buffer, packet_len, 0);
-    if (bytes_sent < 0) {
-        perror("send connect packet failed");
+    unsigned char buffer[MQTT_PACKET_SIZE];
+    int packet_len;
+
+    if (version == MQTT_VERSION_5) {
+        packet_len = mqtt_create_connect_packet_v5(buffer, sizeof(buffer), MQTT_CLIENT_ID,
+                                                   MQTT_USERNAME, MQTT_PASSWORD);
+    } else {
+        packet_len = mqtt_create_connect_packet(buffer, sizeof(buffer), MQTT_CLIENT_ID,
+                                                MQTT_USERNAME, MQTT_PASSWORD);
+    }
+    if (packet_len < 0) {
+        log_error("connect packet too large");
         return -1;
     }
     
-    printf("Sent MQTT connect packet (%d bytes)\n", bytes_sent);
-    
-    // 接收连接确认
-    unsigned char connack_buf[10];
-    int bytes_received = recv(sock_fd, connack_buf, sizeof(connack_buf), 0);
-    if (bytes_received < 0) {
-        perror("recv connack failed");
+    int bytes_sent = send(sock_fd, buffer, packet_len, MSG_NOSIGNAL);
+    if (bytes_sent < 0) {
+        metrics_inc(m_connect_errors);
+        log_errno("send connect packet failed");
         return -1;
     }
+    metrics_add(m_bytes_out, bytes_sent);
+    
+    log_info("Sent MQTT connect packet (%d bytes)", bytes_sent);
+    
+    // 接收连接确认（MQTT 5的CONNACK带属性，可能分多次到达）
+    struct mqtt_packet pkt;
+    int received = 0;
+    int parsed = 0;
+    while (parsed == 0 && received < (int)sizeof(buffer)) {
+        int bytes_received = tls_recv(sock_fd, &buffer[received], sizeof(buffer) - received, 0);
+        if (bytes_received <= 0) {
+            metrics_inc(m_connect_errors);
+            log_errno("recv connack failed");
+            return -1;
+        }
+        metrics_add(m_bytes_in, bytes_received);
+        received += bytes_received;
+        parsed = (version == MQTT_VERSION_5) ? mqtt_parse_packet_v5(buffer, received, &pkt)
+                                             : mqtt_parse_packet(buffer, received, &pkt);
+    }
     
     // 检查连接确认
-    if (bytes_received >= 4 && (connack_buf[0] & 0xF0) == (MQTT_CONNACK << 4)) {
-        if (connack_buf[3] == CONNACK_ACCEPTED) {
-            printf("MQTT connection accepted\n");
+    if (parsed > 0 && pkt.type == MQTT_CONNACK) {
+        if (pkt.return_code == CONNACK_ACCEPTED) {
+            metrics_inc(m_connects);
+            *alias_max = pkt.topic_alias_max;
+            if (version == MQTT_VERSION_5) {
+                log_info("MQTT 5 connection accepted, topic alias maximum %d", pkt.topic_alias_max);
+            } else {
+                log_info("MQTT connection accepted");
+            }
             return 0;
         } else {
-            fprintf(stderr, "MQTT connection rejected with code: %d\n", connack_buf[3]);
+            metrics_inc(m_connect_errors);
+            log_error("MQTT connection rejected with code: %d", pkt.return_code);
             return -1;
         }
     }
     
-    fprintf(stderr, "Invalid connack packet\n");
+    metrics_inc(m_connect_errors);
+    log_error("Invalid connack packet");
     return -1;
 }
 
+/**
+ * @brief 按连接的协议级别编码PUBLISH：MQTT 5下已建立别名的主题只带2字节别名
+ * @param ctx 客户端状态
+ * @param buffer 存储发布数据包
+ * @param size 缓冲区大小
+ * @param topic 主题
+ * @param payload 消息内容
+ * @param payload_len 消息长度
+ * @param flags 固定头标志（MQTT_PUBLISH_DUP、MQTT_PUBLISH_QOS1）
+ * @param packet_id 消息ID（QoS 0时忽略）
+ * @param expiry 消息过期时间（秒，MQTT 5，0表示不过期）
+ * @return 发布数据包长度，失败返回-1
+ */
+static int mqtt_build_publish(struct mqtt_ctx *ctx, unsigned char *buffer, size_t size, const char *topic,
+                              const unsigned char *payload, int payload_len, int flags, int packet_id,
+                              uint32_t expiry)
+{
+    if (ctx->version != MQTT_VERSION_5) {
+        if (flags & MQTT_PUBLISH_QOS1) {
+            return mqtt_create_publish_packet_qos1(buffer, size, topic, payload, payload_len, packet_id,
+                                                   (flags & MQTT_PUBLISH_DUP) != 0);
+        }
+        return mqtt_create_publish_packet(buffer, size, topic, payload, payload_len);
+    }
+
+    for (int i = 0; i < ctx->alias_count; i++) {
+        if (strcmp(ctx->alias_topic[i], topic) == 0) {
+            int len = mqtt_create_publish_packet_v5(buffer, size, "", payload, payload_len, flags, packet_id,
+                                                    i + 1, expiry);
+            if (len > 0) {
+                metrics_add(m_alias_saved, (int)strlen(topic) - 3);
+            }
+            return len;
+        }
+    }
+
+    // 新主题：别名未用完时带上主题和新别名建立映射（编码成功后才记录，失败的报文不会发出）
+    int alias = 0;
+    if (ctx->alias_count < ctx->alias_max && ctx->alias_count < MQTT_ALIAS_SLOTS &&
+        strlen(topic) < MQTT_ALIAS_TOPIC_MAX) {
+        alias = ctx->alias_count + 1;
+    }
+    int len = mqtt_create_publish_packet_v5(buffer, size, topic, payload, payload_len, flags, packet_id,
+                                            alias, expiry);
+    if (len > 0 && alias > 0) {
+        strcpy(ctx->alias_topic[alias - 1], topic);
+        ctx->alias_count = alias;
+    }
+    return len;
+}
+
 /**
  * @brief 发送MQTT发布消息
- * @param sock_fd socket描述符
+ * @param ctx 客户端状态
  * @param message 要发布的消息
  * @return 成功返回0，失败返回-1
  */
-int send_mqtt_publish(int sock_fd, const char *message)
+int send_mqtt_publish(struct mqtt_ctx *ctx, const char *message)
 {
-    unsigned char buffer[1024];
-    int packet_len = mqtt_create_publish_packet(buffer, MQTT_TOPIC, message);
+    unsigned char buffer[MQTT_PACKET_SIZE];
+    int sock_fd = ctx->sock_fd;
+    int packet_len = mqtt_build_publish(ctx, buffer, sizeof(buffer), MQTT_TOPIC,
+                                        (const unsigned char *)message, strlen(message), 0, 0,
+                                        ctx->live_expiry);
+    if (packet_len < 0) {
+        log_error("publish packet too large");
+        return -1;
+    }
     
-    int bytes_sent = send(sock_fd, buffer, packet_len, 0);
-    if (bytes_sent < 0) {
-        perror("send publish packet failed");
+    // 发送超时只发出一部分时后续报文无法对齐，按失败处理并重连
+    int bytes_sent = send(sock_fd, buffer, packet_len, MSG_NOSIGNAL);
+    if (bytes_sent != packet_len) {
+        metrics_inc(m_publish_errors);
+        log_errno("send publish packet failed");
         return -1;
     }
+    metrics_inc(m_publishes);
+    metrics_add(m_bytes_out, bytes_sent);
     
-    printf("Sent MQTT publish packet (%d bytes)\n", bytes_sent);
-    printf("Published message to topic %s: %s\n", MQTT_TOPIC, message);
+    log_info("Published message to topic %s (%d bytes): %s", MQTT_TOPIC, bytes_sent, message);
     return 0;
 }
 
 /**
- * @brief 主函数
+ * @brief 用队列统计更新指标
+ * @param ctx 客户端状态
+ */
+static void mqtt_spool_metrics(const struct mqtt_ctx *ctx)
+{
+    metrics_set(m_spooled, ctx->spool->appended);
+    metrics_set(m_spool_acked, ctx->spool->acked);
+    metrics_set(m_spool_evicted, ctx->spool->evicted);
+    metrics_set(m_spool_records, mqtt_spool_count(ctx->spool));
+    metrics_set(m_spool_bytes, mqtt_spool_bytes(ctx->spool));
+}
+
+/**
+ * @brief 关闭到服务器的连接，未确认的补发消息重连后重发
+ * @param ctx 客户端状态
+ */
+static void mqtt_session_close(struct mqtt_ctx *ctx)
+{
+    if (ctx->sock_fd < 0) {
+        return;
+    }
+    close(ctx->sock_fd);
+    ctx->sock_fd = -1;
+    ctx->inflight = 0;
+    ctx->in_len = 0;
+    log_info("Disconnected from MQTT server, %llu messages spooled",
+             (unsigned long long)mqtt_spool_count(ctx->spool));
+}
+
+/**
+ * @brief 连接服务器并建立MQTT会话，成功后从最旧的未确认消息开始补发
+ * @param ctx 客户端状态
+ * @param opts 运行参数
  * @return 成功返回0，失败返回-1
  */
-int main()
+static int mqtt_session_open(struct mqtt_ctx *ctx, const struct mqtt_options *opts)
 {
-    int sock_fd = -1;
-    int rc = 0;
-    int send_count = 0;
-    
-    // 连接到MQTT服务器
-    sock_fd = connect_to_mqtt_server(MQTT_SERVER, MQTT_PORT);
+    int sock_fd = connect_to_mqtt_server(opts->host, opts->port);
     if (sock_fd < 0) {
-        fprintf(stderr, "Failed to connect to MQTT server\n");
+        metrics_inc(m_connect_errors);
         return -1;
     }
-    
-    // 发送MQTT连接请求
-    rc = send_mqtt_connect(sock_fd);
-    if (rc != 0) {
-        fprintf(stderr, "Failed to send MQTT connect\n");
+
+    // 加密传输：握手后密钥装入内核TLS，之后的MQTT报文照常send/recv；
+    // 退回用户态转发时换成socketpair的一端，须重新设置超时
+    if (ctx->tls != NULL) {
+        int app_fd = tls_handshake(ctx->tls, sock_fd, opts->host, MQTT_IO_TIMEOUT_SEC * 1000);
+        if (app_fd < 0) {
+            metrics_inc(m_connect_errors);
+            close(sock_fd);
+            return -1;
+        }
+        if (app_fd != sock_fd) {
+            set_socket_timeouts(app_fd);
+        }
+        log_info("TLS established (%s)", tls_mode_name(tls_fd_mode(app_fd)));
+        sock_fd = app_fd;
+    }
+
+    if (send_mqtt_connect(sock_fd, ctx->version, &ctx->alias_max) != 0) {
         close(sock_fd);
         return -1;
     }
-    
-    // 循环发送测试消息，每秒一次
-    const char *test_message = "BDS-RTKtest";
-    while (send_count < 5) {  // 发送5次后退出
-        rc = send_mqtt_publish(sock_fd, test_message);
-        if (rc != 0) {
-            fprintf(stderr, "Failed to send MQTT publish\n");
-            close(sock_fd);
+
+    ctx->sock_fd = sock_fd;
+    ctx->inflight = 0;
+    ctx->in_len = 0;
+    ctx->tokens = 0;
+    ctx->tokens_ns = bds_now_ns();
+    mqtt_spool_rewind(ctx->spool);
+    ctx->alias_count = 0;
+    ctx->draining = mqtt_spool_count(ctx->spool) > 0;
+    if (ctx->draining) {
+        log_info("Draining %llu spooled messages at up to %d/s",
+                 (unsigned long long)mqtt_spool_count(ctx->spool), ctx->drain_rate);
+    }
+    return 0;
+}
+
+/**
+ * @brief 服务器确认补发消息：按发送顺序确认到该消息为止，队列中的记录随之出队
+ * @param ctx 客户端状态
+ * @param packet_id PUBACK中的消息ID
+ */
+static void mqtt_puback(struct mqtt_ctx *ctx, int packet_id)
+{
+    for (int i = 0; i < ctx->inflight; i++) {
+        if (ctx->inflight_id[i] != packet_id) {
+            continue;
+        }
+        mqtt_spool_ack(ctx->spool, ctx->inflight_seq[i]);
+        ctx->inflight -= i + 1;
+        memmove(ctx->inflight_id, &ctx->inflight_id[i + 1], ctx->inflight * sizeof(ctx->inflight_id[0]));
+        memmove(ctx->inflight_seq, &ctx->inflight_seq[i + 1], ctx->inflight * sizeof(ctx->inflight_seq[0]));
+        if (ctx->draining && mqtt_spool_count(ctx->spool) == 0) {
+            ctx->draining = 0;
+            log_info("Spool drained (%llu messages acknowledged)", (unsigned long long)ctx->spool->acked);
+        }
+        return;
+    }
+}
+
+/**
+ * @brief 读取服务器下发的报文，处理PUBACK
+ * @param ctx 客户端状态
+ */
+static void mqtt_read(struct mqtt_ctx *ctx)
+{
+    int n = tls_recv(ctx->sock_fd, &ctx->in_buf[ctx->in_len], sizeof(ctx->in_buf) - ctx->in_len, MSG_DONTWAIT);
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        log_warn("MQTT server closed the connection");
+        mqtt_session_close(ctx);
+        return;
+    }
+    metrics_add(m_bytes_in, n);
+    ctx->in_len += n;
+
+    int pos = 0;
+    while (pos < ctx->in_len) {
+        struct mqtt_packet pkt;
+        int len = (ctx->version == MQTT_VERSION_5)
+                  ? mqtt_parse_packet_v5(&ctx->in_buf[pos], ctx->in_len - pos, &pkt)
+                  : mqtt_parse_packet(&ctx->in_buf[pos], ctx->in_len - pos, &pkt);
+        if (len == 0) {
+            break;
+        }
+        if (len < 0) {
+            log_error("Invalid packet from MQTT server");
+            mqtt_session_close(ctx);
+            return;
+        }
+        if (pkt.type == MQTT_PUBACK) {
+            mqtt_puback(ctx, pkt.packet_id);
+        }
+        pos += len;
+    }
+
+    // 不完整的报文留到下次；缓冲区装满仍不完整时说明报文过长
+    ctx->in_len -= pos;
+    memmove(ctx->in_buf, &ctx->in_buf[pos], ctx->in_len);
+    if (ctx->in_len == (int)sizeof(ctx->in_buf)) {
+        log_error("Packet from MQTT server too large");
+        mqtt_session_close(ctx);
+    }
+}
+
+/**
+ * @brief 按速率补发队列中的消息：实时消息总是先发，socket发送缓冲区有积压时暂停补发
+ * @param ctx 客户端状态
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void mqtt_drain(struct mqtt_ctx *ctx, uint64_t now)
+{
+    unsigned char packet[MQTT_PACKET_SIZE];
+    char topic[MQTT_PACKET_SIZE];
+    struct mqtt_spool_record rec;
+
+    if (ctx->sock_fd < 0) {
+        return;
+    }
+
+    // 令牌桶：按速率补充，最多积累一个发送窗口
+    ctx->tokens += (double)(now - ctx->tokens_ns) * ctx->drain_rate / 1e9;
+    if (ctx->tokens > MQTT_DRAIN_INFLIGHT) {
+        ctx->tokens = MQTT_DRAIN_INFLIGHT;
+    }
+    ctx->tokens_ns = now;
+
+    while (ctx->tokens >= 1 && ctx->inflight < MQTT_DRAIN_INFLIGHT) {
+        int unsent = 0;
+        if (ioctl(ctx->sock_fd, SIOCOUTQ, &unsent) == 0 && unsent > MQTT_DRAIN_OUTQ_MAX) {
+            break;
+        }
+        if (!mqtt_spool_next(ctx->spool, &rec)) {
+            break;
+        }
+
+        // 编码要求以'\0'结尾的主题；放不下的记录直接确认丢弃
+        int len = -1;
+        if (rec.topic_len < (int)sizeof(topic)) {
+            memcpy(topic, rec.topic, rec.topic_len);
+            topic[rec.topic_len] = '\0';
+            if (++ctx->next_id == 0) {
+                ctx->next_id = 1;
+            }
+            int flags = MQTT_PUBLISH_QOS1 | (rec.seq <= ctx->sent_seq ? MQTT_PUBLISH_DUP : 0);
+            len = mqtt_build_publish(ctx, packet, sizeof(packet), topic, rec.payload, rec.payload_len,
+                                     flags, ctx->next_id, 0);
+        }
+        if (len < 0) {
+            log_error("spooled message %llu too large, dropping", (unsigned long long)rec.seq);
+            if (ctx->inflight == 0) {
+                mqtt_spool_ack(ctx->spool, rec.seq);
+            }
+            continue;
+        }
+
+        int bytes_sent = send(ctx->sock_fd, packet, len, MSG_NOSIGNAL);
+        if (bytes_sent != len) {
+            metrics_inc(m_publish_errors);
+            log_errno("send spooled message failed");
+            mqtt_session_close(ctx);
+            return;
+        }
+        metrics_inc(m_publishes);
+        metrics_add(m_bytes_out, bytes_sent);
+
+        ctx->inflight_id[ctx->inflight] = ctx->next_id;
+        ctx->inflight_seq[ctx->inflight] = rec.seq;
+        ctx->inflight++;
+        if (rec.seq > ctx->sent_seq) {
+            ctx->sent_seq = rec.seq;
+        }
+        ctx->tokens -= 1;
+    }
+}
+
+/**
+ * @brief 每秒一次：发布实时消息（未连接时丢弃），状态消息写入存储转发队列
+ * @param ctx 客户端状态
+ * @param count 已发送次数
+ */
+static void mqtt_tick(struct mqtt_ctx *ctx, int count)
+{
+    char status[256];
+
+    // 实时消息过时即无用，不进入队列
+    if (ctx->sock_fd < 0) {
+        metrics_inc(m_live_dropped);
+    } else if (send_mqtt_publish(ctx, "BDS-RTKtest") != 0) {
+        mqtt_session_close(ctx);
+    }
+
+    int len = snprintf(status, sizeof(status),
+                       "{\"seq\":%d,\"time_ms\":%llu,\"connected\":%d,\"spooled\":%llu}",
+                       count + 1, (unsigned long long)(bds_realtime_ns() / 1000000),
+                       ctx->sock_fd >= 0, (unsigned long long)mqtt_spool_count(ctx->spool));
+    if (mqtt_spool_append(ctx->spool, MQTT_STATUS_TOPIC, status, len, bds_realtime_ns()) != 0) {
+        log_error("status message too large for the spool");
+    }
+}
+
+/**
+ * @brief 发布一批共享内存遥测记录（QoS 0，与实时消息相同的过期时间）
+ * @param ctx 客户端状态
+ * @param feed 遥测
+ * @param payload 按原顺序拼接的记录
+ * @param len 长度
+ * @return 成功返回0，失败返回-1
+ */
+static int mqtt_publish_feed(struct mqtt_ctx *ctx, const struct mqtt_feed *feed, const unsigned char *payload,
+                             int len)
+{
+    unsigned char packet[MQTT_PACKET_SIZE];
+
+    int packet_len = mqtt_build_publish(ctx, packet, sizeof(packet), feed->topic, payload, len, 0, 0,
+                                        ctx->live_expiry);
+    if (packet_len < 0) {
+        log_error("%s publish packet too large", feed->what);
+        return -1;
+    }
+    int bytes_sent = send(ctx->sock_fd, packet, packet_len, MSG_NOSIGNAL);
+    if (bytes_sent != packet_len) {
+        metrics_inc(m_publish_errors);
+        log_errno("send %s publish packet failed", feed->what);
+        return -1;
+    }
+    metrics_inc(m_publishes);
+    metrics_add(m_bytes_out, bytes_sent);
+    return 0;
+}
+
+/**
+ * @brief 读取基站发布到共享内存的记录（NMEA语句、观测质量摘要），合并成尽量少的报文发布；未连接时丢弃
+ * @param ctx 客户端状态
+ * @param feed 遥测
+ * @param now 当前时间（单调时钟纳秒）
+ */
+static void mqtt_feed(struct mqtt_ctx *ctx, struct mqtt_feed *feed, uint64_t now)
+{
+    unsigned char payload[MQTT_FEED_PAYLOAD];
+    unsigned char record[MQTT_FEED_PAYLOAD];
+    struct shmring_info info;
+    int len = 0;
+
+    if (feed->name == NULL) {
+        return;
+    }
+    if (!feed->open) {
+        // 基站尚未创建共享内存时按重连间隔重试
+        if (now < feed->retry_ns) {
+            return;
+        }
+        if (shmring_reader_open(&feed->rd, feed->name) != 0) {
+            feed->retry_ns = now + MQTT_RECONNECT_SEC * 1000000000ULL;
+            return;
+        }
+        feed->open = 1;
+        printf("Forwarding %s from shared memory %s to %s\n", feed->what, feed->name, feed->topic);
+    }
+
+    while (1) {
+        int n = shmring_read(&feed->rd, record, sizeof(record), &info, 0);
+        if (n < 0) {
+            // 基站删除了共享内存（退出或重建），重新打开
+            shmring_reader_close(&feed->rd);
+            feed->open = 0;
+            feed->retry_ns = now;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        metrics_add(m_live_dropped, info.lost);
+        if (n > (int)sizeof(record)) {
+            continue;
+        }
+        if (ctx->sock_fd < 0) {
+            metrics_inc(m_live_dropped);
+            continue;
+        }
+
+        // 放不下时先发出已合并的记录
+        if (len + n > (int)sizeof(payload)) {
+            if (mqtt_publish_feed(ctx, feed, payload, len) != 0) {
+                mqtt_session_close(ctx);
+                return;
+            }
+            len = 0;
+        }
+        memcpy(&payload[len], record, n);
+        len += n;
+    }
+
+    if (len > 0 && mqtt_publish_feed(ctx, feed, payload, len) != 0) {
+        mqtt_session_close(ctx);
+    }
+}
+
+/**
+ * @brief 计算poll等待时间：下一次发送、重连、补发令牌到期或读取共享内存遥测
+ * @param ctx 客户端状态
+ * @param now 当前时间（单调时钟纳秒）
+ * @param next_tick 下一次发送时间
+ * @param next_connect 下一次重连时间
+ * @return 等待时间（毫秒）
+ */
+static int mqtt_timeout_ms(const struct mqtt_ctx *ctx, uint64_t now, uint64_t next_tick, uint64_t next_connect)
+{
+    uint64_t next = next_tick;
+
+    if (ctx->sock_fd < 0 && next_connect < next) {
+        next = next_connect;
+    }
+    if (ctx->sock_fd >= 0 && ctx->inflight < MQTT_DRAIN_INFLIGHT &&
+        ctx->spool->send_seq < ctx->spool->next_seq) {
+        // 有待补发的消息：等下一个令牌（发送缓冲区积压时也按此间隔重试）
+        uint64_t wait = (uint64_t)(1e9 / ctx->drain_rate);
+        if (now + wait < next) {
+            next = now + wait;
+        }
+    }
+    for (int i = 0; i < MQTT_FEEDS; i++) {
+        const struct mqtt_feed *feed = &ctx->feeds[i];
+        if (feed->name == NULL) {
+            continue;
+        }
+        // 共享内存没有可等待的描述符，按固定间隔读取；未打开时等到下次重试
+        uint64_t feed_next = feed->open ? now + MQTT_FEED_POLL_MS * 1000000ULL : feed->retry_ns;
+        if (feed_next < next) {
+            next = feed_next;
+        }
+    }
+    return next > now ? (int)((next - now + 999999) / 1000000) : 0;
+}
+
+/**
+ * @brief 退出信号处理
+ * @param sig 信号编号
+ */
+static void mqtt_signal_handler(int sig)
+{
+    (void)sig;
+    mqtt_stop = 1;
+}
+
+/**
+ * @brief 解析命令行参数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @param opts 输出的运行参数
+ * @return 成功返回0，失败返回-1
+ */
+static int parse_options(int argc, char *argv[], struct mqtt_options *opts)
+{
+    int c;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->host = MQTT_SERVER;
+    opts->count = MQTT_SEND_COUNT;
+    opts->spool_path = MQTT_SPOOL_PATH;
+    opts->drain_rate = MQTT_DRAIN_RATE;
+    opts->metrics_port = MQTT_METRICS_PORT;
+    opts->version = MQTT_VERSION_311;
+    opts->live_expiry = MQTT_LIVE_EXPIRY_SEC;
+
+    while ((c = getopt(argc, argv, "H:p:n:q:R:m:5E:T:M:s:Q:G:h")) != -1) {
+        switch (c) {
+        case 'H':
+            opts->host = optarg;
+            break;
+        case 'p':
+            opts->port = atoi(optarg);
+            break;
+        case 'n':
+            opts->count = atoi(optarg);
+            break;
+        case 'q':
+            opts->spool_path = optarg;
+            break;
+        case 'R':
+            opts->drain_rate = atoi(optarg);
+            if (opts->drain_rate <= 0) {
+                fprintf(stderr, "drain rate must be positive\n");
+                return -1;
+            }
+            break;
+        case 'm':
+            opts->metrics_port = atoi(optarg);
+            break;
+        case '5':
+            opts->version = MQTT_VERSION_5;
+            break;
+        case 'E':
+            opts->live_expiry = atoi(optarg);
+            if (opts->live_expiry < 0) {
+                fprintf(stderr, "message expiry must not be negative\n");
+                return -1;
+            }
+            break;
+        case 'T':
+            opts->tls_ca = optarg;
+            break;
+        case 'M':
+            opts->budget_kb = atoi(optarg);
+            if (opts->budget_kb <= 0) {
+                fprintf(stderr, "memory budget must be positive\n");
+                return -1;
+            }
+            break;
+        case 's':
+            opts->nmea_ring = optarg;
+            break;
+        case 'Q':
+            opts->obs_ring = optarg;
+            break;
+        case 'G':
+            opts->log_file = optarg;
+            break;
+        case 'h':
+        default:
+            fprintf(stderr, "Usage: %s [-H host] [-p port] [-n count] [-q spool_file] [-R drain_per_s] "
+                    "[-m metrics_port] [-5] [-E expiry_s] [-T tls_ca.pem] [-M budget_kb] "
+                    "[-s nmea_ring_name] [-Q obs_ring_name] [-G log_file]\n", argv[0]);
             return -1;
         }
-        
-        send_count++;
-        printf("Sent message %d times\n", send_count);
-        
-        // 等待1秒
-        sleep(1);
     }
-    
-    // 断开连接
-    close(sock_fd);
+
+    // 未指定端口时按是否加密选择MQTT的标准端口
+    if (opts->port == 0) {
+        opts->port = opts->tls_ca != NULL ? MQTT_TLS_PORT : MQTT_PORT;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 主函数
+ * @param argc 参数个数
+ * @param argv 参数列表
+ * @return 成功返回0，失败返回-1
+ */
+int main(int argc, char *argv[])
+{
+    static struct mqtt_ctx ctx;
+    struct mqtt_options opts;
+    int send_count = 0;
+
+    if (parse_options(argc, argv, &opts) != 0) {
+        return -1;
+    }
+
+    // 注册运行指标，按需启动HTTP指标端点
+    mqtt_metrics_init();
+    if (opts.metrics_port > 0) {
+        metrics_start_http(opts.metrics_port);
+    }
+
+    // 退出信号打断poll，关闭前回写队列文件
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = mqtt_signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // 异步日志：连接、发布和补发的错误只写入环形缓冲区，由后台线程格式化输出
+    if (log_start("simple_mqtt_client", opts.log_file) != 0) {
+        return -1;
+    }
+
+    // 打开存储转发队列（上次运行未确认的消息在重连后补发）
+    ctx.sock_fd = -1;
+    ctx.drain_rate = opts.drain_rate;
+    ctx.version = opts.version;
+    ctx.live_expiry = opts.live_expiry;
+    ctx.feeds[MQTT_FEED_NMEA] = (struct mqtt_feed){ .name = opts.nmea_ring, .topic = MQTT_NMEA_TOPIC,
+                                                    .what = "NMEA sentences" };
+    ctx.feeds[MQTT_FEED_OBSQ] = (struct mqtt_feed){ .name = opts.obs_ring, .topic = MQTT_OBSQ_TOPIC,
+                                                    .what = "observation quality summaries" };
+    if (opts.tls_ca != NULL) {
+        ctx.tls = tls_client_config(opts.tls_ca);
+        if (ctx.tls == NULL) {
+            return -1;
+        }
+    }
+    ctx.spool = mqtt_spool_open(opts.spool_path, MQTT_SPOOL_SIZE);
+    if (ctx.spool == NULL) {
+        fprintf(stderr, "Failed to open spool %s\n", opts.spool_path);
+        return -1;
+    }
+    if (mqtt_spool_count(ctx.spool) > 0) {
+        printf("Recovered %llu spooled messages from %s\n",
+               (unsigned long long)mqtt_spool_count(ctx.spool), opts.spool_path);
+    }
+
+    // 初始化结束：输出内存预算，之后不再分配内存
+    pool_account("mqtt", "session context", &ctx, sizeof(ctx), 1, POOL_PER_CONN);
+    if (pool_seal("simple_mqtt_client", opts.budget_kb) != 0) {
+        mqtt_spool_close(ctx.spool);
+        return -1;
+    }
+
+    uint64_t now = bds_now_ns();
+    uint64_t next_tick = now;
+    uint64_t next_connect = now;
+    uint64_t next_sync = now + MQTT_SYNC_SEC * 1000000000ULL;
+
+    // 每秒发送一次；服务器不可达时实时消息丢弃、状态消息进入队列，按间隔重连
+    while (!mqtt_stop && (opts.count == 0 || send_count < opts.count)) {
+        now = bds_now_ns();
+        if (ctx.sock_fd < 0 && now >= next_connect) {
+            if (mqtt_session_open(&ctx, &opts) != 0) {
+                log_warn("Failed to connect to MQTT server, retrying in %d s", MQTT_RECONNECT_SEC);
+                next_connect = bds_now_ns() + MQTT_RECONNECT_SEC * 1000000000ULL;
+            }
+            now = bds_now_ns();
+        }
+        if (now >= next_tick) {
+            mqtt_tick(&ctx, send_count);
+            send_count++;
+            log_info("Sent message %d times", send_count);
+            next_tick += 1000000000ULL;
+        }
+        for (int i = 0; i < MQTT_FEEDS; i++) {
+            mqtt_feed(&ctx, &ctx.feeds[i], now);
+        }
+        mqtt_drain(&ctx, now);
+        if (now >= next_sync) {
+            mqtt_spool_sync(ctx.spool);
+            next_sync = now + MQTT_SYNC_SEC * 1000000000ULL;
+        }
+        mqtt_spool_metrics(&ctx);
+
+        struct pollfd pfd = { .fd = ctx.sock_fd, .events = POLLIN };
+        int n = poll(&pfd, 1, mqtt_timeout_ms(&ctx, now, next_tick, next_connect));
+        if (n < 0 && errno != EINTR) {
+            log_errno("poll failed");
+            break;
+        }
+        if (n > 0 && pfd.revents) {
+            mqtt_read(&ctx);
+        }
+    }
+
+    // 断开连接（未确认的消息留在队列文件中，下次运行时补发）
+    mqtt_session_close(&ctx);
+    mqtt_spool_close(ctx.spool);
+    for (int i = 0; i < MQTT_FEEDS; i++) {
+        if (ctx.feeds[i].open) {
+            shmring_reader_close(&ctx.feeds[i].rd);
+        }
+    }
+    log_stop();
     
     printf("MQTT test completed successfully. Sent message %d times\n", send_count);
     return 0;